@@ -0,0 +1,4 @@
+# Provides jsonc::static and jsonc::shared.
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+include("${CMAKE_CURRENT_LIST_DIR}/jsonc-targets.cmake")
@@ -3,10 +3,14 @@
 
 #ifdef __cplusplus
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
 extern "C" {
 #else
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #endif
 
 typedef enum jsonc_value_type {
@@ -32,14 +36,26 @@ typedef struct jsonc_object {
   size_t count;
 } jsonc_object;
 
+// Longest string kept inline in jsonc_value.value.small.
+#define JSONC_SMALL_STRING_MAX 15
+
+// `capacity` is the number of member slots allocated for an array or object,
+// kept in what would otherwise be padding. Zero means exactly `count`, which
+// is what the parser produces. For a string, a nonzero `capacity` means the
+// text is stored inline in `small` and is capacity - 1 bytes long; otherwise
+// `string` points to it. Read strings with jsonc_string_get. The root of a
+// tree from jsonc_compact has a capacity of UINT32_MAX. Trees built by hand
+// must leave `capacity` zero.
 struct jsonc_value {
   jsonc_value_type type;
+  uint32_t capacity;
   union {
     bool boolean;
     double number;
     char *string;
     jsonc_object object;
     jsonc_array array;
+    char small[JSONC_SMALL_STRING_MAX + 1];
   } value;
 };
 
@@ -50,8 +66,571 @@ struct jsonc_object_entry {
 
 typedef bool err_t;
 
+typedef enum jsonc_error_code {
+  JSONC_ERROR_NONE,
+  JSONC_ERROR_UNEXPECTED_CHARACTER,
+  JSONC_ERROR_UNEXPECTED_END,
+  JSONC_ERROR_UNTERMINATED_STRING,
+  JSONC_ERROR_UNTERMINATED_COMMENT,
+  JSONC_ERROR_INVALID_UTF8,
+  JSONC_ERROR_BAD_ESCAPE,
+  JSONC_ERROR_UNEXPECTED_TOKEN,
+  JSONC_ERROR_TRAILING_DATA,
+  JSONC_ERROR_MAX_DEPTH,
+  JSONC_ERROR_MAX_DOCUMENT_SIZE,
+  JSONC_ERROR_MAX_STRING_LENGTH,
+  JSONC_ERROR_MAX_ARRAY_SIZE,
+  JSONC_ERROR_MAX_OBJECT_SIZE,
+  JSONC_ERROR_TYPE_MISMATCH,
+  JSONC_ERROR_SCHEMA_NOT_ALLOWED,
+  JSONC_ERROR_SCHEMA_REQUIRED,
+  JSONC_ERROR_SCHEMA_ENUM,
+  JSONC_ERROR_SCHEMA_MINIMUM,
+  JSONC_ERROR_SCHEMA_MAXIMUM,
+  JSONC_ERROR_SCHEMA_MAX_LENGTH,
+  JSONC_ERROR_READ,
+  JSONC_ERROR_PATCH_INVALID,
+  JSONC_ERROR_PATCH_PATH,
+  JSONC_ERROR_PATCH_TEST,
+} jsonc_error_code;
+
+// Bits of jsonc_error.expected: what the parser would have accepted at the
+// error position.
+typedef enum jsonc_expect {
+  JSONC_EXPECT_VALUE = 1 << 0,
+  JSONC_EXPECT_KEY = 1 << 1,
+  JSONC_EXPECT_COLON = 1 << 2,
+  JSONC_EXPECT_COMMA = 1 << 3,
+  JSONC_EXPECT_RIGHT_BRACKET = 1 << 4,
+  JSONC_EXPECT_RIGHT_BRACE = 1 << 5,
+  JSONC_EXPECT_EOF = 1 << 6,
+} jsonc_expect;
+
+// `offset` is a byte offset into the source. `line` and `column` are 1-based
+// (column counts bytes) and are derived from `offset` only once an error has
+// occurred. `expected` is zero for errors raised by the tokenizer.
+typedef struct jsonc_error {
+  jsonc_error_code code;
+  size_t offset;
+  size_t line;
+  size_t column;
+  unsigned expected;
+} jsonc_error;
+
+typedef struct jsonc_schema jsonc_schema;
+typedef struct jsonc_intern jsonc_intern;
+typedef struct jsonc_source_map jsonc_source_map;
+
+// JSON5-style extensions accepted when set in jsonc_parse_options.flags.
+// Identifiers are ASCII letters, digits, '_' and '$', not starting with a
+// digit. With no flags set the parser is strict and runs exactly as fast as
+// it would without these.
+typedef enum jsonc_parse_flags {
+  // Object keys may be bare identifiers: {name: 1}.
+  JSONC_PARSE_UNQUOTED_KEYS = 1 << 0,
+  // Strings may be enclosed in '...', in which '"' needs no escape.
+  JSONC_PARSE_SINGLE_QUOTES = 1 << 1,
+  // 0x1F and -0xff.
+  JSONC_PARSE_HEX_NUMBERS = 1 << 2,
+  // NaN and Infinity, optionally signed.
+  JSONC_PARSE_NAN_INFINITY = 1 << 3,
+  // A leading '+', and a leading or trailing '.': +1, .5, 5.
+  JSONC_PARSE_LENIENT_NUMBERS = 1 << 4,
+  JSONC_PARSE_JSON5 = (1 << 5) - 1,
+} jsonc_parse_flags;
+
+// Resource limits for jsonc_parse_ex. A limit of zero means unlimited.
+// max_document_size is in bytes of source text and max_string_length in bytes
+// of decoded UTF-8; exceeding a limit fails with the matching error code.
+// With a `schema` every value is validated as soon as it is read, so the
+// parse stops at the first violation (see jsonc_schema_compile). With an
+// `intern` table jsonc_parse_ex deduplicates strings (see
+// jsonc_intern_create), and with a `source_map` it records where every value
+// and key came from (see jsonc_source_map_create). `flags` is a set of
+// jsonc_parse_flags.
+typedef struct jsonc_parse_options {
+  size_t max_depth;
+  size_t max_document_size;
+  size_t max_string_length;
+  size_t max_array_size;
+  size_t max_object_size;
+  const jsonc_schema *schema;
+  jsonc_intern *intern;
+  jsonc_source_map *source_map;
+  unsigned flags;
+} jsonc_parse_options;
+
 err_t jsonc_parse(const char *source, jsonc_value *out, bool *out_is_error);
+// `options` may be NULL. On failure out_error->code is not JSONC_ERROR_NONE
+// and `out` is left untouched.
+err_t jsonc_parse_ex(const char *source, const jsonc_parse_options *options,
+                     jsonc_value *out, jsonc_error *out_error);
 void jsonc_free(jsonc_value value);
+const char *jsonc_error_message(jsonc_error_code code);
+// Text of a string value, NUL-terminated, wherever it is stored.
+// `out_length` may be NULL.
+const char *jsonc_string_get(const jsonc_value *value, size_t *out_length);
+
+// Parses what remains of `file` as jsonc_parse_ex does, without first
+// reading it all: where threads are available a second thread reads it in
+// large blocks while the text that has arrived is parsed, so the time taken
+// is close to the longer of reading and parsing rather than their sum. The
+// file is not closed. Reading stops with the parse: a document that parses
+// has been read to the end of the file, but after a syntax error or a
+// limit the file is left at some point past the error. A read error fails
+// with JSONC_ERROR_READ at the number of bytes read.
+err_t jsonc_parse_file(FILE *file, const jsonc_parse_options *options,
+                       jsonc_value *out, jsonc_error *out_error);
+// Called once jsonc_parse_file_async is done, with what jsonc_parse_file
+// would have returned. `value` belongs to the callback if `out_of_memory` is
+// false and error->code is JSONC_ERROR_NONE.
+typedef void (*jsonc_file_callback)(void *context, err_t out_of_memory,
+                                    jsonc_value value,
+                                    const jsonc_error *error);
+// Runs jsonc_parse_file on a thread of its own and calls `callback` on it.
+// `options` is copied; the schema, intern table and source map it names, and
+// `file`, must last until the callback. Where no thread can be started the
+// parse runs, and the callback is called, before this returns.
+err_t jsonc_parse_file_async(FILE *file, const jsonc_parse_options *options,
+                             jsonc_file_callback callback, void *context);
+
+typedef enum jsonc_strip_flags {
+  // Also drop a comma that is followed, past whitespace and comments, by
+  // ']' or '}'.
+  JSONC_STRIP_TRAILING_COMMAS = 1 << 0,
+  // Blank out what is dropped with spaces instead of removing it, so that
+  // every offset, line and column in the output matches the source.
+  JSONC_STRIP_PRESERVE_OFFSETS = 1 << 1,
+} jsonc_strip_flags;
+
+// Turns JSONC into JSON without parsing it: copies the `length` bytes of
+// `source` to `out` minus its comments, and sets *out_length to the length
+// of the result, which is followed by a NUL. Newlines inside comments are
+// kept, so lines still match the source. Only double-quoted strings are
+// recognized and nothing else is validated. `out` needs room for `length`
+// + 1 bytes and may be `source` itself, to strip in place. An unterminated
+// comment fails with JSONC_ERROR_UNTERMINATED_COMMENT, leaving the content
+// of `out` unspecified. `flags` is a set of jsonc_strip_flags.
+void jsonc_strip(const char *source, size_t length, unsigned flags, char *out,
+                 size_t *out_length, jsonc_error *out_error);
+
+// A reusable parse context. Parsing through one keeps the scratch buffers a
+// parse needs (token queue, string buffer, container stacks) between calls,
+// at the largest size any parse needed, so that a loop of parses allocates
+// only the trees it returns once it has warmed up. A parser is not locked:
+// give each thread its own.
+typedef struct jsonc_parser jsonc_parser;
+
+// After each parse, scratch buffers larger than `max_retained` bytes are
+// shrunk back to that size; zero keeps them at any size.
+err_t jsonc_parser_create(size_t max_retained, jsonc_parser **out);
+void jsonc_parser_free(jsonc_parser *parser);
+// Parses as jsonc_parse_ex does.
+err_t jsonc_parser_parse(jsonc_parser *parser, const char *source,
+                         const jsonc_parse_options *options, jsonc_value *out,
+                         jsonc_error *out_error);
+// Bytes of scratch buffers the parser holds between parses. It stops
+// growing once the parser has seen its largest document.
+size_t jsonc_parser_retained(const jsonc_parser *parser);
+
+// A parsed document kept up to date as its text is edited, for editors that
+// parse on every keystroke. An edit parses again only the innermost array or
+// object whose brackets enclose it and splices that into the tree, so its
+// cost follows the size of that container rather than of the document. The
+// tree always equals what jsonc_parse_ex gives for the new text: edits that
+// touch a container's brackets, that change where the enclosing container
+// ends, or that are made with a schema, fall back to a full parse.
+typedef struct jsonc_document jsonc_document;
+
+// Copies `source`; the document is created even if it has a syntax error.
+// `options` may be NULL; it is copied.
+err_t jsonc_document_create(const char *source,
+                            const jsonc_parse_options *options,
+                            jsonc_document **out);
+void jsonc_document_free(jsonc_document *document);
+// Replaces the `removed` bytes at `offset` with `inserted_length` bytes of
+// `inserted`, which must not contain NUL. Pointers into the previous tree
+// are invalidated. If out of memory the document is left as it was.
+err_t jsonc_document_edit(jsonc_document *document, size_t offset,
+                          size_t removed, const char *inserted,
+                          size_t inserted_length);
+// The current text, NUL-terminated; `out_length` may be NULL.
+const char *jsonc_document_source(const jsonc_document *document,
+                                  size_t *out_length);
+// NULL while the text has an error, which jsonc_document_error describes.
+const jsonc_value *jsonc_document_root(const jsonc_document *document);
+const jsonc_error *jsonc_document_error(const jsonc_document *document);
+
+// A tree shared by threads that only read it, freed with its last
+// reference. Nothing may change it once it is shared.
+typedef struct jsonc_shared jsonc_shared;
+
+// Takes ownership of `value`, which is released with jsonc_free in the end,
+// so it must not be interned or come from jsonc_clone. The caller holds the
+// one reference. If out of memory the caller still owns `value`.
+err_t jsonc_shared_create(jsonc_value value, jsonc_shared **out);
+const jsonc_value *jsonc_shared_root(const jsonc_shared *shared);
+// Adds a reference and returns `shared`.
+jsonc_shared *jsonc_shared_retain(jsonc_shared *shared);
+// Drops a reference; NULL is ignored.
+void jsonc_shared_release(jsonc_shared *shared);
+
+// The current version of a shared tree, such as a configuration that worker
+// threads read while another thread reloads it. Each reading thread uses
+// its own index below `max_readers`. Reads never wait, allocate or write
+// to memory other readers touch. Publishing swaps in a new tree at once and
+// retires the old one; a retired tree is released by the first publish or
+// reclaim that finds no reader can still be using it. Publish and reclaim
+// calls must not overlap each other, but may overlap any reads.
+typedef struct jsonc_snapshot jsonc_snapshot;
+
+// Takes the caller's reference to `initial`, which may be NULL.
+err_t jsonc_snapshot_create(size_t max_readers, jsonc_shared *initial,
+                            jsonc_snapshot **out);
+// Releases the current and retired trees. No read may be in progress.
+void jsonc_snapshot_free(jsonc_snapshot *snapshot);
+// Starts a read and returns the current tree, or NULL if there is none. It
+// stays valid until the same reader leaves or enters again; retain it to
+// keep it longer.
+jsonc_shared *jsonc_snapshot_enter(jsonc_snapshot *snapshot, size_t reader);
+void jsonc_snapshot_leave(jsonc_snapshot *snapshot, size_t reader);
+// Makes `shared`, which may be NULL, current and takes the caller's
+// reference to it. If out of memory nothing changes.
+err_t jsonc_snapshot_publish(jsonc_snapshot *snapshot, jsonc_shared *shared);
+// Releases the retired trees that no reader can still be using.
+void jsonc_snapshot_reclaim(jsonc_snapshot *snapshot);
+
+// String interning for record-heavy documents. Trees parsed with a table in
+// jsonc_parse_options.intern take their keys, and string values of at most
+// `max_value_length` bytes (none if it is 0) that are too long to be stored
+// inline, from the table, so equal strings are stored once and keys can be
+// compared by pointer. Release such trees with jsonc_free_interned before
+// freeing the table, and do not change them with the builder API. A table
+// can serve any number of parses, one at a time.
+err_t jsonc_intern_create(size_t max_value_length, jsonc_intern **out);
+void jsonc_intern_free(jsonc_intern *table);
+// The table's copy of `string`, or NULL if it holds none.
+const char *jsonc_intern_find(const jsonc_intern *table, const char *string);
+void jsonc_free_interned(jsonc_value value, const jsonc_intern *table);
+
+// Source locations, for tools that report against the user's text. A parse
+// given a map in jsonc_parse_options.source_map records the span of every
+// value and object key it builds in arrays beside the tree, so jsonc_value
+// stays as it is and parses without a map do no extra work.
+// jsonc_parse_ex, jsonc_parser_parse and jsonc_parse_file fill it; other
+// functions ignore it. Each parse replaces what the map held and a failed one
+// leaves it empty. The map describes the tree as parsed, so it must not be
+// used once the tree has been changed, compacted or freed. A map can serve
+// any number of parses, one at a time.
+typedef struct jsonc_span {
+  size_t offset;
+  size_t length;
+} jsonc_span;
+
+err_t jsonc_source_map_create(jsonc_source_map **out);
+void jsonc_source_map_free(jsonc_source_map *map);
+// Where `value`, a node of the tree last parsed with `map`, came from:
+// brackets and quotes included, and for object members also the key's span
+// (a zero span for other nodes). Returns false for values that are not in
+// the tree. Either output may be NULL.
+bool jsonc_source_map_find(jsonc_source_map *map, const jsonc_value *value,
+                           jsonc_span *out_span, jsonc_span *out_key);
+// Line and column of `offset` as in jsonc_error, in `source`, the text that
+// was parsed. The first call after each parse indexes the lines of `source`;
+// later calls take a binary search.
+err_t jsonc_source_map_locate(jsonc_source_map *map, const char *source,
+                              size_t offset, size_t *out_line,
+                              size_t *out_column);
+
+// Builder API. Constructors return values owned by the caller. Inserting a
+// value into a container moves it there; if the call fails the caller still
+// owns it. Containers grow geometrically, so appends are amortized O(1). Trees
+// from jsonc_clone cannot be modified in place.
+jsonc_value jsonc_null_new(void);
+jsonc_value jsonc_boolean_new(bool boolean);
+jsonc_value jsonc_number_new(double number);
+err_t jsonc_string_new(const char *string, jsonc_value *out);
+jsonc_value jsonc_array_new(void);
+jsonc_value jsonc_object_new(void);
+err_t jsonc_reserve(jsonc_value *container, size_t capacity);
+err_t jsonc_array_push(jsonc_value *array, jsonc_value value);
+// Fails if `index` is past the end of the array.
+err_t jsonc_array_insert(jsonc_value *array, size_t index, jsonc_value value);
+void jsonc_array_remove(jsonc_value *array, size_t index);
+jsonc_value *jsonc_object_get(const jsonc_value *object, const char *key);
+// Like jsonc_object_get on an interned tree, for a key from
+// jsonc_intern_find; keys are compared by pointer only.
+jsonc_value *jsonc_object_get_interned(const jsonc_value *object,
+                                       const char *key);
+// Replaces the value of the first member named `key`, or appends a member.
+err_t jsonc_object_set(jsonc_value *object, const char *key,
+                       jsonc_value value);
+// Removes the first member named `key`, keeping the order of the others.
+// Returns whether a member was removed.
+bool jsonc_object_remove(jsonc_value *object, const char *key);
+
+typedef enum jsonc_equal_flags {
+  JSONC_EQUAL_IGNORE_KEY_ORDER = 1 << 0,
+} jsonc_equal_flags;
+
+// Deep copy of `value` in a single allocation holding the root, all member
+// arrays and all strings. Returns NULL if out of memory. Release the result
+// with free(), not jsonc_free, and do not grow its containers in place.
+jsonc_value *jsonc_clone(const jsonc_value *value);
+// Structural equality. Numbers compare with ==. With
+// JSONC_EQUAL_IGNORE_KEY_ORDER object members are matched by key instead of
+// by position: the n-th member with a given key in `a` with the n-th member
+// with that key in `b`.
+err_t jsonc_equal(const jsonc_value *a, const jsonc_value *b, unsigned flags,
+                  bool *out_equal);
+// 64-bit structural hash that is the same across runs and platforms. It does
+// not depend on object key order, so values that compare equal in either
+// jsonc_equal mode hash alike.
+err_t jsonc_hash(const jsonc_value *value, uint64_t *out_hash);
+
+typedef enum jsonc_diff_format {
+  // RFC 6902: an array of operations such as
+  // {"op": "replace", "path": "/a/0", "value": 1}.
+  JSONC_DIFF_JSON_PATCH,
+  // RFC 7386: an object with the members to set, and null for those to
+  // remove.
+  JSONC_DIFF_MERGE_PATCH,
+} jsonc_diff_format;
+
+// Computes a patch that turns `a` into `b`, in time roughly linear in the
+// size of the trees. Both are hashed once up front so that most differing
+// subtrees are told apart by their hashes; subtrees whose hashes agree are
+// compared in full, once, and then skipped. Object members are matched by
+// key, ignoring key order and all but the first member with a key, through a
+// hash index for large objects. Arrays are compared element by element once
+// their common start and end are set aside, so an insertion or removal in
+// one place costs one operation. JSON Patches use only add, remove and
+// replace. A merge patch cannot set a member to null, which it would remove
+// instead, and replaces arrays that differ as a whole. Release the patch
+// with jsonc_free.
+err_t jsonc_diff(const jsonc_value *a, const jsonc_value *b,
+                 jsonc_diff_format format, jsonc_value *out_patch);
+// Applies a patch to `target`, which must be modifiable with the builder
+// API. A JSON Patch is applied completely or not at all: if an operation
+// fails out_error->code says why, out_error->offset is the index of the
+// operation, and the changes before it are undone, as they are when memory
+// runs out. An operation that repeats "op", "path", "from" or "value" is
+// invalid. Paths are looked up member by member, so each operation costs
+// time linear in the size of the containers on its path. A merge patch
+// cannot fail, but running out of memory leaves `target` partly patched.
+err_t jsonc_apply_patch(jsonc_value *target, const jsonc_value *patch,
+                        jsonc_diff_format format, jsonc_error *out_error);
+
+// Heap bytes held by a tree, not counting the root jsonc_value itself.
+// `nodes` covers the member arrays of arrays and objects, spare capacity
+// included. `overhead` estimates what a typical malloc adds to each of the
+// `allocations` blocks for headers and rounding. Inline strings cost
+// nothing beyond their node; interned strings are counted at every use.
+typedef struct jsonc_memory_stats {
+  size_t nodes;
+  size_t keys;
+  size_t strings;
+  size_t overhead;
+  size_t allocations;
+} jsonc_memory_stats;
+
+err_t jsonc_memory_usage(const jsonc_value *value, jsonc_memory_stats *out);
+// Moves the tree owned by `value` into a single exact-size block: member
+// arrays in breadth-first order, so that siblings and then cousins are
+// adjacent, followed by all key and string bytes. The result is still
+// released with jsonc_free, but must not be changed with the builder API.
+// Not for interned trees. On failure `value` is left as it was.
+err_t jsonc_compact(jsonc_value *value);
+
+// Resolves an RFC 6901 JSON Pointer such as "/servers/3/limits/cpu" against a
+// parsed tree. Returns NULL if the pointer is malformed or names nothing.
+// Objects with duplicate keys resolve to the first matching member.
+const jsonc_value *jsonc_pointer_get(const jsonc_value *root,
+                                     const char *pointer);
+// Evaluates `count` pointers in a single pass over `source` without building
+// the full tree: only the values the pointers name are materialized, other
+// subtrees are skipped, and reading stops as soon as every pointer is
+// resolved. out_found[i] tells whether out_values[i] was set; each found
+// value is owned by the caller and released with jsonc_free. Syntax errors
+// past the point where reading stopped are not reported.
+err_t jsonc_extract(const char *source, const jsonc_parse_options *options,
+                    const char *const *pointers, size_t count,
+                    jsonc_value *out_values, bool *out_found,
+                    jsonc_error *out_error);
+
+typedef enum jsonc_column_type {
+  JSONC_COLUMN_DOUBLE,
+  // Integral numbers within the range of int64_t. Numbers are read as
+  // doubles, so values beyond 2^53 are rounded.
+  JSONC_COLUMN_INT64,
+  JSONC_COLUMN_BOOLEAN,
+  JSONC_COLUMN_STRING,
+} jsonc_column_type;
+
+typedef enum jsonc_column_flags {
+  // Booleans are packed one bit per row instead of one byte, as Arrow
+  // expects.
+  JSONC_COLUMNS_ARROW = 1 << 0,
+} jsonc_column_flags;
+
+// One output column of jsonc_extract_columns. The caller sets `key` and
+// `type`; the rest is filled in. Every buffer is 64-byte aligned and zero
+// padded to a multiple of 64 bytes, so it can be handed to Arrow as is.
+//
+// `values` holds one double, int64_t or boolean per row; string rows are
+// bytes offsets[i] to offsets[i + 1] of `data` (Arrow's large string
+// layout). Bit i of `validity`, least significant bit first, is clear if
+// row i is null or lacks the key; the slots of such rows are zero.
+typedef struct jsonc_column {
+  const char *key;
+  jsonc_column_type type;
+  void *values;
+  int64_t *offsets;
+  char *data;
+  uint8_t *validity;
+  size_t null_count;
+} jsonc_column;
+
+// Reads a document that is an array of objects, such as
+// [{"ts": 1, "v": 0.5}, ...], straight into one column per key with no
+// intermediate tree. Members whose key has no column are skipped; a key
+// given to several columns fills only the first, and a key repeated within
+// an object keeps its last value. An element that is not an object, or a
+// value of another type than its column, fails with
+// JSONC_ERROR_TYPE_MISMATCH. On success release the buffers with
+// jsonc_columns_free; on failure none are left allocated.
+err_t jsonc_extract_columns(const char *source,
+                            const jsonc_parse_options *options,
+                            unsigned flags, jsonc_column *columns,
+                            size_t column_count, size_t *out_row_count,
+                            jsonc_error *out_error);
+void jsonc_columns_free(jsonc_column *columns, size_t column_count);
+// Reads the array that `pointer` names, such as "/samples" in
+// {"t0": 0, "samples": [0.12, 3.4, 17, ...]}, straight into `column`, one
+// row per element, with no intermediate tree: a JSONC_COLUMN_DOUBLE or
+// JSONC_COLUMN_INT64 column takes 8 bytes per number where a tree takes a
+// jsonc_value of 24. `column->key` is ignored. Elements are stored, and
+// type mismatches fail, as the values of a key in jsonc_extract_columns; a
+// value that is not an array fails the same way. *out_found is false, and
+// nothing is allocated, if the pointer is malformed or names nothing.
+// Reading stops at the end of the array, so syntax errors past it are not
+// reported. Release the buffers with jsonc_columns_free(column, 1).
+err_t jsonc_extract_array(const char *source,
+                          const jsonc_parse_options *options,
+                          const char *pointer, unsigned flags,
+                          jsonc_column *column, size_t *out_row_count,
+                          bool *out_found, jsonc_error *out_error);
+
+typedef enum jsonc_event_type {
+  JSONC_EVENT_ERROR,
+  JSONC_EVENT_EOF,
+  JSONC_EVENT_NULL,
+  JSONC_EVENT_BOOLEAN,
+  JSONC_EVENT_NUMBER,
+  JSONC_EVENT_STRING,
+  JSONC_EVENT_KEY,
+  JSONC_EVENT_BEGIN_ARRAY,
+  JSONC_EVENT_END_ARRAY,
+  JSONC_EVENT_BEGIN_OBJECT,
+  JSONC_EVENT_END_OBJECT,
+} jsonc_event_type;
+
+// One step of a document walk. For JSONC_EVENT_STRING and JSONC_EVENT_KEY,
+// `value.string` holds the decoded text and stays valid until the next call
+// on the reader. `offset` is the byte offset of the token in the source.
+typedef struct jsonc_event {
+  jsonc_event_type type;
+  union {
+    bool boolean;
+    double number;
+    struct {
+      const char *data;
+      size_t length;
+    } string;
+  } value;
+  size_t offset;
+} jsonc_event;
+
+// Pull parser over the same grammar, limits and errors as jsonc_parse_ex,
+// for callers that map documents onto their own types. The first event is a
+// value, the last is JSONC_EVENT_EOF or JSONC_EVENT_ERROR, after which every
+// call yields the same event again. `source` must outlive the reader.
+typedef struct jsonc_reader jsonc_reader;
+
+// `options` may be NULL; it is copied.
+err_t jsonc_reader_create(const char *source,
+                          const jsonc_parse_options *options,
+                          jsonc_reader **out);
+void jsonc_reader_destroy(jsonc_reader *reader);
+err_t jsonc_reader_next(jsonc_reader *reader, jsonc_event *out);
+// Consumes the rest of the value that `first`, the last event returned,
+// starts. Afterwards `first` is JSONC_EVENT_ERROR if the source was invalid.
+err_t jsonc_reader_skip(jsonc_reader *reader, jsonc_event *first);
+// The error behind the last JSONC_EVENT_ERROR, with line and column set.
+const jsonc_error *jsonc_reader_error(jsonc_reader *reader);
+// Fills in error->line and error->column from error->offset, for errors that
+// callers raise against offsets of their own.
+void jsonc_error_locate(const char *source, jsonc_error *error);
+// JSON Pointer to the value, or object key, at error->offset in `source`,
+// such as "/servers/3/port"; for other offsets, the pointer to the enclosing
+// container. Release it with free().
+err_t jsonc_error_pointer(const char *source, const jsonc_error *error,
+                          char **out_pointer);
+
+// Binary images: a parsed tree laid out with relative offsets instead of
+// pointers, so that a cache file can be mapped and read in place with no
+// deserialization. Object members keep their order and also get an index
+// sorted by key for jsonc_node_get. Images record a hash of the source text
+// they were saved from.
+typedef struct jsonc_image jsonc_image;
+typedef struct jsonc_node jsonc_node;
+
+// Writes `value`, parsed from `source`, to `path`, replacing the file as a
+// whole. *out_is_error is set if the file cannot be written or a string or
+// container holds more than UINT32_MAX bytes or members.
+err_t jsonc_save_binary(const jsonc_value *value, const char *source,
+                        const char *path, bool *out_is_error);
+// Maps the image at `path` if it was saved from exactly `source`. Otherwise
+// parses `source`, returns an image of it built in memory and rewrites
+// `path` for the next run. Every offset in a mapped image is checked once,
+// and an image that is damaged counts as stale. With a NULL `source` the
+// image is used without the staleness check and *out is NULL if it cannot
+// be read or is damaged. On a syntax error *out is NULL and out_error says
+// why.
+err_t jsonc_load_binary(const char *path, const char *source,
+                        const jsonc_parse_options *options, jsonc_image **out,
+                        jsonc_error *out_error);
+void jsonc_image_free(jsonc_image *image);
+// Nodes stay valid until their image is freed.
+const jsonc_node *jsonc_image_root(const jsonc_image *image);
+jsonc_value_type jsonc_node_type(const jsonc_node *node);
+bool jsonc_node_boolean(const jsonc_node *node);
+double jsonc_node_number(const jsonc_node *node);
+// NUL-terminated; `out_length` may be NULL.
+const char *jsonc_node_string(const jsonc_node *node, size_t *out_length);
+// Number of members of an array or object, 0 for anything else.
+size_t jsonc_node_count(const jsonc_node *node);
+// Element of an array or value of an object member, NULL if out of range.
+const jsonc_node *jsonc_node_at(const jsonc_node *node, size_t index);
+const char *jsonc_node_key(const jsonc_node *object, size_t index,
+                           size_t *out_length);
+// Binary search on the sorted key index; the first member named `key`.
+const jsonc_node *jsonc_node_get(const jsonc_node *object, const char *key);
+
+// Compiles a JSON Schema, given as a parsed tree, for use through
+// jsonc_parse_options.schema. Supported keywords are type (including
+// "integer"), properties, required, items (a single schema),
+// additionalProperties, enum (of scalars), minimum, maximum and maxLength;
+// other keywords are ignored. *out is set to NULL if a supported keyword is
+// malformed. The compiled schema does not refer to `schema` and is never
+// modified, so it may be shared by concurrent parses.
+//
+// Violations fail with JSONC_ERROR_TYPE_MISMATCH or a JSONC_ERROR_SCHEMA_*
+// code at the offset of the offending value. A disallowed additional
+// property is reported at its key and a missing required property at the
+// opening brace of its object.
+err_t jsonc_schema_compile(const jsonc_value *schema, jsonc_schema **out);
+void jsonc_schema_free(jsonc_schema *schema);
 
 #ifdef __cplusplus
 }
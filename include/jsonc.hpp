@@ -0,0 +1,417 @@
+#ifndef JSONC_HPP
+#define JSONC_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "jsonc.h"
+
+// Header-only C++17 wrapper over the C API. Views hold a pointer into the
+// tree and read it in place; nothing is copied and no std::string is built.
+namespace jsonc {
+
+enum class type {
+  null = JSONC_VALUE_TYPE_NULL,
+  boolean = JSONC_VALUE_TYPE_BOOLEAN,
+  number = JSONC_VALUE_TYPE_NUMBER,
+  string = JSONC_VALUE_TYPE_STRING,
+  array = JSONC_VALUE_TYPE_ARRAY,
+  object = JSONC_VALUE_TYPE_OBJECT,
+};
+
+class error {
+public:
+  explicit error(const jsonc_error &raw) noexcept : error_(raw) {}
+
+  jsonc_error_code code() const noexcept { return error_.code; }
+  size_t offset() const noexcept { return error_.offset; }
+  size_t line() const noexcept { return error_.line; }
+  size_t column() const noexcept { return error_.column; }
+  unsigned expected() const noexcept { return error_.expected; }
+  const char *message() const noexcept {
+    return jsonc_error_message(error_.code);
+  }
+  const jsonc_error &get() const noexcept { return error_; }
+
+private:
+  jsonc_error error_;
+};
+
+// Either a T or a jsonc::error, in the manner of std::expected. Allocation
+// failures are not reported through it; they throw std::bad_alloc.
+template <class T> class result {
+public:
+  result(T &&value) noexcept : storage_(std::in_place_index<0>,
+                                        std::move(value)) {}
+  result(const jsonc::error &failure) noexcept
+      : storage_(std::in_place_index<1>, failure) {}
+
+  bool has_value() const noexcept { return storage_.index() == 0; }
+  explicit operator bool() const noexcept { return has_value(); }
+
+  T &value() & { return std::get<0>(storage_); }
+  const T &value() const & { return std::get<0>(storage_); }
+  T &&value() && { return std::get<0>(std::move(storage_)); }
+  const jsonc::error &error() const { return std::get<1>(storage_); }
+
+  T &operator*() & { return value(); }
+  const T &operator*() const & { return value(); }
+  T *operator->() { return &value(); }
+  const T *operator->() const { return &value(); }
+
+private:
+  std::variant<T, jsonc::error> storage_;
+};
+
+struct member;
+
+// A non-owning view of a node. A default-constructed or failed lookup yields
+// an empty ref that tests false; lookups on it stay empty, so chains such as
+// doc["a"][3]["b"] need only one check at the end.
+class value_ref {
+public:
+  class array_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = value_ref;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_ref;
+
+    array_iterator() noexcept = default;
+    explicit array_iterator(const jsonc_value *current) noexcept
+        : current_(current) {}
+    value_ref operator*() const noexcept { return value_ref(current_); }
+    value_ref operator[](difference_type n) const noexcept {
+      return value_ref(current_ + n);
+    }
+    array_iterator &operator++() noexcept {
+      ++current_;
+      return *this;
+    }
+    array_iterator operator++(int) noexcept {
+      return array_iterator(current_++);
+    }
+    array_iterator &operator--() noexcept {
+      --current_;
+      return *this;
+    }
+    array_iterator operator--(int) noexcept {
+      return array_iterator(current_--);
+    }
+    array_iterator &operator+=(difference_type n) noexcept {
+      current_ += n;
+      return *this;
+    }
+    array_iterator &operator-=(difference_type n) noexcept {
+      current_ -= n;
+      return *this;
+    }
+    array_iterator operator+(difference_type n) const noexcept {
+      return array_iterator(current_ + n);
+    }
+    friend array_iterator operator+(difference_type n,
+                                    const array_iterator &it) noexcept {
+      return it + n;
+    }
+    array_iterator operator-(difference_type n) const noexcept {
+      return array_iterator(current_ - n);
+    }
+    difference_type operator-(const array_iterator &other) const noexcept {
+      return current_ - other.current_;
+    }
+    bool operator==(const array_iterator &other) const noexcept {
+      return current_ == other.current_;
+    }
+    bool operator!=(const array_iterator &other) const noexcept {
+      return current_ != other.current_;
+    }
+    bool operator<(const array_iterator &other) const noexcept {
+      return current_ < other.current_;
+    }
+    bool operator>(const array_iterator &other) const noexcept {
+      return current_ > other.current_;
+    }
+    bool operator<=(const array_iterator &other) const noexcept {
+      return current_ <= other.current_;
+    }
+    bool operator>=(const array_iterator &other) const noexcept {
+      return current_ >= other.current_;
+    }
+
+  private:
+    const jsonc_value *current_ = nullptr;
+  };
+
+  class object_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = member;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = member;
+
+    object_iterator() noexcept = default;
+    explicit object_iterator(const jsonc_object_entry *current) noexcept
+        : current_(current) {}
+    member operator*() const noexcept;
+    object_iterator &operator++() noexcept {
+      ++current_;
+      return *this;
+    }
+    object_iterator operator++(int) noexcept {
+      return object_iterator(current_++);
+    }
+    bool operator==(const object_iterator &other) const noexcept {
+      return current_ == other.current_;
+    }
+    bool operator!=(const object_iterator &other) const noexcept {
+      return current_ != other.current_;
+    }
+
+  private:
+    const jsonc_object_entry *current_ = nullptr;
+  };
+
+  template <class Iterator> class range {
+  public:
+    range(Iterator begin, Iterator end) noexcept : begin_(begin), end_(end) {}
+    Iterator begin() const noexcept { return begin_; }
+    Iterator end() const noexcept { return end_; }
+
+  private:
+    Iterator begin_;
+    Iterator end_;
+  };
+
+  value_ref() noexcept = default;
+  explicit value_ref(const jsonc_value *value) noexcept : value_(value) {}
+
+  explicit operator bool() const noexcept { return value_ != nullptr; }
+  const jsonc_value *get() const noexcept { return value_; }
+
+  // Only meaningful on a non-empty ref.
+  jsonc::type type() const noexcept {
+    return static_cast<jsonc::type>(value_->type);
+  }
+  bool is(jsonc::type kind) const noexcept {
+    return value_ && value_->type == static_cast<jsonc_value_type>(kind);
+  }
+  bool is_null() const noexcept { return is(jsonc::type::null); }
+  bool is_bool() const noexcept { return is(jsonc::type::boolean); }
+  bool is_number() const noexcept { return is(jsonc::type::number); }
+  bool is_string() const noexcept { return is(jsonc::type::string); }
+  bool is_array() const noexcept { return is(jsonc::type::array); }
+  bool is_object() const noexcept { return is(jsonc::type::object); }
+
+  std::optional<bool> as_bool() const noexcept {
+    if (!is_bool()) {
+      return std::nullopt;
+    }
+    return value_->value.boolean;
+  }
+  std::optional<double> as_number() const noexcept {
+    if (!is_number()) {
+      return std::nullopt;
+    }
+    return value_->value.number;
+  }
+  std::optional<std::string_view> as_string() const noexcept {
+    if (!is_string()) {
+      return std::nullopt;
+    }
+    size_t length;
+    const char *const data = jsonc_string_get(value_, &length);
+    return std::string_view(data, length);
+  }
+
+  // Number of members of an array or object, 0 for anything else.
+  size_t size() const noexcept {
+    if (is_array()) {
+      return value_->value.array.count;
+    }
+    return is_object() ? value_->value.object.count : 0;
+  }
+
+  value_ref operator[](size_t index) const noexcept {
+    if (!is_array() || index >= value_->value.array.count) {
+      return value_ref();
+    }
+    return value_ref(&value_->value.array.values[index]);
+  }
+  // First member named `key`.
+  value_ref operator[](std::string_view key) const noexcept {
+    if (!is_object()) {
+      return value_ref();
+    }
+    const jsonc_object &object = value_->value.object;
+    for (size_t i = 0; i < object.count; i++) {
+      if (key == object.entries[i].key) {
+        return value_ref(&object.entries[i].value);
+      }
+    }
+    return value_ref();
+  }
+  value_ref at_pointer(const char *pointer) const noexcept {
+    return value_ ? value_ref(jsonc_pointer_get(value_, pointer))
+                  : value_ref();
+  }
+
+  // Empty unless this is an array.
+  range<array_iterator> elements() const noexcept {
+    const jsonc_value *const begin =
+        is_array() ? value_->value.array.values : nullptr;
+    return {array_iterator(begin), array_iterator(begin + size())};
+  }
+  // Empty unless this is an object.
+  range<object_iterator> members() const noexcept {
+    const jsonc_object_entry *const begin =
+        is_object() ? value_->value.object.entries : nullptr;
+    return {object_iterator(begin), object_iterator(begin + size())};
+  }
+
+private:
+  const jsonc_value *value_ = nullptr;
+};
+
+// An object member as seen when iterating, e.g.
+// `for (auto [key, value] : ref.members())`.
+struct member {
+  std::string_view key;
+  value_ref value;
+};
+
+inline member value_ref::object_iterator::operator*() const noexcept {
+  return member{std::string_view(current_->key), value_ref(&current_->value)};
+}
+
+// Owns a tree released with jsonc_free. Move-only.
+class document {
+public:
+  document() noexcept : value_() { value_.type = JSONC_VALUE_TYPE_NULL; }
+  explicit document(jsonc_value value) noexcept : value_(value) {}
+  document(document &&other) noexcept : value_(other.release()) {}
+  document &operator=(document &&other) noexcept {
+    if (this != &other) {
+      jsonc_free(value_);
+      value_ = other.release();
+    }
+    return *this;
+  }
+  document(const document &) = delete;
+  document &operator=(const document &) = delete;
+  ~document() { jsonc_free(value_); }
+
+  value_ref root() const noexcept { return value_ref(&value_); }
+  value_ref operator[](size_t index) const noexcept { return root()[index]; }
+  value_ref operator[](std::string_view key) const noexcept {
+    return root()[key];
+  }
+
+  jsonc_value &get() noexcept { return value_; }
+  const jsonc_value &get() const noexcept { return value_; }
+  // Gives up ownership; the document is left holding null.
+  jsonc_value release() noexcept {
+    const jsonc_value value = value_;
+    value_ = jsonc_value();
+    value_.type = JSONC_VALUE_TYPE_NULL;
+    return value;
+  }
+
+private:
+  jsonc_value value_;
+};
+
+inline result<document> parse(const char *source,
+                              const jsonc_parse_options *options = nullptr) {
+  jsonc_value value;
+  jsonc_error error;
+  if (jsonc_parse_ex(source, options, &value, &error)) {
+    throw std::bad_alloc();
+  }
+  if (error.code != JSONC_ERROR_NONE) {
+    return jsonc::error(error);
+  }
+  return document(value);
+}
+
+// Reads and parses what remains of `file`; see jsonc_parse_file.
+inline result<document>
+parse_file(std::FILE *file, const jsonc_parse_options *options = nullptr) {
+  jsonc_value value;
+  jsonc_error error;
+  if (jsonc_parse_file(file, options, &value, &error)) {
+    throw std::bad_alloc();
+  }
+  if (error.code != JSONC_ERROR_NONE) {
+    return jsonc::error(error);
+  }
+  return document(value);
+}
+
+// `text` without its comments; see jsonc_strip.
+inline result<std::string> strip(std::string_view text, unsigned flags = 0) {
+  std::string out(text.size(), '\0');
+  size_t length;
+  jsonc_error error;
+  jsonc_strip(text.data(), text.size(), flags, out.data(), &length, &error);
+  if (error.code != JSONC_ERROR_NONE) {
+    return jsonc::error(error);
+  }
+  out.resize(length);
+  return out;
+}
+
+// Owns a jsonc_parser, whose scratch buffers are reused by every parse made
+// through it. Move-only, and for one thread at a time.
+class parser {
+public:
+  explicit parser(size_t max_retained = 0) {
+    if (jsonc_parser_create(max_retained, &parser_)) {
+      throw std::bad_alloc();
+    }
+  }
+  parser(parser &&other) noexcept : parser_(other.parser_) {
+    other.parser_ = nullptr;
+  }
+  parser &operator=(parser &&other) noexcept {
+    std::swap(parser_, other.parser_);
+    return *this;
+  }
+  parser(const parser &) = delete;
+  parser &operator=(const parser &) = delete;
+  ~parser() {
+    if (parser_) {
+      jsonc_parser_free(parser_);
+    }
+  }
+
+  result<document> parse(const char *source,
+                         const jsonc_parse_options *options = nullptr) {
+    jsonc_value value;
+    jsonc_error error;
+    if (jsonc_parser_parse(parser_, source, options, &value, &error)) {
+      throw std::bad_alloc();
+    }
+    if (error.code != JSONC_ERROR_NONE) {
+      return jsonc::error(error);
+    }
+    return document(value);
+  }
+
+  size_t retained() const noexcept { return jsonc_parser_retained(parser_); }
+
+private:
+  jsonc_parser *parser_;
+};
+
+} // namespace jsonc
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef JSONC_BIND_HPP
+#define JSONC_BIND_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "jsonc.hpp"
+
+// Reads documents straight into C++ structs from the jsonc_reader event
+// stream, without building a jsonc_value tree. A struct opts in with a
+// constexpr field table:
+//
+//   struct limits {
+//     double cpu;
+//     int64_t memory;
+//   };
+//   JSONC_BIND(limits, JSONC_FIELD(limits, cpu), JSONC_FIELD(limits, memory));
+//
+//   jsonc::result<limits> parsed = jsonc::parse_as<limits>(source);
+//
+// Members may be bool, integers, floating point, std::string, std::optional,
+// std::vector or other bound structs. Unknown keys are skipped, absent ones
+// leave the member as it was, and a repeated key overwrites the earlier one.
+// A value of the wrong JSON type, or a number that does not fit an integer
+// member exactly, fails with JSONC_ERROR_TYPE_MISMATCH at its offset.
+namespace jsonc {
+
+// Specialized through JSONC_BIND, or by hand with a static constexpr tuple
+// named `fields`.
+template <class T> struct binding;
+
+template <class Class, class Member> struct field {
+  std::string_view name;
+  Member Class::*pointer;
+};
+
+template <class Class, class Member>
+constexpr field<Class, Member> make_field(std::string_view name,
+                                          Member Class::*pointer) {
+  return {name, pointer};
+}
+
+#define JSONC_FIELD(type, member) ::jsonc::make_field(#member, &type::member)
+
+#define JSONC_BIND(type, ...)                                                 \
+  template <> struct jsonc::binding<type> {                                   \
+    static constexpr auto fields = std::make_tuple(__VA_ARGS__);              \
+  }
+
+namespace detail {
+
+template <class T, class = void> struct is_bound : std::false_type {};
+template <class T>
+struct is_bound<T, std::void_t<decltype(binding<T>::fields)>>
+    : std::true_type {};
+
+template <class T> struct is_vector : std::false_type {};
+template <class T, class Allocator>
+struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+
+template <class T> struct is_optional : std::false_type {};
+template <class T> struct is_optional<std::optional<T>> : std::true_type {};
+
+// FNV-1a with a seeded basis and a final mix so that the low bits, which
+// pick the slot, depend on every byte.
+constexpr uint32_t key_hash(std::string_view key, uint32_t seed) noexcept {
+  uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+  for (const char c : key) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6du;
+  return hash ^ (hash >> 12);
+}
+
+// At least four slots per key keeps the expected number of seeds tried at
+// compile time small even for large structs.
+constexpr size_t key_table_size(size_t count) noexcept {
+  size_t size = 1;
+  while (size < count * 4) {
+    size *= 2;
+  }
+  return size;
+}
+
+// A collision-free table from key hash to field index + 1 (0 is empty).
+template <size_t N> struct key_table {
+  static constexpr size_t size = key_table_size(N);
+  uint32_t seed;
+  std::array<size_t, size> slots;
+};
+
+template <size_t N>
+constexpr key_table<N>
+make_key_table(const std::array<std::string_view, N> &names) {
+  for (size_t i = 0; i < N; i++) {
+    for (size_t j = i + 1; j < N; j++) {
+      if (names[i] == names[j]) {
+        throw std::logic_error("jsonc: duplicate field name");
+      }
+    }
+  }
+  key_table<N> table{};
+  for (uint32_t seed = 0;; seed++) {
+    table.seed = seed;
+    table.slots = {};
+    bool collided = false;
+    for (size_t i = 0; i < N && !collided; i++) {
+      size_t &slot = table.slots[key_hash(names[i], seed) & (table.size - 1)];
+      collided = slot != 0;
+      slot = i + 1;
+    }
+    if (!collided) {
+      return table;
+    }
+  }
+}
+
+// Owns a jsonc_reader and remembers the event the readers below are on.
+class event_reader {
+public:
+  event_reader(const char *source, jsonc_reader *reader) noexcept
+      : source_(source), reader_(reader) {}
+  event_reader(const event_reader &) = delete;
+  event_reader &operator=(const event_reader &) = delete;
+  ~event_reader() { jsonc_reader_destroy(reader_); }
+
+  const jsonc_event &event() const noexcept { return event_; }
+
+  // The functions below return false once the read has failed.
+  bool next() {
+    if (jsonc_reader_next(reader_, &event_)) {
+      throw std::bad_alloc();
+    }
+    return event_.type != JSONC_EVENT_ERROR;
+  }
+  bool skip() {
+    if (jsonc_reader_skip(reader_, &event_)) {
+      throw std::bad_alloc();
+    }
+    return event_.type != JSONC_EVENT_ERROR;
+  }
+  bool mismatch() noexcept {
+    mismatch_ = jsonc_error{};
+    mismatch_.code = JSONC_ERROR_TYPE_MISMATCH;
+    mismatch_.offset = event_.offset;
+    jsonc_error_locate(source_, &mismatch_);
+    return false;
+  }
+
+  jsonc::error error() const noexcept {
+    return jsonc::error(mismatch_.code != JSONC_ERROR_NONE
+                            ? mismatch_
+                            : *jsonc_reader_error(reader_));
+  }
+
+private:
+  const char *source_;
+  jsonc_reader *reader_;
+  jsonc_event event_ = {};
+  jsonc_error mismatch_ = {};
+};
+
+template <class T> bool read_value(event_reader &in, T &out);
+
+template <class T, size_t I> bool read_field(event_reader &in, T &out) {
+  return read_value(in, out.*(std::get<I>(binding<T>::fields).pointer));
+}
+
+template <class T, size_t... I>
+constexpr std::array<std::string_view, sizeof...(I)>
+field_names(std::index_sequence<I...>) {
+  return {{std::get<I>(binding<T>::fields).name...}};
+}
+
+template <class T, size_t... I>
+constexpr std::array<bool (*)(event_reader &, T &), sizeof...(I)>
+field_readers(std::index_sequence<I...>) {
+  return {{&read_field<T, I>...}};
+}
+
+// Per-struct dispatch built at compile time: a key is hashed once, checked
+// against the one name its slot can hold, and its reader called directly.
+template <class T> struct bound_fields {
+  static constexpr size_t count =
+      std::tuple_size_v<std::decay_t<decltype(binding<T>::fields)>>;
+  static constexpr auto names =
+      field_names<T>(std::make_index_sequence<count>());
+  static constexpr auto table = make_key_table(names);
+  static constexpr auto readers =
+      field_readers<T>(std::make_index_sequence<count>());
+
+  // Index of the field named `key`, or `count`.
+  static size_t find(std::string_view key) noexcept {
+    const size_t slot =
+        table.slots[key_hash(key, table.seed) & (table.size - 1)];
+    return slot && names[slot - 1] == key ? slot - 1 : count;
+  }
+};
+
+// Integers must be read exactly: no fraction and within range.
+template <class T> bool fits_integer(double number) noexcept {
+  constexpr double limit =
+      static_cast<double>(std::numeric_limits<T>::max() / 2 + 1) * 2.0;
+  return number == std::trunc(number) &&
+         number >= (std::is_signed_v<T> ? -limit : 0.0) && number < limit;
+}
+
+template <class T> bool read_object(event_reader &in, T &out) {
+  using fields = bound_fields<T>;
+  if (in.event().type != JSONC_EVENT_BEGIN_OBJECT) {
+    return in.mismatch();
+  }
+  for (;;) {
+    if (!in.next()) {
+      return false;
+    }
+    if (in.event().type == JSONC_EVENT_END_OBJECT) {
+      return true;
+    }
+    const size_t index = fields::find(std::string_view(
+        in.event().value.string.data, in.event().value.string.length));
+    if (!in.next()) {
+      return false;
+    }
+    if (index == fields::count ? !in.skip()
+                               : !fields::readers[index](in, out)) {
+      return false;
+    }
+  }
+}
+
+// Reads the value that starts at the current event, leaving the reader on
+// its last event.
+template <class T> bool read_value(event_reader &in, T &out) {
+  const jsonc_event &event = in.event();
+  if constexpr (std::is_same_v<T, bool>) {
+    if (event.type != JSONC_EVENT_BOOLEAN) {
+      return in.mismatch();
+    }
+    out = event.value.boolean;
+  } else if constexpr (std::is_integral_v<T>) {
+    if (event.type != JSONC_EVENT_NUMBER ||
+        !fits_integer<T>(event.value.number)) {
+      return in.mismatch();
+    }
+    out = static_cast<T>(event.value.number);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    if (event.type != JSONC_EVENT_NUMBER) {
+      return in.mismatch();
+    }
+    out = static_cast<T>(event.value.number);
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    if (event.type != JSONC_EVENT_STRING) {
+      return in.mismatch();
+    }
+    out.assign(event.value.string.data, event.value.string.length);
+  } else if constexpr (is_optional<T>::value) {
+    if (event.type == JSONC_EVENT_NULL) {
+      out.reset();
+    } else {
+      if (!out) {
+        out.emplace();
+      }
+      return read_value(in, *out);
+    }
+  } else if constexpr (is_vector<T>::value) {
+    if (event.type != JSONC_EVENT_BEGIN_ARRAY) {
+      return in.mismatch();
+    }
+    out.clear();
+    for (;;) {
+      if (!in.next()) {
+        return false;
+      }
+      if (in.event().type == JSONC_EVENT_END_ARRAY) {
+        break;
+      }
+      typename T::value_type element{};
+      if (!read_value(in, element)) {
+        return false;
+      }
+      out.push_back(std::move(element));
+    }
+  } else {
+    static_assert(is_bound<T>::value, "jsonc: type has no jsonc::binding");
+    return read_object(in, out);
+  }
+  return true;
+}
+
+} // namespace detail
+
+// Parses `source` into a value-initialized T. Limits in `options` apply as
+// in jsonc_parse_ex.
+template <class T>
+result<T> parse_as(const char *source,
+                   const jsonc_parse_options *options = nullptr) {
+  jsonc_reader *reader;
+  if (jsonc_reader_create(source, options, &reader)) {
+    throw std::bad_alloc();
+  }
+  detail::event_reader in(source, reader);
+  T value{};
+  if (in.next() && detail::read_value(in, value) && in.next()) {
+    return value;
+  }
+  return in.error();
+}
+
+} // namespace jsonc
+
+#endif
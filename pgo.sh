@@ -0,0 +1,40 @@
+#!/bin/sh
+
+# Profile-guided build: instruments the library, the tool and the benchmarks,
+# trains them on the benchmark corpus, or on the given JSON files through the
+# tool, and rebuilds them with the profile, in build/pgo.
+
+set -e
+cd "$(dirname "$0")"
+
+BUILD=build/pgo
+PROFILES="$PWD/$BUILD/profiles"
+
+rm -rf "$PROFILES"
+cmake -B "$BUILD" -DCMAKE_BUILD_TYPE=Release -DJSONC_PGO=GENERATE \
+  -DJSONC_PGO_DIR="$PROFILES" -DJSONC_BUILD_BENCHMARKS=ON .
+cmake --build "$BUILD" --clean-first
+
+# The test/data files are small and mostly malformed, so by default the
+# profile comes from the documents the benchmarks generate, one round each.
+if [ "$#" -eq 0 ]; then
+  "$BUILD/test/bench_numbers" 300000 1 >/dev/null
+  "$BUILD/test/bench_strict" 16 1 >/dev/null
+  "$BUILD/test/bench_patch" >/dev/null
+fi
+
+for file in "$@"; do
+  "$BUILD/test/jsonc" "$file" >/dev/null
+  "$BUILD/test/jsonc" validate "$file" >/dev/null 2>&1 || true
+  "$BUILD/test/jsonc" strip-comments "$file" >/dev/null 2>&1 || true
+done
+
+# Clang writes raw profiles that have to be merged first.
+if ls "$PROFILES"/*.profraw >/dev/null 2>&1; then
+  llvm-profdata merge -output="$PROFILES/default.profdata" \
+    "$PROFILES"/*.profraw
+fi
+
+# The same build directory, so that GCC finds each object's profile.
+cmake -B "$BUILD" -DJSONC_PGO=USE .
+cmake --build "$BUILD" --clean-first
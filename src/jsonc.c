@@ -6,7 +6,9 @@
 
 #include <cctype>
 #include <climits>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
@@ -14,13 +16,36 @@
 
 #include <ctype.h>
 #include <limits.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #endif
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+#define JSONC_HAVE_MMAP
+#define JSONC_HAVE_PTHREAD
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#if !defined(__GNUC__) && !defined(__clang__) && !defined(_MSC_VER) &&        \
+    defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L &&               \
+    !defined(__STDC_NO_ATOMICS__)
+#define JSONC_HAVE_STDATOMIC
+#include <stdatomic.h>
+#endif
+
 typedef struct arraybuffer {
   void *data;
   size_t element_size;
@@ -70,6 +95,27 @@ static inline err_t arraybuffer_push(arraybuffer *buffer, const void *value) {
   return false;
 }
 
+static inline err_t arraybuffer_append(arraybuffer *buffer, const void *values,
+                                       size_t count) {
+  if (buffer->capacity - buffer->length < count) {
+    size_t new_capacity = buffer->capacity * 2;
+    while (new_capacity - buffer->length < count) {
+      new_capacity *= 2;
+    }
+    void *const new_data =
+        realloc(buffer->data, new_capacity * buffer->element_size);
+    if (!new_data) {
+      return true;
+    }
+    buffer->data = new_data;
+    buffer->capacity = new_capacity;
+  }
+  memcpy(arraybuffer_get(buffer, buffer->length), values,
+         count * buffer->element_size);
+  buffer->length += count;
+  return false;
+}
+
 static inline char *util_strdup(const char *str) {
   char *const result = malloc(strlen(str) + 1);
   if (!result) {
@@ -79,6 +125,17 @@ static inline char *util_strdup(const char *str) {
   return result;
 }
 
+// Copies `length` bytes of `str` and a NUL.
+static inline char *util_strndup(const char *str, size_t length) {
+  char *const result = malloc(length + 1);
+  if (!result) {
+    return NULL;
+  }
+  memcpy(result, str, length);
+  result[length] = '\0';
+  return result;
+}
+
 typedef enum token_type {
   TT_EOF,
   TT_LEFT_BRACE,
@@ -92,14 +149,23 @@ typedef enum token_type {
   TT_TRUE,
   TT_FALSE,
   TT_NULL,
+  TT_IDENTIFIER,
 } token_type;
 
+// TT_STRING and TT_IDENTIFIER tokens refer to their decoded text in the
+// lexer's string buffer, where it is followed by a NUL. The token's source
+// text runs from `offset` up to `end`.
 typedef struct token {
   token_type type;
   union {
-    char *string;
+    struct {
+      size_t offset;
+      size_t length;
+    } text;
     double number;
   } value;
+  size_t offset;
+  size_t end;
 } token;
 
 #define TS_ERROR -1
@@ -134,15 +200,27 @@ typedef struct token {
 #define TS_MULTI_LINE_COMMENT_STAR 28
 #define TS_STRING_SURROGATE 29
 #define TS_STRING_SURROGATE_U 30
+// Only reachable through lenient_state_functions.
+#define TS_IDENTIFIER 31
+#define TS_NUMBER_HEX_START 32
+#define TS_NUMBER_HEX 33
+#define TS_NUMBER_LEADING_DOT 34
 
+// The text is decoded onto the end of `stringbuilder`, from `start`.
 typedef struct tokenizer_state_string {
   arraybuffer *stringbuilder;
+  size_t start;
   uint32_t u;
   uint32_t high_surrogate;
+  bool single_quoted;
+  bool has_nul;
 } tokenizer_state_string;
 
+// While the integer part fits in 64 bits it is kept exactly in `integer`,
+// and `value` is its nearest double.
 typedef struct tokenizer_state_number {
   double value;
+  uint64_t integer;
   double current_digit;
   int sign;
   int exp;
@@ -163,6 +241,20 @@ typedef err_t (*tokenizer_state_function)(
     char c, arraybuffer *list, // arraybuffer of tokens
     tokenizer_state_data *data, tokenizer_state *out_next_state);
 
+// What a state function's `data` points into: the state data, followed by
+// what the lexer keeps across states, reached through tokenizer_context_of.
+// `strings` is the one buffer that strings and identifiers are decoded into,
+// one after the other.
+typedef struct tokenizer_context {
+  tokenizer_state_data data;
+  unsigned flags;
+  arraybuffer *strings;
+} tokenizer_context;
+
+static tokenizer_context *tokenizer_context_of(tokenizer_state_data *data) {
+  return (tokenizer_context *)(void *)data;
+}
+
 static double exponential(double n, int e) {
   while (e < 0) {
     e++;
@@ -175,11 +267,26 @@ static double exponential(double n, int e) {
   return n;
 }
 
+static double number_value(const tokenizer_state_number *state) {
+  return exponential(state->value * state->sign, state->exp * state->exp_sign);
+}
+
+// Appends a digit to the integer part. Converting the exact integer once
+// keeps numbers of up to 19 digits correctly rounded, where multiplying in
+// double would drift once past 2^53.
+static void number_add_digit(tokenizer_state_number *number, int digit) {
+  if (number->integer <= (UINT64_MAX - 9) / 10) {
+    number->integer = number->integer * 10 + (uint64_t)digit;
+    number->value = (double)number->integer;
+  } else {
+    number->value = number->value * 10 + digit;
+  }
+}
+
 static err_t add_number_token(arraybuffer *list,
                               tokenizer_state_number *state) {
-  const double number =
-      exponential(state->value * state->sign, state->exp * state->exp_sign);
-  const token current = {.type = TT_NUMBER, .value.number = number};
+  const token current = {.type = TT_NUMBER,
+                         .value.number = number_value(state)};
 
   if (arraybuffer_push(list, &current)) {
     return true;
@@ -228,37 +335,33 @@ static bool is_valid_utf8(const unsigned char *s, size_t length) {
   return true;
 }
 
+// Strings are NUL-terminated, so one with an escaped NUL ends there.
+static size_t string_token_length(const tokenizer_state_string *state) {
+  const char *const text = arraybuffer_get(state->stringbuilder, state->start);
+  return state->has_nul ? strlen(text)
+                        : state->stringbuilder->length - state->start;
+}
+
 static err_t add_string_token(arraybuffer *list,
-                              /* always-consumed */
                               tokenizer_state_string *state,
                               tokenizer_state *out_next_state) {
   static const char null_byte = '\0';
-  err_t result = true;
+  const size_t length = string_token_length(state);
   if (arraybuffer_push(state->stringbuilder, &null_byte)) {
-    goto cleanup;
-  }
-  char *const string = util_strdup(arraybuffer_get(state->stringbuilder, 0));
-  if (!string) {
-    goto cleanup;
+    return true;
   }
-  const size_t len = strlen(string);
-  if (!is_valid_utf8((const unsigned char *)string, len)) {
-    free(string);
+  if (!is_valid_utf8(arraybuffer_get(state->stringbuilder, state->start),
+                     length)) {
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
-    result = false;
-    goto cleanup;
+    return false;
   }
-  const token current = {.type = TT_STRING, .value.string = string};
+  const token current = {.type = TT_STRING,
+                         .value.text = {state->start, length}};
   if (arraybuffer_push(list, &current)) {
-    free(string);
-    goto cleanup;
+    return true;
   }
   *out_next_state = (tokenizer_state){.state = TS_DEFAULT};
-  result = false;
-
-cleanup:
-  arraybuffer_destroy(state->stringbuilder);
-  return result;
+  return false;
 }
 
 static err_t add_simple_token(arraybuffer *list, token_type type) {
@@ -268,7 +371,6 @@ static err_t add_simple_token(arraybuffer *list, token_type type) {
 
 static err_t ts_default(char c, arraybuffer *list, tokenizer_state_data *data,
                         tokenizer_state *out_next_state) {
-  (void)data;
   *out_next_state = (tokenizer_state){.state = TS_ERROR};
   if (!c || c == '[' || c == ']' || c == '{' || c == '}' || c == ':' ||
       c == ',') {
@@ -293,6 +395,7 @@ static err_t ts_default(char c, arraybuffer *list, tokenizer_state_data *data,
   } else if (c == '-' || ('0' <= c && c <= '9')) {
     out_next_state->data.number.current_digit = 1;
     out_next_state->data.number.value = 0;
+    out_next_state->data.number.integer = 0;
     out_next_state->data.number.sign = 1;
     out_next_state->data.number.exp = 0;
     out_next_state->data.number.exp_sign = 1;
@@ -304,15 +407,16 @@ static err_t ts_default(char c, arraybuffer *list, tokenizer_state_data *data,
       out_next_state->state = TS_NUMBER_ZERO;
     } else {
       out_next_state->data.number.value = c - '0';
+      out_next_state->data.number.integer = (uint64_t)(c - '0');
     }
   } else if (c == '"') {
-    arraybuffer *const stringbuilder = arraybuffer_create(1, 128);
-    if (!stringbuilder) {
-      return true;
-    }
+    arraybuffer *const stringbuilder = tokenizer_context_of(data)->strings;
     out_next_state->data.string.stringbuilder = stringbuilder;
+    out_next_state->data.string.start = stringbuilder->length;
     out_next_state->data.string.u = 0;
     out_next_state->data.string.high_surrogate = 0;
+    out_next_state->data.string.single_quoted = false;
+    out_next_state->data.string.has_nul = false;
     out_next_state->state = TS_STRING_ANY;
     return false;
   }
@@ -429,12 +533,30 @@ static err_t ts_string_any(char c, arraybuffer *list,
   }
   *out_next_state = (tokenizer_state){.state = TS_STRING_ANY, .data = *data};
   if (arraybuffer_push(data->string.stringbuilder, &c)) {
-    arraybuffer_destroy(data->string.stringbuilder);
     return true;
   }
   return false;
 }
 
+// What the escape `\c` stands for, or NUL unless it is one of the single
+// character escapes.
+static char unescape(char c) {
+  if (c == '\"' || c == '\\' || c == '/') {
+    return c;
+  } else if (c == 'b') {
+    return '\b';
+  } else if (c == 'f') {
+    return '\f';
+  } else if (c == 'n') {
+    return '\n';
+  } else if (c == 'r') {
+    return '\r';
+  } else if (c == 't') {
+    return '\t';
+  }
+  return 0;
+}
+
 static err_t ts_string_backslash(char c, arraybuffer *list,
                                  tokenizer_state_data *data,
                                  tokenizer_state *out_next_state) {
@@ -444,29 +566,12 @@ static err_t ts_string_backslash(char c, arraybuffer *list,
     *out_next_state = (tokenizer_state){.state = TS_STRING_U0, .data = *data};
     return false;
   }
-  char next;
-  if (c == '\"' || c == '\\' || c == '/') {
-    next = c;
-  } else if (c == 'b') {
-    next = '\b';
-  } else if (c == 'f') {
-    next = '\f';
-  } else if (c == 'n') {
-    next = '\n';
-  } else if (c == 'r') {
-    next = '\r';
-  } else if (c == 't') {
-    next = '\t';
-  } else {
-    next = 0;
-  }
+  const char next = unescape(c);
   if (!next) {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
   if (arraybuffer_push(data->string.stringbuilder, &next)) {
-    arraybuffer_destroy(data->string.stringbuilder);
     return true;
   }
   *out_next_state = (tokenizer_state){.state = TS_STRING_ANY, .data = *data};
@@ -481,7 +586,6 @@ static err_t ts_string_surrogate(char c, arraybuffer *list,
     *out_next_state =
         (tokenizer_state){.state = TS_STRING_SURROGATE_U, .data = *data};
   } else {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
   }
   return false;
@@ -495,7 +599,6 @@ static err_t ts_string_surrogate_u(char c, arraybuffer *list,
     data->string.u = 0;
     *out_next_state = (tokenizer_state){.state = TS_STRING_U0, .data = *data};
   } else {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
   }
   return false;
@@ -517,7 +620,6 @@ static err_t ts_string_u0(char c, arraybuffer *list, tokenizer_state_data *data,
 
   const unsigned char value = from_hex(c);
   if (value == (unsigned char)-1) {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
@@ -532,7 +634,6 @@ static err_t ts_string_u1(char c, arraybuffer *list, tokenizer_state_data *data,
 
   const unsigned char value = from_hex(c);
   if (value == (unsigned char)-1) {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
@@ -547,7 +648,6 @@ static err_t ts_string_u2(char c, arraybuffer *list, tokenizer_state_data *data,
 
   const unsigned char value = from_hex(c);
   if (value == (unsigned char)-1) {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
@@ -594,7 +694,6 @@ static err_t ts_string_u3(char c, arraybuffer *list, tokenizer_state_data *data,
 
   const unsigned char value = from_hex(c);
   if (value == (unsigned char)-1) {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
@@ -602,7 +701,6 @@ static err_t ts_string_u3(char c, arraybuffer *list, tokenizer_state_data *data,
 
   if (data->string.high_surrogate) {
     if (data->string.u < 0xDC00 || data->string.u > 0xDFFF) {
-      arraybuffer_destroy(data->string.stringbuilder);
       *out_next_state = (tokenizer_state){.state = TS_ERROR};
       return false;
     }
@@ -611,7 +709,6 @@ static err_t ts_string_u3(char c, arraybuffer *list, tokenizer_state_data *data,
                          (data->string.u - 0xDC00);
     data->string.high_surrogate = 0;
     if (utf8_append(data->string.stringbuilder, codepoint)) {
-      arraybuffer_destroy(data->string.stringbuilder);
       return true;
     }
     *out_next_state = (tokenizer_state){.state = TS_STRING_ANY, .data = *data};
@@ -626,13 +723,12 @@ static err_t ts_string_u3(char c, arraybuffer *list, tokenizer_state_data *data,
   }
 
   if (data->string.u >= 0xD800 && data->string.u <= 0xDFFF) {
-    arraybuffer_destroy(data->string.stringbuilder);
     *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
+  data->string.has_nul |= !data->string.u;
 
   if (utf8_append(data->string.stringbuilder, data->string.u)) {
-    arraybuffer_destroy(data->string.stringbuilder);
     return true;
   }
   *out_next_state = (tokenizer_state){.state = TS_STRING_ANY, .data = *data};
@@ -644,7 +740,7 @@ static err_t ts_number_sign(char c, arraybuffer *list,
                             tokenizer_state *out_next_state) {
   (void)list;
   if ('0' <= c && c <= '9') {
-    data->number.value = data->number.value * 10 + (c - '0');
+    number_add_digit(&data->number, c - '0');
     *out_next_state =
         (tokenizer_state){.state = TS_NUMBER_INTEGER, .data = *data};
   } else {
@@ -685,7 +781,7 @@ static err_t ts_number_integer(char c, arraybuffer *list,
     return false;
   }
   if ('0' <= c && c <= '9') {
-    data->number.value = data->number.value * 10 + (c - '0');
+    number_add_digit(&data->number, c - '0');
     *out_next_state =
         (tokenizer_state){.state = TS_NUMBER_INTEGER, .data = *data};
     return false;
@@ -877,354 +973,7283 @@ static const tokenizer_state_function state_functions[] = {
     ts_string_surrogate_u,
 };
 
-static void tokenize_free(arraybuffer *tokens) {
-  for (size_t i = 0; i < tokens->length; i++) {
-    token *token = arraybuffer_get(tokens, i);
-    if (token->type == TT_STRING) {
-      free(token->value.string);
-    }
-  }
-  arraybuffer_destroy(tokens);
-}
-
-static err_t tokenize(const char *str, arraybuffer **out) {
-  tokenizer_state current_state = {.state = TS_DEFAULT};
-  arraybuffer *tokens = arraybuffer_create(sizeof(token), 128);
-  size_t i = -1;
-  while (current_state.state != TS_ERROR && (i++ == (size_t)-1 || str[i - 1])) {
-    tokenizer_state_data data = current_state.data;
-    if (state_functions[current_state.state](str[i], tokens, &data,
-                                             &current_state)) {
-      tokenize_free(tokens);
-      return true;
-    }
-  }
-  if (current_state.state == TS_ERROR) {
-    tokenize_free(tokens);
-    *out = NULL;
-    return false;
-  }
-  *out = tokens;
-  return false;
-}
-
-static token token_get(arraybuffer *tokens, size_t index) {
-  return *((token *)arraybuffer_get(tokens, index));
-}
-
-static bool parse_next_is_array(token_type type) {
-  return type == TT_LEFT_BRACKET;
+// The extensions of jsonc_parse_flags live in a second table, chosen once per
+// lexer, so the strict functions above neither know about them nor pay for
+// them. Lenient functions read the flags from the tokenizer_context.
+static unsigned lenient_flags(tokenizer_state_data *data) {
+  return tokenizer_context_of(data)->flags;
 }
 
-static bool parse_next_is_object(token_type type) {
-  return type == TT_LEFT_BRACE;
+static bool is_identifier_start(char c) {
+  return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_' ||
+         c == '$';
 }
 
-static bool parse_next_is_value(token_type type) {
-  return type == TT_NULL || type == TT_TRUE || type == TT_FALSE ||
-         type == TT_NUMBER || type == TT_STRING || parse_next_is_array(type) ||
-         parse_next_is_object(type);
+static bool is_identifier_part(char c) {
+  return is_identifier_start(c) || ('0' <= c && c <= '9');
 }
 
-static void free_array(jsonc_array array);
-static void free_object(jsonc_object object);
-static void free_value(jsonc_value value);
-
-static void free_array(jsonc_array array) {
-  for (size_t i = 0; i < array.count; i++) {
-    free_value(array.values[i]);
+// Starts an identifier, or a signed NaN or Infinity when `sign` is not NUL.
+static err_t start_identifier(tokenizer_state_data *data, char sign, char c,
+                              tokenizer_state *out_next_state) {
+  arraybuffer *const stringbuilder = tokenizer_context_of(data)->strings;
+  const size_t start = stringbuilder->length;
+  if ((sign && arraybuffer_push(stringbuilder, &sign)) ||
+      arraybuffer_push(stringbuilder, &c)) {
+    return true;
   }
-  free(array.values);
+  *out_next_state = (tokenizer_state){.state = TS_IDENTIFIER};
+  out_next_state->data.string.stringbuilder = stringbuilder;
+  out_next_state->data.string.start = start;
+  return false;
 }
 
-static void free_object(jsonc_object object) {
-  for (size_t i = 0; i < object.count; i++) {
-    free_value(object.entries[i].value);
-    free(object.entries[i].key);
+static err_t ts_lenient_default(char c, arraybuffer *list,
+                                tokenizer_state_data *data,
+                                tokenizer_state *out_next_state) {
+  const unsigned flags = lenient_flags(data);
+  if (c == '"' || (c == '\'' && (flags & JSONC_PARSE_SINGLE_QUOTES))) {
+    if (ts_default('"', list, data, out_next_state)) {
+      return true;
+    }
+    out_next_state->data.string.single_quoted = c == '\'';
+    return false;
   }
-  free(object.entries);
-}
-
-static void free_value(jsonc_value value) {
-  if (value.type == JSONC_VALUE_TYPE_ARRAY) {
-    free_array(value.value.array);
-  } else if (value.type == JSONC_VALUE_TYPE_OBJECT) {
-    free_object(value.value.object);
-  } else if (value.type == JSONC_VALUE_TYPE_STRING) {
-    free(value.value.string);
+  if (c == '+' &&
+      (flags & (JSONC_PARSE_LENIENT_NUMBERS | JSONC_PARSE_NAN_INFINITY))) {
+    if (ts_default('-', list, data, out_next_state)) {
+      return true;
+    }
+    out_next_state->data.number.sign = 1;
+    return false;
   }
+  if (c == '.' && (flags & JSONC_PARSE_LENIENT_NUMBERS)) {
+    if (ts_default('0', list, data, out_next_state)) {
+      return true;
+    }
+    out_next_state->state = TS_NUMBER_LEADING_DOT;
+    return false;
+  }
+  if ((flags & JSONC_PARSE_UNQUOTED_KEYS)
+          ? is_identifier_start(c)
+          : (flags & JSONC_PARSE_NAN_INFINITY) && (c == 'N' || c == 'I')) {
+    return start_identifier(data, '\0', c, out_next_state);
+  }
+  return ts_default(c, list, data, out_next_state);
 }
 
-static err_t parse_array(arraybuffer *list, size_t *index, jsonc_array *out,
-                         bool *out_is_error);
-static err_t parse_object(arraybuffer *list, size_t *index, jsonc_object *out,
-                          bool *out_is_error);
-static err_t parse_value(arraybuffer *list, size_t *index, jsonc_value *out,
-                         bool *out_is_error);
-
-static err_t parse_array(arraybuffer *list, size_t *index, jsonc_array *out,
-                         bool *out_is_error) {
-  (*index)++;
-  if (token_get(list, *index).type == TT_RIGHT_BRACKET) {
-    out->count = 0;
-    out->values = NULL;
-    (*index)++;
-    return false;
+// Ends the identifier on the first character that cannot continue it. Since
+// every letter starts one, it also reads the keywords.
+static err_t ts_identifier(char c, arraybuffer *list,
+                           tokenizer_state_data *data,
+                           tokenizer_state *out_next_state) {
+  static const char null_byte = '\0';
+  arraybuffer *const stringbuilder = data->string.stringbuilder;
+  if (is_identifier_part(c)) {
+    *out_next_state = (tokenizer_state){.state = TS_IDENTIFIER, .data = *data};
+    return arraybuffer_push(stringbuilder, &c);
   }
-  jsonc_value first;
-  bool is_error;
-  if (parse_value(list, index, &first, &is_error)) {
+  if (arraybuffer_push(stringbuilder, &null_byte)) {
     return true;
   }
-  if (is_error) {
-    *out_is_error = true;
+  const unsigned flags = lenient_flags(data);
+  const size_t start = data->string.start;
+  const char *const text = arraybuffer_get(stringbuilder, start);
+  const char *const name = text + (*text == '+' || *text == '-');
+  token current = {.type = TT_IDENTIFIER};
+  if (!strcmp(text, "true")) {
+    current.type = TT_TRUE;
+  } else if (!strcmp(text, "false")) {
+    current.type = TT_FALSE;
+  } else if (!strcmp(text, "null")) {
+    current.type = TT_NULL;
+  } else if ((flags & JSONC_PARSE_NAN_INFINITY) &&
+             (!strcmp(name, "NaN") || !strcmp(name, "Infinity"))) {
+    current.type = TT_NUMBER;
+    current.value.number = *name == 'N'   ? NAN
+                           : *text == '-' ? -INFINITY
+                                          : INFINITY;
+  } else if ((flags & JSONC_PARSE_UNQUOTED_KEYS) && name == text) {
+    current.value.text.offset = start;
+    current.value.text.length = stringbuilder->length - start - 1;
+  } else {
+    *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
-  arraybuffer *const values = arraybuffer_create(sizeof(jsonc_value), 4);
-  if (!values) {
-    free_value(first);
-    return true;
-  }
-  if (arraybuffer_push(values, &first)) {
-    free_value(first);
-    goto fail;
+  if (current.type != TT_IDENTIFIER) {
+    stringbuilder->length = start;
   }
-  while (token_get(list, *index).type == TT_COMMA) {
-    (*index)++;
-    if (token_get(list, *index).type == TT_RIGHT_BRACKET) {
-      break;
-    }
-    jsonc_value value;
-    if (parse_value(list, index, &value, &is_error)) {
-      goto fail;
-    }
-    if (is_error) {
-      goto error;
-    }
-    if (arraybuffer_push(values, &value)) {
-      free_value(value);
-      goto fail;
-    }
+  if (arraybuffer_push(list, &current)) {
+    return true;
   }
-  if (token_get(list, *index).type != TT_RIGHT_BRACKET) {
-    goto error;
+  return ts_lenient_default(c, list, data, out_next_state);
+}
+
+static err_t ts_lenient_string_any(char c, arraybuffer *list,
+                                   tokenizer_state_data *data,
+                                   tokenizer_state *out_next_state) {
+  if (!data->string.single_quoted || (c != '\'' && c != '"')) {
+    return ts_string_any(c, list, data, out_next_state);
   }
-  (*index)++;
-  out->count = values->length;
-  out->values = malloc(sizeof(jsonc_value) * out->count);
-  if (!out->values) {
-    goto fail;
+  if (c == '\'') {
+    return add_string_token(list, &data->string, out_next_state);
   }
-  for (size_t i = 0; i < out->count; i++) {
-    out->values[i] = *((jsonc_value *)arraybuffer_get(values, i));
+  *out_next_state = (tokenizer_state){.state = TS_STRING_ANY, .data = *data};
+  if (arraybuffer_push(data->string.stringbuilder, &c)) {
+    return true;
   }
-  arraybuffer_destroy(values);
-  *out_is_error = false;
   return false;
+}
 
-fail:
-  for (size_t i = 0; i < values->length; i++) {
-    jsonc_value *value = arraybuffer_get(values, i);
-    free_value(*value);
+static err_t ts_lenient_string_backslash(char c, arraybuffer *list,
+                                         tokenizer_state_data *data,
+                                         tokenizer_state *out_next_state) {
+  if (c != '\'' || !(lenient_flags(data) & JSONC_PARSE_SINGLE_QUOTES)) {
+    return ts_string_backslash(c, list, data, out_next_state);
   }
-  arraybuffer_destroy(values);
-  return true;
-
-error:
-  for (size_t i = 0; i < values->length; i++) {
-    jsonc_value *value = arraybuffer_get(values, i);
-    free_value(*value);
+  *out_next_state = (tokenizer_state){.state = TS_STRING_ANY, .data = *data};
+  if (arraybuffer_push(data->string.stringbuilder, &c)) {
+    return true;
   }
-  arraybuffer_destroy(values);
-  *out_is_error = true;
   return false;
 }
 
-static err_t parse_object(arraybuffer *list, size_t *index, jsonc_object *out,
-                          bool *out_is_error) {
-  (*index)++;
-  if (token_get(list, *index).type == TT_RIGHT_BRACE) {
-    out->count = 0;
-    out->entries = NULL;
-    (*index)++;
-    return false;
-  }
-  jsonc_object_entry first;
-  if (token_get(list, *index).type != TT_STRING) {
-    *out_is_error = true;
-    return false;
+// The strict number states hand the character after a number to ts_default;
+// here it goes to ts_lenient_default instead.
+static err_t lenient_number_end(tokenizer_state_function strict, char c,
+                                arraybuffer *list, tokenizer_state_data *data,
+                                tokenizer_state *out_next_state) {
+  if (('0' <= c && c <= '9') || c == '.' || c == 'e' || c == 'E') {
+    return strict(c, list, data, out_next_state);
   }
-  first.key = util_strdup(token_get(list, *index).value.string);
-  if (!first.key) {
+  if (add_number_token(list, &data->number)) {
     return true;
   }
-  (*index)++;
-  if (token_get(list, *index).type != TT_COLON) {
-    free(first.key);
-    *out_is_error = true;
+  return ts_lenient_default(c, list, data, out_next_state);
+}
+
+static err_t ts_lenient_number_sign(char c, arraybuffer *list,
+                                    tokenizer_state_data *data,
+                                    tokenizer_state *out_next_state) {
+  const unsigned flags = lenient_flags(data);
+  if (c == '.' && (flags & JSONC_PARSE_LENIENT_NUMBERS)) {
+    *out_next_state =
+        (tokenizer_state){.state = TS_NUMBER_LEADING_DOT, .data = *data};
     return false;
   }
-  (*index)++;
-  bool is_error;
-  if (parse_value(list, index, &first.value, &is_error)) {
-    return true;
+  if ((c == 'N' || c == 'I') && (flags & JSONC_PARSE_NAN_INFINITY)) {
+    return start_identifier(data, data->number.sign < 0 ? '-' : '+', c,
+                            out_next_state);
   }
-  if (is_error) {
-    *out_is_error = true;
-    free(first.key);
+  if (data->number.sign > 0 && !(flags & JSONC_PARSE_LENIENT_NUMBERS)) {
+    *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
   }
-  arraybuffer *const entries =
-      arraybuffer_create(sizeof(jsonc_object_entry), 4);
-  if (!entries) {
-    free_value(first.value);
-    free(first.key);
-    return true;
-  }
-  if (arraybuffer_push(entries, &first)) {
-    free_value(first.value);
-    free(first.key);
-    goto fail;
-  }
-  while (token_get(list, *index).type == TT_COMMA) {
-    (*index)++;
-    if (token_get(list, *index).type == TT_RIGHT_BRACE) {
-      break;
-    }
-    if (token_get(list, *index).type != TT_STRING) {
-      goto error;
-    }
-    jsonc_object_entry entry;
-    entry.key = util_strdup(token_get(list, *index).value.string);
-    if (!entry.key) {
-      goto fail;
-    }
-    (*index)++;
-    if (token_get(list, *index).type != TT_COLON) {
-      free(entry.key);
-      goto error;
-    }
-    (*index)++;
-    if (parse_value(list, index, &entry.value, &is_error)) {
-      free(entry.key);
-      goto fail;
-    }
-    if (is_error) {
-      free(entry.key);
-      goto error;
-    }
-    if (arraybuffer_push(entries, &entry)) {
-      free_value(entry.value);
-      free(entry.key);
-      goto fail;
-    }
+  // Unlike ts_number_sign, keeps -0x1F and -01 apart.
+  if (c == '0') {
+    *out_next_state = (tokenizer_state){.state = TS_NUMBER_ZERO, .data = *data};
+    return false;
   }
-  if (token_get(list, *index).type != TT_RIGHT_BRACE) {
-    goto error;
+  return ts_number_sign(c, list, data, out_next_state);
+}
+
+static err_t ts_lenient_number_zero(char c, arraybuffer *list,
+                                    tokenizer_state_data *data,
+                                    tokenizer_state *out_next_state) {
+  if ((c == 'x' || c == 'X') &&
+      (lenient_flags(data) & JSONC_PARSE_HEX_NUMBERS)) {
+    *out_next_state =
+        (tokenizer_state){.state = TS_NUMBER_HEX_START, .data = *data};
+    return false;
   }
-  (*index)++;
-  out->count = entries->length;
-  out->entries = malloc(sizeof(jsonc_object_entry) * out->count);
-  if (!out->entries) {
-    goto fail;
+  return lenient_number_end(ts_number_zero, c, list, data, out_next_state);
+}
+
+static err_t ts_lenient_number_integer(char c, arraybuffer *list,
+                                       tokenizer_state_data *data,
+                                       tokenizer_state *out_next_state) {
+  return lenient_number_end(ts_number_integer, c, list, data, out_next_state);
+}
+
+// A '.' after the integer part; only TS_NUMBER_LEADING_DOT needs a digit.
+static err_t ts_lenient_number_dot(char c, arraybuffer *list,
+                                   tokenizer_state_data *data,
+                                   tokenizer_state *out_next_state) {
+  if (!(lenient_flags(data) & JSONC_PARSE_LENIENT_NUMBERS)) {
+    return ts_number_dot(c, list, data, out_next_state);
   }
-  for (size_t i = 0; i < out->count; i++) {
-    out->entries[i] = *((jsonc_object_entry *)arraybuffer_get(entries, i));
+  if (c == 'e' || c == 'E') {
+    *out_next_state = (tokenizer_state){.state = TS_NUMBER_E, .data = *data};
+    return false;
   }
-  arraybuffer_destroy(entries);
-  *out_is_error = false;
-  return false;
+  return lenient_number_end(ts_number_dot, c, list, data, out_next_state);
+}
 
-fail:
-  for (size_t i = 0; i < entries->length; i++) {
-    jsonc_object_entry *entry = arraybuffer_get(entries, i);
-    free_value(entry->value);
-    free(entry->key);
-  }
-  arraybuffer_destroy(entries);
-  return true;
+static err_t ts_lenient_number_fraction(char c, arraybuffer *list,
+                                        tokenizer_state_data *data,
+                                        tokenizer_state *out_next_state) {
+  return lenient_number_end(ts_number_fraction, c, list, data, out_next_state);
+}
 
-error:
-  for (size_t i = 0; i < entries->length; i++) {
-    jsonc_object_entry *entry = arraybuffer_get(entries, i);
-    free_value(entry->value);
-    free(entry->key);
+static err_t ts_lenient_number_e_digit(char c, arraybuffer *list,
+                                       tokenizer_state_data *data,
+                                       tokenizer_state *out_next_state) {
+  return lenient_number_end(ts_number_e_digit, c, list, data, out_next_state);
+}
+
+static err_t ts_number_hex(char c, arraybuffer *list,
+                           tokenizer_state_data *data,
+                           tokenizer_state *out_next_state) {
+  const unsigned char value = from_hex(c);
+  if (value == (unsigned char)-1) {
+    if (add_number_token(list, &data->number)) {
+      return true;
+    }
+    return ts_lenient_default(c, list, data, out_next_state);
   }
-  arraybuffer_destroy(entries);
-  *out_is_error = true;
+  data->number.value = data->number.value * 16 + value;
+  *out_next_state = (tokenizer_state){.state = TS_NUMBER_HEX, .data = *data};
   return false;
 }
 
-static err_t parse_value(arraybuffer *list, size_t *index, jsonc_value *out,
-                         bool *out_is_error) {
-  if (!parse_next_is_value(token_get(list, *index).type)) {
-    *out_is_error = true;
+static err_t ts_number_hex_start(char c, arraybuffer *list,
+                                 tokenizer_state_data *data,
+                                 tokenizer_state *out_next_state) {
+  if (from_hex(c) == (unsigned char)-1) {
+    *out_next_state = (tokenizer_state){.state = TS_ERROR};
     return false;
-  } else if (parse_next_is_array(token_get(list, *index).type)) {
-    out->type = JSONC_VALUE_TYPE_ARRAY;
-    return parse_array(list, index, &out->value.array, out_is_error);
-  } else if (parse_next_is_object(token_get(list, *index).type)) {
-    out->type = JSONC_VALUE_TYPE_OBJECT;
-    return parse_object(list, index, &out->value.object, out_is_error);
-  } else {
-    err_t result;
+  }
+  return ts_number_hex(c, list, data, out_next_state);
+}
 
-    result = false;
-    if (token_get(list, *index).type == TT_NULL) {
-      out->type = JSONC_VALUE_TYPE_NULL;
-    } else if (token_get(list, *index).type == TT_TRUE ||
-               token_get(list, *index).type == TT_FALSE) {
-      out->type = JSONC_VALUE_TYPE_BOOLEAN;
-      out->value.boolean = token_get(list, *index).type == TT_TRUE;
-    } else if (token_get(list, *index).type == TT_NUMBER) {
-      out->type = JSONC_VALUE_TYPE_NUMBER;
-      out->value.number = token_get(list, *index).value.number;
-    } else if (token_get(list, *index).type == TT_STRING) {
-      out->type = JSONC_VALUE_TYPE_STRING;
-      out->value.string = util_strdup(token_get(list, *index).value.string);
-      result = !out->value.string;
+static const tokenizer_state_function lenient_state_functions[] = {
+    ts_lenient_default,
+    ts_keyword_t,
+    ts_keyword_tr,
+    ts_keyword_tru,
+    ts_keyword_f,
+    ts_keyword_fa,
+    ts_keyword_fal,
+    ts_keyword_fals,
+    ts_keyword_n,
+    ts_keyword_nu,
+    ts_keyword_nul,
+    ts_lenient_string_any,
+    ts_lenient_string_backslash,
+    ts_string_u0,
+    ts_string_u1,
+    ts_string_u2,
+    ts_string_u3,
+    ts_lenient_number_sign,
+    ts_lenient_number_zero,
+    ts_lenient_number_integer,
+    ts_lenient_number_dot,
+    ts_lenient_number_fraction,
+    ts_number_e,
+    ts_number_e_sign,
+    ts_lenient_number_e_digit,
+    ts_slash,
+    ts_single_line_comment,
+    ts_multi_line_comment,
+    ts_multi_line_comment_star,
+    ts_string_surrogate,
+    ts_string_surrogate_u,
+    ts_identifier,
+    ts_number_hex_start,
+    ts_number_hex,
+    ts_number_dot,
+};
+
+// States that are decoding into the string buffer.
+static bool is_string_state(int state) {
+  return (TS_STRING_ANY <= state && state <= TS_STRING_U3) ||
+         state == TS_STRING_SURROGATE || state == TS_STRING_SURROGATE_U ||
+         state == TS_IDENTIFIER;
+}
+
+static bool is_scalar_token(token_type type) {
+  return type == TT_STRING || type == TT_NUMBER || type == TT_TRUE ||
+         type == TT_FALSE || type == TT_NULL || type == TT_IDENTIFIER;
+}
+
+// States that end their token on the character after it.
+static bool is_token_end_state(int state) {
+  return state == TS_NUMBER_ZERO || state == TS_NUMBER_INTEGER ||
+         state == TS_NUMBER_FRACTION || state == TS_NUMBER_E_DIGIT ||
+         state == TS_NUMBER_DOT || state == TS_NUMBER_HEX ||
+         state == TS_IDENTIFIER;
+}
+
+// Classifies a tokenizer failure from the state it happened in and the
+// offending character. Only called once tokenizing has already failed.
+static void tokenize_error(int state, char c, size_t offset,
+                           size_t lexeme_start, jsonc_error *out_error) {
+  out_error->offset = offset;
+  if (state == TS_IDENTIFIER) {
+    out_error->code = JSONC_ERROR_UNEXPECTED_CHARACTER;
+    out_error->offset = lexeme_start;
+  } else if (is_string_state(state)) {
+    if (!c) {
+      out_error->code = JSONC_ERROR_UNTERMINATED_STRING;
+      out_error->offset = lexeme_start;
+    } else if (state == TS_STRING_ANY && (c == '"' || c == '\'')) {
+      out_error->code = JSONC_ERROR_INVALID_UTF8;
+      out_error->offset = lexeme_start;
+    } else if (state == TS_STRING_ANY) {
+      out_error->code = JSONC_ERROR_UNEXPECTED_CHARACTER;
     } else {
-      *out_is_error = true;
-      return false;
+      out_error->code = JSONC_ERROR_BAD_ESCAPE;
     }
-    (*index)++;
-    *out_is_error = false;
-    return result;
+  } else if (state == TS_SINGLE_LINE_COMMENT ||
+             state == TS_MULTI_LINE_COMMENT ||
+             state == TS_MULTI_LINE_COMMENT_STAR) {
+    out_error->code = JSONC_ERROR_UNTERMINATED_COMMENT;
+    out_error->offset = lexeme_start;
+  } else if (!c) {
+    out_error->code = JSONC_ERROR_UNEXPECTED_END;
+  } else {
+    out_error->code = JSONC_ERROR_UNEXPECTED_CHARACTER;
   }
 }
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+// jsonc_strip's progress: `read` bytes of `source` taken, `written` bytes of
+// output produced. Kept bytes are moved to `out` only when something is
+// dropped or the end is reached, so unchanged text is copied in long runs:
+// the last `read - unmoved` bytes taken are still to be moved. Lines are
+// counted lazily, since in place the source behind `read` is gone:
+// out[0, counted) has been counted into `line`, and `line_start` is the
+// source offset after the last newline seen.
+typedef struct stripper {
+  const char *source;
+  size_t length;
+  char *out;
+  size_t read;
+  size_t written;
+  size_t unmoved;
+  unsigned flags;
+  // Output offset of a comma still waiting to learn whether it trails, or
+  // SIZE_MAX.
+  size_t comma;
+  size_t counted;
+  size_t line;
+  size_t line_start;
+} stripper;
 
-err_t jsonc_parse(const char *source, jsonc_value *out, bool *out_is_error) {
-  arraybuffer *tokens;
-  if (tokenize(source, &tokens)) {
-    return true;
-  }
-  if (!tokens) {
-    *out_is_error = true;
-    return false;
-  }
-  size_t index = 0;
-  if (parse_value(tokens, &index, out, out_is_error)) {
-    tokenize_free(tokens);
-    return true;
+// Bytes that end a run of kept text: 1 for those that start a string or a
+// comment, 2 for those that matter only when dropping trailing commas.
+static const unsigned char strip_stops[256] = {['"'] = 1, ['/'] = 1, [','] = 2};
+
+static bool is_strip_space(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Whether removing a comment between two bytes could join them into one
+// token, as in 1/**/2.
+static bool is_strip_word(char c) {
+  return c && !is_strip_space(c) && c != '"' && c != ',' && c != ':' &&
+         c != '[' && c != ']' && c != '{' && c != '}';
+}
+
+static void strip_keep(stripper *strip, size_t count) {
+  strip->read += count;
+  strip->written += count;
+}
+
+// Moves the kept bytes not yet in `out` there.
+static void strip_move(stripper *strip) {
+  const size_t count = strip->read - strip->unmoved;
+  char *const to = strip->out + strip->written - count;
+  const char *const from = strip->source + strip->unmoved;
+  if (to != from) {
+    memmove(to, from, count);
   }
-  if (*out_is_error) {
-    tokenize_free(tokens);
+  strip->unmoved = strip->read;
+}
+
+// Called with every kept byte moved.
+static void strip_put(stripper *strip, const char *bytes, size_t count) {
+  memcpy(strip->out + strip->written, bytes, count);
+  strip->written += count;
+}
+
+// Counts the newlines of the output since the last call, moving it first.
+// Called before anything is dropped, while that output still sits a fixed
+// distance from where it came from.
+static void strip_count_lines(stripper *strip) {
+  strip_move(strip);
+  const size_t shift = strip->read - strip->written;
+  for (size_t i = strip->counted; i < strip->written; i++) {
+    if (strip->out[i] == '\n') {
+      strip->line++;
+      strip->line_start = i + shift + 1;
+    }
+  }
+  strip->counted = strip->written;
+}
+
+// Drops the comment at `read`, which starts with "//" or "/*" and is preceded
+// by a call to strip_count_lines. The comment is run through the tokenizer's
+// own comment states, so that it ends exactly where the parser would end it;
+// only the bytes that leave a comment state unchanged are skipped in bulk.
+// Returns false if the comment does not end.
+static bool strip_comment(stripper *strip) {
+  static const char spaces[64] = "                                "
+                                 "                               ";
+  const bool preserve = strip->flags & JSONC_STRIP_PRESERVE_OFFSETS;
+  const size_t start = strip->written;
+  tokenizer_state state = {.state = TS_SLASH};
+  strip->read++;
+  if (preserve) {
+    strip_put(strip, spaces, 1);
+  }
+  do {
+    if (state.state == TS_SINGLE_LINE_COMMENT ||
+        state.state == TS_MULTI_LINE_COMMENT) {
+      const char end = state.state == TS_SINGLE_LINE_COMMENT ? '\n' : '*';
+      size_t run = strip->read;
+      while (run < strip->length && strip->source[run] != end &&
+             strip->source[run] != '\n' && strip->source[run] != '\r' &&
+             strip->source[run]) {
+        run++;
+      }
+      for (size_t left = run - strip->read; preserve && left;) {
+        const size_t count = left < sizeof(spaces) ? left : sizeof(spaces);
+        strip_put(strip, spaces, count);
+        left -= count;
+      }
+      strip->read = run;
+    }
+    const char c =
+        strip->read < strip->length ? strip->source[strip->read] : '\0';
+    state_functions[state.state](c, NULL, NULL, &state);
+    if (state.state == TS_ERROR) {
+      return false;
+    }
+    strip->read++;
+    if (c == '\n') {
+      strip->line++;
+      strip->line_start = strip->read;
+      strip_put(strip, &c, 1);
+    } else if (preserve) {
+      strip_put(strip, c == '\r' ? &c : spaces, 1);
+    }
+  } while (state.state != TS_DEFAULT);
+  if (!preserve && strip->written == start && start &&
+      is_strip_word(strip->out[start - 1]) && strip->read < strip->length &&
+      is_strip_word(strip->source[strip->read])) {
+    strip_put(strip, spaces, 1);
+  }
+  strip->counted = strip->written;
+  strip->unmoved = strip->read;
+  return true;
+}
+
+// Called on a byte other than whitespace outside comments and strings.
+static void strip_significant(stripper *strip, char c) {
+  const size_t comma = strip->comma;
+  strip->comma = SIZE_MAX;
+  if (comma == SIZE_MAX || (c != ']' && c != '}')) {
+    return;
+  }
+  if (strip->flags & JSONC_STRIP_PRESERVE_OFFSETS) {
+    strip_move(strip);
+    strip->out[comma] = ' ';
+    return;
+  }
+  strip_count_lines(strip);
+  memmove(strip->out + comma, strip->out + comma + 1,
+          strip->written - comma - 1);
+  strip->written--;
+  strip->counted = strip->written;
+}
+
+// Keeps a string, escapes included, up to and including its closing quote.
+// Quotes are found with memchr, which libraries vectorize; one that follows
+// an odd number of backslashes is escaped.
+static void strip_string(stripper *strip) {
+  const char *const source = strip->source;
+  size_t i = strip->read + 1;
+  for (;;) {
+    const char *const quote = memchr(source + i, '"', strip->length - i);
+    if (!quote) {
+      i = strip->length;
+      break;
+    }
+    i = (size_t)(quote - source);
+    size_t backslashes = 0;
+    while (source[i - 1 - backslashes] == '\\') {
+      backslashes++;
+    }
+    i++;
+    if (backslashes % 2 == 0) {
+      break;
+    }
+  }
+  strip_keep(strip, i - strip->read);
+}
+
+// Buffers that a parse needs only while it runs: the token queue, the string
+// buffer, the reader's stack of open containers, and build_value's stack with
+// the members of its open containers. A jsonc_parser keeps one set across
+// parses; otherwise each reader makes its own.
+typedef struct parse_scratch {
+  arraybuffer *tokens;
+  arraybuffer *strings;
+  arraybuffer *frames;
+  arraybuffer *builds;
+  arraybuffer *values;
+  arraybuffer *entries;
+} parse_scratch;
+
+// Hands a lexer more of a source that is still arriving. `wait` blocks
+// until bytes past `*available` can be read, or the source has ended; it
+// then updates `*source`, which may have moved, and `*available`, which
+// counts the final NUL once the end has been reached.
+typedef struct lexer_feed {
+  err_t (*wait)(struct lexer_feed *feed, const char **source,
+                size_t *available);
+} lexer_feed;
+
+// Produces tokens on demand from a NUL-terminated source, which is either
+// all in memory or still arriving through `feed`. Tokens are queued in
+// `tokens` from `head` onwards; the queue only ever holds the few tokens of
+// lookahead the reader asks for, so memory does not grow with the document.
+typedef struct lexer {
+  const char *source;
+  // Bytes of `source` that may be read; past them the feed is waited on.
+  // Without a feed the source is all there and this is SIZE_MAX.
+  size_t available;
+  lexer_feed *feed;
+  // The lesser of `available` and the document size limit, so that
+  // lexer_step checks both with one comparison.
+  size_t limit;
+  size_t position;
+  size_t lexeme_start;
+  bool finished;
+  tokenizer_state state;
+  const tokenizer_state_function *functions;
+  // What the state functions are handed; only `data` changes between
+  // characters, and it is refreshed from `state` before each one.
+  tokenizer_context context;
+  arraybuffer *tokens;
+  size_t head;
+  const jsonc_parse_options *options;
+  jsonc_error *error;
+} lexer;
+
+static void lexer_init(lexer *lexer, const char *source,
+                       const jsonc_parse_options *options,
+                       parse_scratch *scratch, jsonc_error *error) {
+  *lexer = (struct lexer){
+      .source = source,
+      .available = SIZE_MAX,
+      .limit = options->max_document_size ? options->max_document_size
+                                          : SIZE_MAX,
+      .state = {.state = TS_DEFAULT},
+      .functions = options->flags ? lenient_state_functions : state_functions,
+      .context = {.flags = options->flags, .strings = scratch->strings},
+      .tokens = scratch->tokens,
+      .options = options,
+      .error = error,
+  };
+}
+
+// Empties the buffers, which belong to the parse_scratch.
+static void lexer_destroy(lexer *lexer) {
+  lexer->tokens->length = 0;
+  lexer->context.strings->length = 0;
+}
+
+// Empties the string buffer if no queued token or string being decoded still
+// refers to it. Event strings point into it too, so this is only done once
+// the last event has been dealt with.
+static void lexer_recycle_strings(lexer *lexer) {
+  if (is_string_state(lexer->state.state)) {
+    return;
+  }
+  for (size_t i = lexer->head; i < lexer->tokens->length; i++) {
+    const token *const current = arraybuffer_get(lexer->tokens, i);
+    if (current->type == TT_STRING || current->type == TT_IDENTIFIER) {
+      return;
+    }
+  }
+  lexer->context.strings->length = 0;
+}
+
+static bool read_hex4(const char *p, uint32_t *out) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < 4; i++) {
+    const unsigned char digit = from_hex(p[i]);
+    if (digit == (unsigned char)-1) {
+      return false;
+    }
+    value = value << 4 | digit;
+  }
+  *out = value;
+  return true;
+}
+
+// Decodes as much of a string as it can in bulk: runs of plain bytes are
+// copied as one block and escapes are decoded whole, surrogate pairs
+// included. It stops in front of the closing quote, a control character,
+// the end of the source, the document size limit or any escape it does not
+// know to be valid, all of which the state functions then handle one
+// character at a time.
+static err_t lexer_scan_string(lexer *lexer) {
+  const char *const source = lexer->source;
+  tokenizer_state_string *const state = &lexer->state.data.string;
+  const char quote = state->single_quoted ? '\'' : '"';
+  const size_t end = lexer->limit;
+  size_t i = lexer->position;
+  err_t result = false;
+  while (i < end) {
+    size_t run = i;
+    while (run < end && (unsigned char)source[run] >= 0x20 &&
+           source[run] != quote && source[run] != '\\' &&
+           source[run] != 0x7F) {
+      run++;
+    }
+    if (run != i) {
+      if (arraybuffer_append(state->stringbuilder, source + i, run - i)) {
+        result = true;
+        break;
+      }
+      i = run;
+    }
+    if (end - i < 2 || source[i] != '\\') {
+      break;
+    }
+    const char decoded = unescape(source[i + 1]);
+    if (decoded) {
+      if (arraybuffer_push(state->stringbuilder, &decoded)) {
+        result = true;
+        break;
+      }
+      i += 2;
+      continue;
+    }
+    uint32_t codepoint, low;
+    size_t used = 6;
+    if (end - i < used || source[i + 1] != 'u' ||
+        !read_hex4(source + i + 2, &codepoint)) {
+      break;
+    }
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+      if (end - i < 12 || source[i + 6] != '\\' || source[i + 7] != 'u' ||
+          !read_hex4(source + i + 8, &low) || low < 0xDC00 || low > 0xDFFF) {
+        break;
+      }
+      codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+      used = 12;
+    } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+      break;
+    }
+    state->has_nul |= !codepoint;
+    if (utf8_append(state->stringbuilder, codepoint)) {
+      result = true;
+      break;
+    }
+    i += used;
+  }
+  lexer->position = i;
+  return result;
+}
+
+// Reads 8 bytes as a little-endian word, whatever the host's byte order.
+static uint64_t load_le64(const char *p) {
+  const unsigned char *const b = (const unsigned char *)p;
+  return (uint64_t)b[0] | (uint64_t)b[1] << 8 | (uint64_t)b[2] << 16 |
+         (uint64_t)b[3] << 24 | (uint64_t)b[4] << 32 | (uint64_t)b[5] << 40 |
+         (uint64_t)b[6] << 48 | (uint64_t)b[7] << 56;
+}
+
+// The value of eight ASCII digits, the first in the low byte, in three
+// multiplications instead of eight steps.
+static uint32_t digits8_value(uint64_t chunk) {
+  chunk -= 0x3030303030303030u;
+  // Pairs, then quads, then all eight.
+  chunk = chunk * 10 + (chunk >> 8);
+  chunk = ((chunk & 0x000000FF000000FFu) * (100 + (1000000ull << 32)) +
+           (chunk >> 16 & 0x000000FF000000FFu) * (1 + (10000ull << 32))) >>
+          32;
+  return (uint32_t)chunk;
+}
+
+// Adds `count` digits to the integer part of `number` or, with `fraction`,
+// to its fraction part. The arithmetic is that of ts_number_integer and
+// ts_number_fraction, so numbers come out exactly as if each digit had gone
+// through them.
+static void number_add_digits(tokenizer_state_number *number,
+                              const char *digits, size_t count,
+                              bool fraction) {
+  size_t i = 0;
+  if (fraction) {
+    for (; i < count; i++) {
+      number->current_digit /= 10;
+      number->value += number->current_digit * (digits[i] - '0');
+    }
+    return;
+  }
+  // While integer * 10^8 + 99999999 fits in 64 bits a whole chunk gives
+  // what eight single steps would.
+  while (count - i >= 8 && number->integer <= 184467440736u) {
+    number->integer =
+        number->integer * 100000000 + digits8_value(load_le64(digits + i));
+    number->value = (double)number->integer;
+    i += 8;
+  }
+  for (; i < count; i++) {
+    number_add_digit(number, digits[i] - '0');
+  }
+}
+
+static size_t skip_digits(const char *source, size_t i, size_t limit) {
+  while (i < limit && '0' <= source[i] && source[i] <= '9') {
+    i++;
+  }
+  return i;
+}
+
+// Consumes the digits that follow in TS_NUMBER_INTEGER or TS_NUMBER_FRACTION
+// without a state function call each, leaving the character after them to
+// the state function.
+static void lexer_scan_digits(lexer *lexer) {
+  const size_t end = skip_digits(lexer->source, lexer->position, lexer->limit);
+  number_add_digits(&lexer->state.data.number,
+                    lexer->source + lexer->position, end - lexer->position,
+                    lexer->state.state == TS_NUMBER_FRACTION);
+  lexer->position = end;
+}
+
+static void lexer_fail(lexer *lexer, jsonc_error_code code, size_t offset) {
+  lexer->state.state = TS_ERROR;
+  lexer->error->code = code;
+  lexer->error->offset = offset;
+}
+
+static bool lexer_string_too_long(const lexer *lexer) {
+  const tokenizer_state_string *const string = &lexer->state.data.string;
+  return lexer->options->max_string_length &&
+         is_string_state(lexer->state.state) &&
+         string->stringbuilder->length - string->start >
+             lexer->options->max_string_length;
+}
+
+// Waits for more of a fed source, and fails if the document size limit has
+// been reached with more text to come.
+static err_t lexer_reach_limit(lexer *lexer) {
+  const size_t i = lexer->position;
+  if (i >= lexer->available &&
+      lexer->feed->wait(lexer->feed, &lexer->source, &lexer->available)) {
+    return true;
+  }
+  const size_t max = lexer->options->max_document_size;
+  if (max && i >= max && lexer->source[i]) {
+    lexer_fail(lexer, JSONC_ERROR_MAX_DOCUMENT_SIZE, i);
+    return false;
+  }
+  lexer->limit = max && max < lexer->available ? max : lexer->available;
+  return false;
+}
+
+// Feeds one source character through the tokenizer state machine, after
+// the plain part of a string has been taken in bulk and after waiting for
+// the character to arrive if the source is fed.
+static err_t lexer_step(lexer *lexer) {
+  if (lexer->state.state == TS_STRING_ANY) {
+    if (lexer_scan_string(lexer)) {
+      lexer->state.state = TS_ERROR;
+      return true;
+    }
+    if (lexer_string_too_long(lexer)) {
+      lexer_fail(lexer, JSONC_ERROR_MAX_STRING_LENGTH, lexer->lexeme_start);
+      return false;
+    }
+  } else if (lexer->state.state == TS_NUMBER_INTEGER ||
+             lexer->state.state == TS_NUMBER_FRACTION) {
+    lexer_scan_digits(lexer);
+  }
+  const size_t i = lexer->position;
+  if (i >= lexer->limit) {
+    if (lexer_reach_limit(lexer)) {
+      lexer->state.state = TS_ERROR;
+      return true;
+    }
+    if (lexer->state.state == TS_ERROR) {
+      return false;
+    }
+  }
+  const char c = lexer->source[i];
+  const int state = lexer->state.state;
+  if (state == TS_DEFAULT) {
+    lexer->lexeme_start = i;
+  }
+  const size_t first_new = lexer->tokens->length;
+  lexer->context.data = lexer->state.data;
+  if (lexer->functions[state](c, lexer->tokens, &lexer->context.data,
+                              &lexer->state)) {
+    lexer->state.state = TS_ERROR;
+    return true;
+  }
+  if (lexer->state.state == TS_ERROR) {
+    tokenize_error(state, c, i, lexer->lexeme_start, lexer->error);
+    return false;
+  }
+  // Value tokens start at the lexeme start; punctuation and EOF are emitted
+  // on the character that produced them. Tokens ended by the character after
+  // them are the only ones that do not include it.
+  if (lexer->tokens->length != first_new) {
+    const bool ended = is_token_end_state(state);
+    for (size_t t = first_new; t < lexer->tokens->length; t++) {
+      token *const current = arraybuffer_get(lexer->tokens, t);
+      const bool is_scalar = is_scalar_token(current->type);
+      current->offset = is_scalar ? lexer->lexeme_start : i;
+      current->end = is_scalar && ended ? i : i + 1;
+    }
+    if (ended) {
+      lexer->lexeme_start = i;
+    }
+  }
+  if (lexer_string_too_long(lexer)) {
+    lexer_fail(lexer, JSONC_ERROR_MAX_STRING_LENGTH, lexer->lexeme_start);
+    return false;
+  }
+  if (c) {
+    lexer->position++;
+  } else {
+    lexer->finished = true;
+  }
+  return false;
+}
+
+// Points `*out` at the token `ahead` positions past the head of the queue, or
+// at NULL if the source could not be tokenized that far. Once the EOF token
+// has been produced, peeking further keeps returning it.
+static err_t lexer_peek(lexer *lexer, size_t ahead, token **out) {
+  arraybuffer *const tokens = lexer->tokens;
+  if (tokens->length - lexer->head <= ahead && lexer->head) {
+    memmove(tokens->data, arraybuffer_get(tokens, lexer->head),
+            (tokens->length - lexer->head) * tokens->element_size);
+    tokens->length -= lexer->head;
+    lexer->head = 0;
+  }
+  while (tokens->length - lexer->head <= ahead && !lexer->finished &&
+         lexer->state.state != TS_ERROR) {
+    if (lexer_step(lexer)) {
+      return true;
+    }
+  }
+  if (tokens->length - lexer->head > ahead) {
+    *out = arraybuffer_get(tokens, lexer->head + ahead);
+  } else if (lexer->state.state == TS_ERROR) {
+    *out = NULL;
+  } else {
+    *out = arraybuffer_get(tokens, tokens->length - 1);
+  }
+  return false;
+}
+
+static void lexer_advance(lexer *lexer, size_t count) {
+  lexer->head += count;
+  if (lexer->head > lexer->tokens->length) {
+    lexer->head = lexer->tokens->length;
+  }
+}
+
+static uint64_t hash_string(const char *s);
+
+typedef struct intern_slot {
+  char *string;
+  uint64_t hash;
+} intern_slot;
+
+// Open addressing with linear probing, kept at most half full. The table
+// owns every string in it.
+struct jsonc_intern {
+  intern_slot *slots;
+  size_t capacity;
+  size_t count;
+  size_t max_value_length;
+};
+
+// The slot holding `string`, or the empty slot where it would go.
+static intern_slot *intern_probe(const jsonc_intern *table, const char *string,
+                                 uint64_t hash) {
+  const size_t mask = table->capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    intern_slot *const slot = &table->slots[i];
+    if (!slot->string ||
+        (slot->hash == hash && !strcmp(slot->string, string))) {
+      return slot;
+    }
+  }
+}
+
+static err_t intern_grow(jsonc_intern *table) {
+  const size_t capacity = table->capacity * 2;
+  intern_slot *const slots = calloc(capacity, sizeof(intern_slot));
+  if (!slots) {
+    return true;
+  }
+  for (size_t i = 0; i < table->capacity; i++) {
+    const intern_slot *const slot = &table->slots[i];
+    if (slot->string) {
+      size_t j = slot->hash & (capacity - 1);
+      while (slots[j].string) {
+        j = (j + 1) & (capacity - 1);
+      }
+      slots[j] = *slot;
+    }
+  }
+  free(table->slots);
+  table->slots = slots;
+  table->capacity = capacity;
+  return false;
+}
+
+// Points *out at the table's copy of `string`, which is `length` bytes long,
+// copying it into the table the first time it is seen.
+static err_t intern_copy(jsonc_intern *table, const char *string, size_t length,
+                         char **out) {
+  const uint64_t hash = hash_string(string);
+  intern_slot *slot = intern_probe(table, string, hash);
+  if (!slot->string) {
+    if ((table->count + 1) * 2 > table->capacity) {
+      if (intern_grow(table)) {
+        return true;
+      }
+      slot = intern_probe(table, string, hash);
+    }
+    slot->string = util_strndup(string, length);
+    if (!slot->string) {
+      return true;
+    }
+    slot->hash = hash;
+    table->count++;
+  }
+  *out = slot->string;
+  return false;
+}
+
+static bool intern_owns(const jsonc_intern *table, const char *string) {
+  return intern_probe(table, string, hash_string(string))->string == string;
+}
+
+// Frees a string unless `intern` holds it. `intern` may be NULL.
+static void release_string(const jsonc_intern *intern, char *string) {
+  if (!intern || !intern_owns(intern, string)) {
+    free(string);
+  }
+}
+
+// Strings of up to JSONC_SMALL_STRING_MAX bytes are stored inline.
+static const char *string_data(const jsonc_value *value) {
+  return value->capacity ? value->value.small : value->value.string;
+}
+
+// Makes `out` a string value holding a copy of the `length` bytes of
+// `text`: inline if short, otherwise in an allocation of its own, or the
+// `intern` table's copy if the table takes strings that long. `intern` may
+// be NULL.
+static err_t string_copy(const char *text, size_t length, jsonc_intern *intern,
+                         jsonc_value *out) {
+  if (length <= JSONC_SMALL_STRING_MAX) {
+    out->type = JSONC_VALUE_TYPE_STRING;
+    out->capacity = (uint32_t)length + 1;
+    memcpy(out->value.small, text, length);
+    out->value.small[length] = '\0';
+    return false;
+  }
+  char *string;
+  if (intern && length <= intern->max_value_length) {
+    if (intern_copy(intern, text, length, &string)) {
+      return true;
+    }
+  } else if (!(string = util_strndup(text, length))) {
+    return true;
+  }
+  out->type = JSONC_VALUE_TYPE_STRING;
+  out->capacity = 0;
+  out->value.string = string;
+  return false;
+}
+
+static void release_value(jsonc_value value, const jsonc_intern *intern);
+
+// `capacity` of the root of a tree from jsonc_compact, whose member array
+// starts the block that holds the rest of the tree.
+#define CAPACITY_COMPACT UINT32_MAX
+
+static void release_container_recursive(jsonc_value value,
+                                        const jsonc_intern *intern) {
+  if (value.capacity == CAPACITY_COMPACT) {
+    free(value.value.array.values);
+  } else if (value.type == JSONC_VALUE_TYPE_ARRAY) {
+    for (size_t i = 0; i < value.value.array.count; i++) {
+      release_value(value.value.array.values[i], intern);
+    }
+    free(value.value.array.values);
+  } else {
+    for (size_t i = 0; i < value.value.object.count; i++) {
+      release_value(value.value.object.entries[i].value, intern);
+      release_string(intern, value.value.object.entries[i].key);
+    }
+    free(value.value.object.entries);
+  }
+}
+
+// Containers are released through an explicit worklist so that freeing a
+// deeply nested document does not recurse once per level. If the worklist
+// itself cannot grow, the remaining containers are freed recursively.
+// Strings held by `intern` are left alone.
+static void release_value(jsonc_value value, const jsonc_intern *intern) {
+  if (value.type == JSONC_VALUE_TYPE_STRING) {
+    if (!value.capacity) {
+      release_string(intern, value.value.string);
+    }
+    return;
+  }
+  if (value.type != JSONC_VALUE_TYPE_ARRAY &&
+      value.type != JSONC_VALUE_TYPE_OBJECT) {
+    return;
+  }
+  arraybuffer *const pending = arraybuffer_create(sizeof(jsonc_value), 16);
+  if (!pending) {
+    release_container_recursive(value, intern);
+    return;
+  }
+  arraybuffer_push(pending, &value);
+  while (pending->length) {
+    const jsonc_value current =
+        *(jsonc_value *)arraybuffer_get(pending, --pending->length);
+    if (current.capacity == CAPACITY_COMPACT) {
+      free(current.value.array.values);
+      continue;
+    }
+    const bool is_array = current.type == JSONC_VALUE_TYPE_ARRAY;
+    const size_t count =
+        is_array ? current.value.array.count : current.value.object.count;
+    for (size_t i = 0; i < count; i++) {
+      const jsonc_value child = is_array
+                                    ? current.value.array.values[i]
+                                    : current.value.object.entries[i].value;
+      if (!is_array) {
+        release_string(intern, current.value.object.entries[i].key);
+      }
+      if (child.type == JSONC_VALUE_TYPE_STRING) {
+        if (!child.capacity) {
+          release_string(intern, child.value.string);
+        }
+      } else if ((child.type == JSONC_VALUE_TYPE_ARRAY ||
+                  child.type == JSONC_VALUE_TYPE_OBJECT) &&
+                 arraybuffer_push(pending, &child)) {
+        release_container_recursive(child, intern);
+      }
+    }
+    if (is_array) {
+      free(current.value.array.values);
+    } else {
+      free(current.value.object.entries);
+    }
+  }
+  arraybuffer_destroy(pending);
+}
+
+static void free_value(jsonc_value value) { release_value(value, NULL); }
+
+// A compiled schema is a flat array of nodes that refer to their subschemas
+// by index; SCHEMA_ANY stands for the schema that accepts everything.
+#define SCHEMA_ANY SIZE_MAX
+
+// schema_node.types holds 1 << jsonc_value_type for each allowed type, plus
+// this bit for "integer". Zero allows every type.
+#define SCHEMA_TYPE_INTEGER (1u << 6)
+
+typedef enum schema_flag {
+  SCHEMA_FALSE = 1 << 0,
+  SCHEMA_HAS_MINIMUM = 1 << 1,
+  SCHEMA_HAS_MAXIMUM = 1 << 2,
+} schema_flag;
+
+typedef struct schema_node {
+  unsigned types;
+  unsigned flags;
+  double minimum;
+  double maximum;
+  size_t max_length;
+  size_t items;
+  size_t additional;
+  size_t properties;
+  size_t property_count;
+  size_t enums;
+  size_t enum_count;
+} schema_node;
+
+// Properties named only in `required` have the node SCHEMA_ANY.
+typedef struct schema_property {
+  char *key;
+  size_t node;
+  bool required;
+} schema_property;
+
+struct jsonc_schema {
+  schema_node *nodes;
+  size_t node_count;
+  schema_property *properties;
+  size_t property_count;
+  jsonc_value *enums;
+  size_t enum_count;
+};
+
+// An open container while validating. `seen` is the index of its first
+// flag in reader.schema_seen, one per property of its node.
+typedef struct schema_frame {
+  size_t node;
+  bool is_array;
+  size_t offset;
+  size_t seen;
+} schema_frame;
+
+// Internal form of jsonc_event. For JSONC_EVENT_STRING and JSONC_EVENT_KEY
+// `value.string` points into the lexer's string buffer, NUL-terminated, and
+// is only valid until the next reader_next. `end` is where the token that
+// produced the event ends.
+typedef struct event {
+  jsonc_event_type type;
+  union {
+    bool boolean;
+    double number;
+    struct {
+      const char *data;
+      size_t length;
+    } string;
+  } value;
+  size_t offset;
+  size_t end;
+} event;
+
+typedef enum reader_step {
+  RS_VALUE,
+  RS_ELEMENT,
+  RS_KEY,
+  RS_AFTER_VALUE,
+  RS_END,
+  RS_DONE,
+  RS_ERROR,
+} reader_step;
+
+typedef struct reader_frame {
+  bool is_array;
+  size_t count;
+} reader_frame;
+
+// Validates the token stream against the grammar and turns it into events,
+// keeping only a stack of open containers. Depth and member limits are
+// enforced here so that every consumer of the event stream gets them.
+typedef struct reader {
+  lexer lexer;
+  parse_scratch scratch;
+  bool owns_scratch;
+  arraybuffer *stack;
+  reader_step step;
+  const jsonc_parse_options *options;
+  jsonc_error *error;
+  // Only used with options->schema. `schema_member` is the node for the
+  // value that follows the last key.
+  arraybuffer *schema_stack;
+  arraybuffer *schema_seen;
+  size_t schema_member;
+} reader;
+
+static void reader_destroy(reader *reader);
+
+static err_t scratch_init(parse_scratch *scratch);
+static void scratch_destroy(parse_scratch *scratch);
+
+// Without `scratch` the reader makes its own.
+static err_t reader_init(reader *reader, const char *source,
+                         const jsonc_parse_options *options,
+                         parse_scratch *scratch, jsonc_error *error) {
+  reader->owns_scratch = !scratch;
+  if (scratch) {
+    reader->scratch = *scratch;
+  } else if (scratch_init(&reader->scratch)) {
+    return true;
+  }
+  lexer_init(&reader->lexer, source, options, &reader->scratch, error);
+  reader->stack = reader->scratch.frames;
+  reader->stack->length = 0;
+  reader->step = RS_VALUE;
+  reader->options = options;
+  reader->error = error;
+  reader->schema_stack = NULL;
+  reader->schema_seen = NULL;
+  if (options->schema) {
+    reader->schema_stack = arraybuffer_create(sizeof(schema_frame), 16);
+    reader->schema_seen = arraybuffer_create(sizeof(bool), 16);
+    if (!reader->schema_stack || !reader->schema_seen) {
+      reader_destroy(reader);
+      return true;
+    }
+  }
+  return false;
+}
+
+static void reader_destroy(reader *reader) {
+  lexer_destroy(&reader->lexer);
+  if (reader->owns_scratch) {
+    scratch_destroy(&reader->scratch);
+  }
+  if (reader->schema_stack) {
+    arraybuffer_destroy(reader->schema_stack);
+  }
+  if (reader->schema_seen) {
+    arraybuffer_destroy(reader->schema_seen);
+  }
+}
+
+static reader_frame *reader_top(reader *reader) {
+  return reader->stack->length
+             ? arraybuffer_get(reader->stack, reader->stack->length - 1)
+             : NULL;
+}
+
+static void reader_fail(reader *reader, event *out, jsonc_error_code code,
+                        size_t offset, unsigned expected) {
+  reader->error->code = code;
+  reader->error->offset = offset;
+  reader->error->expected = expected;
+  reader->step = RS_ERROR;
+  out->type = JSONC_EVENT_ERROR;
+}
+
+static void reader_unexpected(reader *reader, event *out, const token *current,
+                              unsigned expected) {
+  reader_fail(reader, out,
+              current->type == TT_EOF ? JSONC_ERROR_UNEXPECTED_END
+                                      : JSONC_ERROR_UNEXPECTED_TOKEN,
+              current->offset, expected);
+}
+
+// Emits the end of the innermost container.
+static void reader_close(reader *reader, event *out, const token *current) {
+  const reader_frame *const top = reader_top(reader);
+  out->type = top->is_array ? JSONC_EVENT_END_ARRAY : JSONC_EVENT_END_OBJECT;
+  out->offset = current->offset;
+  out->end = current->end;
+  reader->stack->length--;
+  lexer_advance(&reader->lexer, 1);
+  reader->step = RS_AFTER_VALUE;
+}
+
+static void reader_text(reader *reader, const token *current, event *out) {
+  out->value.string.data = arraybuffer_get(reader->lexer.context.strings,
+                                           current->value.text.offset);
+  out->value.string.length = current->value.text.length;
+}
+
+static err_t reader_value(reader *reader, event *out, token *current) {
+  out->offset = current->offset;
+  out->end = current->end;
+  if (current->type == TT_LEFT_BRACKET || current->type == TT_LEFT_BRACE) {
+    if (reader->options->max_depth &&
+        reader->stack->length >= reader->options->max_depth) {
+      reader_fail(reader, out, JSONC_ERROR_MAX_DEPTH, current->offset, 0);
+      return false;
+    }
+    const reader_frame frame = {.is_array = current->type == TT_LEFT_BRACKET};
+    if (arraybuffer_push(reader->stack, &frame)) {
+      return true;
+    }
+    out->type =
+        frame.is_array ? JSONC_EVENT_BEGIN_ARRAY : JSONC_EVENT_BEGIN_OBJECT;
+    reader->step = frame.is_array ? RS_ELEMENT : RS_KEY;
+    lexer_advance(&reader->lexer, 1);
+    return false;
+  }
+  if (current->type == TT_NULL) {
+    out->type = JSONC_EVENT_NULL;
+  } else if (current->type == TT_TRUE || current->type == TT_FALSE) {
+    out->type = JSONC_EVENT_BOOLEAN;
+    out->value.boolean = current->type == TT_TRUE;
+  } else if (current->type == TT_NUMBER) {
+    out->type = JSONC_EVENT_NUMBER;
+    out->value.number = current->value.number;
+  } else if (current->type == TT_STRING) {
+    out->type = JSONC_EVENT_STRING;
+    reader_text(reader, current, out);
+  } else {
+    reader_unexpected(reader, out, current,
+                      reader->step == RS_ELEMENT
+                          ? JSONC_EXPECT_VALUE | JSONC_EXPECT_RIGHT_BRACKET
+                          : JSONC_EXPECT_VALUE);
+    return false;
+  }
+  reader->step = RS_AFTER_VALUE;
+  lexer_advance(&reader->lexer, 1);
+  return false;
+}
+
+// Counts a new member of the innermost container against its size limit.
+static bool reader_count_member(reader *reader, event *out,
+                                const token *current) {
+  reader_frame *const top = reader_top(reader);
+  const size_t limit = top->is_array ? reader->options->max_array_size
+                                     : reader->options->max_object_size;
+  if (limit && top->count >= limit) {
+    reader_fail(reader, out,
+                top->is_array ? JSONC_ERROR_MAX_ARRAY_SIZE
+                              : JSONC_ERROR_MAX_OBJECT_SIZE,
+                current->offset, 0);
+    return false;
+  }
+  top->count++;
+  return true;
+}
+
+static err_t reader_scan(reader *reader, event *out) {
+  for (;;) {
+    if (reader->step == RS_ERROR) {
+      out->type = JSONC_EVENT_ERROR;
+      return false;
+    }
+    token *current;
+    if (lexer_peek(&reader->lexer, 0, &current)) {
+      return true;
+    }
+    if (!current) {
+      reader->step = RS_ERROR;
+      continue;
+    }
+    switch (reader->step) {
+    case RS_VALUE:
+      return reader_value(reader, out, current);
+    case RS_ELEMENT:
+      if (current->type == TT_RIGHT_BRACKET) {
+        reader_close(reader, out, current);
+        return false;
+      }
+      if (!reader_count_member(reader, out, current)) {
+        return false;
+      }
+      return reader_value(reader, out, current);
+    case RS_KEY: {
+      if (current->type == TT_RIGHT_BRACE) {
+        reader_close(reader, out, current);
+        return false;
+      }
+      if (current->type != TT_STRING && current->type != TT_IDENTIFIER) {
+        reader_unexpected(reader, out, current,
+                          JSONC_EXPECT_KEY | JSONC_EXPECT_RIGHT_BRACE);
+        return false;
+      }
+      if (!reader_count_member(reader, out, current)) {
+        return false;
+      }
+      token *colon;
+      if (lexer_peek(&reader->lexer, 1, &colon)) {
+        return true;
+      }
+      if (!colon) {
+        reader->step = RS_ERROR;
+        continue;
+      }
+      if (colon->type != TT_COLON) {
+        reader_unexpected(reader, out, colon, JSONC_EXPECT_COLON);
+        return false;
+      }
+      out->type = JSONC_EVENT_KEY;
+      out->offset = current->offset;
+      out->end = current->end;
+      reader_text(reader, current, out);
+      lexer_advance(&reader->lexer, 2);
+      reader->step = RS_VALUE;
+      return false;
+    }
+    case RS_AFTER_VALUE: {
+      const reader_frame *const top = reader_top(reader);
+      if (!top) {
+        reader->step = RS_END;
+        continue;
+      }
+      if (current->type == TT_COMMA) {
+        lexer_advance(&reader->lexer, 1);
+        reader->step = top->is_array ? RS_ELEMENT : RS_KEY;
+        continue;
+      }
+      if (current->type ==
+          (top->is_array ? TT_RIGHT_BRACKET : TT_RIGHT_BRACE)) {
+        reader_close(reader, out, current);
+        return false;
+      }
+      reader_unexpected(reader, out, current,
+                        JSONC_EXPECT_COMMA |
+                            (top->is_array ? JSONC_EXPECT_RIGHT_BRACKET
+                                           : JSONC_EXPECT_RIGHT_BRACE));
+      return false;
+    }
+    case RS_END:
+    case RS_DONE:
+      if (current->type != TT_EOF) {
+        reader_fail(reader, out, JSONC_ERROR_TRAILING_DATA, current->offset,
+                    JSONC_EXPECT_EOF);
+        return false;
+      }
+      out->type = JSONC_EVENT_EOF;
+      out->offset = current->offset;
+      out->end = current->end;
+      reader->step = RS_DONE;
+      return false;
+    case RS_ERROR:
+      break;
+    }
+  }
+}
+
+static bool is_integral(double number) {
+  return number - number == 0 &&
+         (number >= 0x1p52 || number <= -0x1p52 ||
+          number == (double)(int64_t)number);
+}
+
+// Length of UTF-8 text in code points, as JSON Schema counts it.
+static size_t utf8_length(const char *string) {
+  size_t length = 0;
+  for (const char *p = string; *p; p++) {
+    length += ((unsigned char)*p & 0xC0) != 0x80;
+  }
+  return length;
+}
+
+static bool schema_enum_matches(const jsonc_value *value,
+                                const event *current) {
+  switch (current->type) {
+  case JSONC_EVENT_NULL:
+    return value->type == JSONC_VALUE_TYPE_NULL;
+  case JSONC_EVENT_BOOLEAN:
+    return value->type == JSONC_VALUE_TYPE_BOOLEAN &&
+           value->value.boolean == current->value.boolean;
+  case JSONC_EVENT_NUMBER:
+    return value->type == JSONC_VALUE_TYPE_NUMBER &&
+           value->value.number == current->value.number;
+  case JSONC_EVENT_STRING:
+    return value->type == JSONC_VALUE_TYPE_STRING &&
+           strcmp(string_data(value), current->value.string.data) == 0;
+  default:
+    return false;
+  }
+}
+
+// Checks a value, given by its first event, against everything in `index`
+// that does not depend on its members.
+static jsonc_error_code schema_check_value(const jsonc_schema *schema,
+                                           size_t index,
+                                           const event *current) {
+  if (index == SCHEMA_ANY) {
+    return JSONC_ERROR_NONE;
+  }
+  const schema_node *const node = &schema->nodes[index];
+  if (node->flags & SCHEMA_FALSE) {
+    return JSONC_ERROR_SCHEMA_NOT_ALLOWED;
+  }
+  if (node->types) {
+    jsonc_value_type type = JSONC_VALUE_TYPE_NULL;
+    switch (current->type) {
+    case JSONC_EVENT_BOOLEAN:
+      type = JSONC_VALUE_TYPE_BOOLEAN;
+      break;
+    case JSONC_EVENT_NUMBER:
+      type = JSONC_VALUE_TYPE_NUMBER;
+      break;
+    case JSONC_EVENT_STRING:
+      type = JSONC_VALUE_TYPE_STRING;
+      break;
+    case JSONC_EVENT_BEGIN_ARRAY:
+      type = JSONC_VALUE_TYPE_ARRAY;
+      break;
+    case JSONC_EVENT_BEGIN_OBJECT:
+      type = JSONC_VALUE_TYPE_OBJECT;
+      break;
+    default:
+      break;
+    }
+    if (!(node->types & (1u << type)) &&
+        !(type == JSONC_VALUE_TYPE_NUMBER &&
+          (node->types & SCHEMA_TYPE_INTEGER) &&
+          is_integral(current->value.number))) {
+      return JSONC_ERROR_TYPE_MISMATCH;
+    }
+  }
+  if (node->enum_count) {
+    size_t i = 0;
+    while (i < node->enum_count &&
+           !schema_enum_matches(&schema->enums[node->enums + i], current)) {
+      i++;
+    }
+    if (i == node->enum_count) {
+      return JSONC_ERROR_SCHEMA_ENUM;
+    }
+  }
+  if (current->type == JSONC_EVENT_NUMBER) {
+    if ((node->flags & SCHEMA_HAS_MINIMUM) &&
+        !(current->value.number >= node->minimum)) {
+      return JSONC_ERROR_SCHEMA_MINIMUM;
+    }
+    if ((node->flags & SCHEMA_HAS_MAXIMUM) &&
+        !(current->value.number <= node->maximum)) {
+      return JSONC_ERROR_SCHEMA_MAXIMUM;
+    }
+  }
+  if (current->type == JSONC_EVENT_STRING && node->max_length != SIZE_MAX &&
+      utf8_length(current->value.string.data) > node->max_length) {
+    return JSONC_ERROR_SCHEMA_MAX_LENGTH;
+  }
+  return JSONC_ERROR_NONE;
+}
+
+// Node that the value starting at the next event must satisfy.
+static size_t schema_value_node(reader *reader) {
+  if (!reader->schema_stack->length) {
+    return 0;
+  }
+  const schema_frame *const top = arraybuffer_get(
+      reader->schema_stack, reader->schema_stack->length - 1);
+  if (!top->is_array) {
+    return reader->schema_member;
+  }
+  return top->node == SCHEMA_ANY
+             ? SCHEMA_ANY
+             : reader->options->schema->nodes[top->node].items;
+}
+
+static jsonc_error_code schema_check_key(reader *reader,
+                                         const event *current) {
+  const jsonc_schema *const schema = reader->options->schema;
+  const schema_frame *const top = arraybuffer_get(
+      reader->schema_stack, reader->schema_stack->length - 1);
+  reader->schema_member = SCHEMA_ANY;
+  if (top->node == SCHEMA_ANY) {
+    return JSONC_ERROR_NONE;
+  }
+  const schema_node *const node = &schema->nodes[top->node];
+  for (size_t i = 0; i < node->property_count; i++) {
+    const schema_property *const property =
+        &schema->properties[node->properties + i];
+    if (strcmp(property->key, current->value.string.data) == 0) {
+      *(bool *)arraybuffer_get(reader->schema_seen, top->seen + i) = true;
+      reader->schema_member = property->node;
+      return JSONC_ERROR_NONE;
+    }
+  }
+  if (node->additional != SCHEMA_ANY &&
+      (schema->nodes[node->additional].flags & SCHEMA_FALSE)) {
+    return JSONC_ERROR_SCHEMA_NOT_ALLOWED;
+  }
+  reader->schema_member = node->additional;
+  return JSONC_ERROR_NONE;
+}
+
+// Pops the innermost container, checking that no required property of an
+// object is missing.
+static jsonc_error_code schema_close(reader *reader, size_t *out_offset) {
+  const jsonc_schema *const schema = reader->options->schema;
+  const schema_frame top = *(schema_frame *)arraybuffer_get(
+      reader->schema_stack, reader->schema_stack->length - 1);
+  reader->schema_stack->length--;
+  reader->schema_seen->length = top.seen;
+  if (top.is_array || top.node == SCHEMA_ANY) {
+    return JSONC_ERROR_NONE;
+  }
+  const schema_node *const node = &schema->nodes[top.node];
+  for (size_t i = 0; i < node->property_count; i++) {
+    if (schema->properties[node->properties + i].required &&
+        !*(bool *)arraybuffer_get(reader->schema_seen, top.seen + i)) {
+      *out_offset = top.offset;
+      return JSONC_ERROR_SCHEMA_REQUIRED;
+    }
+  }
+  return JSONC_ERROR_NONE;
+}
+
+static err_t schema_open(reader *reader, size_t index, const event *current) {
+  const schema_frame frame = {
+      .node = index,
+      .is_array = current->type == JSONC_EVENT_BEGIN_ARRAY,
+      .offset = current->offset,
+      .seen = reader->schema_seen->length,
+  };
+  if (arraybuffer_push(reader->schema_stack, &frame)) {
+    return true;
+  }
+  if (frame.is_array || index == SCHEMA_ANY) {
+    return false;
+  }
+  const size_t count = reader->options->schema->nodes[index].property_count;
+  const bool seen = false;
+  for (size_t i = 0; i < count; i++) {
+    if (arraybuffer_push(reader->schema_seen, &seen)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Validates the event just read, turning it into an error on a violation.
+static err_t schema_check(reader *reader, event *out) {
+  jsonc_error_code code = JSONC_ERROR_NONE;
+  size_t offset = out->offset;
+  switch (out->type) {
+  case JSONC_EVENT_ERROR:
+  case JSONC_EVENT_EOF:
+    return false;
+  case JSONC_EVENT_KEY:
+    code = schema_check_key(reader, out);
+    break;
+  case JSONC_EVENT_END_ARRAY:
+  case JSONC_EVENT_END_OBJECT:
+    code = schema_close(reader, &offset);
+    break;
+  default: {
+    const size_t index = schema_value_node(reader);
+    code = schema_check_value(reader->options->schema, index, out);
+    if (code == JSONC_ERROR_NONE && (out->type == JSONC_EVENT_BEGIN_ARRAY ||
+                                     out->type == JSONC_EVENT_BEGIN_OBJECT)) {
+      return schema_open(reader, index, out);
+    }
+    break;
+  }
+  }
+  if (code != JSONC_ERROR_NONE) {
+    reader_fail(reader, out, code, offset, 0);
+  }
+  return false;
+}
+
+static err_t reader_next(reader *reader, event *out) {
+  lexer_recycle_strings(&reader->lexer);
+  if (reader_scan(reader, out)) {
+    return true;
+  }
+  return reader->options->schema ? schema_check(reader, out) : false;
+}
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Fast path for long arrays of numbers. At an array element that is a plain
+// number followed by a comma, reads it as reader_next would but straight
+// from the source, with no tokens. Returns false, having consumed nothing,
+// at anything else (including the last element), which is left to
+// reader_next.
+static bool reader_next_number(reader *reader, event *out) {
+  lexer *const lexer = &reader->lexer;
+  if (reader->step != RS_ELEMENT || reader->options->schema ||
+      lexer->head != lexer->tokens->length ||
+      lexer->state.state != TS_DEFAULT) {
+    return false;
+  }
+  reader_frame *const top = reader_top(reader);
+  const size_t max = reader->options->max_array_size;
+  if (max && top->count >= max) {
+    return false;
+  }
+  const char *const source = lexer->source;
+  const size_t limit = lexer->limit;
+  size_t i = lexer->position;
+  while (i < limit && is_space(source[i])) {
+    i++;
+  }
+  const size_t start = i;
+  tokenizer_state_number number = {
+      .current_digit = 1, .sign = 1, .exp_sign = 1};
+  if (i < limit && source[i] == '-') {
+    number.sign = -1;
+    i++;
+  }
+  // Leading zeros are left to the tokenizer to accept or reject.
+  size_t digits = skip_digits(source, i, limit);
+  if (digits == i || (source[i] == '0' && digits - i > 1)) {
+    return false;
+  }
+  number_add_digits(&number, source + i, digits - i, false);
+  i = digits;
+  if (i < limit && source[i] == '.') {
+    digits = skip_digits(source, ++i, limit);
+    if (digits == i) {
+      return false;
+    }
+    number_add_digits(&number, source + i, digits - i, true);
+    i = digits;
+  }
+  if (i < limit && (source[i] == 'e' || source[i] == 'E')) {
+    if (++i < limit && (source[i] == '+' || source[i] == '-')) {
+      number.exp_sign = source[i++] == '-' ? -1 : 1;
+    }
+    // Long exponents are rare enough to leave to the tokenizer.
+    digits = skip_digits(source, i, limit);
+    if (digits == i || digits - i > 4) {
+      return false;
+    }
+    for (; i < digits; i++) {
+      number.exp = number.exp * 10 + (source[i] - '0');
+    }
+  }
+  const size_t end = i;
+  while (i < limit && is_space(source[i])) {
+    i++;
+  }
+  if (i >= limit || source[i] != ',') {
+    return false;
+  }
+  top->count++;
+  lexer->position = i + 1;
+  *out = (event){
+      .type = JSONC_EVENT_NUMBER,
+      .value.number = number_value(&number),
+      .offset = start,
+      .end = end,
+  };
+  return true;
+}
+
+// Consumes the rest of the value that `first` starts without building it.
+static err_t reader_skip(reader *reader, event *first) {
+  size_t depth = 0;
+  event current = *first;
+  for (;;) {
+    if (current.type == JSONC_EVENT_ERROR) {
+      return false;
+    }
+    if (current.type == JSONC_EVENT_BEGIN_ARRAY ||
+        current.type == JSONC_EVENT_BEGIN_OBJECT) {
+      depth++;
+    } else if (current.type == JSONC_EVENT_END_ARRAY ||
+               current.type == JSONC_EVENT_END_OBJECT) {
+      depth--;
+    }
+    if (!depth) {
+      return false;
+    }
+    if (reader_next(reader, &current)) {
+      return true;
+    }
+  }
+}
+
+// Where an array or object sits in the source: the offsets of its brackets,
+// and how many containers it holds at any depth. Spans are kept in the
+// order containers open, so those nested in one follow it directly.
+typedef struct container_span {
+  size_t start;
+  size_t end;
+  size_t descendants;
+  jsonc_value *value;
+} container_span;
+
+// An open array or object while building a tree. `items` holds jsonc_value
+// (array) or jsonc_object_entry (object) elements and is created on the first
+// member so that empty containers allocate nothing. `span` indexes its entry
+// in the spans being recorded, if any, and `mark` its own span among those a
+// source map holds pending.
+typedef struct build_frame {
+  jsonc_value_type type;
+  // Where the container's members start in the scratch `values` (arrays) or
+  // `entries` (objects).
+  size_t start;
+  char *key;
+  size_t span;
+  size_t mark;
+} build_frame;
+
+static err_t scratch_init(parse_scratch *scratch) {
+  *scratch = (parse_scratch){
+      .tokens = arraybuffer_create(sizeof(token), 16),
+      .strings = arraybuffer_create(1, 128),
+      .frames = arraybuffer_create(sizeof(reader_frame), 16),
+      .builds = arraybuffer_create(sizeof(build_frame), 16),
+      .values = arraybuffer_create(sizeof(jsonc_value), 16),
+      .entries = arraybuffer_create(sizeof(jsonc_object_entry), 16),
+  };
+  if (!scratch->tokens || !scratch->strings || !scratch->frames ||
+      !scratch->builds || !scratch->values || !scratch->entries) {
+    scratch_destroy(scratch);
+    return true;
+  }
+  return false;
+}
+
+static void scratch_destroy(parse_scratch *scratch) {
+  arraybuffer *const buffers[] = {scratch->tokens, scratch->strings,
+                                  scratch->frames, scratch->builds,
+                                  scratch->values, scratch->entries};
+  for (size_t i = 0; i < sizeof(buffers) / sizeof(*buffers); i++) {
+    if (buffers[i]) {
+      arraybuffer_destroy(buffers[i]);
+    }
+  }
+}
+
+// Shrinks every buffer larger than `max_bytes` to at most that size. The
+// buffers are empty between parses.
+static void scratch_trim(parse_scratch *scratch, size_t max_bytes) {
+  arraybuffer *const buffers[] = {scratch->tokens, scratch->strings,
+                                  scratch->frames, scratch->builds,
+                                  scratch->values, scratch->entries};
+  for (size_t i = 0; i < sizeof(buffers) / sizeof(*buffers); i++) {
+    arraybuffer *const buffer = buffers[i];
+    if (buffer->capacity * buffer->element_size <= max_bytes) {
+      continue;
+    }
+    size_t capacity = max_bytes / buffer->element_size;
+    if (!capacity) {
+      capacity = 1;
+    }
+    void *const data = realloc(buffer->data, capacity * buffer->element_size);
+    if (data) {
+      buffer->data = data;
+      buffer->capacity = capacity;
+    }
+  }
+}
+
+static arraybuffer *build_members(reader *reader, const build_frame *frame) {
+  return frame->type == JSONC_VALUE_TYPE_ARRAY ? reader->scratch.values
+                                               : reader->scratch.entries;
+}
+
+// Moves the members of `frame` out of the scratch buffer into an allocation
+// of exactly their size.
+static err_t build_frame_finish(build_frame *frame, arraybuffer *members,
+                                jsonc_value *out) {
+  const size_t count = members->length - frame->start;
+  void *data = NULL;
+  if (count) {
+    data = malloc(count * members->element_size);
+    if (!data) {
+      return true;
+    }
+    memcpy(data, arraybuffer_get(members, frame->start),
+           count * members->element_size);
+  }
+  members->length = frame->start;
+  out->type = frame->type;
+  out->capacity = 0;
+  if (frame->type == JSONC_VALUE_TYPE_ARRAY) {
+    out->value.array = (jsonc_array){.values = data, .count = count};
+  } else {
+    out->value.object = (jsonc_object){.entries = data, .count = count};
+  }
+  return false;
+}
+
+static err_t build_frame_append(build_frame *frame, arraybuffer *members,
+                                jsonc_value *value) {
+  if (frame->type == JSONC_VALUE_TYPE_ARRAY) {
+    if (arraybuffer_push(members, value)) {
+      return true;
+    }
+  } else {
+    const jsonc_object_entry entry = {.key = frame->key, .value = *value};
+    if (arraybuffer_push(members, &entry)) {
+      return true;
+    }
+    frame->key = NULL;
+  }
+  value->type = JSONC_VALUE_TYPE_NULL;
+  return false;
+}
+
+// Releases everything build_value left in the scratch buffers.
+static void build_abandon(reader *reader, const jsonc_intern *intern) {
+  parse_scratch *const scratch = &reader->scratch;
+  for (size_t i = 0; i < scratch->builds->length; i++) {
+    const build_frame *const frame = arraybuffer_get(scratch->builds, i);
+    if (frame->key) {
+      release_string(intern, frame->key);
+    }
+  }
+  for (size_t i = 0; i < scratch->values->length; i++) {
+    release_value(*(jsonc_value *)arraybuffer_get(scratch->values, i), intern);
+  }
+  for (size_t i = 0; i < scratch->entries->length; i++) {
+    jsonc_object_entry *const entry = arraybuffer_get(scratch->entries, i);
+    release_value(entry->value, intern);
+    release_string(intern, entry->key);
+  }
+  scratch->builds->length = 0;
+  scratch->values->length = 0;
+  scratch->entries->length = 0;
+}
+
+// The members of one non-empty container: `first` indexes the span of its
+// first member in the map's `spans`, where objects have a key and a value
+// span per member and arrays a value span.
+typedef struct source_block {
+  const void *members;
+  size_t count;
+  size_t first;
+  bool is_object;
+} source_block;
+
+// Blocks are added as containers close, so their members' spans are
+// contiguous; `pending` holds the spans of keys and values whose container
+// is still open. The root has no container and is kept apart. `lines` holds
+// the offsets at which the second and later lines start, once a lookup has
+// needed them.
+struct jsonc_source_map {
+  arraybuffer *spans;
+  arraybuffer *blocks;
+  arraybuffer *pending;
+  arraybuffer *lines;
+  jsonc_span root;
+  const void *root_members;
+  jsonc_value_type root_type;
+  bool has_root;
+  bool is_sorted;
+  bool has_lines;
+};
+
+static void source_map_clear(jsonc_source_map *map) {
+  map->spans->length = 0;
+  map->blocks->length = 0;
+  map->pending->length = 0;
+  map->lines->length = 0;
+  map->has_root = false;
+  map->is_sorted = false;
+  map->has_lines = false;
+}
+
+static err_t source_map_push(jsonc_source_map *map, size_t offset,
+                             size_t end) {
+  const jsonc_span span = {.offset = offset, .length = end - offset};
+  return arraybuffer_push(map->pending, &span);
+}
+
+// Completes the span at `mark` of the container `value`, which closed at
+// `end`, and moves the spans of its members, pending above it, into a block.
+static err_t source_map_close(jsonc_source_map *map, size_t mark, size_t end,
+                              const jsonc_value *value) {
+  jsonc_span *const span = arraybuffer_get(map->pending, mark);
+  span->length = end - span->offset;
+  const size_t spans = map->pending->length - mark - 1;
+  if (!spans) {
+    return false;
+  }
+  source_block block = {.first = map->spans->length};
+  if (value->type == JSONC_VALUE_TYPE_OBJECT) {
+    block.members = value->value.object.entries;
+    block.count = value->value.object.count;
+    block.is_object = true;
+  } else {
+    block.members = value->value.array.values;
+    block.count = value->value.array.count;
+  }
+  if (arraybuffer_push(map->blocks, &block) ||
+      arraybuffer_append(map->spans, arraybuffer_get(map->pending, mark + 1),
+                         spans)) {
+    return true;
+  }
+  map->pending->length = mark + 1;
+  return false;
+}
+
+// Takes the only span left pending as that of `root`.
+static void source_map_finish(jsonc_source_map *map, const jsonc_value *root) {
+  map->root = *(jsonc_span *)arraybuffer_get(map->pending, 0);
+  map->pending->length = 0;
+  map->root_members = NULL;
+  map->root_type = root->type;
+  if (root->type == JSONC_VALUE_TYPE_ARRAY) {
+    map->root_members = root->value.array.values;
+  } else if (root->type == JSONC_VALUE_TYPE_OBJECT) {
+    map->root_members = root->value.object.entries;
+  }
+  map->has_root = true;
+}
+
+// Builds the value that `first` starts from the reader's events, with an
+// explicit stack of open containers so nesting depth is bounded by
+// `max_depth` (or by memory) rather than by the C stack. On a syntax error
+// nothing is stored and the reader's error is left set. With an `intern`
+// table, keys and short strings are replaced by the table's copies. With
+// `spans`, a container_span is appended for each container, with offsets
+// relative to the reader's source and no `value` yet. With a `map`, the
+// spans of every value and key are recorded in it.
+static err_t build_value(reader *reader, event *first, jsonc_intern *intern,
+                         arraybuffer *spans, jsonc_source_map *map,
+                         jsonc_value *out) {
+  arraybuffer *const stack = reader->scratch.builds;
+  err_t result = true;
+  jsonc_value value = {.type = JSONC_VALUE_TYPE_NULL};
+  event current = *first;
+
+  for (;;) {
+    build_frame *const top =
+        stack->length ? arraybuffer_get(stack, stack->length - 1) : NULL;
+    if (current.type == JSONC_EVENT_BEGIN_ARRAY ||
+        current.type == JSONC_EVENT_BEGIN_OBJECT) {
+      build_frame frame = {
+          .type = current.type == JSONC_EVENT_BEGIN_ARRAY
+                      ? JSONC_VALUE_TYPE_ARRAY
+                      : JSONC_VALUE_TYPE_OBJECT,
+          .span = spans ? spans->length : 0,
+          .mark = map ? map->pending->length : 0,
+      };
+      frame.start = build_members(reader, &frame)->length;
+      const container_span span = {.start = current.offset};
+      if ((spans && arraybuffer_push(spans, &span)) ||
+          (map && source_map_push(map, current.offset, current.offset)) ||
+          arraybuffer_push(stack, &frame)) {
+        goto cleanup;
+      }
+    } else if (current.type == JSONC_EVENT_KEY) {
+      const char *const key = current.value.string.data;
+      const size_t length = current.value.string.length;
+      if (intern ? intern_copy(intern, key, length, &top->key)
+                 : !(top->key = util_strndup(key, length))) {
+        goto cleanup;
+      }
+      if (map && source_map_push(map, current.offset, current.end)) {
+        goto cleanup;
+      }
+    } else {
+      if (current.type == JSONC_EVENT_END_ARRAY ||
+          current.type == JSONC_EVENT_END_OBJECT) {
+        if (spans) {
+          container_span *const span = arraybuffer_get(spans, top->span);
+          span->end = current.offset;
+          span->descendants = spans->length - top->span - 1;
+        }
+        if (build_frame_finish(top, build_members(reader, top), &value) ||
+            (map && source_map_close(map, top->mark, current.end, &value))) {
+          goto cleanup;
+        }
+        stack->length--;
+      } else if (current.type == JSONC_EVENT_NULL) {
+        value.type = JSONC_VALUE_TYPE_NULL;
+      } else if (current.type == JSONC_EVENT_BOOLEAN) {
+        value.type = JSONC_VALUE_TYPE_BOOLEAN;
+        value.value.boolean = current.value.boolean;
+      } else if (current.type == JSONC_EVENT_NUMBER) {
+        value.type = JSONC_VALUE_TYPE_NUMBER;
+        value.value.number = current.value.number;
+      } else if (current.type == JSONC_EVENT_STRING) {
+        if (string_copy(current.value.string.data,
+                        current.value.string.length, intern, &value)) {
+          goto cleanup;
+        }
+      } else {
+        result = false;
+        goto cleanup;
+      }
+      // A closed container's span was pushed when it opened.
+      if (map && current.type != JSONC_EVENT_END_ARRAY &&
+          current.type != JSONC_EVENT_END_OBJECT &&
+          source_map_push(map, current.offset, current.end)) {
+        goto cleanup;
+      }
+      if (!stack->length) {
+        if (map) {
+          source_map_finish(map, &value);
+        }
+        *out = value;
+        value.type = JSONC_VALUE_TYPE_NULL;
+        result = false;
+        goto cleanup;
+      }
+      build_frame *const parent = arraybuffer_get(stack, stack->length - 1);
+      if (build_frame_append(parent, build_members(reader, parent), &value)) {
+        goto cleanup;
+      }
+    }
+    if (!reader_next_number(reader, &current) &&
+        reader_next(reader, &current)) {
+      goto cleanup;
+    }
+  }
+
+cleanup:
+  release_value(value, intern);
+  build_abandon(reader, intern);
+  return result;
+}
+
+// Fills in line and column for an error offset. This is the only place the
+// source is rescanned, so successful parses never pay for line tracking.
+static void locate_error(const char *source, jsonc_error *error) {
+  error->line = 1;
+  error->column = 1;
+  for (size_t i = 0; i < error->offset && source[i]; i++) {
+    if (source[i] == '\n') {
+      error->line++;
+      error->column = 1;
+    } else {
+      error->column++;
+    }
+  }
+}
+
+// An open container while rebuilding the pointer to an error offset.
+// `length` is the length of the container's own pointer.
+typedef struct path_frame {
+  size_t length;
+  bool is_array;
+  size_t index;
+} path_frame;
+
+// Appends "/" and `segment`, escaped as RFC 6901 requires.
+static err_t path_append(arraybuffer *text, const char *segment) {
+  const char slash = '/';
+  if (arraybuffer_push(text, &slash)) {
+    return true;
+  }
+  for (const char *p = segment; *p; p++) {
+    const char *const escaped = *p == '~' ? "~0" : *p == '/' ? "~1" : NULL;
+    if (escaped ? arraybuffer_push(text, &escaped[0]) ||
+                      arraybuffer_push(text, &escaped[1])
+                : arraybuffer_push(text, p)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static err_t path_append_index(arraybuffer *text, size_t index) {
+  char digits[24];
+  char *p = digits + sizeof(digits) - 1;
+  *p = '\0';
+  do {
+    *--p = (char)('0' + index % 10);
+    index /= 10;
+  } while (index);
+  return path_append(text, p);
+}
+
+// Replays `source` up to `offset`, like locate_error, so that the path is
+// only worked out once it is asked for.
+static err_t error_path(const char *source, size_t offset, arraybuffer *text,
+                        arraybuffer *frames) {
+  static const jsonc_parse_options unlimited = {0};
+  jsonc_error error = {.code = JSONC_ERROR_NONE};
+  reader reader;
+  if (reader_init(&reader, source, &unlimited, NULL, &error)) {
+    return true;
+  }
+  err_t result = true;
+  for (;;) {
+    event current;
+    if (reader_next(&reader, &current)) {
+      goto cleanup;
+    }
+    path_frame *const top =
+        frames->length ? arraybuffer_get(frames, frames->length - 1) : NULL;
+    const bool is_end = current.type == JSONC_EVENT_END_ARRAY ||
+                        current.type == JSONC_EVENT_END_OBJECT;
+    if (current.type == JSONC_EVENT_ERROR ||
+        current.type == JSONC_EVENT_EOF || current.offset > offset ||
+        (is_end && current.offset == offset)) {
+      text->length = top ? top->length : 0;
+      break;
+    }
+    if (is_end) {
+      frames->length--;
+      continue;
+    }
+    err_t failed = false;
+    if (current.type == JSONC_EVENT_KEY) {
+      text->length = top->length;
+      failed = path_append(text, current.value.string.data);
+    } else if (top && top->is_array) {
+      text->length = top->length;
+      failed = path_append_index(text, top->index++);
+    }
+    if (failed) {
+      goto cleanup;
+    }
+    if (current.offset == offset) {
+      break;
+    }
+    if (current.type == JSONC_EVENT_BEGIN_ARRAY ||
+        current.type == JSONC_EVENT_BEGIN_OBJECT) {
+      const path_frame frame = {
+          .length = text->length,
+          .is_array = current.type == JSONC_EVENT_BEGIN_ARRAY,
+      };
+      if (arraybuffer_push(frames, &frame)) {
+        goto cleanup;
+      }
+    }
+  }
+  result = false;
+
+cleanup:
+  reader_destroy(&reader);
+  return result;
+}
+
+// A decoded JSON Pointer (RFC 6901) reference token. `index` is the token
+// read as an array index, or SIZE_MAX if it is not a valid one.
+typedef struct pointer_segment {
+  char *key;
+  size_t index;
+} pointer_segment;
+
+static bool pointer_is_valid(const char *pointer) {
+  if (*pointer && *pointer != '/') {
+    return false;
+  }
+  for (const char *p = pointer; *p; p++) {
+    if (*p == '~' && p[1] != '0' && p[1] != '1') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static size_t pointer_segment_index(const char *segment, size_t length) {
+  if (!length || (segment[0] == '0' && length > 1)) {
+    return SIZE_MAX;
+  }
+  size_t index = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (segment[i] < '0' || segment[i] > '9' ||
+        index > (SIZE_MAX - 1 - (segment[i] - '0')) / 10) {
+      return SIZE_MAX;
+    }
+    index = index * 10 + (segment[i] - '0');
+  }
+  return index;
+}
+
+static bool pointer_segment_equals(const char *segment, size_t length,
+                                   const char *key) {
+  for (size_t i = 0; i < length; i++, key++) {
+    char c = segment[i];
+    if (c == '~') {
+      c = segment[++i] == '0' ? '~' : '/';
+    }
+    if (*key != c) {
+      return false;
+    }
+  }
+  return !*key;
+}
+
+// Splits a valid pointer into decoded segments.
+static err_t pointer_compile(const char *pointer, pointer_segment **out,
+                             size_t *out_count) {
+  size_t count = 0;
+  for (const char *p = pointer; *p; p++) {
+    count += *p == '/';
+  }
+  *out_count = count;
+  *out = NULL;
+  if (!count) {
+    return false;
+  }
+  pointer_segment *const segments = calloc(count, sizeof(pointer_segment));
+  if (!segments) {
+    return true;
+  }
+  const char *p = pointer + 1;
+  for (size_t i = 0; i < count; i++) {
+    const size_t length = strcspn(p, "/");
+    char *const key = malloc(length + 1);
+    if (!key) {
+      for (size_t j = 0; j < i; j++) {
+        free(segments[j].key);
+      }
+      free(segments);
+      return true;
+    }
+    size_t n = 0;
+    for (size_t j = 0; j < length; j++) {
+      key[n++] = p[j] == '~' ? (p[++j] == '0' ? '~' : '/') : p[j];
+    }
+    key[n] = '\0';
+    segments[i] = (pointer_segment){
+        .key = key,
+        .index = pointer_segment_index(p, length),
+    };
+    p += length + 1;
+  }
+  *out = segments;
+  return false;
+}
+
+static void pointer_free(pointer_segment *segments, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    free(segments[i].key);
+  }
+  free(segments);
+}
+
+static const jsonc_value *pointer_resolve(const jsonc_value *value,
+                                          const pointer_segment *segments,
+                                          size_t count) {
+  for (size_t i = 0; i < count && value; i++) {
+    const jsonc_value *next = NULL;
+    if (value->type == JSONC_VALUE_TYPE_ARRAY) {
+      if (segments[i].index < value->value.array.count) {
+        next = &value->value.array.values[segments[i].index];
+      }
+    } else if (value->type == JSONC_VALUE_TYPE_OBJECT) {
+      for (size_t j = 0; j < value->value.object.count; j++) {
+        if (!strcmp(value->value.object.entries[j].key, segments[i].key)) {
+          next = &value->value.object.entries[j].value;
+          break;
+        }
+      }
+    }
+    value = next;
+  }
+  return value;
+}
+
+static uint64_t hash_mix(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9u;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBu;
+  h ^= h >> 31;
+  return h;
+}
+
+static uint64_t hash_string(const char *s) {
+  uint64_t h = 0xCBF29CE484222325u;
+  for (; *s; s++) {
+    h = (h ^ (unsigned char)*s) * 0x100000001B3u;
+  }
+  return hash_mix(h);
+}
+
+// Objects with more members than this are searched through a key_index.
+#define KEY_INDEX_MIN 8
+
+// Open-addressing table from the key hashes of an object's members to their
+// index + 1, kept at most half full. Members with the same key follow each
+// other in probe order, so a search finds the first. Members whose key is
+// NULL have been removed and are skipped. `size` is zero while the object
+// is small enough to scan.
+typedef struct key_index {
+  size_t *slots;
+  size_t allocated;
+  size_t size;
+  size_t used;
+} key_index;
+
+// Index of the first member of `object` named `key`, or SIZE_MAX.
+static size_t key_index_find(const key_index *index, const jsonc_value *object,
+                             const char *key) {
+  const jsonc_object_entry *const entries = object->value.object.entries;
+  if (!index->size) {
+    for (size_t i = 0; i < object->value.object.count; i++) {
+      if (entries[i].key && !strcmp(entries[i].key, key)) {
+        return i;
+      }
+    }
+    return SIZE_MAX;
+  }
+  const size_t mask = index->size - 1;
+  for (size_t slot = hash_string(key) & mask;; slot = (slot + 1) & mask) {
+    const size_t member = index->slots[slot];
+    if (!member) {
+      return SIZE_MAX;
+    }
+    if (entries[member - 1].key && !strcmp(entries[member - 1].key, key)) {
+      return member - 1;
+    }
+  }
+}
+
+static void key_index_insert(key_index *index, const char *key,
+                             size_t member) {
+  const size_t mask = index->size - 1;
+  size_t slot = hash_string(key) & mask;
+  while (index->slots[slot]) {
+    slot = (slot + 1) & mask;
+  }
+  index->slots[slot] = member + 1;
+  index->used++;
+}
+
+// Indexes every member of `object`, if it has enough of them to need it.
+// The slots are reused from one object to the next.
+static err_t key_index_build(key_index *index, const jsonc_value *object) {
+  const size_t count = object->value.object.count;
+  index->size = 0;
+  index->used = 0;
+  if (count <= KEY_INDEX_MIN) {
+    return false;
+  }
+  size_t size = 64;
+  while (size < count * 4) {
+    size *= 2;
+  }
+  if (size > index->allocated) {
+    free(index->slots);
+    index->allocated = 0;
+    if (!(index->slots = malloc(size * sizeof(size_t)))) {
+      return true;
+    }
+    index->allocated = size;
+  }
+  memset(index->slots, 0, size * sizeof(size_t));
+  index->size = size;
+  for (size_t i = 0; i < count; i++) {
+    const char *const key = object->value.object.entries[i].key;
+    if (key) {
+      key_index_insert(index, key, i);
+    }
+  }
+  return false;
+}
+
+// Indexes the member just appended to `object`.
+static err_t key_index_add(key_index *index, const jsonc_value *object) {
+  if (!index->size || (index->used + 1) * 2 > index->size) {
+    return key_index_build(index, object);
+  }
+  const size_t member = object->value.object.count - 1;
+  key_index_insert(index, object->value.object.entries[member].key, member);
+  return false;
+}
+
+typedef enum visit_event {
+  VISIT_LEAF,
+  VISIT_ENTER,
+  VISIT_LEAVE,
+} visit_event;
+
+// Pairs the members of a large object with those of `b` by key once their
+// keys stop agreeing by position. `index` finds the first member of `b` with
+// a key, `next` is the member of `b` after each with the same key (SIZE_MAX
+// after the last), and `cursor`, at the first member with each key, is the
+// member that the next member of `a` with that key pairs with.
+typedef struct key_pairing {
+  key_index index;
+  size_t *next;
+  size_t *cursor;
+} key_pairing;
+
+// An array or object being walked. `b` is its counterpart in the second tree
+// of a paired walk, `position` its index in its parent and `next` the index
+// of the next member to visit. `aligned` counts the leading members of an
+// object whose keys are those of `b`, in the same order, and `pairing` is
+// built for the members after them when `b` is large. `data` is scratch
+// space for the visitor.
+typedef struct traversal_frame {
+  const jsonc_value *a;
+  const jsonc_value *b;
+  size_t position;
+  size_t next;
+  size_t aligned;
+  key_pairing *pairing;
+  union {
+    uint64_t hash;
+    size_t index;
+    jsonc_value *target;
+  } data;
+} traversal_frame;
+
+// `self` is the frame of the container being entered or left and `parent`
+// the frame of the enclosing container (NULL at the root). `key` is set for
+// object members.
+typedef struct visit {
+  visit_event event;
+  const jsonc_value *a;
+  const jsonc_value *b;
+  const char *key;
+  size_t position;
+  traversal_frame *self;
+  traversal_frame *parent;
+} visit;
+
+// Returns false to stop the walk.
+typedef bool (*visitor)(void *context, const visit *visit);
+
+static bool is_container(const jsonc_value *value) {
+  return value->type == JSONC_VALUE_TYPE_ARRAY ||
+         value->type == JSONC_VALUE_TYPE_OBJECT;
+}
+
+static size_t container_count(const jsonc_value *value) {
+  return value->type == JSONC_VALUE_TYPE_ARRAY ? value->value.array.count
+                                               : value->value.object.count;
+}
+
+static void key_pairing_free(key_pairing *pairing) {
+  if (pairing) {
+    free(pairing->index.slots);
+    free(pairing->next);
+    free(pairing);
+  }
+}
+
+// Builds the pairing of frame->b, whose first `aligned` members have been
+// paired by position already.
+static err_t key_pairing_create(const traversal_frame *frame,
+                                key_pairing **out) {
+  const jsonc_object object = frame->b->value.object;
+  key_pairing *const pairing = calloc(1, sizeof(key_pairing));
+  if (!pairing) {
+    return true;
+  }
+  pairing->next = malloc(2 * object.count * sizeof(size_t));
+  if (!pairing->next || key_index_build(&pairing->index, frame->b)) {
+    key_pairing_free(pairing);
+    return true;
+  }
+  pairing->cursor = pairing->next + object.count;
+  // Chain the members with each key, with the cursor of the first member
+  // keeping the last one until the chains are complete.
+  for (size_t i = 0; i < object.count; i++) {
+    const size_t first =
+        key_index_find(&pairing->index, frame->b, object.entries[i].key);
+    pairing->next[i] = SIZE_MAX;
+    if (first != i) {
+      pairing->next[pairing->cursor[first]] = i;
+    }
+    pairing->cursor[first] = i;
+  }
+  for (size_t i = 0; i < object.count; i++) {
+    const size_t first =
+        key_index_find(&pairing->index, frame->b, object.entries[i].key);
+    if (first == i) {
+      pairing->cursor[i] = i;
+    }
+  }
+  for (size_t i = 0; i < frame->aligned; i++) {
+    const size_t first =
+        key_index_find(&pairing->index, frame->b, object.entries[i].key);
+    pairing->cursor[first] = pairing->next[pairing->cursor[first]];
+  }
+  *out = pairing;
+  return false;
+}
+
+// Finds the member of frame->b that pairs with member `index` of frame->a,
+// which is visited after the members before it, and stores it in `out`
+// (NULL if there is none): the same position for arrays, and for objects
+// the same position if the keys agree. When key order is ignored, the n-th
+// member with a key pairs with the n-th member with that key in `b`, so no
+// member of `b` pairs twice. While the keys have agreed so far that is the
+// same position, which takes no search; after that small objects are
+// scanned and large ones go through a key_pairing.
+static err_t traversal_pair(traversal_frame *frame, size_t index,
+                            bool ignore_key_order, const jsonc_value **out) {
+  const jsonc_value *const a = frame->a;
+  const jsonc_value *const b = frame->b;
+  *out = NULL;
+  if (!b || b->type != a->type) {
+    return false;
+  }
+  if (a->type == JSONC_VALUE_TYPE_ARRAY) {
+    if (index < b->value.array.count) {
+      *out = &b->value.array.values[index];
+    }
+    return false;
+  }
+  const char *const key = a->value.object.entries[index].key;
+  const jsonc_object object = b->value.object;
+  if (frame->aligned == index && index < object.count &&
+      !strcmp(object.entries[index].key, key)) {
+    frame->aligned++;
+    *out = &object.entries[index].value;
+    return false;
+  }
+  if (!ignore_key_order) {
+    return false;
+  }
+  if (object.count > KEY_INDEX_MIN) {
+    key_pairing *pairing = frame->pairing;
+    if (!pairing && key_pairing_create(frame, &pairing)) {
+      return true;
+    }
+    frame->pairing = pairing;
+    const size_t first = key_index_find(&pairing->index, b, key);
+    if (first != SIZE_MAX && pairing->cursor[first] != SIZE_MAX) {
+      *out = &object.entries[pairing->cursor[first]].value;
+      pairing->cursor[first] = pairing->next[pairing->cursor[first]];
+    }
+    return false;
+  }
+  size_t occurrence = 0;
+  for (size_t i = 0; i < index; i++) {
+    occurrence += !strcmp(a->value.object.entries[i].key, key);
+  }
+  for (size_t i = 0; i < object.count; i++) {
+    if (!strcmp(object.entries[i].key, key) && !occurrence--) {
+      *out = &object.entries[i].value;
+      break;
+    }
+  }
+  return false;
+}
+
+// Frees the stack of a walk, with the pairings of the frames on it.
+static void traversal_stack_destroy(arraybuffer *stack) {
+  for (size_t i = 0; i < stack->length; i++) {
+    key_pairing_free(((traversal_frame *)arraybuffer_get(stack, i))->pairing);
+  }
+  arraybuffer_destroy(stack);
+}
+
+// Walks `a` depth-first with an explicit stack, pairing each node with its
+// counterpart in `b` when a second tree is given. Shared by copying,
+// comparison and hashing, and only reads the trees, so it works the same on
+// heap-allocated and compact (single-block) trees.
+static err_t traverse(const jsonc_value *a, const jsonc_value *b,
+                      bool ignore_key_order, visitor visitor, void *context,
+                      bool *out_stopped) {
+  *out_stopped = false;
+  if (!is_container(a)) {
+    const visit leaf = {.event = VISIT_LEAF, .a = a, .b = b};
+    *out_stopped = !visitor(context, &leaf);
+    return false;
+  }
+  arraybuffer *const stack = arraybuffer_create(sizeof(traversal_frame), 16);
+  if (!stack) {
+    return true;
+  }
+  const traversal_frame root = {.a = a, .b = b};
+  arraybuffer_push(stack, &root);
+  visit current = {.event = VISIT_ENTER,
+                   .a = a,
+                   .b = b,
+                   .self = arraybuffer_get(stack, 0)};
+  if (!visitor(context, &current)) {
+    *out_stopped = true;
+    traversal_stack_destroy(stack);
+    return false;
+  }
+  while (stack->length) {
+    traversal_frame *frame = arraybuffer_get(stack, stack->length - 1);
+    traversal_frame *parent =
+        stack->length > 1 ? arraybuffer_get(stack, stack->length - 2) : NULL;
+    if (frame->next == container_count(frame->a)) {
+      current = (visit){
+          .event = VISIT_LEAVE,
+          .a = frame->a,
+          .b = frame->b,
+          .key = parent && parent->a->type == JSONC_VALUE_TYPE_OBJECT
+                     ? parent->a->value.object.entries[frame->position].key
+                     : NULL,
+          .position = frame->position,
+          .self = frame,
+          .parent = parent,
+      };
+      if (!visitor(context, &current)) {
+        *out_stopped = true;
+        break;
+      }
+      key_pairing_free(frame->pairing);
+      stack->length--;
+      continue;
+    }
+    const size_t index = frame->next++;
+    const bool is_array = frame->a->type == JSONC_VALUE_TYPE_ARRAY;
+    const jsonc_value *const child =
+        is_array ? &frame->a->value.array.values[index]
+                 : &frame->a->value.object.entries[index].value;
+    const jsonc_value *pair;
+    if (traversal_pair(frame, index, ignore_key_order, &pair)) {
+      traversal_stack_destroy(stack);
+      return true;
+    }
+    current = (visit){
+        .event = VISIT_LEAF,
+        .a = child,
+        .b = pair,
+        .key = is_array ? NULL : frame->a->value.object.entries[index].key,
+        .position = index,
+        .parent = frame,
+    };
+    if (is_container(child)) {
+      const traversal_frame next = {
+          .a = child, .b = current.b, .position = index};
+      if (arraybuffer_push(stack, &next)) {
+        traversal_stack_destroy(stack);
+        return true;
+      }
+      current.event = VISIT_ENTER;
+      current.self = arraybuffer_get(stack, stack->length - 1);
+      current.parent = arraybuffer_get(stack, stack->length - 2);
+    }
+    if (!visitor(context, &current)) {
+      *out_stopped = true;
+      break;
+    }
+  }
+  traversal_stack_destroy(stack);
+  return false;
+}
+
+static bool equal_visit(void *context, const visit *visit) {
+  (void)context;
+  const jsonc_value *const a = visit->a;
+  const jsonc_value *const b = visit->b;
+  if (visit->event == VISIT_LEAVE) {
+    return true;
+  }
+  if (!b || a->type != b->type) {
+    return false;
+  }
+  switch (a->type) {
+  case JSONC_VALUE_TYPE_NULL:
+    return true;
+  case JSONC_VALUE_TYPE_BOOLEAN:
+    return a->value.boolean == b->value.boolean;
+  case JSONC_VALUE_TYPE_NUMBER:
+    return a->value.number == b->value.number;
+  case JSONC_VALUE_TYPE_STRING:
+    return !strcmp(string_data(a), string_data(b));
+  case JSONC_VALUE_TYPE_ARRAY:
+  case JSONC_VALUE_TYPE_OBJECT:
+    return container_count(a) == container_count(b);
+  }
+  return false;
+}
+
+static uint64_t hash_scalar(const jsonc_value *value) {
+  switch (value->type) {
+  case JSONC_VALUE_TYPE_BOOLEAN:
+    return hash_mix(2 + value->value.boolean);
+  case JSONC_VALUE_TYPE_NUMBER: {
+    // -0.0 == 0.0, so both must hash alike.
+    const double number = value->value.number == 0 ? 0 : value->value.number;
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return hash_mix(bits ^ 0x3C6EF372FE94F82Au);
+  }
+  case JSONC_VALUE_TYPE_STRING:
+    return hash_string(string_data(value)) ^ 0xA54FF53A5F1D36F1u;
+  default:
+    return hash_mix(1);
+  }
+}
+
+// Array elements are combined in order; object members are summed so the
+// hash does not depend on key order and agrees with both equality modes.
+static uint64_t hash_member(uint64_t container, const char *key,
+                            uint64_t hash) {
+  if (key) {
+    return container + hash_mix(hash_string(key) * 31 + hash);
+  }
+  return hash_mix(container ^ hash) * 0x9E3779B97F4A7C15u;
+}
+
+static void hash_combine(traversal_frame *parent, const char *key,
+                         uint64_t hash, uint64_t *out_root) {
+  if (!parent) {
+    *out_root = hash;
+  } else {
+    parent->data.hash = hash_member(parent->data.hash, key, hash);
+  }
+}
+
+// What a container's hash starts from before its members are added.
+static uint64_t hash_start(const jsonc_value *container) {
+  return container->type == JSONC_VALUE_TYPE_ARRAY ? 0x510E527FADE682D1u
+                                                   : 0x9B05688C2B3E6C1Fu;
+}
+
+static uint64_t hash_finish(const jsonc_value *container, uint64_t hash) {
+  return hash_mix(hash ^ container_count(container));
+}
+
+static bool hash_visit(void *context, const visit *visit) {
+  if (visit->event == VISIT_ENTER) {
+    visit->self->data.hash = hash_start(visit->a);
+  } else if (visit->event == VISIT_LEAVE) {
+    hash_combine(visit->parent, visit->key,
+                 hash_finish(visit->a, visit->self->data.hash), context);
+  } else {
+    hash_combine(visit->parent, visit->key, hash_scalar(visit->a), context);
+  }
+  return true;
+}
+
+// The slot a copied node goes to: the root, or the matching member of the
+// already-copied parent container.
+static jsonc_value *copy_slot(const visit *visit, jsonc_value *root,
+                              char ***out_key) {
+  *out_key = NULL;
+  if (!visit->parent) {
+    return root;
+  }
+  jsonc_value *const target = visit->parent->data.target;
+  if (target->type == JSONC_VALUE_TYPE_ARRAY) {
+    return &target->value.array.values[visit->position];
+  }
+  *out_key = &target->value.object.entries[visit->position].key;
+  return &target->value.object.entries[visit->position].value;
+}
+
+typedef struct heap_copy {
+  jsonc_value *root;
+  bool failed;
+} heap_copy;
+
+// Copies into separately allocated nodes, like a parsed tree. Containers are
+// zero-filled before their members are copied, so a copy that runs out of
+// memory midway can still be released with free_value.
+static bool heap_copy_visit(void *context, const visit *visit) {
+  heap_copy *const copy = context;
+  if (visit->event == VISIT_LEAVE) {
+    return true;
+  }
+  char **key;
+  jsonc_value *const slot = copy_slot(visit, copy->root, &key);
+  if (key && !(*key = util_strdup(visit->key))) {
+    copy->failed = true;
+    return false;
+  }
+  *slot = *visit->a;
+  if (visit->event == VISIT_ENTER) {
+    slot->capacity = 0;
+    const size_t count = container_count(visit->a);
+    const size_t size = visit->a->type == JSONC_VALUE_TYPE_ARRAY
+                            ? sizeof(jsonc_value)
+                            : sizeof(jsonc_object_entry);
+    void *const members = count ? calloc(count, size) : NULL;
+    slot->value.array = (jsonc_array){.values = members, .count = count};
+    if (count && !members) {
+      slot->value.array.count = 0;
+      copy->failed = true;
+      return false;
+    }
+    visit->self->data.target = slot;
+  } else if (slot->type == JSONC_VALUE_TYPE_STRING && !slot->capacity &&
+             !(slot->value.string = util_strdup(visit->a->value.string))) {
+    slot->type = JSONC_VALUE_TYPE_NULL;
+    copy->failed = true;
+    return false;
+  }
+  return true;
+}
+
+static err_t copy_value(const jsonc_value *source, jsonc_value *out) {
+  heap_copy copy = {.root = out};
+  bool stopped;
+  out->type = JSONC_VALUE_TYPE_NULL;
+  if (traverse(source, NULL, false, heap_copy_visit, &copy, &stopped) ||
+      copy.failed) {
+    free_value(*out);
+    return true;
+  }
+  return false;
+}
+
+// jsonc_clone lays the copy out as the root value, then every member array
+// in visiting order, then all string bytes.
+typedef struct compact_copy {
+  size_t nodes_size;
+  size_t strings_size;
+  jsonc_value *root;
+  char *nodes;
+  char *strings;
+} compact_copy;
+
+static bool compact_size_visit(void *context, const visit *visit) {
+  compact_copy *const copy = context;
+  if (visit->event == VISIT_LEAVE) {
+    return true;
+  }
+  if (visit->key) {
+    copy->strings_size += strlen(visit->key) + 1;
+  }
+  if (visit->event == VISIT_ENTER) {
+    copy->nodes_size += container_count(visit->a) *
+                        (visit->a->type == JSONC_VALUE_TYPE_ARRAY
+                             ? sizeof(jsonc_value)
+                             : sizeof(jsonc_object_entry));
+  } else if (visit->a->type == JSONC_VALUE_TYPE_STRING &&
+             !visit->a->capacity) {
+    copy->strings_size += strlen(visit->a->value.string) + 1;
+  }
+  return true;
+}
+
+static char *compact_string(compact_copy *copy, const char *s) {
+  const size_t size = strlen(s) + 1;
+  char *const result = memcpy(copy->strings, s, size);
+  copy->strings += size;
+  return result;
+}
+
+static bool compact_fill_visit(void *context, const visit *visit) {
+  compact_copy *const copy = context;
+  if (visit->event == VISIT_LEAVE) {
+    return true;
+  }
+  char **key;
+  jsonc_value *const slot = copy_slot(visit, copy->root, &key);
+  if (key) {
+    *key = compact_string(copy, visit->key);
+  }
+  *slot = *visit->a;
+  if (visit->event == VISIT_ENTER) {
+    slot->capacity = 0;
+    const size_t count = container_count(visit->a);
+    slot->value.array.values = count ? (jsonc_value *)copy->nodes : NULL;
+    copy->nodes += count * (visit->a->type == JSONC_VALUE_TYPE_ARRAY
+                                ? sizeof(jsonc_value)
+                                : sizeof(jsonc_object_entry));
+    visit->self->data.target = slot;
+  } else if (slot->type == JSONC_VALUE_TYPE_STRING && !slot->capacity) {
+    slot->value.string = compact_string(copy, visit->a->value.string);
+  }
+  return true;
+}
+
+// What a typical malloc spends on a block beyond `size`: a header word,
+// rounding to two words and a minimum of four.
+static size_t allocation_overhead(size_t size) {
+  const size_t granule = 2 * sizeof(size_t);
+  size_t chunk = (size + sizeof(size_t) + granule - 1) / granule * granule;
+  if (chunk < 2 * granule) {
+    chunk = 2 * granule;
+  }
+  return chunk - size;
+}
+
+static size_t container_capacity(const jsonc_value *container);
+
+static void usage_add(jsonc_memory_stats *stats, size_t *field, size_t size,
+                      bool is_block) {
+  *field += size;
+  if (is_block) {
+    stats->overhead += allocation_overhead(size);
+    stats->allocations++;
+  }
+}
+
+static size_t usage_total(const jsonc_memory_stats *stats) {
+  return stats->nodes + stats->keys + stats->strings;
+}
+
+// `compact` is the tree from jsonc_compact being walked, if any, which is
+// accounted for as a single block when it is left; `compact_start` is the
+// total before it.
+typedef struct usage_count {
+  jsonc_memory_stats *stats;
+  const jsonc_value *compact;
+  size_t compact_start;
+} usage_count;
+
+static bool usage_visit(void *context, const visit *visit) {
+  usage_count *const count = context;
+  jsonc_memory_stats *const stats = count->stats;
+  if (visit->event == VISIT_LEAVE) {
+    if (visit->a == count->compact) {
+      const size_t size = usage_total(stats) - count->compact_start;
+      if (size) {
+        stats->overhead += allocation_overhead(size);
+        stats->allocations++;
+      }
+      count->compact = NULL;
+    }
+    return true;
+  }
+  if (visit->key) {
+    usage_add(stats, &stats->keys, strlen(visit->key) + 1, !count->compact);
+  }
+  if (visit->event == VISIT_ENTER && !count->compact &&
+      visit->a->capacity == CAPACITY_COMPACT) {
+    count->compact = visit->a;
+    count->compact_start = usage_total(stats);
+  }
+  const bool is_block = !count->compact;
+  if (visit->event == VISIT_ENTER) {
+    const size_t slots = visit->a->capacity == CAPACITY_COMPACT
+                             ? container_count(visit->a)
+                             : container_capacity(visit->a);
+    if (slots) {
+      usage_add(stats, &stats->nodes,
+                slots * (visit->a->type == JSONC_VALUE_TYPE_ARRAY
+                             ? sizeof(jsonc_value)
+                             : sizeof(jsonc_object_entry)),
+                is_block);
+    }
+  } else if (visit->a->type == JSONC_VALUE_TYPE_STRING &&
+             !visit->a->capacity) {
+    usage_add(stats, &stats->strings, strlen(visit->a->value.string) + 1,
+              is_block);
+  }
+  return true;
+}
+
+// Lays the tree out in `block` breadth first. `queue` lists the containers
+// of the new tree whose members still point into the old one.
+static err_t compact_fill(jsonc_value *root, compact_copy *copy,
+                          arraybuffer *queue) {
+  if (arraybuffer_push(queue, &root)) {
+    return true;
+  }
+  for (size_t head = 0; head < queue->length; head++) {
+    jsonc_value *const container =
+        *(jsonc_value **)arraybuffer_get(queue, head);
+    const bool is_array = container->type == JSONC_VALUE_TYPE_ARRAY;
+    const size_t count = container_count(container);
+    const size_t size =
+        count * (is_array ? sizeof(jsonc_value) : sizeof(jsonc_object_entry));
+    container->capacity = 0;
+    container->value.array.values =
+        memcpy(copy->nodes, container->value.array.values, size);
+    copy->nodes += size;
+    for (size_t i = 0; i < count; i++) {
+      jsonc_value *const child =
+          is_array ? &container->value.array.values[i]
+                   : &container->value.object.entries[i].value;
+      if (!is_array) {
+        jsonc_object_entry *const entry = &container->value.object.entries[i];
+        entry->key = compact_string(copy, entry->key);
+      }
+      if (child->type == JSONC_VALUE_TYPE_STRING && !child->capacity) {
+        child->value.string = compact_string(copy, child->value.string);
+      } else if (is_container(child) && !container_count(child)) {
+        child->capacity = 0;
+        child->value.array.values = NULL;
+      } else if (is_container(child) && arraybuffer_push(queue, &child)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// One pointer being evaluated by jsonc_extract. `matched` is how many of its
+// segments the path of the value currently being read agrees with.
+typedef struct extract_path {
+  pointer_segment *segments;
+  size_t count;
+  size_t matched;
+  bool done;
+} extract_path;
+
+// Resolves every pending pointer that reaches the value `first` starts: the
+// value is built once, handed to the first pointer naming it exactly, and
+// copied for the others.
+static err_t extract_build(reader *reader, event *first, extract_path *paths,
+                           size_t count, size_t level, jsonc_value *out_values,
+                           bool *out_found, size_t *remaining) {
+  jsonc_value value;
+  if (build_value(reader, first, NULL, NULL, NULL, &value)) {
+    return true;
+  }
+  if (reader->error->code != JSONC_ERROR_NONE) {
+    return false;
+  }
+  bool moved = false;
+  err_t result = false;
+  for (size_t i = 0; i < count && !result; i++) {
+    if (paths[i].done || paths[i].matched != level) {
+      continue;
+    }
+    paths[i].done = true;
+    (*remaining)--;
+    const jsonc_value *const found = pointer_resolve(
+        &value, paths[i].segments + level, paths[i].count - level);
+    if (!found) {
+      continue;
+    }
+    if (found == &value && !moved) {
+      out_values[i] = value;
+      moved = true;
+    } else if ((result = copy_value(found, &out_values[i]))) {
+      break;
+    }
+    out_found[i] = true;
+  }
+  if (!moved) {
+    free_value(value);
+  }
+  return result;
+}
+
+static void extract_fail(extract_path *paths, size_t count, size_t level,
+                         size_t *remaining) {
+  for (size_t i = 0; i < count; i++) {
+    if (!paths[i].done && paths[i].matched == level) {
+      paths[i].done = true;
+      (*remaining)--;
+    }
+  }
+}
+
+static err_t extract(reader *reader, extract_path *paths, size_t count,
+                     jsonc_value *out_values, bool *out_found,
+                     size_t remaining) {
+  // Next array index of each open container on the matched path, or
+  // SIZE_MAX for objects.
+  arraybuffer *const indexes = arraybuffer_create(sizeof(size_t), 8);
+  if (!indexes) {
+    return true;
+  }
+  err_t result = true;
+  size_t level = 0;
+  event current;
+  if (reader_next(reader, &current)) {
+    goto cleanup;
+  }
+
+  for (;;) {
+    // `current` starts a value whose path has `level` segments.
+    if (current.type == JSONC_EVENT_ERROR) {
+      break;
+    }
+    bool has_target = false;
+    bool has_live = false;
+    for (size_t i = 0; i < count; i++) {
+      if (!paths[i].done && paths[i].matched == level) {
+        has_target |= paths[i].count == level;
+        has_live |= paths[i].count > level;
+      }
+    }
+    if (has_target) {
+      if (extract_build(reader, &current, paths, count, level, out_values,
+                        out_found, &remaining)) {
+        goto cleanup;
+      }
+    } else if (has_live && (current.type == JSONC_EVENT_BEGIN_ARRAY ||
+                            current.type == JSONC_EVENT_BEGIN_OBJECT)) {
+      const size_t index =
+          current.type == JSONC_EVENT_BEGIN_ARRAY ? 0 : SIZE_MAX;
+      if (arraybuffer_push(indexes, &index)) {
+        goto cleanup;
+      }
+      level++;
+    } else {
+      if (reader_skip(reader, &current)) {
+        goto cleanup;
+      }
+      extract_fail(paths, count, level, &remaining);
+    }
+    if (reader->error->code != JSONC_ERROR_NONE) {
+      break;
+    }
+
+    // Advance to the start of the next value on the matched path, closing
+    // containers on the way.
+    for (;;) {
+      if (!remaining || (!level && indexes->length == 0)) {
+        result = false;
+        goto cleanup;
+      }
+      if (reader_next(reader, &current)) {
+        goto cleanup;
+      }
+      if (current.type != JSONC_EVENT_END_ARRAY &&
+          current.type != JSONC_EVENT_END_OBJECT) {
+        break;
+      }
+      indexes->length--;
+      level--;
+      extract_fail(paths, count, level, &remaining);
+      if (!level) {
+        result = false;
+        goto cleanup;
+      }
+    }
+    if (current.type == JSONC_EVENT_ERROR) {
+      break;
+    }
+    size_t *const index = arraybuffer_get(indexes, indexes->length - 1);
+    // The key is only valid until the reader moves on, so match it first.
+    const char *const key =
+        current.type == JSONC_EVENT_KEY ? current.value.string.data : NULL;
+    for (size_t i = 0; i < count; i++) {
+      extract_path *const path = &paths[i];
+      if (path->done || path->matched != level - 1) {
+        continue;
+      }
+      const pointer_segment *const segment = &path->segments[level - 1];
+      if (key ? !strcmp(segment->key, key) : segment->index == *index) {
+        path->matched = level;
+      }
+    }
+    if (!key) {
+      (*index)++;
+    } else if (reader_next(reader, &current)) {
+      goto cleanup;
+    }
+  }
+  result = false;
+
+cleanup:
+  arraybuffer_destroy(indexes);
+  return result;
+}
+
+// Column buffers are aligned to this and padded to a multiple of it. The
+// byte just before a buffer holds its distance from the start of the
+// allocation.
+#define COLUMN_ALIGNMENT 64
+
+static size_t column_padded(size_t size) {
+  return size ? (size + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT *
+                    COLUMN_ALIGNMENT
+              : COLUMN_ALIGNMENT;
+}
+
+// Zeroed; `size` must be padded.
+static void *column_alloc(size_t size) {
+  if (size > SIZE_MAX - COLUMN_ALIGNMENT) {
+    return NULL;
+  }
+  unsigned char *const raw = calloc(size + COLUMN_ALIGNMENT, 1);
+  if (!raw) {
+    return NULL;
+  }
+  const size_t shift = COLUMN_ALIGNMENT - (uintptr_t)raw % COLUMN_ALIGNMENT;
+  raw[shift - 1] = (unsigned char)shift;
+  return raw + shift;
+}
+
+static void column_release(void *buffer) {
+  if (buffer) {
+    unsigned char *const aligned = buffer;
+    free(aligned - aligned[-1]);
+  }
+}
+
+// Moves the `size` bytes at *buffer, if any, into a new zeroed buffer.
+static err_t column_resize(void **buffer, size_t size, size_t new_size) {
+  void *const resized = column_alloc(new_size);
+  if (!resized) {
+    return true;
+  }
+  if (*buffer) {
+    memcpy(resized, *buffer, size);
+    column_release(*buffer);
+  }
+  *buffer = resized;
+  return false;
+}
+
+static void columns_release(jsonc_column *columns, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    column_release(columns[i].values);
+    column_release(columns[i].offsets);
+    column_release(columns[i].data);
+    column_release(columns[i].validity);
+    columns[i].values = NULL;
+    columns[i].offsets = NULL;
+    columns[i].data = NULL;
+    columns[i].validity = NULL;
+    columns[i].null_count = 0;
+  }
+}
+
+// The event each column type is filled from.
+static const jsonc_event_type column_events[] = {
+    [JSONC_COLUMN_DOUBLE] = JSONC_EVENT_NUMBER,
+    [JSONC_COLUMN_INT64] = JSONC_EVENT_NUMBER,
+    [JSONC_COLUMN_BOOLEAN] = JSONC_EVENT_BOOLEAN,
+    [JSONC_COLUMN_STRING] = JSONC_EVENT_STRING,
+};
+
+// State of jsonc_extract_columns. `slots` is an open-addressing table from
+// key hash to column index + 1, with zero for an empty slot.
+typedef struct column_reader {
+  jsonc_column *columns;
+  size_t count;
+  unsigned flags;
+  size_t *slots;
+  size_t mask;
+  size_t *data_lengths;
+  size_t *data_capacities;
+  size_t rows;
+  size_t capacity;
+} column_reader;
+
+// Size of the values buffer, or of the offsets of a string column, for
+// `rows` rows.
+static size_t column_values_size(const column_reader *columns,
+                                 const jsonc_column *column, size_t rows) {
+  switch (column->type) {
+  case JSONC_COLUMN_DOUBLE:
+    return rows * sizeof(double);
+  case JSONC_COLUMN_INT64:
+    return rows * sizeof(int64_t);
+  case JSONC_COLUMN_BOOLEAN:
+    return columns->flags & JSONC_COLUMNS_ARROW ? (rows + 7) / 8 : rows;
+  case JSONC_COLUMN_STRING:
+    return (rows + 1) * sizeof(int64_t);
+  }
+  return 0;
+}
+
+static err_t columns_reserve(column_reader *columns, size_t capacity) {
+  if (capacity > SIZE_MAX / sizeof(int64_t) - 1) {
+    return true;
+  }
+  for (size_t i = 0; i < columns->count; i++) {
+    jsonc_column *const column = &columns->columns[i];
+    const bool is_string = column->type == JSONC_COLUMN_STRING;
+    void *values = is_string ? (void *)column->offsets : column->values;
+    void *validity = column->validity;
+    const err_t failed =
+        column_resize(&values,
+                      column_padded(column_values_size(columns, column,
+                                                       columns->capacity)),
+                      column_padded(
+                          column_values_size(columns, column, capacity))) ||
+        column_resize(&validity, column_padded((columns->capacity + 7) / 8),
+                      column_padded((capacity + 7) / 8));
+    if (is_string) {
+      column->offsets = values;
+    } else {
+      column->values = values;
+    }
+    column->validity = validity;
+    if (failed) {
+      return true;
+    }
+  }
+  columns->capacity = capacity;
+  return false;
+}
+
+static size_t columns_find(const column_reader *columns, const char *key) {
+  for (size_t i = hash_string(key) & columns->mask; columns->slots[i];
+       i = (i + 1) & columns->mask) {
+    if (!strcmp(columns->columns[columns->slots[i] - 1].key, key)) {
+      return columns->slots[i] - 1;
+    }
+  }
+  return SIZE_MAX;
+}
+
+static void columns_destroy(column_reader *columns) {
+  free(columns->slots);
+  free(columns->data_lengths);
+  free(columns->data_capacities);
+}
+
+static err_t columns_init(column_reader *columns, unsigned flags,
+                          jsonc_column *output, size_t count) {
+  size_t size = 4;
+  while (size < count * 2) {
+    size *= 2;
+  }
+  *columns = (column_reader){.columns = output,
+                             .count = count,
+                             .flags = flags,
+                             .slots = calloc(size, sizeof(size_t)),
+                             .mask = size - 1,
+                             .data_lengths = calloc(count + 1, sizeof(size_t)),
+                             .data_capacities =
+                                 calloc(count + 1, sizeof(size_t))};
+  for (size_t i = 0; i < count; i++) {
+    output[i].values = NULL;
+    output[i].offsets = NULL;
+    output[i].data = NULL;
+    output[i].validity = NULL;
+    output[i].null_count = 0;
+  }
+  if (!columns->slots || !columns->data_lengths ||
+      !columns->data_capacities || columns_reserve(columns, 64)) {
+    return true;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (output[i].type == JSONC_COLUMN_STRING) {
+      if (!(output[i].data = column_alloc(COLUMN_ALIGNMENT))) {
+        return true;
+      }
+      columns->data_capacities[i] = COLUMN_ALIGNMENT;
+    }
+    if (output[i].key && columns_find(columns, output[i].key) == SIZE_MAX) {
+      size_t slot = hash_string(output[i].key) & columns->mask;
+      while (columns->slots[slot]) {
+        slot = (slot + 1) & columns->mask;
+      }
+      columns->slots[slot] = i + 1;
+    }
+  }
+  return false;
+}
+
+// Drops the text stored for the current row of a string column, zeroing it
+// so that the buffer stays zero past its last row.
+static void column_truncate(column_reader *columns, size_t index) {
+  const jsonc_column *const column = &columns->columns[index];
+  const size_t start = (size_t)column->offsets[columns->rows];
+  memset(column->data + start, 0, columns->data_lengths[index] - start);
+  columns->data_lengths[index] = start;
+}
+
+static err_t column_append(column_reader *columns, size_t index,
+                           const char *string) {
+  jsonc_column *const column = &columns->columns[index];
+  const size_t length = strlen(string);
+  size_t *const data_length = &columns->data_lengths[index];
+  size_t *const capacity = &columns->data_capacities[index];
+  if (length > *capacity - *data_length) {
+    if (length > SIZE_MAX / 2 - *data_length) {
+      return true;
+    }
+    size_t needed = *data_length + length;
+    needed = column_padded(needed > *capacity * 2 ? needed : *capacity * 2);
+    void *data = column->data;
+    if (column_resize(&data, *data_length, needed)) {
+      return true;
+    }
+    column->data = data;
+    *capacity = needed;
+  }
+  memcpy(column->data + *data_length, string, length);
+  *data_length += length;
+  return false;
+}
+
+static void bitmap_set(uint8_t *bitmap, size_t index, bool bit) {
+  if (bit) {
+    bitmap[index / 8] |= (uint8_t)(1u << index % 8);
+  } else {
+    bitmap[index / 8] &= (uint8_t)~(1u << index % 8);
+  }
+}
+
+// Stores `current`, the value of the column's key in the current row. A
+// value of the wrong type fails the read.
+static err_t column_store(column_reader *columns, size_t index,
+                          reader *reader, event *current) {
+  jsonc_column *const column = &columns->columns[index];
+  const size_t row = columns->rows;
+  if (current->type == JSONC_EVENT_ERROR) {
+    return false;
+  }
+  const bool is_null = current->type == JSONC_EVENT_NULL;
+  if (!is_null &&
+      (current->type != column_events[column->type] ||
+       (column->type == JSONC_COLUMN_INT64 &&
+        !(is_integral(current->value.number) &&
+          current->value.number >= -0x1p63 &&
+          current->value.number < 0x1p63)))) {
+    reader_fail(reader, current, JSONC_ERROR_TYPE_MISMATCH, current->offset,
+                0);
+    return false;
+  }
+  switch (column->type) {
+  case JSONC_COLUMN_DOUBLE:
+    ((double *)column->values)[row] = is_null ? 0 : current->value.number;
+    break;
+  case JSONC_COLUMN_INT64:
+    ((int64_t *)column->values)[row] =
+        is_null ? 0 : (int64_t)current->value.number;
+    break;
+  case JSONC_COLUMN_BOOLEAN: {
+    const bool boolean = !is_null && current->value.boolean;
+    if (columns->flags & JSONC_COLUMNS_ARROW) {
+      bitmap_set(column->values, row, boolean);
+    } else {
+      ((uint8_t *)column->values)[row] = boolean;
+    }
+    break;
+  }
+  case JSONC_COLUMN_STRING:
+    column_truncate(columns, index);
+    if (!is_null) {
+      if (column_append(columns, index, current->value.string.data)) {
+        return true;
+      }
+    }
+    break;
+  }
+  bitmap_set(column->validity, row, !is_null);
+  return false;
+}
+
+static err_t columns_read(reader *reader, column_reader *columns) {
+  event current;
+  if (reader_next(reader, &current)) {
+    return true;
+  }
+  if (current.type != JSONC_EVENT_BEGIN_ARRAY) {
+    if (current.type != JSONC_EVENT_ERROR) {
+      reader_fail(reader, &current, JSONC_ERROR_TYPE_MISMATCH, current.offset,
+                  0);
+    }
+    return false;
+  }
+  for (;;) {
+    if (reader_next(reader, &current)) {
+      return true;
+    }
+    if (current.type == JSONC_EVENT_END_ARRAY) {
+      break;
+    }
+    if (current.type != JSONC_EVENT_BEGIN_OBJECT) {
+      if (current.type != JSONC_EVENT_ERROR) {
+        reader_fail(reader, &current, JSONC_ERROR_TYPE_MISMATCH,
+                    current.offset, 0);
+      }
+      return false;
+    }
+    if (columns->rows == columns->capacity &&
+        columns_reserve(columns, columns->capacity * 2)) {
+      return true;
+    }
+    for (;;) {
+      if (reader_next(reader, &current)) {
+        return true;
+      }
+      if (current.type == JSONC_EVENT_END_OBJECT) {
+        break;
+      }
+      if (current.type == JSONC_EVENT_ERROR) {
+        return false;
+      }
+      const size_t index = columns_find(columns, current.value.string.data);
+      if (reader_next(reader, &current)) {
+        return true;
+      }
+      if (index == SIZE_MAX ? reader_skip(reader, &current)
+                            : column_store(columns, index, reader, &current)) {
+        return true;
+      }
+      if (reader->error->code != JSONC_ERROR_NONE) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < columns->count; i++) {
+      if (columns->columns[i].type == JSONC_COLUMN_STRING) {
+        columns->columns[i].offsets[columns->rows + 1] =
+            (int64_t)columns->data_lengths[i];
+      }
+    }
+    columns->rows++;
+  }
+  // Only trailing data is left to report.
+  return reader_next(reader, &current);
+}
+
+// Reads up to the value that `segments` name, skipping everything before
+// it, and leaves `current` at its first event. *out_found is false if the
+// document has no such value; `current` is then where that became clear.
+static err_t pointer_seek(reader *reader, const pointer_segment *segments,
+                          size_t count, event *current, bool *out_found) {
+  *out_found = false;
+  if (reader_next(reader, current)) {
+    return true;
+  }
+  for (size_t level = 0; level < count; level++) {
+    const pointer_segment *const segment = &segments[level];
+    const bool is_object = current->type == JSONC_EVENT_BEGIN_OBJECT;
+    if (!is_object && current->type != JSONC_EVENT_BEGIN_ARRAY) {
+      return false;
+    }
+    // Duplicate keys resolve to the first member, as in jsonc_pointer_get.
+    for (size_t index = 0;; index++) {
+      if (reader_next(reader, current)) {
+        return true;
+      }
+      if (current->type == JSONC_EVENT_ERROR ||
+          current->type == JSONC_EVENT_END_ARRAY ||
+          current->type == JSONC_EVENT_END_OBJECT) {
+        return false;
+      }
+      bool match = index == segment->index;
+      if (is_object) {
+        match = !strcmp(current->value.string.data, segment->key);
+        if (reader_next(reader, current)) {
+          return true;
+        }
+      }
+      if (match) {
+        break;
+      }
+      if (reader_skip(reader, current)) {
+        return true;
+      }
+      if (current->type == JSONC_EVENT_ERROR) {
+        return false;
+      }
+    }
+  }
+  *out_found = current->type != JSONC_EVENT_ERROR;
+  return false;
+}
+
+// Reads the array that `current` starts into the only column, a row per
+// element.
+static err_t array_read(reader *reader, column_reader *columns,
+                        event *current) {
+  if (current->type != JSONC_EVENT_BEGIN_ARRAY) {
+    reader_fail(reader, current, JSONC_ERROR_TYPE_MISMATCH, current->offset,
+                0);
+    return false;
+  }
+  jsonc_column *const column = columns->columns;
+  for (;;) {
+    if (!reader_next_number(reader, current) && reader_next(reader, current)) {
+      return true;
+    }
+    if (current->type == JSONC_EVENT_END_ARRAY) {
+      return false;
+    }
+    if (columns->rows == columns->capacity &&
+        columns_reserve(columns, columns->capacity * 2)) {
+      return true;
+    }
+    if (column_store(columns, 0, reader, current)) {
+      return true;
+    }
+    if (reader->error->code != JSONC_ERROR_NONE) {
+      return false;
+    }
+    if (column->type == JSONC_COLUMN_STRING) {
+      column->offsets[columns->rows + 1] = (int64_t)columns->data_lengths[0];
+    }
+    columns->rows++;
+  }
+}
+
+static size_t column_null_count(const jsonc_column *column, size_t rows) {
+  size_t count = 0;
+  for (size_t i = 0; i < rows; i++) {
+    count += !(column->validity[i / 8] >> i % 8 & 1);
+  }
+  return count;
+}
+
+static size_t container_capacity(const jsonc_value *container) {
+  return container->capacity ? container->capacity
+                             : container_count(container);
+}
+
+// Makes room for `needed` members, at least doubling the allocation so that
+// repeated appends are amortized O(1). Beyond what the 32-bit capacity field
+// can record, containers are kept at their exact size.
+static err_t container_reserve(jsonc_value *container, size_t needed) {
+  const size_t capacity = container_capacity(container);
+  if (needed <= capacity) {
+    return false;
+  }
+  size_t new_capacity = capacity < 2 ? 4 : capacity * 2;
+  if (new_capacity < needed || new_capacity >= CAPACITY_COMPACT) {
+    new_capacity = needed;
+  }
+  const size_t size = container->type == JSONC_VALUE_TYPE_ARRAY
+                          ? sizeof(jsonc_value)
+                          : sizeof(jsonc_object_entry);
+  if (new_capacity > SIZE_MAX / size) {
+    return true;
+  }
+  void *const members =
+      realloc(container->value.array.values, new_capacity * size);
+  if (!members) {
+    return true;
+  }
+  container->value.array.values = members;
+  container->capacity =
+      new_capacity < CAPACITY_COMPACT ? (uint32_t)new_capacity : 0;
+  return false;
+}
+
+static jsonc_object_entry *object_find(const jsonc_value *object,
+                                       const char *key) {
+  for (size_t i = 0; i < object->value.object.count; i++) {
+    if (!strcmp(object->value.object.entries[i].key, key)) {
+      return &object->value.object.entries[i];
+    }
+  }
+  return NULL;
+}
+
+// Appends a member without looking for one with the same key. On failure
+// the caller still owns `value`.
+static err_t object_append(jsonc_value *object, const char *key,
+                           jsonc_value value) {
+  jsonc_object *const members = &object->value.object;
+  char *const copy = util_strdup(key);
+  if (!copy || container_reserve(object, members->count + 1)) {
+    free(copy);
+    return true;
+  }
+  members->entries[members->count++] =
+      (jsonc_object_entry){.key = copy, .value = value};
+  return false;
+}
+
+// Records the size of the allocation of a container that is about to lose
+// members, which a capacity of zero would no longer tell.
+static void container_pin(jsonc_value *container) {
+  const size_t count = container_count(container);
+  if (!container->capacity && count < CAPACITY_COMPACT) {
+    container->capacity = (uint32_t)count;
+  }
+}
+
+// Puts a member in at `position`; `key` is NULL for arrays. On failure the
+// caller still owns `key` and `value`.
+static err_t container_insert(jsonc_value *container, size_t position,
+                              char *key, jsonc_value value) {
+  const size_t count = container_count(container);
+  if (container_reserve(container, count + 1)) {
+    return true;
+  }
+  if (container->type == JSONC_VALUE_TYPE_ARRAY) {
+    jsonc_value *const values = container->value.array.values;
+    memmove(&values[position + 1], &values[position],
+            (count - position) * sizeof(jsonc_value));
+    values[position] = value;
+    container->value.array.count++;
+  } else {
+    jsonc_object_entry *const entries = container->value.object.entries;
+    memmove(&entries[position + 1], &entries[position],
+            (count - position) * sizeof(jsonc_object_entry));
+    entries[position] = (jsonc_object_entry){.key = key, .value = value};
+    container->value.object.count++;
+  }
+  return false;
+}
+
+// Takes member `position` out of `container` without releasing it. The
+// allocation keeps its size, so putting the member back with
+// container_insert cannot fail.
+static void container_detach(jsonc_value *container, size_t position,
+                             char **out_key, jsonc_value *out_value) {
+  container_pin(container);
+  const size_t count = container_count(container) - 1;
+  if (container->type == JSONC_VALUE_TYPE_ARRAY) {
+    jsonc_value *const values = container->value.array.values;
+    *out_key = NULL;
+    *out_value = values[position];
+    memmove(&values[position], &values[position + 1],
+            (count - position) * sizeof(jsonc_value));
+    container->value.array.count = count;
+  } else {
+    jsonc_object_entry *const entries = container->value.object.entries;
+    *out_key = entries[position].key;
+    *out_value = entries[position].value;
+    memmove(&entries[position], &entries[position + 1],
+            (count - position) * sizeof(jsonc_object_entry));
+    container->value.object.count = count;
+  }
+}
+
+// A container's structural hash, as jsonc_hash computes it, and how many
+// containers its subtree holds, itself included. The subtrees of a tree are
+// listed in the order its containers are entered, so those of a container's
+// members follow it, each after the subtrees of the members before it.
+typedef struct subtree {
+  uint64_t hash;
+  size_t size;
+} subtree;
+
+// Lists the subtrees of a tree. `data.index` of a frame is where the
+// subtree of its container is listed; its `hash` is built up there.
+static bool subtree_visit(void *context, const visit *visit) {
+  arraybuffer *const subtrees = context;
+  uint64_t hash;
+  if (visit->event == VISIT_ENTER) {
+    const subtree entry = {.hash = hash_start(visit->a)};
+    visit->self->data.index = subtrees->length;
+    return !arraybuffer_push(subtrees, &entry);
+  }
+  if (visit->event == VISIT_LEAVE) {
+    subtree *const entry = arraybuffer_get(subtrees, visit->self->data.index);
+    entry->hash = hash_finish(visit->a, entry->hash);
+    entry->size = subtrees->length - visit->self->data.index;
+    hash = entry->hash;
+  } else {
+    hash = hash_scalar(visit->a);
+  }
+  if (visit->parent) {
+    subtree *const parent =
+        arraybuffer_get(subtrees, visit->parent->data.index);
+    parent->hash = hash_member(parent->hash, visit->key, hash);
+  }
+  return true;
+}
+
+// One side of a jsonc_diff: the subtrees of the tree, and where those of
+// the members of the container being compared are listed, or SIZE_MAX for
+// members that are not containers.
+typedef struct diff_side {
+  arraybuffer *subtrees;
+  arraybuffer *members;
+} diff_side;
+
+static err_t diff_side_init(diff_side *side, const jsonc_value *tree) {
+  bool stopped;
+  side->subtrees = arraybuffer_create(sizeof(subtree), 64);
+  side->members = arraybuffer_create(sizeof(size_t), 64);
+  return !side->subtrees || !side->members ||
+         traverse(tree, NULL, false, subtree_visit, side->subtrees,
+                  &stopped) ||
+         stopped;
+}
+
+static void diff_side_destroy(diff_side *side) {
+  if (side->subtrees) {
+    arraybuffer_destroy(side->subtrees);
+  }
+  if (side->members) {
+    arraybuffer_destroy(side->members);
+  }
+}
+
+static const subtree *diff_side_subtree(const diff_side *side, size_t index) {
+  return &((const subtree *)side->subtrees->data)[index];
+}
+
+// Fills side->members for `container`, whose subtree is listed at `index`.
+static err_t diff_side_enter(diff_side *side, const jsonc_value *container,
+                             size_t index) {
+  const subtree *const subtrees = side->subtrees->data;
+  const size_t count = container_count(container);
+  size_t next = index + 1;
+  side->members->length = 0;
+  for (size_t i = 0; i < count; i++) {
+    const jsonc_value *const member =
+        container->type == JSONC_VALUE_TYPE_ARRAY
+            ? &container->value.array.values[i]
+            : &container->value.object.entries[i].value;
+    const size_t at = is_container(member) ? next : SIZE_MAX;
+    if (arraybuffer_push(side->members, &at)) {
+      return true;
+    }
+    if (is_container(member)) {
+      next += subtrees[next].size;
+    }
+  }
+  return false;
+}
+
+static size_t diff_side_member(const diff_side *side, size_t member) {
+  return ((const size_t *)side->members->data)[member];
+}
+
+// Whether `a` and `b`, whose subtrees are listed at `index_a` and `index_b`
+// if they are containers, are equal. Differing hashes or sizes rule a pair
+// of containers out at once. Hashes can collide, so a pair that agrees is
+// compared in full; it is then skipped, so no subtree is compared twice.
+static err_t diff_same(const diff_side *sides, const jsonc_value *a,
+                       size_t index_a, const jsonc_value *b, size_t index_b,
+                       bool *out_same) {
+  const visit leaf = {.event = VISIT_LEAF, .a = a, .b = b};
+  *out_same = equal_visit(NULL, &leaf);
+  if (!*out_same || !is_container(a)) {
+    return false;
+  }
+  const subtree *const subtree_a = diff_side_subtree(&sides[0], index_a);
+  const subtree *const subtree_b = diff_side_subtree(&sides[1], index_b);
+  *out_same = subtree_a->hash == subtree_b->hash &&
+              subtree_a->size == subtree_b->size;
+  return *out_same &&
+         jsonc_equal(a, b, JSONC_EQUAL_IGNORE_KEY_ORDER, out_same);
+}
+
+// A pair of differing containers of the same type that jsonc_diff has still
+// to compare member by member, with the indexes of their subtrees. For a
+// JSON Patch, `path` and `length` give the pointer to them in diff.text.
+// For a merge patch, the output for them is member `member` of `parent`, or
+// the patch itself if `parent` is NULL.
+typedef struct diff_item {
+  const jsonc_value *a;
+  const jsonc_value *b;
+  size_t index_a;
+  size_t index_b;
+  size_t path;
+  size_t length;
+  jsonc_value *parent;
+  size_t member;
+} diff_item;
+
+// `text` holds the paths of the queued items, each after those queued
+// before it, followed by the path being written.
+typedef struct diff {
+  jsonc_diff_format format;
+  diff_side sides[2];
+  key_index index_a;
+  key_index index_b;
+  arraybuffer *items;
+  arraybuffer *text;
+  jsonc_value *out;
+} diff;
+
+// Writes the pointer to member `key`, or element `index` if `key` is NULL,
+// of the item's containers at the end of diff->text, from *out_offset on.
+static err_t diff_path(diff *diff, const diff_item *item, const char *key,
+                       size_t index, size_t *out_offset) {
+  arraybuffer *const text = diff->text;
+  char chunk[64];
+  *out_offset = text->length;
+  // The item's path is in the same buffer, which appending may move.
+  for (size_t done = 0; done < item->length;) {
+    const size_t n = item->length - done < sizeof(chunk)
+                         ? item->length - done
+                         : sizeof(chunk);
+    memcpy(chunk, (char *)text->data + item->path + done, n);
+    if (arraybuffer_append(text, chunk, n)) {
+      return true;
+    }
+    done += n;
+  }
+  return key ? path_append(text, key) : path_append_index(text, index);
+}
+
+// Appends {"op": op, "path": ..., "value": value} to the JSON Patch, with
+// the path written from `offset` on, which is dropped again. "value" is
+// left out if `value` is NULL.
+static err_t diff_op(diff *diff, const char *op, size_t offset,
+                     const jsonc_value *value) {
+  static const char *const keys[] = {"op", "path", "value"};
+  const char *const path = (const char *)diff->text->data + offset;
+  const size_t length = diff->text->length - offset;
+  const size_t count = value ? 3 : 2;
+  diff->text->length = offset;
+  jsonc_value entry = {.type = JSONC_VALUE_TYPE_OBJECT};
+  if (container_reserve(&entry, count)) {
+    return true;
+  }
+  jsonc_object *const members = &entry.value.object;
+  for (size_t i = 0; i < count; i++) {
+    jsonc_object_entry *const member = &members->entries[i];
+    if (!(member->key = util_strdup(keys[i])) ||
+        (i == 0   ? string_copy(op, strlen(op), NULL, &member->value)
+         : i == 1 ? string_copy(path, length, NULL, &member->value)
+                  : copy_value(value, &member->value))) {
+      free(member->key);
+      free_value(entry);
+      return true;
+    }
+    members->count++;
+  }
+  if (jsonc_array_push(diff->out, entry)) {
+    free_value(entry);
+    return true;
+  }
+  return false;
+}
+
+// The object that the merge patch for `item` is written to.
+static jsonc_value *diff_target(const diff *diff, const diff_item *item) {
+  return item->parent
+             ? &item->parent->value.object.entries[item->member].value
+             : diff->out;
+}
+
+// Appends a copy of `value` to the merge patch for `item`.
+static err_t diff_merge_set(diff *diff, const diff_item *item, const char *key,
+                            const jsonc_value *value) {
+  jsonc_value copy;
+  if (copy_value(value, &copy)) {
+    return true;
+  }
+  if (object_append(diff_target(diff, item), key, copy)) {
+    free_value(copy);
+    return true;
+  }
+  return false;
+}
+
+// Records that member `key` of item->b, or element `index` in arrays,
+// differs from member `member_a` of item->a, or, if that is SIZE_MAX, that
+// it is new.
+static err_t diff_member(diff *diff, const diff_item *item, const char *key,
+                         size_t index, size_t member_a, size_t member_b) {
+  const jsonc_value *const a =
+      member_a == SIZE_MAX ? NULL
+      : item->a->type == JSONC_VALUE_TYPE_ARRAY
+          ? &item->a->value.array.values[member_a]
+          : &item->a->value.object.entries[member_a].value;
+  const jsonc_value *const b =
+      item->b->type == JSONC_VALUE_TYPE_ARRAY
+          ? &item->b->value.array.values[member_b]
+          : &item->b->value.object.entries[member_b].value;
+  const size_t index_a =
+      a ? diff_side_member(&diff->sides[0], member_a) : SIZE_MAX;
+  const size_t index_b = diff_side_member(&diff->sides[1], member_b);
+  bool same = false;
+  if (a && diff_same(diff->sides, a, index_a, b, index_b, &same)) {
+    return true;
+  }
+  if (same) {
+    return false;
+  }
+  const bool nested = a && is_container(a) && a->type == b->type;
+  diff_item child = {.a = a, .b = b, .index_a = index_a, .index_b = index_b};
+  if (diff->format == JSONC_DIFF_MERGE_PATCH) {
+    if (!nested || a->type != JSONC_VALUE_TYPE_OBJECT) {
+      return diff_merge_set(diff, item, key, b);
+    }
+    child.parent = diff_target(diff, item);
+    if (object_append(child.parent, key, jsonc_object_new())) {
+      return true;
+    }
+    child.member = child.parent->value.object.count - 1;
+    return arraybuffer_push(diff->items, &child);
+  }
+  if (diff_path(diff, item, key, index, &child.path)) {
+    return true;
+  }
+  if (nested) {
+    child.length = diff->text->length - child.path;
+    return arraybuffer_push(diff->items, &child);
+  }
+  return diff_op(diff, a ? "replace" : "add", child.path, b);
+}
+
+// Records that member `key` of item->a, or element `index`, is gone.
+static err_t diff_remove(diff *diff, const diff_item *item, const char *key,
+                         size_t index) {
+  if (diff->format == JSONC_DIFF_MERGE_PATCH) {
+    return object_append(diff_target(diff, item), key, jsonc_null_new());
+  }
+  size_t offset;
+  return diff_path(diff, item, key, index, &offset) ||
+         diff_op(diff, "remove", offset, NULL);
+}
+
+// Members are matched by key through a key_index of each side, taking the
+// first member with a key and ignoring the rest.
+static err_t diff_object(diff *diff, const diff_item *item) {
+  const jsonc_value *const a = item->a;
+  const jsonc_value *const b = item->b;
+  if (key_index_build(&diff->index_a, a) ||
+      key_index_build(&diff->index_b, b)) {
+    return true;
+  }
+  for (size_t i = 0; i < a->value.object.count; i++) {
+    const char *const key = a->value.object.entries[i].key;
+    if (key_index_find(&diff->index_a, a, key) != i) {
+      continue;
+    }
+    const size_t j = key_index_find(&diff->index_b, b, key);
+    if (j == SIZE_MAX ? diff_remove(diff, item, key, 0)
+                      : diff_member(diff, item, key, 0, i, j)) {
+      return true;
+    }
+  }
+  for (size_t j = 0; j < b->value.object.count; j++) {
+    const char *const key = b->value.object.entries[j].key;
+    if (key_index_find(&diff->index_b, b, key) == j &&
+        key_index_find(&diff->index_a, a, key) == SIZE_MAX &&
+        diff_member(diff, item, key, 0, SIZE_MAX, j)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Elements are paired by position once the common start and end of the
+// arrays are set aside, so that elements inserted or removed in one place
+// cost an operation each rather than one for every element after them.
+// Removals go from the back, so each moves as few elements as it can.
+static err_t diff_array(diff *diff, const diff_item *item) {
+  const jsonc_array a = item->a->value.array;
+  const jsonc_array b = item->b->value.array;
+  const diff_side *const sides = diff->sides;
+  const size_t common = a.count < b.count ? a.count : b.count;
+  size_t start = 0;
+  size_t end = 0;
+  bool same = true;
+  for (; start < common; start++) {
+    if (diff_same(sides, &a.values[start], diff_side_member(&sides[0], start),
+                  &b.values[start], diff_side_member(&sides[1], start),
+                  &same)) {
+      return true;
+    }
+    if (!same) {
+      break;
+    }
+  }
+  for (; end < common - start; end++) {
+    const size_t i = a.count - 1 - end;
+    const size_t j = b.count - 1 - end;
+    if (diff_same(sides, &a.values[i], diff_side_member(&sides[0], i),
+                  &b.values[j], diff_side_member(&sides[1], j), &same)) {
+      return true;
+    }
+    if (!same) {
+      break;
+    }
+  }
+  const size_t a_end = a.count - end;
+  const size_t b_end = b.count - end;
+  for (size_t i = start; i < a_end && i < b_end; i++) {
+    if (diff_member(diff, item, NULL, i, i, i)) {
+      return true;
+    }
+  }
+  for (size_t i = a_end; i > b_end; i--) {
+    if (diff_remove(diff, item, NULL, i - 1)) {
+      return true;
+    }
+  }
+  for (size_t i = a_end; i < b_end; i++) {
+    if (diff_member(diff, item, NULL, i, SIZE_MAX, i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Compares the members of a pair of containers.
+static err_t diff_pair(diff *diff, const diff_item *item) {
+  if (diff_side_enter(&diff->sides[0], item->a, item->index_a) ||
+      diff_side_enter(&diff->sides[1], item->b, item->index_b)) {
+    return true;
+  }
+  return item->a->type == JSONC_VALUE_TYPE_ARRAY ? diff_array(diff, item)
+                                                 : diff_object(diff, item);
+}
+
+// A pointer of a JSON Patch operation, compiled.
+typedef struct patch_path {
+  pointer_segment *segments;
+  size_t count;
+} patch_path;
+
+typedef enum patch_change {
+  PATCH_INSERTED,
+  PATCH_REPLACED,
+  PATCH_DETACHED,
+} patch_change;
+
+// How to take back one change made by a JSON Patch: the member that
+// `segments` names was inserted at `position` of its container, or had its
+// value replaced by another, keeping the old one in `value`, or was
+// detached from `position` with its `key` and `value`. Containers are found
+// again from the root when undoing, since later changes may have moved
+// them. A move is recorded as a detach followed by an insert or replace,
+// both with `moved` set: the value detached is the one put in.
+typedef struct patch_undo {
+  patch_change change;
+  const pointer_segment *segments;
+  size_t count;
+  size_t position;
+  char *key;
+  jsonc_value value;
+  bool moved;
+} patch_undo;
+
+typedef struct patch_state {
+  jsonc_value *target;
+  arraybuffer *undo;
+  arraybuffer *paths;
+} patch_state;
+
+static jsonc_value *patch_resolve(const patch_state *patch,
+                                  const pointer_segment *segments,
+                                  size_t count) {
+  return (jsonc_value *)pointer_resolve(patch->target, segments, count);
+}
+
+// Index of the member of `container` that `segment` names, or SIZE_MAX.
+static size_t patch_position(const jsonc_value *container,
+                             const pointer_segment *segment) {
+  if (container && container->type == JSONC_VALUE_TYPE_ARRAY) {
+    return segment->index < container->value.array.count ? segment->index
+                                                         : SIZE_MAX;
+  }
+  if (container && container->type == JSONC_VALUE_TYPE_OBJECT) {
+    const jsonc_object_entry *const entry =
+        object_find(container, segment->key);
+    return entry ? (size_t)(entry - container->value.object.entries)
+                 : SIZE_MAX;
+  }
+  return SIZE_MAX;
+}
+
+// Takes back every recorded change, newest first. Detached members go back
+// into the room they left, so this does not allocate.
+static void patch_rollback(patch_state *patch) {
+  arraybuffer *const undo = patch->undo;
+  while (undo->length) {
+    patch_undo *const entry = arraybuffer_get(undo, --undo->length);
+    jsonc_value current;
+    if (entry->change == PATCH_REPLACED) {
+      jsonc_value *const slot =
+          patch_resolve(patch, entry->segments, entry->count);
+      current = *slot;
+      *slot = entry->value;
+    } else {
+      jsonc_value *const container =
+          patch_resolve(patch, entry->segments, entry->count - 1);
+      if (entry->change == PATCH_DETACHED) {
+        container_insert(container, entry->position, entry->key,
+                         entry->value);
+        continue;
+      }
+      char *key;
+      container_detach(container, entry->position, &key, &current);
+      free(key);
+    }
+    if (entry->moved) {
+      patch_undo *const detached = arraybuffer_get(undo, undo->length - 1);
+      detached->value = current;
+    } else {
+      free_value(current);
+    }
+  }
+}
+
+// Releases what the changes took out of the tree.
+static void patch_commit(patch_state *patch) {
+  for (size_t i = 0; i < patch->undo->length; i++) {
+    patch_undo *const entry = arraybuffer_get(patch->undo, i);
+    if (entry->change == PATCH_DETACHED) {
+      free(entry->key);
+    }
+    if (entry->change == PATCH_REPLACED ||
+        (entry->change == PATCH_DETACHED && !entry->moved)) {
+      free_value(entry->value);
+    }
+  }
+}
+
+// The "add" operation: inserts `value` into an array, or sets it in an
+// object, replacing the member with that key if there is one. On failure
+// the caller still owns `value`.
+static err_t patch_add(patch_state *patch, const patch_path *path,
+                       jsonc_value value, bool moved,
+                       jsonc_error_code *out_code) {
+  const patch_undo reserved = {.change = PATCH_REPLACED,
+                               .segments = path->segments,
+                               .count = path->count,
+                               .moved = moved};
+  if (arraybuffer_push(patch->undo, &reserved)) {
+    return true;
+  }
+  patch_undo *const entry =
+      arraybuffer_get(patch->undo, patch->undo->length - 1);
+  jsonc_value *slot = patch->target;
+  if (path->count) {
+    const pointer_segment *const last = &path->segments[path->count - 1];
+    jsonc_value *const container =
+        patch_resolve(patch, path->segments, path->count - 1);
+    char *key = NULL;
+    slot = NULL;
+    entry->change = PATCH_INSERTED;
+    if (container && container->type == JSONC_VALUE_TYPE_ARRAY) {
+      entry->position =
+          strcmp(last->key, "-") ? last->index : container->value.array.count;
+      if (entry->position > container->value.array.count) {
+        *out_code = JSONC_ERROR_PATCH_PATH;
+      }
+    } else if (container && container->type == JSONC_VALUE_TYPE_OBJECT) {
+      entry->position = patch_position(container, last);
+      if (entry->position != SIZE_MAX) {
+        entry->change = PATCH_REPLACED;
+        slot = &container->value.object.entries[entry->position].value;
+      } else {
+        entry->position = container->value.object.count;
+        if (!(key = util_strdup(last->key))) {
+          patch->undo->length--;
+          return true;
+        }
+      }
+    } else {
+      *out_code = JSONC_ERROR_PATCH_PATH;
+    }
+    if (*out_code != JSONC_ERROR_NONE) {
+      patch->undo->length--;
+      return false;
+    }
+    if (!slot && container_insert(container, entry->position, key, value)) {
+      free(key);
+      patch->undo->length--;
+      return true;
+    }
+  }
+  if (slot) {
+    entry->value = *slot;
+    *slot = value;
+  }
+  return false;
+}
+
+// The "replace" operation, for a member known to exist.
+static err_t patch_replace(patch_state *patch, const patch_path *path,
+                           jsonc_value value) {
+  jsonc_value *const slot = patch_resolve(patch, path->segments, path->count);
+  const patch_undo entry = {.change = PATCH_REPLACED,
+                            .segments = path->segments,
+                            .count = path->count,
+                            .value = *slot};
+  if (arraybuffer_push(patch->undo, &entry)) {
+    return true;
+  }
+  *slot = value;
+  return false;
+}
+
+// The "remove" operation, and the first half of "move".
+static err_t patch_detach(patch_state *patch, const patch_path *path,
+                          bool moved, jsonc_error_code *out_code) {
+  jsonc_value *const container =
+      path->count ? patch_resolve(patch, path->segments, path->count - 1)
+                  : NULL;
+  const size_t position =
+      path->count ? patch_position(container,
+                                   &path->segments[path->count - 1])
+                  : SIZE_MAX;
+  if (position == SIZE_MAX) {
+    // The root cannot be removed.
+    *out_code = path->count ? JSONC_ERROR_PATCH_PATH
+                            : JSONC_ERROR_PATCH_INVALID;
+    return false;
+  }
+  patch_undo entry = {.change = PATCH_DETACHED,
+                      .segments = path->segments,
+                      .count = path->count,
+                      .position = position,
+                      .moved = moved};
+  container_detach(container, position, &entry.key, &entry.value);
+  if (arraybuffer_push(patch->undo, &entry)) {
+    container_insert(container, position, entry.key, entry.value);
+    return true;
+  }
+  return false;
+}
+
+// Compiles the pointer held in member `name` of `operation`, keeping it
+// until the patch is done with. Sets *out_text to NULL if there is none.
+static err_t patch_pointer(patch_state *patch, const jsonc_value *operation,
+                           const char *name, const char **out_text,
+                           patch_path *out) {
+  const jsonc_object_entry *const member = object_find(operation, name);
+  *out_text = NULL;
+  if (!member || member->value.type != JSONC_VALUE_TYPE_STRING ||
+      !pointer_is_valid(string_data(&member->value))) {
+    return false;
+  }
+  if (pointer_compile(string_data(&member->value), &out->segments,
+                      &out->count)) {
+    return true;
+  }
+  if (arraybuffer_push(patch->paths, out)) {
+    pointer_free(out->segments, out->count);
+    return true;
+  }
+  *out_text = string_data(&member->value);
+  return false;
+}
+
+// Whether `operation` has more than one member named `name`, which RFC 6902
+// does not allow for the members it defines.
+static bool patch_member_repeated(const jsonc_value *operation,
+                                  const char *name) {
+  const jsonc_object_entry *const first = object_find(operation, name);
+  const jsonc_object_entry *const end =
+      operation->value.object.entries + operation->value.object.count;
+  for (const jsonc_object_entry *entry = first ? first + 1 : end;
+       entry < end; entry++) {
+    if (!strcmp(entry->key, name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static err_t patch_operation(patch_state *patch, const jsonc_value *operation,
+                             jsonc_error_code *out_code) {
+  *out_code = JSONC_ERROR_NONE;
+  if (operation->type != JSONC_VALUE_TYPE_OBJECT ||
+      patch_member_repeated(operation, "op") ||
+      patch_member_repeated(operation, "path") ||
+      patch_member_repeated(operation, "from") ||
+      patch_member_repeated(operation, "value")) {
+    *out_code = JSONC_ERROR_PATCH_INVALID;
+    return false;
+  }
+  const jsonc_object_entry *const op = object_find(operation, "op");
+  const jsonc_object_entry *const value = object_find(operation, "value");
+  const char *const name = op && op->value.type == JSONC_VALUE_TYPE_STRING
+                               ? string_data(&op->value)
+                               : "";
+  const bool has_from = !strcmp(name, "move") || !strcmp(name, "copy");
+  const char *to_text;
+  const char *from_text = NULL;
+  patch_path to;
+  patch_path from;
+  if (patch_pointer(patch, operation, "path", &to_text, &to) ||
+      (has_from &&
+       patch_pointer(patch, operation, "from", &from_text, &from))) {
+    return true;
+  }
+  if (!to_text || (has_from && !from_text) ||
+      (!value && (!strcmp(name, "add") || !strcmp(name, "replace") ||
+                  !strcmp(name, "test")))) {
+    *out_code = JSONC_ERROR_PATCH_INVALID;
+    return false;
+  }
+  if (!strcmp(name, "remove")) {
+    return patch_detach(patch, &to, false, out_code);
+  }
+  if (!strcmp(name, "move")) {
+    const size_t length = strlen(from_text);
+    if (!strcmp(from_text, to_text)) {
+      if (!patch_resolve(patch, from.segments, from.count)) {
+        *out_code = JSONC_ERROR_PATCH_PATH;
+      }
+      return false;
+    }
+    // A value cannot be moved into itself.
+    if (!strncmp(from_text, to_text, length) && to_text[length] == '/') {
+      *out_code = JSONC_ERROR_PATCH_INVALID;
+      return false;
+    }
+    if (patch_detach(patch, &from, true, out_code)) {
+      return true;
+    }
+    if (*out_code != JSONC_ERROR_NONE) {
+      return false;
+    }
+    const patch_undo *const detached =
+        arraybuffer_get(patch->undo, patch->undo->length - 1);
+    return patch_add(patch, &to, detached->value, true, out_code);
+  }
+  if (!strcmp(name, "test")) {
+    const jsonc_value *const current =
+        patch_resolve(patch, to.segments, to.count);
+    bool equal = false;
+    if (!current) {
+      *out_code = JSONC_ERROR_PATCH_PATH;
+    } else if (jsonc_equal(current, &value->value,
+                           JSONC_EQUAL_IGNORE_KEY_ORDER, &equal)) {
+      return true;
+    } else if (!equal) {
+      *out_code = JSONC_ERROR_PATCH_TEST;
+    }
+    return false;
+  }
+  const bool replace = !strcmp(name, "replace");
+  const jsonc_value *source = value ? &value->value : NULL;
+  if (!strcmp(name, "copy")) {
+    source = patch_resolve(patch, from.segments, from.count);
+  } else if (replace) {
+    source = patch_resolve(patch, to.segments, to.count) ? source : NULL;
+  } else if (strcmp(name, "add")) {
+    *out_code = JSONC_ERROR_PATCH_INVALID;
+    return false;
+  }
+  if (!source) {
+    *out_code = JSONC_ERROR_PATCH_PATH;
+    return false;
+  }
+  jsonc_value copy;
+  if (copy_value(source, &copy)) {
+    return true;
+  }
+  const err_t failed = replace ? patch_replace(patch, &to, copy)
+                               : patch_add(patch, &to, copy, false, out_code);
+  if (failed || *out_code != JSONC_ERROR_NONE) {
+    free_value(copy);
+  }
+  return failed;
+}
+
+// An object being merged into by a merge patch. Members that `patch`
+// removes only have their key set to NULL until the frame is left, so that
+// `index` stays valid.
+typedef struct merge_frame {
+  jsonc_value *target;
+  const jsonc_value *patch;
+  size_t next;
+  key_index index;
+  bool removed;
+} merge_frame;
+
+// Starts merging object `patch` into `target`, which becomes an empty
+// object first unless it is one.
+static err_t merge_enter(arraybuffer *stack, jsonc_value *target,
+                         const jsonc_value *patch) {
+  if (target->type != JSONC_VALUE_TYPE_OBJECT) {
+    free_value(*target);
+    *target = jsonc_object_new();
+  }
+  merge_frame frame = {.target = target, .patch = patch};
+  if (key_index_build(&frame.index, target) ||
+      arraybuffer_push(stack, &frame)) {
+    free(frame.index.slots);
+    return true;
+  }
+  return false;
+}
+
+// Closes the gaps that removed members left.
+static void merge_leave(merge_frame *frame) {
+  jsonc_value *const target = frame->target;
+  if (frame->removed) {
+    jsonc_object *const members = &target->value.object;
+    size_t kept = 0;
+    container_pin(target);
+    for (size_t i = 0; i < members->count; i++) {
+      if (members->entries[i].key) {
+        members->entries[kept++] = members->entries[i];
+      }
+    }
+    members->count = kept;
+  }
+  free(frame->index.slots);
+}
+
+// Applies one member of the frame's patch. May push a frame, after which
+// `frame` is no longer valid.
+static err_t merge_member(arraybuffer *stack, merge_frame *frame,
+                          const jsonc_object_entry *member) {
+  jsonc_value *const target = frame->target;
+  jsonc_object *const members = &target->value.object;
+  const size_t position = key_index_find(&frame->index, target, member->key);
+  if (member->value.type == JSONC_VALUE_TYPE_NULL) {
+    if (position != SIZE_MAX) {
+      free(members->entries[position].key);
+      free_value(members->entries[position].value);
+      members->entries[position].key = NULL;
+      frame->removed = true;
+    }
+    return false;
+  }
+  if (position == SIZE_MAX) {
+    if (object_append(target, member->key, jsonc_null_new()) ||
+        key_index_add(&frame->index, target)) {
+      return true;
+    }
+  }
+  jsonc_value *const slot =
+      &members->entries[position == SIZE_MAX ? members->count - 1 : position]
+           .value;
+  if (member->value.type == JSONC_VALUE_TYPE_OBJECT) {
+    return merge_enter(stack, slot, &member->value);
+  }
+  jsonc_value copy;
+  if (copy_value(&member->value, &copy)) {
+    return true;
+  }
+  free_value(*slot);
+  *slot = copy;
+  return false;
+}
+
+static err_t merge_apply(jsonc_value *target, const jsonc_value *patch) {
+  if (patch->type != JSONC_VALUE_TYPE_OBJECT) {
+    jsonc_value copy;
+    if (copy_value(patch, &copy)) {
+      return true;
+    }
+    free_value(*target);
+    *target = copy;
+    return false;
+  }
+  arraybuffer *const stack = arraybuffer_create(sizeof(merge_frame), 16);
+  if (!stack) {
+    return true;
+  }
+  err_t failed = merge_enter(stack, target, patch);
+  while (stack->length) {
+    merge_frame *const frame = arraybuffer_get(stack, stack->length - 1);
+    if (failed || frame->next == frame->patch->value.object.count) {
+      merge_leave(frame);
+      stack->length--;
+      continue;
+    }
+    failed = merge_member(
+        stack, frame, &frame->patch->value.object.entries[frame->next++]);
+  }
+  arraybuffer_destroy(stack);
+  return failed;
+}
+
+// Binary images. References inside an image are byte offsets from the
+// structure that holds them, so an image can be used wherever it is mapped.
+// Children are written after their parents, so offsets are never negative.
+struct jsonc_node {
+  uint32_t type;
+  // Elements or members of a container, or the length of a string.
+  uint32_t count;
+  // The boolean, the bits of the number, or the offset of the string or of
+  // the member block.
+  uint64_t payload;
+};
+
+// An object's member block holds its entries in source order, then a
+// uint32_t index of them sorted by key with ties in source order.
+typedef struct image_entry {
+  uint64_t key;
+  uint64_t key_length;
+  jsonc_node value;
+} image_entry;
+
+#define IMAGE_MAGIC "JSONCIMG"
+#define IMAGE_VERSION 1
+// Read back differently on a machine of the other byte order.
+#define IMAGE_BYTE_ORDER 0x01020304u
+
+typedef struct image_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t size;
+  uint64_t source_length;
+  uint64_t source_hash;
+  jsonc_node root;
+} image_header;
+
+struct jsonc_image {
+  char *data;
+  size_t size;
+  bool mapped;
+};
+
+typedef struct image_writer {
+  char *data;
+  size_t length;
+  size_t capacity;
+} image_writer;
+
+// A value waiting to be written to the node at offset `node`.
+typedef struct image_task {
+  const jsonc_value *value;
+  size_t node;
+} image_task;
+
+typedef struct image_key {
+  const char *key;
+  uint32_t index;
+} image_key;
+
+// Hash of the source an image was saved from, taken 8 bytes at a time so
+// that checking a large cache costs little next to parsing it.
+static uint64_t source_hash(const char *source, size_t length) {
+  uint64_t hash = 0xCBF29CE484222325u ^ length;
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, source + i, sizeof(word));
+    hash = hash_mix(hash ^ word);
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, source + i, length - i);
+  return hash_mix(hash ^ tail);
+}
+
+// Appends `size` zeroed bytes, padded to keep every block 8-byte aligned.
+static err_t image_alloc(image_writer *writer, size_t size,
+                         size_t *out_offset) {
+  const size_t aligned = (size + 7) & ~(size_t)7;
+  if (writer->capacity - writer->length < aligned) {
+    size_t capacity = writer->capacity ? writer->capacity : 4096;
+    while (capacity - writer->length < aligned) {
+      capacity *= 2;
+    }
+    char *const data = realloc(writer->data, capacity);
+    if (!data) {
+      return true;
+    }
+    writer->data = data;
+    writer->capacity = capacity;
+  }
+  memset(writer->data + writer->length, 0, aligned);
+  *out_offset = writer->length;
+  writer->length += aligned;
+  return false;
+}
+
+static err_t image_string(image_writer *writer, const char *string,
+                          size_t length, size_t *out_offset) {
+  if (image_alloc(writer, length + 1, out_offset)) {
+    return true;
+  }
+  memcpy(writer->data + *out_offset, string, length);
+  return false;
+}
+
+static int image_key_compare(const void *a, const void *b) {
+  const image_key *const x = a;
+  const image_key *const y = b;
+  const int order = strcmp(x->key, y->key);
+  return order ? order : (x->index > y->index) - (x->index < y->index);
+}
+
+static err_t image_write_members(image_writer *writer, arraybuffer *tasks,
+                                 const jsonc_object *object, size_t block) {
+  image_key *const keys = malloc(object->count * sizeof(image_key) + 1);
+  if (!keys) {
+    return true;
+  }
+  for (size_t i = 0; i < object->count; i++) {
+    const jsonc_object_entry *const source = &object->entries[i];
+    const size_t length = strlen(source->key);
+    const size_t entry = block + i * sizeof(image_entry);
+    size_t key;
+    const image_task task = {
+        .value = &source->value,
+        .node = entry + offsetof(image_entry, value),
+    };
+    if (image_string(writer, source->key, length, &key) ||
+        arraybuffer_push(tasks, &task)) {
+      free(keys);
+      return true;
+    }
+    image_entry *const target = (image_entry *)(writer->data + entry);
+    target->key = key - entry;
+    target->key_length = length;
+    keys[i] = (image_key){.key = source->key, .index = (uint32_t)i};
+  }
+  qsort(keys, object->count, sizeof(image_key), image_key_compare);
+  uint32_t *const index =
+      (uint32_t *)(writer->data + block + object->count * sizeof(image_entry));
+  for (size_t i = 0; i < object->count; i++) {
+    index[i] = keys[i].index;
+  }
+  free(keys);
+  return false;
+}
+
+// Writes one node, queueing its children. Strings and containers too large
+// for a node's 32-bit count set *out_too_large.
+static err_t image_write_node(image_writer *writer, arraybuffer *tasks,
+                              const image_task *task, bool *out_too_large) {
+  const jsonc_value *const value = task->value;
+  jsonc_node node = {.type = value->type};
+  switch (value->type) {
+  case JSONC_VALUE_TYPE_NULL:
+    break;
+  case JSONC_VALUE_TYPE_BOOLEAN:
+    node.payload = value->value.boolean;
+    break;
+  case JSONC_VALUE_TYPE_NUMBER:
+    memcpy(&node.payload, &value->value.number, sizeof(node.payload));
+    break;
+  case JSONC_VALUE_TYPE_STRING: {
+    size_t length;
+    const char *const string = jsonc_string_get(value, &length);
+    size_t offset;
+    if (length > UINT32_MAX) {
+      *out_too_large = true;
+      return false;
+    }
+    if (image_string(writer, string, length, &offset)) {
+      return true;
+    }
+    node.count = (uint32_t)length;
+    node.payload = offset - task->node;
+    break;
+  }
+  case JSONC_VALUE_TYPE_ARRAY:
+  case JSONC_VALUE_TYPE_OBJECT: {
+    const bool is_array = value->type == JSONC_VALUE_TYPE_ARRAY;
+    const size_t count = container_count(value);
+    size_t block;
+    if (count > UINT32_MAX) {
+      *out_too_large = true;
+      return false;
+    }
+    if (image_alloc(writer,
+                    count * (is_array ? sizeof(jsonc_node)
+                                      : sizeof(image_entry) +
+                                            sizeof(uint32_t)),
+                    &block)) {
+      return true;
+    }
+    node.count = (uint32_t)count;
+    node.payload = block - task->node;
+    if (!is_array) {
+      if (image_write_members(writer, tasks, &value->value.object, block)) {
+        return true;
+      }
+      break;
+    }
+    for (size_t i = 0; i < count; i++) {
+      const image_task child = {
+          .value = &value->value.array.values[i],
+          .node = block + i * sizeof(jsonc_node),
+      };
+      if (arraybuffer_push(tasks, &child)) {
+        return true;
+      }
+    }
+    break;
+  }
+  }
+  memcpy(writer->data + task->node, &node, sizeof(node));
+  return false;
+}
+
+// Lays out `value` as an image into writer->data, depth first with an
+// explicit stack.
+static err_t image_build(const jsonc_value *value, const char *source,
+                         image_writer *writer, bool *out_too_large) {
+  *writer = (image_writer){0};
+  *out_too_large = false;
+  arraybuffer *const tasks = arraybuffer_create(sizeof(image_task), 64);
+  size_t header;
+  if (!tasks) {
+    return true;
+  }
+  const image_task root = {
+      .value = value,
+      .node = offsetof(image_header, root),
+  };
+  err_t result = image_alloc(writer, sizeof(image_header), &header) ||
+                 arraybuffer_push(tasks, &root);
+  while (!result && !*out_too_large && tasks->length) {
+    const image_task task =
+        *(image_task *)arraybuffer_get(tasks, --tasks->length);
+    result = image_write_node(writer, tasks, &task, out_too_large);
+  }
+  arraybuffer_destroy(tasks);
+  if (result || *out_too_large) {
+    free(writer->data);
+    writer->data = NULL;
+    return result;
+  }
+  image_header *const target = (image_header *)writer->data;
+  memcpy(target->magic, IMAGE_MAGIC, sizeof(target->magic));
+  target->version = IMAGE_VERSION;
+  target->byte_order = IMAGE_BYTE_ORDER;
+  target->size = writer->length;
+  target->source_length = strlen(source);
+  target->source_hash = source_hash(source, target->source_length);
+  return false;
+}
+
+// Writes to a temporary file renamed over `path`, so that readers never see
+// a partial image.
+static bool image_save(const image_writer *writer, const char *path) {
+  char *const temporary = malloc(strlen(path) + sizeof(".tmp"));
+  if (!temporary) {
+    return false;
+  }
+  strcpy(temporary, path);
+  strcat(temporary, ".tmp");
+  FILE *const file = fopen(temporary, "wb");
+  bool saved = false;
+  if (file) {
+    saved = fwrite(writer->data, 1, writer->length, file) == writer->length;
+    saved = !fclose(file) && saved;
+    if (saved && rename(temporary, path)) {
+      // Some platforms will not rename over an existing file.
+      remove(path);
+      saved = !rename(temporary, path);
+    }
+    if (!saved) {
+      remove(temporary);
+    }
+  }
+  free(temporary);
+  return saved;
+}
+
+static void image_release(jsonc_image *image) {
+#ifdef JSONC_HAVE_MMAP
+  if (image->mapped) {
+    munmap(image->data, image->size);
+    return;
+  }
+#endif
+  free(image->data);
+}
+
+// Maps or reads the file at `path`. *out is NULL if it cannot be read.
+static err_t image_open(const char *path, jsonc_image **out) {
+  *out = NULL;
+  jsonc_image image = {0};
+#ifdef JSONC_HAVE_MMAP
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (!fstat(fd, &status) && status.st_size > 0) {
+    image.size = (size_t)status.st_size;
+    image.data = mmap(NULL, image.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    image.mapped = image.data != MAP_FAILED;
+  }
+  close(fd);
+  if (!image.mapped) {
+    return false;
+  }
+#else
+  FILE *const file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  long size = -1;
+  if (!fseek(file, 0, SEEK_END)) {
+    size = ftell(file);
+    rewind(file);
+  }
+  if (size > 0) {
+    image.size = (size_t)size;
+    image.data = malloc(image.size);
+    if (!image.data) {
+      fclose(file);
+      return true;
+    }
+    if (fread(image.data, 1, image.size, file) != image.size) {
+      free(image.data);
+      image.data = NULL;
+    }
+  }
+  fclose(file);
+  if (!image.data) {
+    return false;
+  }
+#endif
+  *out = malloc(sizeof(jsonc_image));
+  if (!*out) {
+    image_release(&image);
+    return true;
+  }
+  **out = image;
+  return false;
+}
+
+// Checks the header, and with a `source` that the image was saved from it.
+static bool image_is_current(const jsonc_image *image, const char *source) {
+  if (image->size < sizeof(image_header)) {
+    return false;
+  }
+  const image_header *const header = (const image_header *)image->data;
+  if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) ||
+      header->version != IMAGE_VERSION ||
+      header->byte_order != IMAGE_BYTE_ORDER || header->size != image->size) {
+    return false;
+  }
+  if (!source) {
+    return true;
+  }
+  const size_t length = strlen(source);
+  return header->source_length == length &&
+         header->source_hash == source_hash(source, length);
+}
+
+// Whether `count` items of `size` bytes, `offset` bytes past `at`, are inside
+// the image. Offsets point past what holds them; *out_start is where the
+// items start.
+static bool image_fits(const jsonc_image *image, size_t at, uint64_t offset,
+                       uint64_t count, size_t size, size_t *out_start) {
+  if (!offset || offset > image->size - at) {
+    return false;
+  }
+  *out_start = at + (size_t)offset;
+  return count <= (image->size - *out_start) / size;
+}
+
+// Whether the string of `length` bytes that `offset` bytes past `at` leads to
+// is inside the image and NUL-terminated.
+static bool image_string_fits(const jsonc_image *image, size_t at,
+                              uint64_t offset, uint64_t length) {
+  size_t start;
+  return length < image->size &&
+         image_fits(image, at, offset, length + 1, 1, &start) &&
+         !image->data[start + length];
+}
+
+// Checks every node of a current image, so that a damaged file, or another
+// with a valid header, cannot make the node functions read past its end:
+// each string, block and key must be inside the image and each entry of a
+// sorted index must name a member. An image holds at most one node for
+// each node-sized block, so a walk that would visit more, through blocks
+// shared between nodes, rejects the image instead.
+static err_t image_check(const jsonc_image *image, bool *out_valid) {
+  arraybuffer *const stack = arraybuffer_create(sizeof(size_t), 64);
+  if (!stack) {
+    return true;
+  }
+  size_t budget = image->size / sizeof(jsonc_node) - 1;
+  const size_t root = offsetof(image_header, root);
+  err_t result = arraybuffer_push(stack, &root);
+  bool valid = true;
+  while (!result && valid && stack->length) {
+    const size_t at = *(size_t *)arraybuffer_get(stack, --stack->length);
+    const jsonc_node *const node = (const jsonc_node *)(image->data + at);
+    const bool is_array = node->type == JSONC_VALUE_TYPE_ARRAY;
+    size_t block;
+    if (node->type == JSONC_VALUE_TYPE_STRING) {
+      valid = image_string_fits(image, at, node->payload, node->count);
+      continue;
+    }
+    if (!is_array && node->type != JSONC_VALUE_TYPE_OBJECT) {
+      valid = node->type <= JSONC_VALUE_TYPE_NUMBER;
+      continue;
+    }
+    valid = node->count <= budget &&
+            image_fits(image, at, node->payload, node->count,
+                       is_array ? sizeof(jsonc_node)
+                                : sizeof(image_entry) + sizeof(uint32_t),
+                       &block) &&
+            block % 8 == 0;
+    if (!valid) {
+      continue;
+    }
+    budget -= node->count;
+    const uint32_t *const sorted =
+        (const uint32_t *)(image->data + block +
+                           node->count * sizeof(image_entry));
+    for (size_t i = 0; i < node->count && valid && !result; i++) {
+      size_t child = block + i * sizeof(jsonc_node);
+      if (!is_array) {
+        const size_t entry = block + i * sizeof(image_entry);
+        const image_entry *const member =
+            (const image_entry *)(image->data + entry);
+        valid = image_string_fits(image, entry, member->key,
+                                  member->key_length) &&
+                sorted[i] < node->count;
+        child = entry + offsetof(image_entry, value);
+      }
+      result = arraybuffer_push(stack, &child);
+    }
+  }
+  arraybuffer_destroy(stack);
+  *out_valid = valid;
+  return result;
+}
+
+static const schema_node schema_node_empty = {
+    .max_length = SIZE_MAX,
+    .items = SCHEMA_ANY,
+    .additional = SCHEMA_ANY,
+};
+
+// A schema object waiting to be compiled into `node`.
+typedef struct schema_task {
+  const jsonc_value *source;
+  size_t node;
+} schema_task;
+
+typedef struct schema_builder {
+  arraybuffer *nodes;
+  arraybuffer *properties;
+  arraybuffer *enums;
+  arraybuffer *tasks;
+} schema_builder;
+
+static void schema_builder_destroy(schema_builder *builder) {
+  if (builder->nodes) {
+    arraybuffer_destroy(builder->nodes);
+  }
+  if (builder->properties) {
+    for (size_t i = 0; i < builder->properties->length; i++) {
+      free(((schema_property *)arraybuffer_get(builder->properties, i))->key);
+    }
+    arraybuffer_destroy(builder->properties);
+  }
+  if (builder->enums) {
+    for (size_t i = 0; i < builder->enums->length; i++) {
+      free_value(*(jsonc_value *)arraybuffer_get(builder->enums, i));
+    }
+    arraybuffer_destroy(builder->enums);
+  }
+  if (builder->tasks) {
+    arraybuffer_destroy(builder->tasks);
+  }
+}
+
+// Hands over the elements of `buffer` and frees the buffer itself.
+static void *schema_builder_take(arraybuffer **buffer, size_t *out_count) {
+  void *const data = (*buffer)->data;
+  *out_count = (*buffer)->length;
+  free(*buffer);
+  *buffer = NULL;
+  return data;
+}
+
+// Allocates the node for a subschema and queues it if it is an object. The
+// schema `true` needs no node.
+static err_t schema_add(schema_builder *builder, const jsonc_value *source,
+                        size_t *out_index, bool *out_malformed) {
+  if (source->type == JSONC_VALUE_TYPE_BOOLEAN && source->value.boolean) {
+    *out_index = SCHEMA_ANY;
+    return false;
+  }
+  if (source->type != JSONC_VALUE_TYPE_BOOLEAN &&
+      source->type != JSONC_VALUE_TYPE_OBJECT) {
+    *out_malformed = true;
+    return false;
+  }
+  schema_node node = schema_node_empty;
+  if (source->type == JSONC_VALUE_TYPE_BOOLEAN) {
+    node.flags = SCHEMA_FALSE;
+  }
+  *out_index = builder->nodes->length;
+  if (arraybuffer_push(builder->nodes, &node)) {
+    return true;
+  }
+  const schema_task task = {.source = source, .node = *out_index};
+  return source->type == JSONC_VALUE_TYPE_OBJECT &&
+         arraybuffer_push(builder->tasks, &task);
+}
+
+// Adds the type named by `name` to `types`. The names are listed in the
+// order of jsonc_value_type, followed by "integer" for SCHEMA_TYPE_INTEGER.
+static bool schema_add_type(const jsonc_value *name, unsigned *types) {
+  static const char *const names[] = {
+      "null", "boolean", "number", "string", "array", "object", "integer",
+  };
+  if (name->type != JSONC_VALUE_TYPE_STRING) {
+    return false;
+  }
+  for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (!strcmp(string_data(name), names[i])) {
+      *types |= 1u << i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static err_t schema_add_property(schema_builder *builder, const char *key,
+                                 size_t node, bool required) {
+  const schema_property property = {
+      .key = util_strdup(key),
+      .node = node,
+      .required = required,
+  };
+  if (!property.key) {
+    return true;
+  }
+  if (arraybuffer_push(builder->properties, &property)) {
+    free(property.key);
+    return true;
+  }
+  return false;
+}
+
+static err_t schema_compile_types(const jsonc_value *value, unsigned *types,
+                                  bool *out_malformed) {
+  if (value->type != JSONC_VALUE_TYPE_ARRAY) {
+    *out_malformed = !schema_add_type(value, types);
+    return false;
+  }
+  for (size_t i = 0; i < value->value.array.count && !*out_malformed; i++) {
+    *out_malformed = !schema_add_type(&value->value.array.values[i], types);
+  }
+  return false;
+}
+
+static err_t schema_compile_properties(schema_builder *builder,
+                                       const jsonc_value *value,
+                                       schema_node *node,
+                                       bool *out_malformed) {
+  if (value->type != JSONC_VALUE_TYPE_OBJECT) {
+    *out_malformed = true;
+    return false;
+  }
+  for (size_t i = 0; i < value->value.object.count && !*out_malformed; i++) {
+    const jsonc_object_entry *const entry = &value->value.object.entries[i];
+    size_t child;
+    if (schema_add(builder, &entry->value, &child, out_malformed) ||
+        schema_add_property(builder, entry->key, child, false)) {
+      return true;
+    }
+    node->property_count++;
+  }
+  return false;
+}
+
+// Marks the required properties, adding those that `properties` left out.
+static err_t schema_compile_required(schema_builder *builder,
+                                     const jsonc_value *value,
+                                     schema_node *node, bool *out_malformed) {
+  if (value->type != JSONC_VALUE_TYPE_ARRAY) {
+    *out_malformed = true;
+    return false;
+  }
+  for (size_t i = 0; i < value->value.array.count; i++) {
+    const jsonc_value *const name = &value->value.array.values[i];
+    if (name->type != JSONC_VALUE_TYPE_STRING) {
+      *out_malformed = true;
+      return false;
+    }
+    size_t j = 0;
+    for (; j < node->property_count; j++) {
+      schema_property *const property =
+          arraybuffer_get(builder->properties, node->properties + j);
+      if (!strcmp(property->key, string_data(name))) {
+        property->required = true;
+        break;
+      }
+    }
+    if (j == node->property_count) {
+      if (schema_add_property(builder, string_data(name), SCHEMA_ANY,
+                              true)) {
+        return true;
+      }
+      node->property_count++;
+    }
+  }
+  return false;
+}
+
+static err_t schema_compile_enum(schema_builder *builder,
+                                 const jsonc_value *value, schema_node *node,
+                                 bool *out_malformed) {
+  if (value->type != JSONC_VALUE_TYPE_ARRAY) {
+    *out_malformed = true;
+    return false;
+  }
+  for (size_t i = 0; i < value->value.array.count; i++) {
+    const jsonc_value *const member = &value->value.array.values[i];
+    if (is_container(member)) {
+      *out_malformed = true;
+      return false;
+    }
+    jsonc_value copy;
+    if (copy_value(member, &copy)) {
+      return true;
+    }
+    if (arraybuffer_push(builder->enums, &copy)) {
+      free_value(copy);
+      return true;
+    }
+    node->enum_count++;
+  }
+  return false;
+}
+
+static bool schema_number(const jsonc_value *value, double *out) {
+  if (value->type != JSONC_VALUE_TYPE_NUMBER) {
+    return false;
+  }
+  *out = value->value.number;
+  return true;
+}
+
+static err_t schema_compile_node(schema_builder *builder,
+                                 const schema_task *task,
+                                 bool *out_malformed) {
+  schema_node node = schema_node_empty;
+  node.properties = builder->properties->length;
+  node.enums = builder->enums->length;
+  const jsonc_value *required = NULL;
+  const jsonc_object *const object = &task->source->value.object;
+  for (size_t i = 0; i < object->count && !*out_malformed; i++) {
+    const char *const key = object->entries[i].key;
+    const jsonc_value *const value = &object->entries[i].value;
+    err_t result = false;
+    if (!strcmp(key, "type")) {
+      result = schema_compile_types(value, &node.types, out_malformed);
+    } else if (!strcmp(key, "properties")) {
+      result =
+          schema_compile_properties(builder, value, &node, out_malformed);
+    } else if (!strcmp(key, "required")) {
+      required = value;
+    } else if (!strcmp(key, "items")) {
+      result = schema_add(builder, value, &node.items, out_malformed);
+    } else if (!strcmp(key, "additionalProperties")) {
+      result = schema_add(builder, value, &node.additional, out_malformed);
+    } else if (!strcmp(key, "enum")) {
+      result = schema_compile_enum(builder, value, &node, out_malformed);
+    } else if (!strcmp(key, "minimum")) {
+      *out_malformed = !schema_number(value, &node.minimum);
+      node.flags |= SCHEMA_HAS_MINIMUM;
+    } else if (!strcmp(key, "maximum")) {
+      *out_malformed = !schema_number(value, &node.maximum);
+      node.flags |= SCHEMA_HAS_MAXIMUM;
+    } else if (!strcmp(key, "maxLength")) {
+      double length;
+      *out_malformed = !schema_number(value, &length) || length < 0 ||
+                       !is_integral(length);
+      // Lengths no string can reach are the same as no limit.
+      node.max_length = length < 0x1p53 ? (size_t)length : SIZE_MAX;
+    }
+    if (result) {
+      return true;
+    }
+  }
+  if (required && !*out_malformed &&
+      schema_compile_required(builder, required, &node, out_malformed)) {
+    return true;
+  }
+  *(schema_node *)arraybuffer_get(builder->nodes, task->node) = node;
+  return false;
+}
+
+// State behind the public pull API. The string of the last event points
+// into the lexer's string buffer and stays there until the next call.
+struct jsonc_reader {
+  reader reader;
+  jsonc_parse_options options;
+  jsonc_error error;
+  const char *source;
+};
+
+static void reader_publish(const event *current, jsonc_event *out) {
+  out->type = current->type;
+  out->offset = current->offset;
+  switch (current->type) {
+  case JSONC_EVENT_BOOLEAN:
+    out->value.boolean = current->value.boolean;
+    break;
+  case JSONC_EVENT_NUMBER:
+    out->value.number = current->value.number;
+    break;
+  case JSONC_EVENT_STRING:
+  case JSONC_EVENT_KEY:
+    out->value.string.data = current->value.string.data;
+    out->value.string.length = current->value.string.length;
+    break;
+  default:
+    break;
+  }
+}
+
+// Parses a whole document, recording container spans if `spans` is given.
+// `scratch` may be NULL. With a `feed`, `source` is where the text starts
+// arriving, and none of it is available yet. The source map in `options`, if
+// any, is left empty unless the parse succeeds.
+static err_t parse_source(const char *source, lexer_feed *feed,
+                          const jsonc_parse_options *options,
+                          parse_scratch *scratch, arraybuffer *spans,
+                          jsonc_value *out, jsonc_error *out_error) {
+  *out_error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  if (options->source_map) {
+    source_map_clear(options->source_map);
+  }
+  reader reader;
+  if (reader_init(&reader, source, options, scratch, out_error)) {
+    return true;
+  }
+  if (feed) {
+    reader.lexer.feed = feed;
+    reader.lexer.available = 0;
+    reader.lexer.limit = 0;
+  }
+  err_t result = true;
+  event current;
+  jsonc_value value;
+  if (reader_next(&reader, &current) ||
+      build_value(&reader, &current, options->intern, spans,
+                  options->source_map, &value)) {
+    goto cleanup;
+  }
+  if (out_error->code == JSONC_ERROR_NONE) {
+    if (reader_next(&reader, &current)) {
+      release_value(value, options->intern);
+      goto cleanup;
+    }
+    if (out_error->code != JSONC_ERROR_NONE) {
+      release_value(value, options->intern);
+    } else {
+      *out = value;
+    }
+  }
+  result = false;
+
+cleanup:
+  reader_destroy(&reader);
+  if (!result && out_error->code != JSONC_ERROR_NONE) {
+    locate_error(reader.lexer.source, out_error);
+  }
+  if (options->source_map &&
+      (result || out_error->code != JSONC_ERROR_NONE)) {
+    source_map_clear(options->source_map);
+  }
+  return result;
+}
+
+// State behind jsonc_document. `root` and `spans` describe `source` only
+// while error.code is JSONC_ERROR_NONE.
+struct jsonc_document {
+  char *source;
+  size_t length;
+  size_t capacity;
+  jsonc_parse_options options;
+  jsonc_error error;
+  jsonc_value root;
+  arraybuffer *spans;
+};
+
+// Given spans[0].value, points the other `count` - 1 spans at their
+// containers, which open in the same order as the spans are stored.
+static void spans_attach(container_span *spans, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const jsonc_value *const value = spans[i].value;
+    const bool is_array = value->type == JSONC_VALUE_TYPE_ARRAY;
+    size_t child = i + 1;
+    for (size_t j = 0; j < container_count(value); j++) {
+      jsonc_value *const member = is_array
+                                      ? &value->value.array.values[j]
+                                      : &value->value.object.entries[j].value;
+      if (is_container(member)) {
+        spans[child].value = member;
+        child += spans[child].descendants + 1;
+      }
+    }
+  }
+}
+
+// Index of the innermost container whose brackets enclose the bytes from
+// `start` to `end`, or SIZE_MAX. *out_depth is the number of containers
+// around it.
+static size_t spans_find(const container_span *spans, size_t count,
+                         size_t start, size_t end, size_t *out_depth) {
+  *out_depth = 0;
+  if (!count || spans[0].start >= start || spans[0].end < end) {
+    return SIZE_MAX;
+  }
+  size_t index = 0;
+  for (;;) {
+    const size_t stop = index + 1 + spans[index].descendants;
+    size_t child = index + 1;
+    while (child < stop && spans[child].start < start &&
+           spans[child].end < end) {
+      child += spans[child].descendants + 1;
+    }
+    if (child == stop || spans[child].start >= start) {
+      return index;
+    }
+    index = child;
+    (*out_depth)++;
+  }
+}
+
+static void document_splice(jsonc_document *document, size_t offset,
+                            size_t removed, const char *inserted,
+                            size_t inserted_length) {
+  char *const at = document->source + offset;
+  memmove(at + inserted_length, at + removed,
+          document->length - offset - removed + 1);
+  memcpy(at, inserted, inserted_length);
+  document->length = document->length - removed + inserted_length;
+}
+
+// Parses the whole text again.
+static err_t document_reparse(jsonc_document *document) {
+  arraybuffer *const spans = arraybuffer_create(sizeof(container_span), 16);
+  if (!spans) {
+    return true;
+  }
+  jsonc_value root;
+  jsonc_error error;
+  if (parse_source(document->source, NULL, &document->options, NULL, spans,
+                   &root, &error)) {
+    arraybuffer_destroy(spans);
+    return true;
+  }
+  if (document->error.code == JSONC_ERROR_NONE) {
+    release_value(document->root, document->options.intern);
+  }
+  arraybuffer_destroy(document->spans);
+  document->spans = spans;
+  document->error = error;
+  if (error.code == JSONC_ERROR_NONE) {
+    document->root = root;
+    if (spans->length) {
+      container_span *const first = spans->data;
+      first->value = &document->root;
+      spans_attach(first, spans->length);
+    }
+  }
+  return false;
+}
+
+// Replaces `count` spans at `index` with `fresh`, whose offsets are relative
+// to `base`, and moves the spans that follow by `inserted` - `removed`.
+static err_t spans_replace(arraybuffer *spans, size_t index, size_t count,
+                           const arraybuffer *fresh, size_t base,
+                           size_t removed, size_t inserted) {
+  const size_t length = spans->length;
+  const size_t new_length = length - count + fresh->length;
+  const container_span filler = {0};
+  while (spans->length < new_length) {
+    if (arraybuffer_push(spans, &filler)) {
+      spans->length = length;
+      return true;
+    }
+  }
+  container_span *const all = spans->data;
+  memmove(all + index + fresh->length, all + index + count,
+          (length - index - count) * sizeof(container_span));
+  spans->length = new_length;
+  for (size_t i = index + fresh->length; i < new_length; i++) {
+    all[i].start = all[i].start - removed + inserted;
+    all[i].end = all[i].end - removed + inserted;
+  }
+  // The containers around `index` grow by the same amount.
+  for (size_t i = 0; i != index;) {
+    all[i].end = all[i].end - removed + inserted;
+    all[i].descendants = all[i].descendants - count + fresh->length;
+    size_t child = i + 1;
+    while (child + all[child].descendants < index) {
+      child += all[child].descendants + 1;
+    }
+    i = child;
+  }
+  const container_span *const added = fresh->data;
+  for (size_t i = 0; i < fresh->length; i++) {
+    all[index + i] = added[i];
+    all[index + i].start += base;
+    all[index + i].end += base;
+  }
+  return false;
+}
+
+// Brings the tree up to date after `removed` bytes at `offset` were replaced
+// by `inserted` bytes. Only the innermost container enclosing the edit is
+// parsed again: its opening bracket is untouched, and the tokenizer is in
+// its initial state at any bracket, so reading can start there. If the new
+// text of the container is a valid value that still ends at its old closing
+// bracket, everything outside it reads exactly as before; otherwise the
+// whole text is parsed.
+static err_t document_update(jsonc_document *document, size_t offset,
+                             size_t removed, size_t inserted) {
+  const jsonc_parse_options *const options = &document->options;
+  size_t depth;
+  const size_t index =
+      document->error.code != JSONC_ERROR_NONE || options->schema ||
+              (options->max_document_size &&
+               document->length > options->max_document_size)
+          ? SIZE_MAX
+          : spans_find(document->spans->data, document->spans->length,
+                       offset, offset + removed, &depth);
+  if (index == SIZE_MAX) {
+    return document_reparse(document);
+  }
+  const container_span target =
+      *(container_span *)arraybuffer_get(document->spans, index);
+  jsonc_parse_options limited = *options;
+  if (limited.max_depth) {
+    limited.max_depth -= depth;
+  }
+  arraybuffer *const fresh = arraybuffer_create(sizeof(container_span), 16);
+  if (!fresh) {
+    return true;
+  }
+  err_t result = true;
+  jsonc_error error = {.code = JSONC_ERROR_NONE};
+  jsonc_value value;
+  reader reader;
+  if (reader_init(&reader, document->source + target.start, &limited, NULL,
+                  &error)) {
+    goto cleanup;
+  }
+  event first;
+  const err_t failed = reader_next(&reader, &first) ||
+                       build_value(&reader, &first, limited.intern, fresh,
+                                   NULL, &value);
+  reader_destroy(&reader);
+  if (failed) {
+    goto cleanup;
+  }
+  if (error.code != JSONC_ERROR_NONE ||
+      target.start + ((container_span *)fresh->data)->end !=
+          target.end - removed + inserted) {
+    if (error.code == JSONC_ERROR_NONE) {
+      release_value(value, limited.intern);
+    }
+    result = document_reparse(document);
+    goto cleanup;
+  }
+  if (spans_replace(document->spans, index, target.descendants + 1, fresh,
+                    target.start, removed, inserted)) {
+    release_value(value, limited.intern);
+    goto cleanup;
+  }
+  release_value(*target.value, limited.intern);
+  *target.value = value;
+  container_span *const updated = arraybuffer_get(document->spans, index);
+  updated->value = target.value;
+  spans_attach(updated, fresh->length);
+  result = false;
+
+cleanup:
+  arraybuffer_destroy(fresh);
+  return result;
+}
+
+struct jsonc_parser {
+  parse_scratch scratch;
+  size_t max_retained;
+};
+
+// Sequentially consistent atomics for jsonc_snapshot and jsonc_shared, from
+// the compiler's builtins or else from C11. The fields they act on have the
+// types atomic_size and atomic_pointer, which C11 requires to be _Atomic.
+#if defined(__GNUC__) || defined(__clang__)
+
+typedef size_t atomic_size;
+typedef void *atomic_pointer;
+
+static inline size_t atomic_load_size(size_t *p) {
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_store_size(size_t *p, size_t value) {
+  __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+// Returns the new value.
+static inline size_t atomic_add_size(size_t *p, size_t value) {
+  return __atomic_add_fetch(p, value, __ATOMIC_SEQ_CST);
+}
+
+static inline void *atomic_load_pointer(void **p) {
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void *atomic_exchange_pointer(void **p, void *value) {
+  return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+#elif defined(_MSC_VER)
+
+typedef size_t atomic_size;
+typedef void *atomic_pointer;
+
+#ifdef _WIN64
+#define JSONC_INTERLOCKED(name) name##64
+typedef __int64 interlocked_size;
+#else
+#define JSONC_INTERLOCKED(name) name
+typedef long interlocked_size;
+#endif
+
+static inline size_t atomic_load_size(size_t *p) {
+  return (size_t)JSONC_INTERLOCKED(_InterlockedCompareExchange)(
+      (volatile interlocked_size *)p, 0, 0);
+}
+
+static inline void atomic_store_size(size_t *p, size_t value) {
+  (void)JSONC_INTERLOCKED(_InterlockedExchange)(
+      (volatile interlocked_size *)p, (interlocked_size)value);
+}
+
+static inline size_t atomic_add_size(size_t *p, size_t value) {
+  return (size_t)JSONC_INTERLOCKED(_InterlockedExchangeAdd)(
+             (volatile interlocked_size *)p, (interlocked_size)value) +
+         value;
+}
+
+static inline void *atomic_load_pointer(void **p) {
+  return _InterlockedCompareExchangePointer((void *volatile *)p, NULL, NULL);
+}
+
+static inline void *atomic_exchange_pointer(void **p, void *value) {
+  return _InterlockedExchangePointer((void *volatile *)p, value);
+}
+
+#elif defined(JSONC_HAVE_STDATOMIC)
+
+typedef _Atomic size_t atomic_size;
+typedef _Atomic(void *) atomic_pointer;
+
+static inline size_t atomic_load_size(atomic_size *p) {
+  return atomic_load(p);
+}
+
+static inline void atomic_store_size(atomic_size *p, size_t value) {
+  atomic_store(p, value);
+}
+
+static inline size_t atomic_add_size(atomic_size *p, size_t value) {
+  return atomic_fetch_add(p, value) + value;
+}
+
+static inline void *atomic_load_pointer(atomic_pointer *p) {
+  return atomic_load(p);
+}
+
+static inline void *atomic_exchange_pointer(atomic_pointer *p, void *value) {
+  return atomic_exchange(p, value);
+}
+
+#else
+#error "jsonc needs GCC or Clang builtins, MSVC intrinsics or C11 atomics"
+#endif
+
+struct jsonc_shared {
+  atomic_size references;
+  jsonc_value root;
+};
+
+// The snapshot epoch a reader entered at, or 0 while it is not reading.
+// Each sits on a cache line of its own so that readers do not contend.
+typedef struct snapshot_slot {
+  atomic_size epoch;
+  char padding[64 - sizeof(atomic_size)];
+} snapshot_slot;
+
+// A tree that was replaced when the epoch became `epoch`. Only readers that
+// entered before that can still be using it.
+typedef struct snapshot_retired {
+  jsonc_shared *shared;
+  size_t epoch;
+} snapshot_retired;
+
+// Epoch-based reclamation: a reader records the epoch, then loads `current`.
+// A publish swaps `current`, then advances the epoch, so a reader that
+// recorded the new epoch or later cannot have loaded the old tree.
+struct jsonc_snapshot {
+  atomic_pointer current;
+  atomic_size epoch;
+  arraybuffer *retired;
+  size_t reader_count;
+  snapshot_slot *slots;
+};
+
+// Source text read from a FILE in blocks by a second thread while the parse
+// runs on what has arrived. Without threads the whole file is read first.
+#define FILE_BLOCK_SIZE (256 * 1024)
+
+typedef struct file_source {
+  lexer_feed feed;
+  FILE *file;
+  // `data` always has room for a NUL after `length` bytes; one is stored
+  // there once `done` is set.
+  char *data;
+  size_t length;
+  size_t capacity;
+  bool done;
+  bool read_failed;
+  bool out_of_memory;
+  // `data` may only be moved while the parse is waiting for more of it.
+  bool waiting;
+  // Set once the parse needs no more data.
+  bool stopped;
+  // Whether the data is read by a thread of its own, under the lock.
+  bool threaded;
+#ifdef JSONC_HAVE_PTHREAD
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+#endif
+} file_source;
+
+static void file_source_lock(file_source *source) {
+#ifdef JSONC_HAVE_PTHREAD
+  if (source->threaded) {
+    pthread_mutex_lock(&source->mutex);
+  }
+#else
+  (void)source;
+#endif
+}
+
+static void file_source_unlock(file_source *source) {
+#ifdef JSONC_HAVE_PTHREAD
+  if (source->threaded) {
+    pthread_mutex_unlock(&source->mutex);
+  }
+#else
+  (void)source;
+#endif
+}
+
+// Called with the lock held.
+static void file_source_wait_change(file_source *source) {
+#ifdef JSONC_HAVE_PTHREAD
+  if (source->threaded) {
+    pthread_cond_wait(&source->changed, &source->mutex);
+  }
+#else
+  (void)source;
+#endif
+}
+
+static void file_source_signal(file_source *source) {
+#ifdef JSONC_HAVE_PTHREAD
+  if (source->threaded) {
+    pthread_cond_broadcast(&source->changed);
+  }
+#else
+  (void)source;
+#endif
+}
+
+// Bytes left in `file` if it can seek, as a hint for the buffer size, or 0.
+// Some systems put the end of a directory at LONG_MAX, which is no size.
+static size_t file_remaining(FILE *file) {
+  const long start = ftell(file);
+  if (start < 0 || fseek(file, 0, SEEK_END)) {
+    return 0;
+  }
+  const long end = ftell(file);
+  if (fseek(file, start, SEEK_SET) || end == LONG_MAX) {
+    return 0;
+  }
+  return end > start ? (size_t)(end - start) : 0;
+}
+
+static void *file_source_read(void *argument) {
+  file_source *const source = argument;
+  file_source_lock(source);
+  while (!source->stopped) {
+    if (source->length + 1 == source->capacity) {
+      while (!source->waiting && !source->stopped) {
+        file_source_wait_change(source);
+      }
+      if (source->stopped) {
+        break;
+      }
+      char *const data = realloc(source->data, source->capacity * 2);
+      if (!data) {
+        source->out_of_memory = true;
+        break;
+      }
+      source->data = data;
+      source->capacity *= 2;
+    }
+    size_t size = source->capacity - source->length - 1;
+    if (size > FILE_BLOCK_SIZE) {
+      size = FILE_BLOCK_SIZE;
+    }
+    char *const block = source->data + source->length;
+    file_source_unlock(source);
+    const size_t count = fread(block, 1, size, source->file);
+    file_source_lock(source);
+    source->length += count;
+    if (count < size) {
+      source->read_failed = ferror(source->file) != 0;
+      break;
+    }
+    file_source_signal(source);
+  }
+  source->data[source->length] = '\0';
+  source->done = true;
+  file_source_signal(source);
+  file_source_unlock(source);
+  return NULL;
+}
+
+static err_t file_source_wait(lexer_feed *feed, const char **out_source,
+                              size_t *available) {
+  file_source *const source = (file_source *)feed;
+  file_source_lock(source);
+  source->waiting = true;
+  file_source_signal(source);
+  while (!source->done && source->length <= *available) {
+    file_source_wait_change(source);
+  }
+  source->waiting = false;
+  *out_source = source->data;
+  *available = source->done ? source->length + 1 : source->length;
+  const err_t result = source->out_of_memory;
+  file_source_unlock(source);
+  return result;
+}
+
+typedef struct file_job {
+  FILE *file;
+  jsonc_parse_options options;
+  bool has_options;
+  jsonc_file_callback callback;
+  void *context;
+} file_job;
+
+static void *file_job_run(void *argument) {
+  file_job *const job = argument;
+  jsonc_value value = {.type = JSONC_VALUE_TYPE_NULL};
+  jsonc_error error;
+  const err_t failed = jsonc_parse_file(
+      job->file, job->has_options ? &job->options : NULL, &value, &error);
+  job->callback(job->context, failed, value, &error);
+  free(job);
+  return NULL;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+err_t jsonc_parse_ex(const char *source, const jsonc_parse_options *options,
+                     jsonc_value *out, jsonc_error *out_error) {
+  static const jsonc_parse_options unlimited = {0};
+  return parse_source(source, NULL, options ? options : &unlimited, NULL,
+                      NULL, out, out_error);
+}
+
+err_t jsonc_parse(const char *source, jsonc_value *out, bool *out_is_error) {
+  jsonc_error error;
+  if (jsonc_parse_ex(source, NULL, out, &error)) {
+    return true;
+  }
+  *out_is_error = error.code != JSONC_ERROR_NONE;
+  return false;
+}
+
+void jsonc_free(jsonc_value value) { free_value(value); }
+
+err_t jsonc_parser_create(size_t max_retained, jsonc_parser **out) {
+  jsonc_parser *const parser = malloc(sizeof(jsonc_parser));
+  if (!parser) {
+    return true;
+  }
+  if (scratch_init(&parser->scratch)) {
+    free(parser);
+    return true;
+  }
+  parser->max_retained = max_retained;
+  *out = parser;
+  return false;
+}
+
+void jsonc_parser_free(jsonc_parser *parser) {
+  scratch_destroy(&parser->scratch);
+  free(parser);
+}
+
+size_t jsonc_parser_retained(const jsonc_parser *parser) {
+  const parse_scratch *const scratch = &parser->scratch;
+  arraybuffer *const buffers[] = {scratch->tokens, scratch->strings,
+                                  scratch->frames, scratch->builds,
+                                  scratch->values, scratch->entries};
+  size_t bytes = 0;
+  for (size_t i = 0; i < sizeof(buffers) / sizeof(*buffers); i++) {
+    bytes += buffers[i]->capacity * buffers[i]->element_size;
+  }
+  return bytes;
+}
+
+err_t jsonc_parser_parse(jsonc_parser *parser, const char *source,
+                         const jsonc_parse_options *options, jsonc_value *out,
+                         jsonc_error *out_error) {
+  static const jsonc_parse_options unlimited = {0};
+  const err_t result =
+      parse_source(source, NULL, options ? options : &unlimited,
+                   &parser->scratch, NULL, out, out_error);
+  if (parser->max_retained) {
+    scratch_trim(&parser->scratch, parser->max_retained);
+  }
+  return result;
+}
+
+err_t jsonc_parse_file(FILE *file, const jsonc_parse_options *options,
+                       jsonc_value *out, jsonc_error *out_error) {
+  static const jsonc_parse_options unlimited = {0};
+  file_source source = {.feed = {file_source_wait}, .file = file};
+  // Room for the whole file, the NUL and the read that finds the end. The
+  // hint is dropped if it cannot be had.
+  source.capacity = file_remaining(file) + 2;
+  source.data = source.capacity > 4096 ? malloc(source.capacity) : NULL;
+  if (!source.data) {
+    source.capacity = 4096;
+    source.data = malloc(source.capacity);
+    if (!source.data) {
+      return true;
+    }
+  }
+#ifdef JSONC_HAVE_PTHREAD
+  pthread_t thread;
+  if (!pthread_mutex_init(&source.mutex, NULL)) {
+    if (!pthread_cond_init(&source.changed, NULL)) {
+      source.threaded = true;
+      if (pthread_create(&thread, NULL, file_source_read, &source)) {
+        source.threaded = false;
+        pthread_cond_destroy(&source.changed);
+      }
+    }
+    if (!source.threaded) {
+      pthread_mutex_destroy(&source.mutex);
+    }
+  }
+#endif
+  if (!source.threaded) {
+    // Nothing parses yet, so the reader is free to grow the buffer.
+    source.waiting = true;
+    file_source_read(&source);
+    source.waiting = false;
+  }
+  jsonc_value value;
+  err_t result =
+      parse_source(source.data, &source.feed, options ? options : &unlimited,
+                   NULL, NULL, &value, out_error);
+#ifdef JSONC_HAVE_PTHREAD
+  if (source.threaded) {
+    file_source_lock(&source);
+    source.stopped = true;
+    file_source_signal(&source);
+    file_source_unlock(&source);
+    pthread_join(thread, NULL);
+    pthread_cond_destroy(&source.changed);
+    pthread_mutex_destroy(&source.mutex);
+  }
+#endif
+  if (!result && source.read_failed) {
+    if (out_error->code == JSONC_ERROR_NONE) {
+      release_value(value, options ? options->intern : NULL);
+    }
+    if (options && options->source_map) {
+      source_map_clear(options->source_map);
+    }
+    *out_error = (jsonc_error){.code = JSONC_ERROR_READ,
+                               .offset = source.length};
+    locate_error(source.data, out_error);
+  } else if (!result && out_error->code == JSONC_ERROR_NONE) {
+    *out = value;
+  }
+  free(source.data);
+  return result;
+}
+
+err_t jsonc_parse_file_async(FILE *file, const jsonc_parse_options *options,
+                             jsonc_file_callback callback, void *context) {
+  file_job *const job = malloc(sizeof(file_job));
+  if (!job) {
+    return true;
+  }
+  *job = (file_job){.file = file, .callback = callback, .context = context};
+  if (options) {
+    job->options = *options;
+    job->has_options = true;
+  }
+#ifdef JSONC_HAVE_PTHREAD
+  pthread_attr_t attributes;
+  pthread_t thread;
+  if (!pthread_attr_init(&attributes)) {
+    const bool started =
+        !pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED) &&
+        !pthread_create(&thread, &attributes, file_job_run, job);
+    pthread_attr_destroy(&attributes);
+    if (started) {
+      return false;
+    }
+  }
+#endif
+  file_job_run(job);
+  return false;
+}
+
+void jsonc_strip(const char *source, size_t length, unsigned flags, char *out,
+                 size_t *out_length, jsonc_error *out_error) {
+  stripper strip = {.source = source,
+                    .length = length,
+                    .out = out,
+                    .flags = flags,
+                    .comma = SIZE_MAX,
+                    .line = 1};
+  const unsigned stops = flags & JSONC_STRIP_TRAILING_COMMAS ? 3 : 1;
+  *out_error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  while (strip.read < length) {
+    // Runs are copied whole; after a comma only whitespace is, since the
+    // next byte of anything else decides whether it trails.
+    size_t end = strip.read;
+    if (strip.comma == SIZE_MAX) {
+      while (end < length &&
+             !(strip_stops[(unsigned char)source[end]] & stops)) {
+        end++;
+      }
+    } else {
+      while (end < length && is_strip_space(source[end])) {
+        end++;
+      }
+    }
+    strip_keep(&strip, end - strip.read);
+    if (end == length) {
+      break;
+    }
+    const char c = source[end];
+    const char next = end + 1 < length ? source[end + 1] : '\0';
+    if (c == '/' && (next == '/' || next == '*')) {
+      strip_count_lines(&strip);
+      const size_t line = strip.line;
+      const size_t column = end - strip.line_start + 1;
+      if (!strip_comment(&strip)) {
+        *out_error = (jsonc_error){.code = JSONC_ERROR_UNTERMINATED_COMMENT,
+                                   .offset = end,
+                                   .line = line,
+                                   .column = column};
+        return;
+      }
+      continue;
+    }
+    strip_significant(&strip, c);
+    if (c == '"') {
+      strip_string(&strip);
+    } else {
+      if (c == ',' && (flags & JSONC_STRIP_TRAILING_COMMAS)) {
+        strip.comma = strip.written;
+      }
+      strip_keep(&strip, 1);
+    }
+  }
+  strip_move(&strip);
+  out[strip.written] = '\0';
+  *out_length = strip.written;
+}
+
+err_t jsonc_document_create(const char *source,
+                            const jsonc_parse_options *options,
+                            jsonc_document **out) {
+  jsonc_document *const document = malloc(sizeof(jsonc_document));
+  if (!document) {
+    return true;
+  }
+  document->length = strlen(source);
+  document->capacity = document->length + 1;
+  document->source = malloc(document->capacity);
+  document->spans = arraybuffer_create(sizeof(container_span), 1);
+  if (options) {
+    document->options = *options;
+  } else {
+    document->options = (jsonc_parse_options){0};
+  }
+  // Edits replace parts of the tree that a source map would describe.
+  document->options.source_map = NULL;
+  // No tree to release yet.
+  document->error = (jsonc_error){.code = JSONC_ERROR_UNEXPECTED_END};
+  if (!document->source || !document->spans) {
+    free(document->source);
+    if (document->spans) {
+      arraybuffer_destroy(document->spans);
+    }
+    free(document);
+    return true;
+  }
+  memcpy(document->source, source, document->capacity);
+  if (document_reparse(document)) {
+    jsonc_document_free(document);
+    return true;
+  }
+  *out = document;
+  return false;
+}
+
+void jsonc_document_free(jsonc_document *document) {
+  if (document->error.code == JSONC_ERROR_NONE) {
+    release_value(document->root, document->options.intern);
+  }
+  arraybuffer_destroy(document->spans);
+  free(document->source);
+  free(document);
+}
+
+err_t jsonc_document_edit(jsonc_document *document, size_t offset,
+                          size_t removed, const char *inserted,
+                          size_t inserted_length) {
+  if (offset > document->length) {
+    offset = document->length;
+  }
+  if (removed > document->length - offset) {
+    removed = document->length - offset;
+  }
+  if (inserted_length > SIZE_MAX / 2 - document->length) {
+    return true;
+  }
+  const size_t length = document->length - removed + inserted_length;
+  if (length >= document->capacity) {
+    const size_t capacity = length + 1 > document->capacity * 2
+                                ? length + 1
+                                : document->capacity * 2;
+    char *const source = realloc(document->source, capacity);
+    if (!source) {
+      return true;
+    }
+    document->source = source;
+    document->capacity = capacity;
+  }
+  // Kept to undo the edit if the tree cannot be updated.
+  char *const saved = malloc(removed ? removed : 1);
+  if (!saved) {
+    return true;
+  }
+  memcpy(saved, document->source + offset, removed);
+  document_splice(document, offset, removed, inserted, inserted_length);
+  const err_t result =
+      document_update(document, offset, removed, inserted_length);
+  if (result) {
+    document_splice(document, offset, inserted_length, saved, removed);
+  }
+  free(saved);
+  return result;
+}
+
+const char *jsonc_document_source(const jsonc_document *document,
+                                  size_t *out_length) {
+  if (out_length) {
+    *out_length = document->length;
+  }
+  return document->source;
+}
+
+const jsonc_value *jsonc_document_root(const jsonc_document *document) {
+  return document->error.code == JSONC_ERROR_NONE ? &document->root : NULL;
+}
+
+const jsonc_error *jsonc_document_error(const jsonc_document *document) {
+  return &document->error;
+}
+
+err_t jsonc_shared_create(jsonc_value value, jsonc_shared **out) {
+  jsonc_shared *const shared = malloc(sizeof(jsonc_shared));
+  if (!shared) {
+    return true;
+  }
+  shared->references = 1;
+  shared->root = value;
+  *out = shared;
+  return false;
+}
+
+const jsonc_value *jsonc_shared_root(const jsonc_shared *shared) {
+  return &shared->root;
+}
+
+jsonc_shared *jsonc_shared_retain(jsonc_shared *shared) {
+  atomic_add_size(&shared->references, 1);
+  return shared;
+}
+
+void jsonc_shared_release(jsonc_shared *shared) {
+  if (shared && !atomic_add_size(&shared->references, (size_t)-1)) {
+    free_value(shared->root);
+    free(shared);
+  }
+}
+
+err_t jsonc_snapshot_create(size_t max_readers, jsonc_shared *initial,
+                            jsonc_snapshot **out) {
+  jsonc_snapshot *const snapshot = malloc(sizeof(jsonc_snapshot));
+  if (!snapshot) {
+    return true;
+  }
+  snapshot->current = initial;
+  snapshot->epoch = 1;
+  snapshot->retired = arraybuffer_create(sizeof(snapshot_retired), 4);
+  snapshot->reader_count = max_readers;
+  snapshot->slots = calloc(max_readers, sizeof(snapshot_slot));
+  if (!snapshot->retired || (max_readers && !snapshot->slots)) {
+    if (snapshot->retired) {
+      arraybuffer_destroy(snapshot->retired);
+    }
+    free(snapshot->slots);
+    free(snapshot);
+    return true;
+  }
+  *out = snapshot;
+  return false;
+}
+
+void jsonc_snapshot_free(jsonc_snapshot *snapshot) {
+  for (size_t i = 0; i < snapshot->retired->length; i++) {
+    jsonc_shared_release(
+        ((snapshot_retired *)arraybuffer_get(snapshot->retired, i))->shared);
+  }
+  jsonc_shared_release(snapshot->current);
+  arraybuffer_destroy(snapshot->retired);
+  free(snapshot->slots);
+  free(snapshot);
+}
+
+jsonc_shared *jsonc_snapshot_enter(jsonc_snapshot *snapshot, size_t reader) {
+  atomic_store_size(&snapshot->slots[reader].epoch,
+                    atomic_load_size(&snapshot->epoch));
+  return atomic_load_pointer(&snapshot->current);
+}
+
+void jsonc_snapshot_leave(jsonc_snapshot *snapshot, size_t reader) {
+  atomic_store_size(&snapshot->slots[reader].epoch, 0);
+}
+
+err_t jsonc_snapshot_publish(jsonc_snapshot *snapshot, jsonc_shared *shared) {
+  // Make room first, so that nothing has changed if this fails.
+  const snapshot_retired entry = {NULL, 0};
+  if (arraybuffer_push(snapshot->retired, &entry)) {
+    return true;
+  }
+  snapshot_retired *const retired =
+      arraybuffer_get(snapshot->retired, snapshot->retired->length - 1);
+  retired->shared = atomic_exchange_pointer(&snapshot->current, shared);
+  retired->epoch = atomic_add_size(&snapshot->epoch, 1);
+  jsonc_snapshot_reclaim(snapshot);
+  return false;
+}
+
+void jsonc_snapshot_reclaim(jsonc_snapshot *snapshot) {
+  size_t oldest = SIZE_MAX;
+  for (size_t i = 0; i < snapshot->reader_count; i++) {
+    const size_t epoch = atomic_load_size(&snapshot->slots[i].epoch);
+    if (epoch && epoch < oldest) {
+      oldest = epoch;
+    }
+  }
+  arraybuffer *const retired = snapshot->retired;
+  size_t kept = 0;
+  for (size_t i = 0; i < retired->length; i++) {
+    const snapshot_retired *const entry = arraybuffer_get(retired, i);
+    if (entry->epoch <= oldest) {
+      jsonc_shared_release(entry->shared);
+    } else {
+      *(snapshot_retired *)arraybuffer_get(retired, kept++) = *entry;
+    }
+  }
+  retired->length = kept;
+}
+
+const char *jsonc_string_get(const jsonc_value *value, size_t *out_length) {
+  const char *const string = string_data(value);
+  if (out_length) {
+    *out_length = value->capacity ? value->capacity - 1 : strlen(string);
+  }
+  return string;
+}
+
+err_t jsonc_intern_create(size_t max_value_length, jsonc_intern **out) {
+  jsonc_intern *const table = malloc(sizeof(jsonc_intern));
+  if (!table) {
+    return true;
+  }
+  table->capacity = 64;
+  table->count = 0;
+  table->max_value_length = max_value_length;
+  table->slots = calloc(table->capacity, sizeof(intern_slot));
+  if (!table->slots) {
+    free(table);
+    return true;
+  }
+  *out = table;
+  return false;
+}
+
+void jsonc_intern_free(jsonc_intern *table) {
+  for (size_t i = 0; i < table->capacity; i++) {
+    free(table->slots[i].string);
+  }
+  free(table->slots);
+  free(table);
+}
+
+const char *jsonc_intern_find(const jsonc_intern *table, const char *string) {
+  return intern_probe(table, string, hash_string(string))->string;
+}
+
+void jsonc_free_interned(jsonc_value value, const jsonc_intern *table) {
+  release_value(value, table);
+}
+
+err_t jsonc_source_map_create(jsonc_source_map **out) {
+  jsonc_source_map *const map = malloc(sizeof(jsonc_source_map));
+  if (!map) {
+    return true;
+  }
+  *map = (jsonc_source_map){
+      .spans = arraybuffer_create(sizeof(jsonc_span), 64),
+      .blocks = arraybuffer_create(sizeof(source_block), 16),
+      .pending = arraybuffer_create(sizeof(jsonc_span), 16),
+      .lines = arraybuffer_create(sizeof(size_t), 16),
+  };
+  if (!map->spans || !map->blocks || !map->pending || !map->lines) {
+    jsonc_source_map_free(map);
+    return true;
+  }
+  *out = map;
+  return false;
+}
+
+void jsonc_source_map_free(jsonc_source_map *map) {
+  arraybuffer *const buffers[] = {map->spans, map->blocks, map->pending,
+                                  map->lines};
+  for (size_t i = 0; i < sizeof(buffers) / sizeof(*buffers); i++) {
+    if (buffers[i]) {
+      arraybuffer_destroy(buffers[i]);
+    }
+  }
+  free(map);
+}
+
+static int source_block_compare(const void *a, const void *b) {
+  const uintptr_t x = (uintptr_t)((const source_block *)a)->members;
+  const uintptr_t y = (uintptr_t)((const source_block *)b)->members;
+  return (x > y) - (x < y);
+}
+
+bool jsonc_source_map_find(jsonc_source_map *map, const jsonc_value *value,
+                           jsonc_span *out_span, jsonc_span *out_key) {
+  if (!map->has_root) {
+    return false;
+  }
+  if (!map->is_sorted) {
+    qsort(map->blocks->data, map->blocks->length, sizeof(source_block),
+          source_block_compare);
+    map->is_sorted = true;
+  }
+  // The block that `value` would be in is the last one starting at or
+  // before it.
+  const uintptr_t address = (uintptr_t)value;
+  const source_block *const blocks = map->blocks->data;
+  size_t low = 0;
+  size_t high = map->blocks->length;
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    if ((uintptr_t)blocks[middle].members <= address) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  const jsonc_span *const spans = map->spans->data;
+  const jsonc_span *span = NULL;
+  const jsonc_span *key = NULL;
+  if (low) {
+    const source_block *const block = &blocks[low - 1];
+    const uintptr_t members = (uintptr_t)block->members;
+    if (block->is_object) {
+      const size_t index = (address - members) / sizeof(jsonc_object_entry);
+      const jsonc_object_entry *const entries = block->members;
+      if (index < block->count && &entries[index].value == value) {
+        key = &spans[block->first + 2 * index];
+        span = key + 1;
+      }
+    } else {
+      const size_t index = (address - members) / sizeof(jsonc_value);
+      const jsonc_value *const values = block->members;
+      if (index < block->count && &values[index] == value) {
+        span = &spans[block->first + index];
+      }
+    }
+  }
+  if (!span) {
+    // The root is known by its members, or is the only node.
+    const void *members = NULL;
+    if (value->type == JSONC_VALUE_TYPE_ARRAY) {
+      members = value->value.array.values;
+    } else if (value->type == JSONC_VALUE_TYPE_OBJECT) {
+      members = value->value.object.entries;
+    }
+    if (value->type != map->root_type || members != map->root_members) {
+      return false;
+    }
+    span = &map->root;
+  }
+  if (out_span) {
+    *out_span = *span;
+  }
+  if (out_key) {
+    *out_key = key ? *key : (jsonc_span){0};
+  }
+  return true;
+}
+
+err_t jsonc_source_map_locate(jsonc_source_map *map, const char *source,
+                              size_t offset, size_t *out_line,
+                              size_t *out_column) {
+  if (!map->has_lines) {
+    map->lines->length = 0;
+    for (const char *c = strchr(source, '\n'); c; c = strchr(c + 1, '\n')) {
+      const size_t start = (size_t)(c - source) + 1;
+      if (arraybuffer_push(map->lines, &start)) {
+        return true;
+      }
+    }
+    map->has_lines = true;
+  }
+  // Count the lines that start at or before `offset`, past the first.
+  const size_t *const lines = map->lines->data;
+  size_t low = 0;
+  size_t high = map->lines->length;
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    if (lines[middle] <= offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  *out_line = low + 1;
+  *out_column = offset - (low ? lines[low - 1] : 0) + 1;
+  return false;
+}
+
+jsonc_value jsonc_null_new(void) {
+  return (jsonc_value){.type = JSONC_VALUE_TYPE_NULL};
+}
+
+jsonc_value jsonc_boolean_new(bool boolean) {
+  return (jsonc_value){.type = JSONC_VALUE_TYPE_BOOLEAN,
+                       .value.boolean = boolean};
+}
+
+jsonc_value jsonc_number_new(double number) {
+  return (jsonc_value){.type = JSONC_VALUE_TYPE_NUMBER,
+                       .value.number = number};
+}
+
+err_t jsonc_string_new(const char *string, jsonc_value *out) {
+  const size_t length = strlen(string);
+  *out = (jsonc_value){.type = JSONC_VALUE_TYPE_STRING};
+  if (length <= JSONC_SMALL_STRING_MAX) {
+    out->capacity = (uint32_t)length + 1;
+    memcpy(out->value.small, string, length + 1);
     return false;
   }
-  if ((*out_is_error = token_get(tokens, index).type != TT_EOF)) {
-    free_value(*out);
-    tokenize_free(tokens);
+  out->value.string = util_strdup(string);
+  return !out->value.string;
+}
+
+jsonc_value jsonc_array_new(void) {
+  return (jsonc_value){.type = JSONC_VALUE_TYPE_ARRAY};
+}
+
+jsonc_value jsonc_object_new(void) {
+  return (jsonc_value){.type = JSONC_VALUE_TYPE_OBJECT};
+}
+
+err_t jsonc_reserve(jsonc_value *container, size_t capacity) {
+  return container_reserve(container, capacity);
+}
+
+err_t jsonc_array_push(jsonc_value *array, jsonc_value value) {
+  return jsonc_array_insert(array, array->value.array.count, value);
+}
+
+err_t jsonc_array_insert(jsonc_value *array, size_t index, jsonc_value value) {
+  return index > array->value.array.count ||
+         container_insert(array, index, NULL, value);
+}
+
+void jsonc_array_remove(jsonc_value *array, size_t index) {
+  jsonc_array *const members = &array->value.array;
+  if (index >= members->count) {
+    return;
+  }
+  free_value(members->values[index]);
+  members->count--;
+  memmove(&members->values[index], &members->values[index + 1],
+          (members->count - index) * sizeof(jsonc_value));
+}
+
+jsonc_value *jsonc_object_get_interned(const jsonc_value *object,
+                                       const char *key) {
+  for (size_t i = 0; i < object->value.object.count; i++) {
+    if (object->value.object.entries[i].key == key) {
+      return &object->value.object.entries[i].value;
+    }
+  }
+  return NULL;
+}
+
+jsonc_value *jsonc_object_get(const jsonc_value *object, const char *key) {
+  jsonc_object_entry *const entry = object_find(object, key);
+  return entry ? &entry->value : NULL;
+}
+
+err_t jsonc_object_set(jsonc_value *object, const char *key,
+                       jsonc_value value) {
+  jsonc_object_entry *const existing = object_find(object, key);
+  if (existing) {
+    free_value(existing->value);
+    existing->value = value;
+    return false;
+  }
+  return object_append(object, key, value);
+}
+
+bool jsonc_object_remove(jsonc_value *object, const char *key) {
+  jsonc_object_entry *const entry = object_find(object, key);
+  if (!entry) {
+    return false;
+  }
+  jsonc_object *const members = &object->value.object;
+  const size_t index = entry - members->entries;
+  free(entry->key);
+  free_value(entry->value);
+  members->count--;
+  memmove(&members->entries[index], &members->entries[index + 1],
+          (members->count - index) * sizeof(jsonc_object_entry));
+  return true;
+}
+
+jsonc_value *jsonc_clone(const jsonc_value *value) {
+  compact_copy copy = {.nodes_size = 0};
+  bool stopped;
+  if (traverse(value, NULL, false, compact_size_visit, &copy, &stopped)) {
+    return NULL;
+  }
+  char *const block =
+      malloc(sizeof(jsonc_value) + copy.nodes_size + copy.strings_size);
+  if (!block) {
+    return NULL;
+  }
+  copy.root = (jsonc_value *)block;
+  copy.nodes = block + sizeof(jsonc_value);
+  copy.strings = copy.nodes + copy.nodes_size;
+  if (traverse(value, NULL, false, compact_fill_visit, &copy, &stopped)) {
+    free(block);
+    return NULL;
+  }
+  return copy.root;
+}
+
+err_t jsonc_memory_usage(const jsonc_value *value, jsonc_memory_stats *out) {
+  *out = (jsonc_memory_stats){0};
+  usage_count count = {.stats = out};
+  bool stopped;
+  return traverse(value, NULL, false, usage_visit, &count, &stopped);
+}
+
+err_t jsonc_compact(jsonc_value *value) {
+  if (!is_container(value)) {
+    return false;
+  }
+  if (!container_count(value)) {
+    free_value(*value);
+    value->capacity = 0;
+    value->value.array.values = NULL;
     return false;
   }
-  tokenize_free(tokens);
+  compact_copy copy = {.nodes_size = 0};
+  bool stopped;
+  if (traverse(value, NULL, false, compact_size_visit, &copy, &stopped)) {
+    return true;
+  }
+  char *const block = malloc(copy.nodes_size + copy.strings_size);
+  arraybuffer *const queue = arraybuffer_create(sizeof(jsonc_value *), 16);
+  jsonc_value root = *value;
+  copy.nodes = block;
+  copy.strings = block + copy.nodes_size;
+  const err_t failed = !block || !queue || compact_fill(&root, &copy, queue);
+  if (queue) {
+    arraybuffer_destroy(queue);
+  }
+  if (failed) {
+    free(block);
+    return true;
+  }
+  free_value(*value);
+  root.capacity = CAPACITY_COMPACT;
+  *value = root;
   return false;
 }
 
-void jsonc_free(jsonc_value value) { free_value(value); }
+err_t jsonc_equal(const jsonc_value *a, const jsonc_value *b, unsigned flags,
+                  bool *out_equal) {
+  bool stopped;
+  if (traverse(a, b, flags & JSONC_EQUAL_IGNORE_KEY_ORDER, equal_visit, NULL,
+               &stopped)) {
+    return true;
+  }
+  *out_equal = !stopped;
+  return false;
+}
+
+err_t jsonc_hash(const jsonc_value *value, uint64_t *out_hash) {
+  bool stopped;
+  return traverse(value, NULL, false, hash_visit, out_hash, &stopped);
+}
+
+err_t jsonc_diff(const jsonc_value *a, const jsonc_value *b,
+                 jsonc_diff_format format, jsonc_value *out_patch) {
+  const bool merge = format == JSONC_DIFF_MERGE_PATCH;
+  if (merge && (a->type != JSONC_VALUE_TYPE_OBJECT ||
+                b->type != JSONC_VALUE_TYPE_OBJECT)) {
+    return copy_value(b, out_patch);
+  }
+  *out_patch = merge ? jsonc_object_new() : jsonc_array_new();
+  diff diff = {.format = format,
+               .items = arraybuffer_create(sizeof(diff_item), 16),
+               .text = arraybuffer_create(1, 64),
+               .out = out_patch};
+  err_t failed = !diff.items || !diff.text ||
+                 diff_side_init(&diff.sides[0], a) ||
+                 diff_side_init(&diff.sides[1], b);
+  bool same = false;
+  failed = failed || diff_same(diff.sides, a, 0, b, 0, &same);
+  if (!failed && !same) {
+    const diff_item root = {.a = a, .b = b};
+    failed = is_container(a) && a->type == b->type
+                 ? arraybuffer_push(diff.items, &root)
+                 : diff_op(&diff, "replace", 0, b);
+  }
+  while (!failed && diff.items->length) {
+    const diff_item item =
+        *(diff_item *)arraybuffer_get(diff.items, --diff.items->length);
+    diff.text->length = item.path + item.length;
+    failed = diff_pair(&diff, &item);
+  }
+  if (diff.items) {
+    arraybuffer_destroy(diff.items);
+  }
+  if (diff.text) {
+    arraybuffer_destroy(diff.text);
+  }
+  diff_side_destroy(&diff.sides[0]);
+  diff_side_destroy(&diff.sides[1]);
+  free(diff.index_a.slots);
+  free(diff.index_b.slots);
+  if (failed) {
+    free_value(*out_patch);
+    *out_patch = jsonc_null_new();
+  }
+  return failed;
+}
+
+err_t jsonc_apply_patch(jsonc_value *target, const jsonc_value *patch,
+                        jsonc_diff_format format, jsonc_error *out_error) {
+  *out_error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  if (format == JSONC_DIFF_MERGE_PATCH) {
+    return merge_apply(target, patch);
+  }
+  if (patch->type != JSONC_VALUE_TYPE_ARRAY) {
+    out_error->code = JSONC_ERROR_PATCH_INVALID;
+    return false;
+  }
+  patch_state state = {
+      .target = target,
+      .undo = arraybuffer_create(sizeof(patch_undo), 16),
+      .paths = arraybuffer_create(sizeof(patch_path), 16),
+  };
+  err_t failed = !state.undo || !state.paths;
+  jsonc_error_code code = JSONC_ERROR_NONE;
+  for (size_t i = 0; !failed && i < patch->value.array.count; i++) {
+    failed = patch_operation(&state, &patch->value.array.values[i], &code);
+    if (code != JSONC_ERROR_NONE) {
+      *out_error = (jsonc_error){.code = code, .offset = i};
+      break;
+    }
+  }
+  if (state.undo) {
+    if (failed || code != JSONC_ERROR_NONE) {
+      patch_rollback(&state);
+    } else {
+      patch_commit(&state);
+    }
+    arraybuffer_destroy(state.undo);
+  }
+  if (state.paths) {
+    for (size_t j = 0; j < state.paths->length; j++) {
+      const patch_path *const path = arraybuffer_get(state.paths, j);
+      pointer_free(path->segments, path->count);
+    }
+    arraybuffer_destroy(state.paths);
+  }
+  return failed;
+}
+
+const jsonc_value *jsonc_pointer_get(const jsonc_value *root,
+                                     const char *pointer) {
+  if (!pointer_is_valid(pointer)) {
+    return NULL;
+  }
+  const jsonc_value *value = root;
+  while (*pointer && value) {
+    const char *const segment = pointer + 1;
+    const size_t length = strcspn(segment, "/");
+    const jsonc_value *next = NULL;
+    if (value->type == JSONC_VALUE_TYPE_ARRAY) {
+      const size_t index = pointer_segment_index(segment, length);
+      if (index < value->value.array.count) {
+        next = &value->value.array.values[index];
+      }
+    } else if (value->type == JSONC_VALUE_TYPE_OBJECT) {
+      for (size_t i = 0; i < value->value.object.count; i++) {
+        if (pointer_segment_equals(segment, length,
+                                   value->value.object.entries[i].key)) {
+          next = &value->value.object.entries[i].value;
+          break;
+        }
+      }
+    }
+    value = next;
+    pointer = segment + length;
+  }
+  return value;
+}
+
+err_t jsonc_extract(const char *source, const jsonc_parse_options *options,
+                    const char *const *pointers, size_t count,
+                    jsonc_value *out_values, bool *out_found,
+                    jsonc_error *out_error) {
+  static const jsonc_parse_options unlimited = {0};
+  if (!options) {
+    options = &unlimited;
+  }
+  *out_error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  for (size_t i = 0; i < count; i++) {
+    out_found[i] = false;
+  }
+  extract_path *const paths = calloc(count ? count : 1, sizeof(extract_path));
+  if (!paths) {
+    return true;
+  }
+  err_t result = true;
+  size_t remaining = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!pointer_is_valid(pointers[i])) {
+      paths[i].done = true;
+      continue;
+    }
+    if (pointer_compile(pointers[i], &paths[i].segments, &paths[i].count)) {
+      goto cleanup;
+    }
+    remaining++;
+  }
+  if (remaining) {
+    reader reader;
+    if (reader_init(&reader, source, options, NULL, out_error)) {
+      goto cleanup;
+    }
+    result = extract(&reader, paths, count, out_values, out_found, remaining);
+    reader_destroy(&reader);
+  } else {
+    result = false;
+  }
+
+cleanup:
+  for (size_t i = 0; i < count; i++) {
+    pointer_free(paths[i].segments, paths[i].count);
+    if (out_found[i] && (result || out_error->code != JSONC_ERROR_NONE)) {
+      free_value(out_values[i]);
+      out_found[i] = false;
+    }
+  }
+  free(paths);
+  if (!result && out_error->code != JSONC_ERROR_NONE) {
+    locate_error(source, out_error);
+  }
+  return result;
+}
+
+err_t jsonc_extract_columns(const char *source,
+                            const jsonc_parse_options *options,
+                            unsigned flags, jsonc_column *columns,
+                            size_t column_count, size_t *out_row_count,
+                            jsonc_error *out_error) {
+  static const jsonc_parse_options unlimited = {0};
+  if (!options) {
+    options = &unlimited;
+  }
+  *out_error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  err_t result = true;
+  column_reader state;
+  if (!columns_init(&state, flags, columns, column_count)) {
+    reader reader;
+    if (!reader_init(&reader, source, options, NULL, out_error)) {
+      result = columns_read(&reader, &state);
+      reader_destroy(&reader);
+    }
+  }
+  if (result || out_error->code != JSONC_ERROR_NONE) {
+    columns_release(columns, column_count);
+  } else {
+    for (size_t i = 0; i < column_count; i++) {
+      columns[i].null_count = column_null_count(&columns[i], state.rows);
+    }
+    *out_row_count = state.rows;
+  }
+  columns_destroy(&state);
+  if (!result && out_error->code != JSONC_ERROR_NONE) {
+    locate_error(source, out_error);
+  }
+  return result;
+}
+
+err_t jsonc_extract_array(const char *source,
+                          const jsonc_parse_options *options,
+                          const char *pointer, unsigned flags,
+                          jsonc_column *column, size_t *out_row_count,
+                          bool *out_found, jsonc_error *out_error) {
+  static const jsonc_parse_options unlimited = {0};
+  if (!options) {
+    options = &unlimited;
+  }
+  *out_error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  *out_found = false;
+  if (!pointer_is_valid(pointer)) {
+    return false;
+  }
+  pointer_segment *segments;
+  size_t count;
+  if (pointer_compile(pointer, &segments, &count)) {
+    return true;
+  }
+  err_t result = true;
+  column_reader state;
+  if (!columns_init(&state, flags, column, 1)) {
+    reader reader;
+    if (!reader_init(&reader, source, options, NULL, out_error)) {
+      event current;
+      result = pointer_seek(&reader, segments, count, &current, out_found) ||
+               (*out_found && array_read(&reader, &state, &current));
+      reader_destroy(&reader);
+    }
+  }
+  if (result || !*out_found || out_error->code != JSONC_ERROR_NONE) {
+    columns_release(column, 1);
+  } else {
+    column->null_count = column_null_count(column, state.rows);
+    *out_row_count = state.rows;
+  }
+  columns_destroy(&state);
+  pointer_free(segments, count);
+  if (!result && out_error->code != JSONC_ERROR_NONE) {
+    locate_error(source, out_error);
+  }
+  return result;
+}
+
+void jsonc_columns_free(jsonc_column *columns, size_t column_count) {
+  columns_release(columns, column_count);
+}
+
+err_t jsonc_reader_create(const char *source,
+                          const jsonc_parse_options *options,
+                          jsonc_reader **out) {
+  jsonc_reader *const reader = malloc(sizeof(jsonc_reader));
+  if (!reader) {
+    return true;
+  }
+  if (options) {
+    reader->options = *options;
+  } else {
+    reader->options = (jsonc_parse_options){0};
+  }
+  reader->error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  reader->source = source;
+  if (reader_init(&reader->reader, source, &reader->options, NULL,
+                  &reader->error)) {
+    free(reader);
+    return true;
+  }
+  *out = reader;
+  return false;
+}
+
+void jsonc_reader_destroy(jsonc_reader *reader) {
+  reader_destroy(&reader->reader);
+  free(reader);
+}
+
+err_t jsonc_reader_next(jsonc_reader *reader, jsonc_event *out) {
+  event current;
+  if (reader_next(&reader->reader, &current)) {
+    return true;
+  }
+  reader_publish(&current, out);
+  return false;
+}
+
+err_t jsonc_reader_skip(jsonc_reader *reader, jsonc_event *first) {
+  if (first->type != JSONC_EVENT_BEGIN_ARRAY &&
+      first->type != JSONC_EVENT_BEGIN_OBJECT) {
+    return false;
+  }
+  event current = {.type = first->type, .offset = first->offset};
+  if (reader_skip(&reader->reader, &current)) {
+    return true;
+  }
+  if (reader->error.code != JSONC_ERROR_NONE) {
+    first->type = JSONC_EVENT_ERROR;
+  }
+  return false;
+}
+
+const jsonc_error *jsonc_reader_error(jsonc_reader *reader) {
+  if (reader->error.code != JSONC_ERROR_NONE) {
+    locate_error(reader->source, &reader->error);
+  }
+  return &reader->error;
+}
+
+void jsonc_error_locate(const char *source, jsonc_error *error) {
+  locate_error(source, error);
+}
+
+err_t jsonc_error_pointer(const char *source, const jsonc_error *error,
+                          char **out_pointer) {
+  arraybuffer *const text = arraybuffer_create(1, 64);
+  arraybuffer *const frames = arraybuffer_create(sizeof(path_frame), 16);
+  const char terminator = '\0';
+  err_t result = !text || !frames ||
+                 error_path(source, error->offset, text, frames) ||
+                 arraybuffer_push(text, &terminator);
+  if (frames) {
+    arraybuffer_destroy(frames);
+  }
+  if (!result) {
+    *out_pointer = text->data;
+    free(text);
+  } else if (text) {
+    arraybuffer_destroy(text);
+  }
+  return result;
+}
+
+err_t jsonc_save_binary(const jsonc_value *value, const char *source,
+                        const char *path, bool *out_is_error) {
+  image_writer writer;
+  bool too_large;
+  if (image_build(value, source, &writer, &too_large)) {
+    return true;
+  }
+  *out_is_error = too_large || !image_save(&writer, path);
+  free(writer.data);
+  return false;
+}
+
+err_t jsonc_load_binary(const char *path, const char *source,
+                        const jsonc_parse_options *options, jsonc_image **out,
+                        jsonc_error *out_error) {
+  *out_error = (jsonc_error){.code = JSONC_ERROR_NONE};
+  jsonc_image *image;
+  if (image_open(path, &image)) {
+    return true;
+  }
+  // A damaged image is stale too.
+  bool usable = image && image_is_current(image, source);
+  if (usable && image_check(image, &usable)) {
+    jsonc_image_free(image);
+    return true;
+  }
+  if (usable) {
+    *out = image;
+    return false;
+  }
+  if (image) {
+    jsonc_image_free(image);
+  }
+  *out = NULL;
+  if (!source) {
+    return false;
+  }
+  // Keep strings and containers within what a node can describe, so that
+  // anything that parses can be laid out.
+  jsonc_parse_options limited = {0};
+  if (options) {
+    limited = *options;
+  }
+  // The tree is only used to build the image.
+  limited.source_map = NULL;
+  const size_t node_limit = UINT32_MAX;
+  if (!limited.max_string_length || limited.max_string_length > node_limit) {
+    limited.max_string_length = node_limit;
+  }
+  if (!limited.max_array_size || limited.max_array_size > node_limit) {
+    limited.max_array_size = node_limit;
+  }
+  if (!limited.max_object_size || limited.max_object_size > node_limit) {
+    limited.max_object_size = node_limit;
+  }
+  jsonc_value value;
+  if (jsonc_parse_ex(source, &limited, &value, out_error)) {
+    return true;
+  }
+  if (out_error->code != JSONC_ERROR_NONE) {
+    return false;
+  }
+  image_writer writer;
+  bool too_large;
+  const err_t result = image_build(&value, source, &writer, &too_large);
+  release_value(value, limited.intern);
+  if (result) {
+    return true;
+  }
+  image = malloc(sizeof(jsonc_image));
+  if (!image) {
+    free(writer.data);
+    return true;
+  }
+  // The cache is only an optimization; failing to write it is not an error.
+  image_save(&writer, path);
+  *image = (jsonc_image){.data = writer.data, .size = writer.length};
+  *out = image;
+  return false;
+}
+
+void jsonc_image_free(jsonc_image *image) {
+  image_release(image);
+  free(image);
+}
+
+const jsonc_node *jsonc_image_root(const jsonc_image *image) {
+  return &((const image_header *)image->data)->root;
+}
+
+jsonc_value_type jsonc_node_type(const jsonc_node *node) {
+  return (jsonc_value_type)node->type;
+}
+
+bool jsonc_node_boolean(const jsonc_node *node) { return node->payload; }
+
+double jsonc_node_number(const jsonc_node *node) {
+  double number;
+  memcpy(&number, &node->payload, sizeof(number));
+  return number;
+}
+
+const char *jsonc_node_string(const jsonc_node *node, size_t *out_length) {
+  if (out_length) {
+    *out_length = node->count;
+  }
+  return (const char *)node + node->payload;
+}
+
+size_t jsonc_node_count(const jsonc_node *node) {
+  return node->type == JSONC_VALUE_TYPE_ARRAY ||
+                 node->type == JSONC_VALUE_TYPE_OBJECT
+             ? node->count
+             : 0;
+}
+
+const jsonc_node *jsonc_node_at(const jsonc_node *node, size_t index) {
+  if (index >= jsonc_node_count(node)) {
+    return NULL;
+  }
+  const char *const block = (const char *)node + node->payload;
+  if (node->type == JSONC_VALUE_TYPE_ARRAY) {
+    return (const jsonc_node *)block + index;
+  }
+  return &((const image_entry *)block)[index].value;
+}
+
+const char *jsonc_node_key(const jsonc_node *object, size_t index,
+                           size_t *out_length) {
+  if (object->type != JSONC_VALUE_TYPE_OBJECT || index >= object->count) {
+    return NULL;
+  }
+  const image_entry *const entry =
+      (const image_entry *)((const char *)object + object->payload) + index;
+  if (out_length) {
+    *out_length = entry->key_length;
+  }
+  return (const char *)entry + entry->key;
+}
+
+const jsonc_node *jsonc_node_get(const jsonc_node *object, const char *key) {
+  if (object->type != JSONC_VALUE_TYPE_OBJECT) {
+    return NULL;
+  }
+  const image_entry *const entries =
+      (const image_entry *)((const char *)object + object->payload);
+  const uint32_t *const sorted = (const uint32_t *)(entries + object->count);
+  // Lower bound, so that the first of several equal keys is found.
+  size_t low = 0;
+  size_t high = object->count;
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    const image_entry *const entry = &entries[sorted[middle]];
+    if (strcmp((const char *)entry + entry->key, key) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == object->count) {
+    return NULL;
+  }
+  const image_entry *const entry = &entries[sorted[low]];
+  return strcmp((const char *)entry + entry->key, key) ? NULL : &entry->value;
+}
+
+err_t jsonc_schema_compile(const jsonc_value *schema, jsonc_schema **out) {
+  schema_builder builder = {
+      .nodes = arraybuffer_create(sizeof(schema_node), 16),
+      .properties = arraybuffer_create(sizeof(schema_property), 16),
+      .enums = arraybuffer_create(sizeof(jsonc_value), 16),
+      .tasks = arraybuffer_create(sizeof(schema_task), 16),
+  };
+  err_t result = true;
+  if (!builder.nodes || !builder.properties || !builder.enums ||
+      !builder.tasks) {
+    goto cleanup;
+  }
+  // The root always gets node 0, even when it is `true`.
+  bool malformed = schema->type != JSONC_VALUE_TYPE_BOOLEAN &&
+                   schema->type != JSONC_VALUE_TYPE_OBJECT;
+  schema_node root = schema_node_empty;
+  if (schema->type == JSONC_VALUE_TYPE_BOOLEAN && !schema->value.boolean) {
+    root.flags = SCHEMA_FALSE;
+  }
+  const schema_task task = {.source = schema, .node = 0};
+  if (arraybuffer_push(builder.nodes, &root) ||
+      (schema->type == JSONC_VALUE_TYPE_OBJECT &&
+       arraybuffer_push(builder.tasks, &task))) {
+    goto cleanup;
+  }
+  while (!malformed && builder.tasks->length) {
+    const schema_task next = *(schema_task *)arraybuffer_get(
+        builder.tasks, --builder.tasks->length);
+    if (schema_compile_node(&builder, &next, &malformed)) {
+      goto cleanup;
+    }
+  }
+  result = false;
+  if (malformed) {
+    *out = NULL;
+    goto cleanup;
+  }
+  jsonc_schema *const compiled = malloc(sizeof(jsonc_schema));
+  if (!compiled) {
+    result = true;
+    goto cleanup;
+  }
+  compiled->nodes = schema_builder_take(&builder.nodes, &compiled->node_count);
+  compiled->properties =
+      schema_builder_take(&builder.properties, &compiled->property_count);
+  compiled->enums = schema_builder_take(&builder.enums, &compiled->enum_count);
+  *out = compiled;
+
+cleanup:
+  schema_builder_destroy(&builder);
+  return result;
+}
+
+void jsonc_schema_free(jsonc_schema *schema) {
+  for (size_t i = 0; i < schema->property_count; i++) {
+    free(schema->properties[i].key);
+  }
+  for (size_t i = 0; i < schema->enum_count; i++) {
+    free_value(schema->enums[i]);
+  }
+  free(schema->nodes);
+  free(schema->properties);
+  free(schema->enums);
+  free(schema);
+}
+
+const char *jsonc_error_message(jsonc_error_code code) {
+  switch (code) {
+  case JSONC_ERROR_NONE:
+    return "no error";
+  case JSONC_ERROR_UNEXPECTED_CHARACTER:
+    return "unexpected character";
+  case JSONC_ERROR_UNEXPECTED_END:
+    return "unexpected end of input";
+  case JSONC_ERROR_UNTERMINATED_STRING:
+    return "unterminated string";
+  case JSONC_ERROR_UNTERMINATED_COMMENT:
+    return "unterminated comment";
+  case JSONC_ERROR_INVALID_UTF8:
+    return "invalid UTF-8 in string";
+  case JSONC_ERROR_BAD_ESCAPE:
+    return "invalid escape sequence";
+  case JSONC_ERROR_UNEXPECTED_TOKEN:
+    return "unexpected token";
+  case JSONC_ERROR_TRAILING_DATA:
+    return "trailing data after value";
+  case JSONC_ERROR_MAX_DEPTH:
+    return "maximum nesting depth exceeded";
+  case JSONC_ERROR_MAX_DOCUMENT_SIZE:
+    return "maximum document size exceeded";
+  case JSONC_ERROR_MAX_STRING_LENGTH:
+    return "maximum string length exceeded";
+  case JSONC_ERROR_MAX_ARRAY_SIZE:
+    return "maximum array size exceeded";
+  case JSONC_ERROR_MAX_OBJECT_SIZE:
+    return "maximum object size exceeded";
+  case JSONC_ERROR_TYPE_MISMATCH:
+    return "value has the wrong type";
+  case JSONC_ERROR_SCHEMA_NOT_ALLOWED:
+    return "value not allowed by schema";
+  case JSONC_ERROR_SCHEMA_REQUIRED:
+    return "missing required property";
+  case JSONC_ERROR_SCHEMA_ENUM:
+    return "value not in enum";
+  case JSONC_ERROR_SCHEMA_MINIMUM:
+    return "number below minimum";
+  case JSONC_ERROR_SCHEMA_MAXIMUM:
+    return "number above maximum";
+  case JSONC_ERROR_SCHEMA_MAX_LENGTH:
+    return "string longer than maxLength";
+  case JSONC_ERROR_READ:
+    return "error reading input";
+  case JSONC_ERROR_PATCH_INVALID:
+    return "invalid patch operation";
+  case JSONC_ERROR_PATCH_PATH:
+    return "patch path not found";
+  case JSONC_ERROR_PATCH_TEST:
+    return "patch test failed";
+  }
+  return "unknown error";
+}
 
 #ifdef __cplusplus
 }
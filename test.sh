@@ -4,7 +4,7 @@ set -e
 cd "$(dirname "$0")"
 
 
-cmake -B builddir -DCMAKE_INSTALL_PREFIX=builddir/out test
+cmake -B builddir -DCMAKE_INSTALL_PREFIX=builddir/out .
 cmake --build builddir --config Debug
 cmake --install builddir --config Debug
 
@@ -0,0 +1,343 @@
+// jsonc_extract_array and the fast path for array elements that are plain
+// numbers: numbers on either side of the 8- and 16-digit chunk boundaries,
+// past 2^53 and with exponents read the same as through the tokenizer,
+// whether or not a comma follows them; each column type, nulls and a
+// target that is not an array; and a long array against the pull reader.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <math.h>
+#include <string.h>
+
+// Numbers that go through the fast path when a comma follows.
+static const char *const numbers[] = {
+    "0",
+    "-0",
+    "7",
+    "1234567",
+    "12345678",
+    "-12345678",
+    "123456789",
+    "999999999999999",
+    "1234567890123456",
+    "9999999999999999",
+    "12345678901234567",
+    "9007199254740992",
+    "9007199254740993",
+    "-9007199254740993",
+    "9007199254740995",
+    "18446744073709551615",
+    "123456789012345678901234",
+    "1e5",
+    "-2E+3",
+    "25e-1",
+    "1.5",
+    "-0.125",
+    "12345678.87654321",
+    "1.5e300",
+    "4e-320",
+    "1e0005",
+    "1e00005",
+};
+
+// Integers of up to 19 digits, which are read exactly and rounded once.
+static bool is_exact_integer(const char *text) {
+  const size_t digits = strlen(text) - (*text == '-');
+  return !strpbrk(text, ".eE") && digits <= 19;
+}
+
+// The value of the only number in `source` as the pull reader, which has
+// no fast path, reads it.
+static double read_number(const char *source) {
+  jsonc_reader *reader;
+  CHECK_MEMORY(jsonc_reader_create(source, NULL, &reader));
+  jsonc_event event;
+  CHECK_MEMORY(jsonc_reader_next(reader, &event));
+  CHECK(event.type == JSONC_EVENT_NUMBER);
+  const double value = event.value.number;
+  jsonc_reader_destroy(reader);
+  return value;
+}
+
+static bool same(double a, double b) {
+  return a == b && signbit(a) == signbit(b);
+}
+
+static double *extract_doubles(const char *source, const char *pointer,
+                               size_t *out_rows, jsonc_column *column) {
+  *column = (jsonc_column){.type = JSONC_COLUMN_DOUBLE};
+  bool found;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_extract_array(source, NULL, pointer, 0, column,
+                                   out_rows, &found, &error));
+  if (!found || error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "cannot extract %s from %s\n", pointer, source);
+    exit(EXIT_FAILURE);
+  }
+  return column->values;
+}
+
+// Each number first, with a comma after it, and last, without one; spaced
+// and not; in a tree and in a column.
+static void check_numbers(void) {
+  for (size_t i = 0; i < sizeof(numbers) / sizeof(*numbers); i++) {
+    const char *const text = numbers[i];
+    const double expected = read_number(text);
+    if (is_exact_integer(text)) {
+      CHECK(same(expected, strtod(text, NULL)));
+    }
+    char source[128];
+    snprintf(source, sizeof(source), "{\"a\": [%s,%s , %s ]}", text, text,
+             text);
+    size_t rows;
+    jsonc_column column;
+    const double *const values = extract_doubles(source, "/a", &rows, &column);
+    CHECK(rows == 3);
+    for (size_t row = 0; row < rows; row++) {
+      if (!same(values[row], expected)) {
+        fprintf(stderr, "%s, row %zu: %.17g, not %.17g\n", text, row,
+                values[row], expected);
+        check_failures++;
+      }
+    }
+    jsonc_columns_free(&column, 1);
+
+    jsonc_value value;
+    jsonc_error error;
+    CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+    CHECK(error.code == JSONC_ERROR_NONE);
+    if (error.code == JSONC_ERROR_NONE) {
+      const jsonc_array *const array =
+          &value.value.object.entries[0].value.value.array;
+      for (size_t j = 0; j < array->count; j++) {
+        CHECK(same(array->values[j].value.number, expected));
+      }
+      jsonc_free(value);
+    }
+  }
+}
+
+// Sources that look like numbers but are not are left to the tokenizer,
+// which fails on them at the same place with a comma after or without.
+static void check_malformed(void) {
+  static const struct {
+    const char *source;
+    jsonc_error_code code;
+    size_t offset;
+  } cases[] = {
+      {"[01, 2]", JSONC_ERROR_UNEXPECTED_CHARACTER, 2},
+      {"[-, 2]", JSONC_ERROR_UNEXPECTED_CHARACTER, 2},
+      {"[1., 2]", JSONC_ERROR_UNEXPECTED_CHARACTER, 3},
+      {"[1e, 2]", JSONC_ERROR_UNEXPECTED_CHARACTER, 3},
+      {"[1 2, 3]", JSONC_ERROR_UNEXPECTED_TOKEN, 3},
+      {"[1,, 2]", JSONC_ERROR_UNEXPECTED_TOKEN, 3},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+    jsonc_column column = {.type = JSONC_COLUMN_DOUBLE};
+    size_t rows;
+    bool found;
+    jsonc_error error;
+    CHECK_MEMORY(jsonc_extract_array(cases[i].source, NULL, "", 0, &column,
+                                     &rows, &found, &error));
+    CHECK(found && error.code == cases[i].code &&
+          error.offset == cases[i].offset);
+    CHECK(!column.values && !column.validity);
+    jsonc_value value;
+    CHECK_MEMORY(jsonc_parse_ex(cases[i].source, NULL, &value, &error));
+    CHECK(error.code == cases[i].code && error.offset == cases[i].offset);
+  }
+}
+
+static void check_int64(void) {
+  const char source[] = "[0, -9223372036854775808, 9007199254740993, null,"
+                        " 1e3, -42]";
+  jsonc_column column = {.type = JSONC_COLUMN_INT64};
+  size_t rows;
+  bool found;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_extract_array(source, NULL, "", 0, &column, &rows,
+                                   &found, &error));
+  CHECK(found && error.code == JSONC_ERROR_NONE && rows == 6);
+  if (error.code == JSONC_ERROR_NONE) {
+    const int64_t *const values = column.values;
+    CHECK(values[0] == 0 && values[1] == INT64_MIN);
+    // Past 2^53 numbers are rounded to a double.
+    CHECK(values[2] == 9007199254740992);
+    CHECK(values[3] == 0 && column.null_count == 1 &&
+          !(column.validity[0] >> 3 & 1));
+    CHECK(values[4] == 1000 && values[5] == -42);
+    jsonc_columns_free(&column, 1);
+  }
+
+  static const struct {
+    const char *source;
+    size_t offset;
+  } mismatches[] = {
+      {"[1, 9223372036854775808, 2]", 4},
+      {"[1, 2.5, 3]", 4},
+      {"[1, 2, 1e-1]", 7},
+      {"[1, \"2\"]", 4},
+  };
+  for (size_t i = 0; i < sizeof(mismatches) / sizeof(*mismatches); i++) {
+    column = (jsonc_column){.type = JSONC_COLUMN_INT64};
+    CHECK_MEMORY(jsonc_extract_array(mismatches[i].source, NULL, "", 0,
+                                     &column, &rows, &found, &error));
+    CHECK(error.code == JSONC_ERROR_TYPE_MISMATCH &&
+          error.offset == mismatches[i].offset);
+    CHECK(!column.values && !column.validity);
+  }
+}
+
+static void check_other_types(void) {
+  const char source[] = "{\"s\": [\"x\", null, \"\\u00e9\", \"\"],"
+                        " \"b\": [true, false, null, true]}";
+  jsonc_column column = {.type = JSONC_COLUMN_STRING};
+  size_t rows;
+  bool found;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_extract_array(source, NULL, "/s", 0, &column, &rows,
+                                   &found, &error));
+  CHECK(found && error.code == JSONC_ERROR_NONE && rows == 4);
+  if (error.code == JSONC_ERROR_NONE) {
+    const int64_t *const offsets = column.offsets;
+    CHECK(offsets[0] == 0 && offsets[1] == 1 && offsets[2] == 1 &&
+          offsets[3] == 3 && offsets[4] == 3);
+    CHECK(!memcmp(column.data, "x\xc3\xa9", 3));
+    CHECK(column.null_count == 1);
+    jsonc_columns_free(&column, 1);
+  }
+
+  column = (jsonc_column){.type = JSONC_COLUMN_BOOLEAN};
+  CHECK_MEMORY(jsonc_extract_array(source, NULL, "/b", JSONC_COLUMNS_ARROW,
+                                   &column, &rows, &found, &error));
+  CHECK(found && error.code == JSONC_ERROR_NONE && rows == 4);
+  if (error.code == JSONC_ERROR_NONE) {
+    CHECK(*(const uint8_t *)column.values == 0x9);
+    CHECK(column.validity[0] == 0xb && column.null_count == 1);
+    jsonc_columns_free(&column, 1);
+  }
+}
+
+// Pointers to things other than an array, to nothing, and past the array.
+static void check_targets(void) {
+  const char source[] = "{\"n\": 5, \"o\": {\"a\": [1]}, \"e\": [],"
+                        " \"late\": [1, 2], \"bad\": }";
+  static const struct {
+    const char *pointer;
+    bool found;
+    jsonc_error_code code;
+    size_t offset;
+    size_t rows;
+  } cases[] = {
+      {"/n", true, JSONC_ERROR_TYPE_MISMATCH, 6, 0},
+      {"/o", true, JSONC_ERROR_TYPE_MISMATCH, 14, 0},
+      {"/o/a", true, JSONC_ERROR_NONE, 0, 1},
+      {"/e", true, JSONC_ERROR_NONE, 0, 0},
+      // Reading stops at the end of the array, before the syntax error.
+      {"/late", true, JSONC_ERROR_NONE, 0, 2},
+      // Looking for a key reads to the end, so the syntax error is found.
+      {"/missing", false, JSONC_ERROR_UNEXPECTED_TOKEN, 58, 0},
+      {"/o/a/1", false, JSONC_ERROR_NONE, 0, 0},
+      {"o", false, JSONC_ERROR_NONE, 0, 0},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+    jsonc_column column = {.type = JSONC_COLUMN_DOUBLE};
+    size_t rows = 0;
+    bool found;
+    jsonc_error error;
+    CHECK_MEMORY(jsonc_extract_array(source, NULL, cases[i].pointer, 0,
+                                     &column, &rows, &found, &error));
+    CHECK(found == cases[i].found && error.code == cases[i].code);
+    if (error.code != JSONC_ERROR_NONE || !found) {
+      CHECK(error.offset == cases[i].offset);
+      CHECK(!column.values && !column.validity);
+    } else {
+      CHECK(rows == cases[i].rows);
+      jsonc_columns_free(&column, 1);
+    }
+  }
+}
+
+// max_array_size is enforced on fast-path elements too.
+static void check_limit(void) {
+  const jsonc_parse_options options = {.max_array_size = 3};
+  static const char *const sources[] = {"[1, 2, 3, 4, 5]", "[1, 2, 3, 4]",
+                                        "[[1, 2, 3, 4]]"};
+  for (size_t i = 0; i < sizeof(sources) / sizeof(*sources); i++) {
+    jsonc_column column = {.type = JSONC_COLUMN_DOUBLE};
+    size_t rows;
+    bool found;
+    jsonc_error error;
+    const char *const pointer = i == 2 ? "/0" : "";
+    CHECK_MEMORY(jsonc_extract_array(sources[i], &options, pointer, 0,
+                                     &column, &rows, &found, &error));
+    CHECK(error.code == JSONC_ERROR_MAX_ARRAY_SIZE);
+    jsonc_value value;
+    CHECK_MEMORY(jsonc_parse_ex(sources[i], &options, &value, &error));
+    CHECK(error.code == JSONC_ERROR_MAX_ARRAY_SIZE);
+  }
+}
+
+// Many numbers of every length, against the pull reader.
+static void check_long(void) {
+  const size_t count = 100000;
+  char *const source = malloc(count * 32 + 2);
+  CHECK_MEMORY(!source);
+  size_t length = 0;
+  source[length++] = '[';
+  uint64_t state = 88172645463325252u;
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    const int digits = (int)(state % 19) + 1;
+    uint64_t scale = 1;
+    for (int digit = 1; digit < digits; digit++) {
+      scale *= 10;
+    }
+    const unsigned long long integer = state % scale + 1;
+    const char *const comma = i ? "," : "";
+    if (i % 5 == 3) {
+      length += (size_t)sprintf(source + length, "%s-%llu.%llu", comma,
+                                integer, (unsigned long long)(state >> 40));
+    } else if (i % 5 == 4) {
+      length += (size_t)sprintf(source + length, "%s%llue%d", comma, integer,
+                                (int)(i % 40) - 20);
+    } else {
+      length += (size_t)sprintf(source + length, "%s%llu", comma, integer);
+    }
+  }
+  source[length++] = ']';
+  source[length] = '\0';
+
+  size_t rows;
+  jsonc_column column;
+  const double *const values = extract_doubles(source, "", &rows, &column);
+  CHECK(rows == count);
+  jsonc_reader *reader;
+  CHECK_MEMORY(jsonc_reader_create(source, NULL, &reader));
+  jsonc_event event;
+  CHECK_MEMORY(jsonc_reader_next(reader, &event));
+  size_t mismatches = 0;
+  for (size_t i = 0; i < rows; i++) {
+    CHECK_MEMORY(jsonc_reader_next(reader, &event));
+    mismatches += event.type != JSONC_EVENT_NUMBER ||
+                  !same(event.value.number, values[i]);
+  }
+  CHECK(mismatches == 0);
+  jsonc_reader_destroy(reader);
+  jsonc_columns_free(&column, 1);
+  free(source);
+}
+
+int main(void) {
+  check_numbers();
+  check_malformed();
+  check_int64();
+  check_other_types();
+  check_targets();
+  check_limit();
+  check_long();
+  return CHECK_STATUS();
+}
@@ -0,0 +1,213 @@
+// Binary images: a current cache file is mapped as saved, a stale one is
+// replaced by an image of the new source, and an image reads back the tree it
+// was saved from, including key lookup through the sorted index. Images with
+// a valid header but offsets, lengths or index entries that do not fit are
+// treated as stale.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static const char source[] =
+    "{\"zeta\": \"\", \"dup\": 1, \"arr\": [1.5, true, null, \"h\\u00e9\"],"
+    " \"dup\": 2, \"nested\": {\"x\": 7, \"e\": {}, \"f\": []}}";
+
+// The tree of `source`.
+static void check_tree(const jsonc_node *root) {
+  CHECK(jsonc_node_type(root) == JSONC_VALUE_TYPE_OBJECT);
+  CHECK(jsonc_node_count(root) == 5);
+  size_t length;
+  CHECK(!strcmp(jsonc_node_key(root, 0, &length), "zeta") && length == 4);
+  CHECK(!strcmp(jsonc_node_key(root, 3, NULL), "dup"));
+  const jsonc_node *const array = jsonc_node_get(root, "arr");
+  CHECK(array && jsonc_node_count(array) == 4);
+  if (array) {
+    CHECK(jsonc_node_number(jsonc_node_at(array, 0)) == 1.5);
+    CHECK(jsonc_node_boolean(jsonc_node_at(array, 1)));
+    CHECK(jsonc_node_type(jsonc_node_at(array, 2)) == JSONC_VALUE_TYPE_NULL);
+    CHECK(!strcmp(jsonc_node_string(jsonc_node_at(array, 3), &length),
+                  "h\xc3\xa9") &&
+          length == 3);
+    CHECK(!jsonc_node_at(array, 4));
+    CHECK(!jsonc_node_get(array, "x"));
+  }
+  // The first member with a duplicated key.
+  CHECK(jsonc_node_number(jsonc_node_get(root, "dup")) == 1);
+  CHECK(jsonc_node_number(
+            jsonc_node_get(jsonc_node_get(root, "nested"), "x")) == 7);
+  CHECK(!jsonc_node_get(root, "nope") && !jsonc_node_get(root, ""));
+  CHECK(jsonc_node_count(jsonc_node_get(root, "zeta")) == 0);
+}
+
+static jsonc_image *load(const char *path, const char *text) {
+  jsonc_image *image;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_load_binary(path, text, NULL, &image, &error));
+  if (image) {
+    CHECK(error.code == JSONC_ERROR_NONE);
+  }
+  return image;
+}
+
+// The number of members of the root of the image at `path`, or -1 if there
+// is no image.
+static long root_count(const char *path, const char *text) {
+  jsonc_image *const image = load(path, text);
+  if (!image) {
+    return -1;
+  }
+  const long count = (long)jsonc_node_count(jsonc_image_root(image));
+  jsonc_image_free(image);
+  return count;
+}
+
+static void check_image(const char *path, const char *text) {
+  jsonc_image *const image = load(path, text);
+  CHECK(image);
+  if (image) {
+    check_tree(jsonc_image_root(image));
+    jsonc_image_free(image);
+  }
+}
+
+static void check_cache(void) {
+  const char *const path = "binary-cache.bin";
+  remove(path);
+  CHECK(!load(path, NULL));
+
+  // No cache yet: the source is parsed and the cache written.
+  check_image(path, source);
+  // Current: the saved image is used, with or without the source.
+  check_image(path, source);
+  check_image(path, NULL);
+
+  // Stale: the new source wins and replaces the cache.
+  CHECK(root_count(path, "[1, 2]") == 2);
+  CHECK(root_count(path, NULL) == 2);
+
+  // A syntax error gives no image and leaves the cache alone.
+  jsonc_image *image;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_load_binary(path, "[1,", NULL, &image, &error));
+  CHECK(!image && error.code == JSONC_ERROR_UNEXPECTED_END);
+  CHECK(root_count(path, NULL) == 2);
+  remove(path);
+}
+
+static void check_save(void) {
+  const char *const path = "binary-saved.bin";
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  bool failed;
+  CHECK_MEMORY(jsonc_save_binary(&value, source, path, &failed));
+  CHECK(!failed);
+  CHECK_MEMORY(
+      jsonc_save_binary(&value, source, "missing/binary.bin", &failed));
+  CHECK(failed);
+  jsonc_free(value);
+  check_image(path, source);
+
+  // Files that are not images are rejected rather than mapped.
+  FILE *const file = fopen(path, "wb");
+  CHECK(file);
+  if (file) {
+    fputs("garbage", file);
+    fclose(file);
+  }
+  CHECK(!load(path, NULL));
+  jsonc_image *const image = load(path, "\"scalar\"");
+  CHECK(image);
+  if (image) {
+    CHECK(!strcmp(jsonc_node_string(jsonc_image_root(image), NULL), "scalar"));
+    jsonc_image_free(image);
+  }
+  remove(path);
+}
+
+// Where the fields a load checks sit in the image of `source`: the root
+// node follows the first 40 bytes of the header, and an object's block is
+// its 32-byte entries (key offset, key length, value node) followed by the
+// 32-bit sorted index.
+enum {
+  ROOT = 40,
+  NODE_COUNT = 4,
+  NODE_PAYLOAD = 8,
+  ENTRY_SIZE = 32,
+  ENTRY_KEY_LENGTH = 8,
+  ENTRY_VALUE = 16,
+  ROOT_MEMBERS = 5,
+};
+
+static void write_file(const char *path, const char *data, size_t size) {
+  FILE *const file = fopen(path, "wb");
+  CHECK_MEMORY(!file);
+  CHECK(fwrite(data, 1, size, file) == size);
+  fclose(file);
+}
+
+static void check_damaged(void) {
+  const char *const path = "binary-damaged.bin";
+  remove(path);
+  check_image(path, source);
+  FILE *const file = fopen(path, "rb");
+  CHECK_MEMORY(!file);
+  char saved[4096];
+  const size_t size = fread(saved, 1, sizeof(saved), file);
+  fclose(file);
+  CHECK(size > ROOT + 16 && size < sizeof(saved));
+  uint64_t block;
+  memcpy(&block, saved + ROOT + NODE_PAYLOAD, sizeof(block));
+  block += ROOT;
+  const size_t zeta = block;
+  const size_t sorted = block + ROOT_MEMBERS * ENTRY_SIZE;
+
+  // Each writes `value` of `width` bytes at `at`.
+  const struct {
+    size_t at;
+    uint64_t value;
+    size_t width;
+  } damages[] = {
+      {ROOT, 9, 4},
+      {ROOT + NODE_PAYLOAD, (uint64_t)1 << 40, 8},
+      {ROOT + NODE_PAYLOAD, 0, 8},
+      {ROOT + NODE_COUNT, 1000000, 4},
+      // The empty string named "zeta" runs past the end.
+      {zeta + ENTRY_VALUE + NODE_COUNT, 1000000, 4},
+      // "zet" is not NUL-terminated.
+      {zeta + ENTRY_KEY_LENGTH, 3, 8},
+      {zeta + ENTRY_KEY_LENGTH, UINT64_MAX, 8},
+      {zeta, (uint64_t)1 << 40, 8},
+      {sorted, ROOT_MEMBERS, 4},
+  };
+  char damaged[sizeof(saved)];
+  for (size_t i = 0; i < sizeof(damages) / sizeof(*damages); i++) {
+    memcpy(damaged, saved, size);
+    const uint32_t narrow = (uint32_t)damages[i].value;
+    memcpy(damaged + damages[i].at,
+           damages[i].width == 4 ? (const void *)&narrow
+                                 : (const void *)&damages[i].value,
+           damages[i].width);
+    write_file(path, damaged, size);
+    jsonc_image *const image = load(path, NULL);
+    if (image) {
+      fprintf(stderr, "damage %zu: image used\n", i);
+      check_failures++;
+      jsonc_image_free(image);
+    }
+    // The source is parsed again and the cache rewritten.
+    check_image(path, source);
+    check_image(path, NULL);
+  }
+  remove(path);
+}
+
+int main(void) {
+  check_cache();
+  check_save();
+  check_damaged();
+  return CHECK_STATUS();
+}
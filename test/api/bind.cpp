@@ -0,0 +1,92 @@
+// Typed binding: documents read straight into structs, vectors and optionals,
+// unknown members skipped but validated, and mismatches reported at the
+// offending value.
+
+#include "check.h"
+#include "jsonc_bind.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct limits {
+  double cpu = 0;
+  int64_t memory = 0;
+};
+JSONC_BIND(limits, JSONC_FIELD(limits, cpu), JSONC_FIELD(limits, memory));
+
+struct server {
+  std::string name;
+  uint16_t port = 0;
+  bool enabled = false;
+  std::vector<int> ports;
+  std::vector<std::vector<double>> matrix;
+  std::vector<bool> flags;
+  std::optional<std::string> note;
+  limits lim;
+  std::vector<limits> history;
+};
+JSONC_BIND(server, JSONC_FIELD(server, name), JSONC_FIELD(server, port),
+           JSONC_FIELD(server, enabled), JSONC_FIELD(server, ports),
+           JSONC_FIELD(server, matrix), JSONC_FIELD(server, flags),
+           JSONC_FIELD(server, note), jsonc::make_field("limits", &server::lim),
+           JSONC_FIELD(server, history));
+
+static void check_bind() {
+  const auto parsed = jsonc::parse_as<server>(R"({
+    // comment
+    "name": "aéb", "port": 8080, "enabled": true,
+    "unknown": {"x": [1, {"y": 2}]},
+    "ports": [1, 2, 3], "matrix": [[1.5], [], [2, 3]], "flags": [true, false],
+    "note": null, "limits": {"cpu": 0.5, "memory": 1e9, "z": 1},
+    "history": [{"cpu": 1}, {"memory": 2}]
+  })");
+  CHECK(parsed);
+  if (!parsed) {
+    return;
+  }
+  CHECK(parsed->name == "a\xc3\xa9"
+                        "b");
+  CHECK(parsed->port == 8080 && parsed->enabled);
+  CHECK((parsed->ports == std::vector<int>{1, 2, 3}));
+  CHECK(parsed->matrix.size() == 3 && parsed->matrix[0][0] == 1.5 &&
+        parsed->matrix[1].empty() && parsed->matrix[2][1] == 3);
+  CHECK((parsed->flags == std::vector<bool>{true, false}));
+  CHECK(!parsed->note);
+  CHECK(parsed->lim.cpu == 0.5 && parsed->lim.memory == 1000000000);
+  CHECK(parsed->history.size() == 2 && parsed->history[0].cpu == 1 &&
+        parsed->history[1].memory == 2);
+
+  const auto numbers =
+      jsonc::parse_as<std::vector<int64_t>>("[-9007199254740992, 3]");
+  CHECK(numbers && (*numbers)[0] == -9007199254740992LL);
+}
+
+static void check_errors() {
+  // Out of range for the field's type, at the number.
+  auto result = jsonc::parse_as<server>("{\"port\": 70000}");
+  CHECK(!result && result.error().code() == JSONC_ERROR_TYPE_MISMATCH);
+  CHECK(!result && result.error().column() == 10);
+  result = jsonc::parse_as<server>("{\"port\": 1.5}");
+  CHECK(!result && result.error().code() == JSONC_ERROR_TYPE_MISMATCH);
+  result = jsonc::parse_as<server>("{\"name\": 1}\n");
+  CHECK(!result && result.error().offset() == 9);
+  result = jsonc::parse_as<server>("[]");
+  CHECK(!result && result.error().code() == JSONC_ERROR_TYPE_MISMATCH);
+  // Syntax errors, including in skipped members and after the root.
+  result = jsonc::parse_as<server>("{\"name\": \"x\"} 1");
+  CHECK(!result && result.error().code() == JSONC_ERROR_TRAILING_DATA);
+  result = jsonc::parse_as<server>("{\"unknown\": [1,}");
+  CHECK(!result && result.error().code() == JSONC_ERROR_UNEXPECTED_TOKEN);
+  jsonc_parse_options options = {};
+  options.max_depth = 2;
+  result = jsonc::parse_as<server>("{\"unknown\": [[1]]}", &options);
+  CHECK(!result && result.error().code() == JSONC_ERROR_MAX_DEPTH);
+}
+
+int main() {
+  check_bind();
+  check_errors();
+  return CHECK_STATUS();
+}
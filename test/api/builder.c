@@ -0,0 +1,104 @@
+// The builder API: trees built by hand, and parsed trees changed in place,
+// equal the documents they should describe. Containers grow geometrically.
+
+#include "check.h"
+#include "jsonc.h"
+
+static jsonc_value parse(const char *source) {
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "cannot parse %s\n", source);
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+static bool equals_text(const jsonc_value *value, const char *text) {
+  jsonc_value expected = parse(text);
+  bool equal;
+  CHECK_MEMORY(jsonc_equal(value, &expected, 0, &equal));
+  jsonc_free(expected);
+  return equal;
+}
+
+static jsonc_value string(const char *text) {
+  jsonc_value value;
+  CHECK_MEMORY(jsonc_string_new(text, &value));
+  return value;
+}
+
+static void check_build(void) {
+  jsonc_value array = jsonc_array_new();
+  const int count = 100000;
+  for (int i = 0; i < count; i++) {
+    CHECK_MEMORY(jsonc_array_push(&array, jsonc_number_new(i)));
+  }
+  CHECK(array.value.array.count == (size_t)count);
+  // Geometric growth leaves less than the count again in spare slots.
+  CHECK(array.capacity >= (uint32_t)count && array.capacity < 2u * count);
+  CHECK(array.value.array.values[count - 1].value.number == count - 1);
+  while (array.value.array.count > 3) {
+    jsonc_array_remove(&array, array.value.array.count - 1);
+  }
+  jsonc_array_remove(&array, 0);
+  CHECK_MEMORY(jsonc_array_insert(&array, 0, jsonc_boolean_new(true)));
+  CHECK_MEMORY(jsonc_array_insert(&array, 2, string("mid")));
+  CHECK_MEMORY(jsonc_array_insert(&array, 4, jsonc_null_new()));
+  // Past the end fails and leaves the array as it was.
+  CHECK(jsonc_array_insert(&array, 6, jsonc_null_new()));
+  CHECK(equals_text(&array, "[true, 1, \"mid\", 2, null]"));
+
+  jsonc_value root = jsonc_object_new();
+  CHECK_MEMORY(jsonc_reserve(&root, 8));
+  CHECK(root.capacity == 8 && root.value.object.count == 0);
+  CHECK_MEMORY(jsonc_object_set(&root, "array", array));
+  CHECK_MEMORY(jsonc_object_set(&root, "x", jsonc_number_new(1)));
+  CHECK_MEMORY(jsonc_object_set(&root, "y", string("two")));
+  CHECK_MEMORY(jsonc_object_set(&root, "x", string("replaced")));
+  CHECK(jsonc_object_remove(&root, "y"));
+  CHECK(!jsonc_object_remove(&root, "missing"));
+  CHECK(jsonc_object_get(&root, "x") &&
+        jsonc_object_get(&root, "x")->type == JSONC_VALUE_TYPE_STRING);
+  CHECK(!jsonc_object_get(&root, "y"));
+  CHECK(equals_text(&root, "{\"array\": [true, 1, \"mid\", 2, null],"
+                           " \"x\": \"replaced\"}"));
+  jsonc_free(root);
+}
+
+// Parsed containers have no spare capacity; the first change reallocates
+// them, after which they grow like built ones.
+static void check_edit_parsed(void) {
+  jsonc_value value = parse("{\"a\": [1, 2, 3], \"b\": {}, \"c\": \"s\"}");
+  CHECK(value.capacity == 0);
+  char key[16];
+  for (int i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    CHECK_MEMORY(jsonc_object_set(&value, key, jsonc_number_new(i)));
+  }
+  CHECK_MEMORY(
+      jsonc_array_push(jsonc_object_get(&value, "a"), jsonc_number_new(4)));
+  CHECK_MEMORY(
+      jsonc_object_set(jsonc_object_get(&value, "b"), "z", jsonc_null_new()));
+  for (int i = 0; i < 99; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    CHECK(jsonc_object_remove(&value, key));
+  }
+  CHECK(jsonc_object_remove(&value, "c"));
+  CHECK(equals_text(&value, "{\"a\": [1, 2, 3, 4], \"b\": {\"z\": null},"
+                            " \"k99\": 99}"));
+  jsonc_value *const clone = jsonc_clone(&value);
+  CHECK_MEMORY(!clone);
+  bool equal;
+  CHECK_MEMORY(jsonc_equal(clone, &value, 0, &equal));
+  CHECK(equal);
+  free(clone);
+  jsonc_free(value);
+}
+
+int main(void) {
+  check_build();
+  check_edit_parsed();
+  return CHECK_STATUS();
+}
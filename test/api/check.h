@@ -0,0 +1,34 @@
+#ifndef JSONC_TEST_CHECK_H
+#define JSONC_TEST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Assertions for the API tests. A failed check prints where it is and the
+// test goes on, so that one run lists every failure; main returns
+// CHECK_STATUS().
+static int check_failures;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,         \
+              #condition);                                                     \
+      check_failures++;                                                        \
+    }                                                                          \
+  } while (0)
+
+// For calls returning err_t: running out of memory is not what the tests
+// are about, so it ends the run.
+#define CHECK_MEMORY(call)                                                     \
+  do {                                                                         \
+    if (call) {                                                                \
+      fprintf(stderr, "%s:%d: out of memory: %s\n", __FILE__, __LINE__,        \
+              #call);                                                          \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_STATUS() (check_failures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+#endif
@@ -0,0 +1,127 @@
+// Columnar extraction: each type of column, nulls and missing keys in the
+// validity bitmap, Arrow's bit-packed booleans, 64-byte aligned and padded
+// buffers, the full int64 range, and type mismatches that fail the read
+// without leaving anything allocated.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static const char source[] =
+    "[{\"ts\": 1, \"v\": 0.5, \"ok\": true, \"name\": \"a\"},\n"
+    " {\"ts\": -9223372036854775808, \"v\": null, \"ok\": false},\n"
+    " {\"extra\": [1, {\"x\": 2}], \"ok\": null,\n"
+    "  \"name\": \"\\u00e9t\\u00e9\"},\n"
+    " {\"ts\": 9007199254740993, \"v\": -2e3, \"ok\": true, \"name\": \"\"},\n"
+    " {\"name\": \"first\", \"name\": \"last\", \"ts\": 0}]";
+
+static bool aligned(const void *pointer) {
+  return (uintptr_t)pointer % 64 == 0;
+}
+
+static bool valid(const jsonc_column *column, size_t row) {
+  return column->validity[row / 8] >> row % 8 & 1;
+}
+
+static void check_types(unsigned flags) {
+  jsonc_column columns[] = {
+      {.key = "ts", .type = JSONC_COLUMN_INT64},
+      {.key = "v", .type = JSONC_COLUMN_DOUBLE},
+      {.key = "ok", .type = JSONC_COLUMN_BOOLEAN},
+      {.key = "name", .type = JSONC_COLUMN_STRING},
+      // A key given to a second column leaves it empty.
+      {.key = "v", .type = JSONC_COLUMN_DOUBLE},
+  };
+  const size_t count = sizeof(columns) / sizeof(*columns);
+  size_t rows;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_extract_columns(source, NULL, flags, columns, count,
+                                     &rows, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  if (error.code != JSONC_ERROR_NONE) {
+    return;
+  }
+  CHECK(rows == 5);
+  for (size_t i = 0; i < count; i++) {
+    CHECK(aligned(columns[i].values) && aligned(columns[i].validity));
+    // Padding past the last row is zero.
+    CHECK(columns[i].validity[0] >> 5 == 0);
+    for (size_t j = 1; j < 64; j++) {
+      CHECK(columns[i].validity[j] == 0);
+    }
+  }
+
+  const int64_t *const ts = columns[0].values;
+  CHECK(ts[0] == 1 && ts[1] == INT64_MIN && ts[2] == 0 && ts[4] == 0);
+  // Numbers are read as doubles.
+  CHECK(ts[3] == 9007199254740992);
+  CHECK(valid(&columns[0], 1) && !valid(&columns[0], 2));
+  CHECK(columns[0].null_count == 1);
+
+  const double *const v = columns[1].values;
+  CHECK(v[0] == 0.5 && v[1] == 0 && v[2] == 0 && v[3] == -2000 && v[4] == 0);
+  CHECK(valid(&columns[1], 0) && !valid(&columns[1], 1));
+  CHECK(!valid(&columns[1], 2) && valid(&columns[1], 3));
+  CHECK(columns[1].null_count == 3);
+
+  bool ok[5];
+  for (size_t row = 0; row < 5; row++) {
+    ok[row] = flags & JSONC_COLUMNS_ARROW
+                  ? ((const uint8_t *)columns[2].values)[row / 8] >> row % 8 & 1
+                  : ((const uint8_t *)columns[2].values)[row];
+  }
+  CHECK(ok[0] && !ok[1] && !ok[2] && ok[3] && !ok[4]);
+  CHECK(valid(&columns[2], 1) && !valid(&columns[2], 2));
+  CHECK(columns[2].null_count == 2);
+  if (flags & JSONC_COLUMNS_ARROW) {
+    CHECK(((const uint8_t *)columns[2].values)[0] == 0x09);
+  }
+
+  const int64_t *const offsets = columns[3].offsets;
+  CHECK(aligned(offsets) && aligned(columns[3].data));
+  static const char *const names[] = {"a", "", "\xc3\xa9t\xc3\xa9", "", "last"};
+  for (size_t row = 0; row < 5; row++) {
+    const size_t length = (size_t)(offsets[row + 1] - offsets[row]);
+    CHECK(length == strlen(names[row]) &&
+          !memcmp(columns[3].data + offsets[row], names[row], length));
+  }
+  CHECK(!valid(&columns[3], 1) && valid(&columns[3], 3));
+  CHECK(columns[3].null_count == 1);
+
+  CHECK(columns[4].null_count == 5);
+  jsonc_columns_free(columns, count);
+}
+
+static void check_mismatch(const char *text, jsonc_column_type type,
+                           size_t offset) {
+  jsonc_column columns[] = {
+      {.key = "a", .type = JSONC_COLUMN_STRING},
+      {.key = "b", .type = type},
+  };
+  size_t rows;
+  jsonc_error error;
+  CHECK_MEMORY(
+      jsonc_extract_columns(text, NULL, 0, columns, 2, &rows, &error));
+  CHECK(error.code == JSONC_ERROR_TYPE_MISMATCH);
+  CHECK(error.offset == offset);
+}
+
+static void check_mismatches(void) {
+  check_mismatch("[{\"a\": \"x\", \"b\": \"1\"}]", JSONC_COLUMN_INT64, 17);
+  check_mismatch("[{\"a\": \"x\", \"b\": 1.5}]", JSONC_COLUMN_INT64, 17);
+  check_mismatch("[{\"b\": 9223372036854775808}]", JSONC_COLUMN_INT64, 7);
+  check_mismatch("[{\"b\": -9223372036854777856}]", JSONC_COLUMN_INT64, 7);
+  check_mismatch("[{\"b\": 1}, {\"b\": \"s\"}]", JSONC_COLUMN_DOUBLE, 17);
+  check_mismatch("[{\"b\": 0}]", JSONC_COLUMN_BOOLEAN, 7);
+  check_mismatch("[{\"b\": []}]", JSONC_COLUMN_STRING, 7);
+  check_mismatch("[{\"a\": \"x\"}, 1]", JSONC_COLUMN_INT64, 13);
+  check_mismatch("{\"a\": \"x\"}", JSONC_COLUMN_INT64, 0);
+}
+
+int main(void) {
+  check_types(0);
+  check_types(JSONC_COLUMNS_ARROW);
+  check_mismatches();
+  return CHECK_STATUS();
+}
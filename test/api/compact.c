@@ -0,0 +1,135 @@
+// jsonc_memory_usage counts every block of a tree, and jsonc_compact moves a
+// tree into one block of the same contents that still compares equal, can
+// be compacted again, cloned, and freed as part of a larger tree.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static const char source[] =
+    "{\"name\": \"a fairly long string value\", \"short\": \"x\",\n"
+    " \"list\": [1, {\"deep\": \"another long string value\"}], \"e\": []}";
+
+static jsonc_value parse(const char *text) {
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(text, NULL, &value, &error));
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "cannot parse %s\n", text);
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+static jsonc_memory_stats usage(const jsonc_value *value) {
+  jsonc_memory_stats stats;
+  CHECK_MEMORY(jsonc_memory_usage(value, &stats));
+  return stats;
+}
+
+static bool equal(const jsonc_value *a, const jsonc_value *b) {
+  bool result;
+  CHECK_MEMORY(jsonc_equal(a, b, 0, &result));
+  return result;
+}
+
+static void check_usage(void) {
+  jsonc_value value = parse(source);
+  // Three member arrays, as the empty array has none; five keys with their
+  // NULs; two strings too long to be stored inline.
+  const size_t nodes =
+      5 * sizeof(jsonc_object_entry) + 2 * sizeof(jsonc_value);
+  const size_t keys = sizeof("name") + sizeof("short") + sizeof("list") +
+                      sizeof("e") + sizeof("deep");
+  const size_t strings = sizeof("a fairly long string value") +
+                         sizeof("another long string value");
+  jsonc_memory_stats stats = usage(&value);
+  CHECK(stats.nodes == nodes && stats.keys == keys &&
+        stats.strings == strings);
+  CHECK(stats.allocations == 10);
+  CHECK(stats.overhead >= stats.allocations * sizeof(size_t));
+
+  jsonc_value expected = parse(source);
+  CHECK_MEMORY(jsonc_compact(&value));
+  CHECK(value.capacity == UINT32_MAX);
+  CHECK(equal(&value, &expected));
+  const size_t heap_overhead = stats.overhead;
+  stats = usage(&value);
+  CHECK(stats.nodes == nodes && stats.keys == keys &&
+        stats.strings == strings);
+  CHECK(stats.allocations == 1 && stats.overhead < heap_overhead);
+
+  CHECK_MEMORY(jsonc_compact(&value));
+  CHECK(equal(&value, &expected));
+  CHECK(usage(&value).allocations == 1);
+  jsonc_value *const clone = jsonc_clone(&value);
+  CHECK_MEMORY(!clone);
+  CHECK(equal(clone, &expected));
+  free(clone);
+
+  // A compacted tree can be a member of a built one.
+  jsonc_value array = jsonc_array_new();
+  CHECK_MEMORY(jsonc_array_push(&array, value));
+  CHECK(usage(&array).allocations == 2);
+  jsonc_free(array);
+  jsonc_free(expected);
+}
+
+static void check_spare_capacity(void) {
+  jsonc_value array = jsonc_array_new();
+  CHECK_MEMORY(jsonc_reserve(&array, 100));
+  CHECK(usage(&array).nodes == 100 * sizeof(jsonc_value));
+  CHECK(usage(&array).allocations == 1);
+  // Compacting drops it.
+  CHECK_MEMORY(jsonc_compact(&array));
+  CHECK(usage(&array).nodes == 0 && usage(&array).allocations == 0);
+  jsonc_free(array);
+
+  jsonc_value string;
+  CHECK_MEMORY(jsonc_string_new("a string longer than fifteen", &string));
+  CHECK(usage(&string).strings == sizeof("a string longer than fifteen"));
+  CHECK_MEMORY(jsonc_compact(&string));
+  CHECK(!strcmp(jsonc_string_get(&string, NULL),
+                "a string longer than fifteen"));
+  jsonc_free(string);
+}
+
+// Many records: compacting keeps the byte counts and removes all but one
+// block.
+static void check_records(void) {
+  const int count = 20000;
+  const size_t capacity = 80 * (size_t)count + 2;
+  char *const text = malloc(capacity);
+  CHECK_MEMORY(!text);
+  size_t length = 0;
+  text[length++] = '[';
+  for (int i = 0; i < count; i++) {
+    length += (size_t)snprintf(
+        text + length, capacity - length,
+        "%s{\"id\": %d, \"tags\": [\"t\", \"u\"],"
+        " \"name\": \"name %d!!!!!!!!\"}",
+        i ? "," : "", i, i);
+  }
+  text[length++] = ']';
+  text[length] = '\0';
+  jsonc_value value = parse(text);
+  jsonc_value expected = parse(text);
+  const jsonc_memory_stats before = usage(&value);
+  CHECK(before.allocations > (size_t)count * 4);
+  CHECK_MEMORY(jsonc_compact(&value));
+  const jsonc_memory_stats after = usage(&value);
+  CHECK(after.nodes == before.nodes && after.keys == before.keys &&
+        after.strings == before.strings && after.allocations == 1);
+  CHECK(equal(&value, &expected));
+  jsonc_free(value);
+  jsonc_free(expected);
+  free(text);
+}
+
+int main(void) {
+  check_usage();
+  check_spare_capacity();
+  check_records();
+  return CHECK_STATUS();
+}
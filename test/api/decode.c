@@ -0,0 +1,161 @@
+// String decoding: escapes, surrogate pairs and raw UTF-8 decode to the same
+// text through the tree, the pull reader and a reused parser; malformed
+// strings fail with their own code and offset; and long strings and many
+// strings in one document come out intact.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+// A JSON string literal, what it decodes to, and the error it fails with
+// at `offset` if it is malformed.
+static const struct {
+  const char *literal;
+  const char *decoded;
+  jsonc_error_code code;
+  size_t offset;
+} cases[] = {
+    {"\"\"", "", JSONC_ERROR_NONE, 0},
+    {"\"plain text\"", "plain text", JSONC_ERROR_NONE, 0},
+    {"\"\\\" \\\\ \\/ \\b \\f \\n \\r \\t\"", "\" \\ / \b \f \n \r \t",
+     JSONC_ERROR_NONE, 0},
+    {"\"\\u0041\\u00e9\\u20AC\"", "A\xc3\xa9\xe2\x82\xac", JSONC_ERROR_NONE, 0},
+    {"\"\\ud83d\\ude00 and \\uD834\\uDD1E\"",
+     "\xf0\x9f\x98\x80 and \xf0\x9d\x84\x9e", JSONC_ERROR_NONE, 0},
+    {"\"raw \xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\"",
+     "raw \xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80", JSONC_ERROR_NONE, 0},
+    {"\"mixed \\n\xc3\xa9\\t end\"", "mixed \n\xc3\xa9\t end", JSONC_ERROR_NONE,
+     0},
+    {"\"\\x41\"", NULL, JSONC_ERROR_BAD_ESCAPE, 2},
+    {"\"ab\\u12G4\"", NULL, JSONC_ERROR_BAD_ESCAPE, 7},
+    {"\"\\ud83d\"", NULL, JSONC_ERROR_BAD_ESCAPE, 7},
+    {"\"\\ud83d\\u0041\"", NULL, JSONC_ERROR_BAD_ESCAPE, 12},
+    {"\"\\ude00\"", NULL, JSONC_ERROR_BAD_ESCAPE, 6},
+    {"\"bad \xc3\x28\"", NULL, JSONC_ERROR_INVALID_UTF8, 0},
+    {"\"overlong \xc0\xaf\"", NULL, JSONC_ERROR_INVALID_UTF8, 0},
+    {"\"tab\there\"", NULL, JSONC_ERROR_UNEXPECTED_CHARACTER, 4},
+};
+
+static bool is_string(const jsonc_value *value, const char *text) {
+  return value->type == JSONC_VALUE_TYPE_STRING &&
+         !strcmp(jsonc_string_get(value, NULL), text);
+}
+
+static void check_case(jsonc_parser *parser, size_t i) {
+  // As a value and as a key.
+  char source[128];
+  snprintf(source, sizeof(source), "{%s: %s}", cases[i].literal,
+           cases[i].literal);
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(cases[i].literal, NULL, &value, &error));
+  if (error.code != cases[i].code) {
+    fprintf(stderr, "case %zu: got %s\n", i, jsonc_error_message(error.code));
+    check_failures++;
+    return;
+  }
+  if (cases[i].decoded) {
+    CHECK(is_string(&value, cases[i].decoded));
+    jsonc_free(value);
+  } else {
+    CHECK(error.offset == cases[i].offset);
+  }
+
+  CHECK_MEMORY(jsonc_parser_parse(parser, source, NULL, &value, &error));
+  CHECK(error.code == cases[i].code);
+  if (cases[i].decoded && error.code == JSONC_ERROR_NONE) {
+    CHECK(!strcmp(value.value.object.entries[0].key, cases[i].decoded));
+    CHECK(is_string(&value.value.object.entries[0].value, cases[i].decoded));
+    jsonc_free(value);
+  } else if (!cases[i].decoded) {
+    CHECK(error.offset == cases[i].offset + 1);
+  }
+
+  jsonc_reader *reader;
+  CHECK_MEMORY(jsonc_reader_create(source, NULL, &reader));
+  jsonc_event event;
+  CHECK_MEMORY(jsonc_reader_next(reader, &event));
+  CHECK_MEMORY(jsonc_reader_next(reader, &event));
+  if (cases[i].decoded) {
+    CHECK(event.type == JSONC_EVENT_KEY &&
+          event.value.string.length == strlen(cases[i].decoded) &&
+          !memcmp(event.value.string.data, cases[i].decoded,
+                  event.value.string.length));
+    CHECK_MEMORY(jsonc_reader_next(reader, &event));
+    CHECK(event.type == JSONC_EVENT_STRING &&
+          !strcmp(event.value.string.data, cases[i].decoded));
+  } else {
+    CHECK(event.type == JSONC_EVENT_ERROR &&
+          jsonc_reader_error(reader)->code == cases[i].code);
+  }
+  jsonc_reader_destroy(reader);
+}
+
+// A string far longer than any internal buffer, with escapes throughout,
+// and an array of many distinct strings.
+static void check_long(jsonc_parser *parser) {
+  const size_t count = 100000;
+  char *const source = malloc(8 * count + 16);
+  char *const expected = malloc(2 * count + 1);
+  CHECK_MEMORY(!source || !expected);
+  size_t length = 0;
+  source[length++] = '"';
+  for (size_t i = 0; i < count; i++) {
+    if (i % 7 == 0) {
+      memcpy(source + length, "\\u00e9", 6);
+      length += 6;
+      memcpy(expected + 2 * i, "\xc3\xa9", 2);
+    } else {
+      source[length++] = (char)('a' + i % 26);
+      expected[2 * i] = (char)('a' + i % 26);
+      expected[2 * i + 1] = '-';
+      source[length++] = '-';
+    }
+  }
+  source[length++] = '"';
+  source[length] = '\0';
+  expected[2 * count] = '\0';
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parser_parse(parser, source, NULL, &value, &error));
+  CHECK(error.code == JSONC_ERROR_NONE && is_string(&value, expected));
+  if (error.code == JSONC_ERROR_NONE) {
+    jsonc_free(value);
+  }
+
+  length = 0;
+  source[length++] = '[';
+  for (size_t i = 0; i < count / 10; i++) {
+    length += (size_t)sprintf(source + length, "%s\"s\\t%zu\"", i ? "," : "",
+                              i * 7919);
+  }
+  source[length++] = ']';
+  source[length] = '\0';
+  CHECK_MEMORY(jsonc_parser_parse(parser, source, NULL, &value, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  if (error.code == JSONC_ERROR_NONE) {
+    for (size_t i = 0; i < count / 10; i++) {
+      char text[32];
+      snprintf(text, sizeof(text), "s\t%zu", i * 7919);
+      CHECK(is_string(&value.value.array.values[i], text));
+    }
+    jsonc_free(value);
+  }
+  free(source);
+  free(expected);
+}
+
+int main(void) {
+  jsonc_parser *parser;
+  CHECK_MEMORY(jsonc_parser_create(0, &parser));
+  // Twice, so that the parser's buffers are reused.
+  for (int round = 0; round < 2; round++) {
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+      check_case(parser, i);
+    }
+    check_long(parser);
+  }
+  jsonc_parser_free(parser);
+  return CHECK_STATUS();
+}
@@ -0,0 +1,155 @@
+// Incremental documents: after every edit the tree, or the error, equals
+// what a full parse of the new text gives, whether the edit is reparsed in
+// place or falls back to a full parse.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static const char base[] =
+    "{\"name\": \"demo\", // comment\n"
+    " \"list\": [1, 2, {\"deep\": [true, false, null]}, \"str\"],\n"
+    " \"obj\": {\"a\": {\"b\": {\"c\": [1, [2, [3]]]}}}, \"tail\": 5}";
+
+// Compares the document with a full parse of its text. Returns false if
+// they differ.
+static bool matches_reparse(const jsonc_document *document,
+                            const jsonc_parse_options *options) {
+  size_t length;
+  const char *const text = jsonc_document_source(document, &length);
+  CHECK(strlen(text) == length);
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(text, options, &value, &error));
+  const jsonc_error *const got = jsonc_document_error(document);
+  if (error.code != JSONC_ERROR_NONE) {
+    return got->code == error.code && got->offset == error.offset &&
+           got->line == error.line && got->column == error.column &&
+           !jsonc_document_root(document);
+  }
+  bool equal = false;
+  if (got->code == JSONC_ERROR_NONE && jsonc_document_root(document)) {
+    CHECK_MEMORY(jsonc_equal(jsonc_document_root(document), &value, 0, &equal));
+  }
+  if (options && options->intern) {
+    jsonc_free_interned(value, options->intern);
+  } else {
+    jsonc_free(value);
+  }
+  return equal;
+}
+
+static void edit(jsonc_document *document, const char *find, size_t removed,
+                 const char *inserted) {
+  const char *const text = jsonc_document_source(document, NULL);
+  const char *const at = strstr(text, find);
+  CHECK(at);
+  if (at) {
+    CHECK_MEMORY(jsonc_document_edit(document, (size_t)(at - text), removed,
+                                     inserted, strlen(inserted)));
+  }
+}
+
+// Edits inside a container, to its brackets, across containers, and ones
+// that break the text and then repair it.
+static void check_edits(void) {
+  jsonc_document *document;
+  CHECK_MEMORY(jsonc_document_create(base, NULL, &document));
+  CHECK(matches_reparse(document, NULL));
+  static const struct {
+    const char *find;
+    size_t removed;
+    const char *inserted;
+  } edits[] = {
+      {"true", 4, "\"yes\""},
+      {"[3]", 1, "[4, "},
+      {"\"str\"", 0, "{\"x\": [], "},
+      {"{\"x\": [], ", 10, ""},
+      {"5}", 1, "[5,"},
+      {"[5,", 3, "6"},
+      {"// comment", 10, "/* was a comment */"},
+      {"\"b\"", 3, "\"b\", \"b2\""},
+      {"\"b2\"", 0, ": 1, "},
+      {"\"demo\"", 6, "\"unterminated"},
+      {"\"unterminated", 13, "\"demo\""},
+      {"]]]", 1, ""},
+      {"]]}", 0, "]"},
+      {"{", 1, "["},
+      {"[", 1, "{"},
+  };
+  for (size_t i = 0; i < sizeof(edits) / sizeof(*edits); i++) {
+    edit(document, edits[i].find, edits[i].removed, edits[i].inserted);
+    if (!matches_reparse(document, NULL)) {
+      fprintf(stderr, "edit %zu: %s\n", i,
+              jsonc_document_source(document, NULL));
+      check_failures++;
+    }
+  }
+  jsonc_document_free(document);
+}
+
+static uint32_t next_random(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Random edits made of JSON fragments, under limits and with interning.
+static void check_random(uint32_t seed) {
+  static const char *const pieces[] = {
+      "{", "}", "[", "]", ",", ":", "1", "23", "-", "e5", ".5", " ", "\n",
+      "null", "true", "/*", "*/", "//", "\"", "", "\"k\"", "\"x\":",
+      "{\"a\":1}", "[1,2]", "\"a string value, long\""};
+  const size_t piece_count = sizeof(pieces) / sizeof(*pieces);
+  jsonc_parse_options options = {0};
+  if (seed % 3 == 0) {
+    options.max_depth = 6;
+  }
+  jsonc_intern *table = NULL;
+  if (seed % 5 == 0) {
+    CHECK_MEMORY(jsonc_intern_create(64, &table));
+    options.intern = table;
+  }
+  jsonc_document *document;
+  CHECK_MEMORY(jsonc_document_create(base, &options, &document));
+  uint32_t state = seed;
+  for (int step = 0; step < 1000; step++) {
+    size_t length;
+    jsonc_document_source(document, &length);
+    size_t offset = next_random(&state) % (length + 1);
+    size_t removed =
+        next_random(&state) % 4 ? 0 : next_random(&state) % 6;
+    if (removed > length - offset) {
+      removed = length - offset;
+    }
+    const char *inserted = pieces[next_random(&state) % piece_count];
+    // Now and then start again from a valid document.
+    if (next_random(&state) % 50 == 0) {
+      offset = 0;
+      removed = length;
+      inserted = base;
+    }
+    CHECK_MEMORY(jsonc_document_edit(document, offset, removed, inserted,
+                                     strlen(inserted)));
+    if (!matches_reparse(document, &options)) {
+      fprintf(stderr, "seed %u step %d: %s\n", (unsigned)seed, step,
+              jsonc_document_source(document, NULL));
+      check_failures++;
+      break;
+    }
+  }
+  jsonc_document_free(document);
+  if (table) {
+    jsonc_intern_free(table);
+  }
+}
+
+int main(void) {
+  check_edits();
+  for (uint32_t seed = 1; seed <= 30; seed++) {
+    check_random(seed);
+  }
+  return CHECK_STATUS();
+}
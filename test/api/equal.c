@@ -0,0 +1,244 @@
+// jsonc_clone, jsonc_equal and jsonc_hash. Equality is symmetric in both
+// modes, including for objects with duplicate keys, small and large, values
+// that compare equal in either mode hash alike, and clones equal their
+// originals.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static jsonc_value parse(const char *source) {
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "cannot parse %s\n", source);
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+static bool equal(const jsonc_value *a, const jsonc_value *b,
+                  unsigned flags) {
+  bool result;
+  CHECK_MEMORY(jsonc_equal(a, b, flags, &result));
+  return result;
+}
+
+static uint64_t hash(const jsonc_value *value) {
+  uint64_t result;
+  CHECK_MEMORY(jsonc_hash(value, &result));
+  return result;
+}
+
+// Two documents, whether they are equal member by member and whether they
+// are equal when key order is ignored.
+static const struct {
+  const char *a;
+  const char *b;
+  bool ordered;
+  bool unordered;
+} cases[] = {
+    {"{\"a\": 1, \"b\": [1, 2, {\"c\": \"x\"}]}",
+     "{\"a\": 1, \"b\": [1, 2, {\"c\": \"x\"}]}", true, true},
+    {"{\"a\": 1, \"b\": 2}", "{\"b\": 2, \"a\": 1}", false, true},
+    {"{\"a\": {\"x\": 1, \"y\": 2}}", "{\"a\": {\"y\": 2, \"x\": 1}}", false,
+     true},
+    {"[1, 2]", "[2, 1]", false, false},
+    {"[1, 2]", "[1, 2, 3]", false, false},
+    {"[[]]", "[[], []]", false, false},
+    {"0", "-0", true, true},
+    {"\"a\"", "\"b\"", false, false},
+    {"\"a fairly long string\"", "\"a fairly long string\"", true, true},
+    {"null", "false", false, false},
+    {"[]", "{}", false, false},
+    {"{\"a\": {}}", "{\"a\": []}", false, false},
+    {"{\"a\": 1}", "{\"b\": 1}", false, false},
+    // Duplicate keys: the n-th member with a key pairs with the n-th member
+    // with that key on the other side, so no member is used twice.
+    {"{\"x\": 1, \"y\": 2}", "{\"x\": 1, \"x\": 1}", false, false},
+    {"{\"x\": 1, \"x\": 2}", "{\"x\": 1, \"x\": 2}", true, true},
+    {"{\"x\": 1, \"x\": 2}", "{\"x\": 2, \"x\": 1}", false, false},
+    {"{\"x\": 1, \"y\": 0, \"x\": 2}", "{\"y\": 0, \"x\": 1, \"x\": 2}", false,
+     true},
+    {"{\"y\": 0, \"x\": 1, \"x\": 2}", "{\"x\": 2, \"x\": 1, \"y\": 0}", false,
+     false},
+    {"{\"y\": 1, \"x\": 1, \"x\": 1}", "{\"x\": 1, \"x\": 1, \"z\": 1}", false,
+     false},
+};
+
+static void check_equal(void) {
+  for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+    jsonc_value a = parse(cases[i].a);
+    jsonc_value b = parse(cases[i].b);
+    CHECK(equal(&a, &b, 0) == cases[i].ordered);
+    CHECK(equal(&b, &a, 0) == cases[i].ordered);
+    CHECK(equal(&a, &b, JSONC_EQUAL_IGNORE_KEY_ORDER) == cases[i].unordered);
+    CHECK(equal(&b, &a, JSONC_EQUAL_IGNORE_KEY_ORDER) == cases[i].unordered);
+    if (cases[i].ordered || cases[i].unordered) {
+      CHECK(hash(&a) == hash(&b));
+    }
+    CHECK(equal(&a, &a, 0));
+    jsonc_free(a);
+    jsonc_free(b);
+  }
+}
+
+static void check_clone(void) {
+  jsonc_value value =
+      parse("{\"servers\": [{\"name\": \"a\", \"limits\": {\"cpu\": 1}},\n"
+            "             {\"x\": [true, null, \"a string that is long\"]}],\n"
+            " \"e\": {}, \"f\": []}");
+  jsonc_value *const clone = jsonc_clone(&value);
+  CHECK_MEMORY(!clone);
+  CHECK(equal(&value, clone, 0));
+  CHECK(hash(&value) == hash(clone));
+  jsonc_value *const again = jsonc_clone(clone);
+  CHECK_MEMORY(!again);
+  CHECK(equal(clone, again, 0));
+  jsonc_free(value);
+  // The clone owns all its memory.
+  CHECK(!strcmp(jsonc_string_get(&clone->value.object.entries[0]
+                                      .value.value.array.values[1]
+                                      .value.object.entries[0]
+                                      .value.value.array.values[2],
+                                 NULL),
+                "a string that is long"));
+  free(clone);
+  free(again);
+
+  jsonc_value scalar = parse("\"scalar\"");
+  jsonc_value *const copy = jsonc_clone(&scalar);
+  CHECK_MEMORY(!copy);
+  CHECK(!strcmp(jsonc_string_get(copy, NULL), "scalar"));
+  free(copy);
+  jsonc_free(scalar);
+}
+
+// An object of `count` members with keys k0 to k19, so that most keys
+// repeat, written with its members in the order `order` gives. The middle
+// member holds the same object, written the same way, `depth` times.
+static size_t write_object(char *out, const int *order, int count,
+                           int depth) {
+  size_t length = (size_t)sprintf(out, "{");
+  for (int n = 0; n < count; n++) {
+    const int i = order[n];
+    length += (size_t)sprintf(out + length, "%s\"k%d\": ", n ? ", " : "",
+                              i % 20);
+    if (i == count / 2 && depth) {
+      length += write_object(out + length, order, count, depth - 1);
+    } else {
+      length += (size_t)sprintf(out + length, "%d", i);
+    }
+  }
+  return length + (size_t)sprintf(out + length, "}");
+}
+
+// Objects too large to scan are paired through a hash index, also after
+// some members have been paired by position, and while the index of an
+// enclosing object is still in use.
+static void check_large(void) {
+  enum { COUNT = 60 };
+  int identity[COUNT];
+  int grouped[COUNT];
+  int reversed[COUNT];
+  int swapped[COUNT];
+  for (int i = 0; i < COUNT; i++) {
+    identity[i] = i;
+    reversed[i] = COUNT - 1 - i;
+  }
+  // The first five in place, then the rest by key, keeping the members with
+  // each key in order.
+  int n = 0;
+  for (int i = 0; i < 5; i++) {
+    grouped[n++] = i;
+  }
+  for (int key = 0; key < 20; key++) {
+    for (int i = 5; i < COUNT; i++) {
+      if (i % 20 == key) {
+        grouped[n++] = i;
+      }
+    }
+  }
+  memcpy(swapped, grouped, sizeof(grouped));
+  // Two members with key k7, so each meets the other's partner.
+  for (int i = 0; i < COUNT; i++) {
+    if (swapped[i] == 27) {
+      swapped[i] = 47;
+    } else if (swapped[i] == 47) {
+      swapped[i] = 27;
+    }
+  }
+  static char texts[4][8192];
+  const int *const orders[] = {identity, grouped, reversed, swapped};
+  jsonc_value values[4];
+  for (int i = 0; i < 4; i++) {
+    write_object(texts[i], orders[i], COUNT, 1);
+    values[i] = parse(texts[i]);
+  }
+  CHECK(!equal(&values[0], &values[1], 0));
+  CHECK(equal(&values[0], &values[1], JSONC_EQUAL_IGNORE_KEY_ORDER));
+  CHECK(equal(&values[1], &values[0], JSONC_EQUAL_IGNORE_KEY_ORDER));
+  CHECK(hash(&values[0]) == hash(&values[1]));
+  for (int i = 2; i < 4; i++) {
+    CHECK(!equal(&values[0], &values[i], JSONC_EQUAL_IGNORE_KEY_ORDER));
+    CHECK(!equal(&values[i], &values[0], JSONC_EQUAL_IGNORE_KEY_ORDER));
+    CHECK(!equal(&values[1], &values[i], JSONC_EQUAL_IGNORE_KEY_ORDER));
+  }
+  for (int i = 0; i < 4; i++) {
+    jsonc_free(values[i]);
+  }
+
+  // With a scan for each member, reversing this many would take minutes.
+  const int count = 100000;
+  char *const forward = malloc(24 * (size_t)count + 2);
+  char *const backward = malloc(24 * (size_t)count + 2);
+  CHECK_MEMORY(!forward || !backward);
+  size_t forward_length = (size_t)sprintf(forward, "{");
+  size_t backward_length = (size_t)sprintf(backward, "{");
+  for (int i = 0; i < count; i++) {
+    const char *const separator = i ? ", " : "";
+    forward_length += (size_t)sprintf(forward + forward_length,
+                                      "%s\"m%d\": %d", separator, i, i);
+    backward_length +=
+        (size_t)sprintf(backward + backward_length, "%s\"m%d\": %d",
+                        separator, count - 1 - i, count - 1 - i);
+  }
+  strcpy(forward + forward_length, "}");
+  strcpy(backward + backward_length, "}");
+  jsonc_value a = parse(forward);
+  jsonc_value b = parse(backward);
+  CHECK(equal(&a, &b, JSONC_EQUAL_IGNORE_KEY_ORDER));
+  CHECK(!equal(&a, &b, 0));
+  jsonc_free(a);
+  jsonc_free(b);
+  free(forward);
+  free(backward);
+}
+
+// Walks are iterative, so depth is bounded by memory only.
+static void check_deep(void) {
+  const size_t depth = 200000;
+  char *const source = malloc(2 * depth + 1);
+  CHECK_MEMORY(!source);
+  memset(source, '[', depth);
+  memset(source + depth, ']', depth);
+  source[2 * depth] = '\0';
+  jsonc_value value = parse(source);
+  jsonc_value *const clone = jsonc_clone(&value);
+  CHECK_MEMORY(!clone);
+  CHECK(equal(&value, clone, 0));
+  CHECK(hash(&value) == hash(clone));
+  free(clone);
+  jsonc_free(value);
+  free(source);
+}
+
+int main(void) {
+  check_equal();
+  check_large();
+  check_clone();
+  check_deep();
+  return CHECK_STATUS();
+}
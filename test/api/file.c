@@ -0,0 +1,225 @@
+// jsonc_parse_file on regular files and pipes gives what jsonc_parse_ex gives
+// on the same text: the same tree, or the same error at the same place,
+// whether it is near the start or the end of a file of many blocks, comes
+// from a limit, or from the text ending early. Read errors and the
+// asynchronous form are covered too.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+// An array of records, two megabytes long, with escapes throughout so
+// that some straddle the blocks the file is read in.
+static char *records(size_t *out_length) {
+  const size_t capacity = 2 << 20;
+  char *const text = malloc(capacity);
+  CHECK_MEMORY(!text);
+  size_t length = 0;
+  text[length++] = '[';
+  for (int i = 0; length < capacity - 200; i++) {
+    length += (size_t)snprintf(text + length, capacity - length,
+                               "%s{\"k\": \"v\\u00e9\\n%d\", \"n\": %d}",
+                               i ? ",\n" : "", i, i);
+  }
+  text[length++] = ']';
+  text[length] = '\0';
+  *out_length = length;
+  return text;
+}
+
+typedef struct pipe_writer {
+  int fd;
+  const char *text;
+  size_t length;
+} pipe_writer;
+
+static void *write_pipe(void *argument) {
+  pipe_writer *const writer = argument;
+  size_t written = 0;
+  while (written < writer->length) {
+    const ssize_t count = write(writer->fd, writer->text + written,
+                                writer->length - written);
+    if (count <= 0) {
+      break;
+    }
+    written += (size_t)count;
+  }
+  close(writer->fd);
+  return NULL;
+}
+
+// Parses the first `length` bytes of `text` from a temporary file, or from
+// a pipe that another thread writes them to.
+static jsonc_error parse_file(const char *text, size_t length,
+                              const jsonc_parse_options *options,
+                              bool use_pipe, jsonc_value *out) {
+  jsonc_error error;
+  if (!use_pipe) {
+    FILE *const file = tmpfile();
+    CHECK(file);
+    if (!file) {
+      exit(EXIT_FAILURE);
+    }
+    CHECK(fwrite(text, 1, length, file) == length);
+    rewind(file);
+    CHECK_MEMORY(jsonc_parse_file(file, options, out, &error));
+    // A document that parses has been read to the end.
+    if (error.code == JSONC_ERROR_NONE) {
+      CHECK(ftell(file) == (long)length && fgetc(file) == EOF);
+    }
+    fclose(file);
+    return error;
+  }
+  int fds[2];
+  CHECK(!pipe(fds));
+  pipe_writer writer = {.fd = fds[1], .text = text, .length = length};
+  pthread_t thread;
+  CHECK(!pthread_create(&thread, NULL, write_pipe, &writer));
+  FILE *const file = fdopen(fds[0], "rb");
+  CHECK(file);
+  CHECK_MEMORY(jsonc_parse_file(file, options, out, &error));
+  // Drain what is left so that the writer can finish.
+  while (fgetc(file) != EOF) {
+  }
+  fclose(file);
+  pthread_join(thread, NULL);
+  return error;
+}
+
+static bool same_error(const jsonc_error *a, const jsonc_error *b) {
+  return a->code == b->code && a->offset == b->offset &&
+         a->line == b->line && a->column == b->column;
+}
+
+// Parses `text` both ways and compares the results.
+static void check_text(const char *text, size_t length,
+                       const jsonc_parse_options *options, bool use_pipe,
+                       jsonc_error_code code) {
+  jsonc_value expected;
+  jsonc_error expected_error;
+  CHECK_MEMORY(jsonc_parse_ex(text, options, &expected, &expected_error));
+  CHECK(expected_error.code == code);
+  jsonc_value value;
+  const jsonc_error error =
+      parse_file(text, length, options, use_pipe, &value);
+  CHECK(same_error(&error, &expected_error));
+  if (error.code == JSONC_ERROR_NONE) {
+    bool equal = false;
+    if (expected_error.code == JSONC_ERROR_NONE) {
+      CHECK_MEMORY(jsonc_equal(&value, &expected, 0, &equal));
+    }
+    CHECK(equal);
+    jsonc_free(value);
+  }
+  if (expected_error.code == JSONC_ERROR_NONE) {
+    jsonc_free(expected);
+  }
+}
+
+static void check_source(bool use_pipe) {
+  size_t length;
+  char *const text = records(&length);
+  check_text(text, length, NULL, use_pipe, JSONC_ERROR_NONE);
+
+  // Errors near the end and near the start.
+  char *const bad = malloc(length + 1);
+  CHECK_MEMORY(!bad);
+  memcpy(bad, text, length + 1);
+  bad[length - 2] = '@';
+  check_text(bad, length, NULL, use_pipe, JSONC_ERROR_UNEXPECTED_CHARACTER);
+  bad[5] = '@';
+  check_text(bad, length, NULL, use_pipe, JSONC_ERROR_UNEXPECTED_CHARACTER);
+  free(bad);
+
+  // Limits, one of which stops the parse in the middle of the file.
+  jsonc_parse_options options = {.max_document_size = 1000000,
+                                 .max_string_length = 5};
+  check_text(text, length, &options, use_pipe,
+             JSONC_ERROR_MAX_STRING_LENGTH);
+  options.max_string_length = 0;
+  check_text(text, length, &options, use_pipe,
+             JSONC_ERROR_MAX_DOCUMENT_SIZE);
+  options.max_document_size = length;
+  check_text(text, length, &options, use_pipe, JSONC_ERROR_NONE);
+
+  // Text that ends early.
+  text[length - 1] = '\0';
+  check_text(text, length - 1, NULL, use_pipe, JSONC_ERROR_UNEXPECTED_END);
+  check_text("", 0, NULL, use_pipe, JSONC_ERROR_UNEXPECTED_END);
+  check_text("{\"a\": \"open", 11, NULL, use_pipe,
+             JSONC_ERROR_UNTERMINATED_STRING);
+  check_text(" 12 /* the end */", 17, NULL, use_pipe, JSONC_ERROR_NONE);
+  free(text);
+}
+
+// A directory opens but cannot be read.
+static void check_read_error(void) {
+  FILE *const directory = fopen(".", "rb");
+  if (!directory) {
+    return;
+  }
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_file(directory, NULL, &value, &error));
+  CHECK(error.code == JSONC_ERROR_READ && error.offset == 0);
+  fclose(directory);
+}
+
+typedef struct async_result {
+  pthread_mutex_t mutex;
+  pthread_cond_t called;
+  bool done;
+  bool ok;
+} async_result;
+
+static void async_done(void *context, err_t out_of_memory, jsonc_value value,
+                       const jsonc_error *error) {
+  async_result *const result = context;
+  const bool ok = !out_of_memory && error->code == JSONC_ERROR_NONE &&
+                  value.type == JSONC_VALUE_TYPE_ARRAY &&
+                  value.value.array.count == 3;
+  if (!out_of_memory && error->code == JSONC_ERROR_NONE) {
+    jsonc_free(value);
+  }
+  pthread_mutex_lock(&result->mutex);
+  result->ok = ok;
+  result->done = true;
+  pthread_cond_signal(&result->called);
+  pthread_mutex_unlock(&result->mutex);
+}
+
+static void check_async(void) {
+  FILE *const file = tmpfile();
+  CHECK(file);
+  if (!file) {
+    return;
+  }
+  fputs("[1, \"two\", {\"three\": 3}] // done\n", file);
+  rewind(file);
+  async_result result = {.done = false};
+  pthread_mutex_init(&result.mutex, NULL);
+  pthread_cond_init(&result.called, NULL);
+  CHECK_MEMORY(jsonc_parse_file_async(file, NULL, async_done, &result));
+  pthread_mutex_lock(&result.mutex);
+  while (!result.done) {
+    pthread_cond_wait(&result.called, &result.mutex);
+  }
+  pthread_mutex_unlock(&result.mutex);
+  CHECK(result.ok);
+  pthread_cond_destroy(&result.called);
+  pthread_mutex_destroy(&result.mutex);
+  fclose(file);
+}
+
+int main(void) {
+  check_source(false);
+  check_source(true);
+  check_read_error();
+  check_async();
+  return CHECK_STATUS();
+}
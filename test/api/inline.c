@@ -0,0 +1,111 @@
+// Inline strings: text of up to JSONC_SMALL_STRING_MAX bytes is kept in the
+// value itself, whether parsed, decoded from escapes or built, longer text is
+// not, and both forms read, compare, hash, clone and survive the builder the
+// same way.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static jsonc_value parse(const char *source) {
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "cannot parse %s\n", source);
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+// Whether `value` is a string holding the `length` bytes of `text`, and
+// whether it is stored inline.
+static bool holds(const jsonc_value *value, const char *text, size_t length,
+                  bool is_inline) {
+  size_t got;
+  const char *const string = jsonc_string_get(value, &got);
+  return value->type == JSONC_VALUE_TYPE_STRING && got == length &&
+         !memcmp(string, text, length) && string[length] == '\0' &&
+         (value->capacity != 0) == is_inline;
+}
+
+static void check_storage(void) {
+  jsonc_value value = parse(
+      "[\"\", \"fifteen bytes..\", \"sixteen bytes...\","
+      " \"\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\t\","
+      " \"\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\","
+      " \"a\\u0000b\", \"\\ud83d\\ude00\"]");
+  const jsonc_value *const strings = value.value.array.values;
+  CHECK(holds(&strings[0], "", 0, true));
+  CHECK(holds(&strings[1], "fifteen bytes..", 15, true));
+  CHECK(holds(&strings[2], "sixteen bytes...", 16, false));
+  // Escapes are decoded first, so what counts is the decoded length.
+  CHECK(holds(&strings[3], "\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9"
+                           "\xc3\xa9\t",
+              15, true));
+  CHECK(holds(&strings[4], "\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9"
+                           "\xc3\xa9\xc3\xa9",
+              16, false));
+  // Strings are NUL-terminated, so an escaped NUL ends one.
+  CHECK(holds(&strings[5], "a", 1, true));
+  CHECK(holds(&strings[6], "\xf0\x9f\x98\x80", 4, true));
+  jsonc_free(value);
+
+  jsonc_value built;
+  CHECK_MEMORY(jsonc_string_new("fifteen bytes..", &built));
+  CHECK(holds(&built, "fifteen bytes..", 15, true));
+  jsonc_free(built);
+  CHECK_MEMORY(jsonc_string_new("sixteen bytes...", &built));
+  CHECK(holds(&built, "sixteen bytes...", 16, false));
+  jsonc_free(built);
+}
+
+// A string stored on the heap equals, and hashes like, the same text stored
+// inline.
+static void check_mixed(void) {
+  jsonc_value parsed = parse("{\"k\": [\"short\", \"a longer string value\"]}");
+  jsonc_value heap = {.type = JSONC_VALUE_TYPE_STRING};
+  heap.value.string = malloc(sizeof("short"));
+  CHECK_MEMORY(!heap.value.string);
+  memcpy(heap.value.string, "short", sizeof("short"));
+  jsonc_value long_string;
+  CHECK_MEMORY(jsonc_string_new("a longer string value", &long_string));
+  jsonc_value array = jsonc_array_new();
+  CHECK_MEMORY(jsonc_array_push(&array, heap));
+  CHECK_MEMORY(jsonc_array_push(&array, long_string));
+  jsonc_value built = jsonc_object_new();
+  CHECK_MEMORY(jsonc_object_set(&built, "k", array));
+
+  bool equal;
+  CHECK_MEMORY(jsonc_equal(&parsed, &built, 0, &equal));
+  CHECK(equal);
+  uint64_t parsed_hash;
+  uint64_t built_hash;
+  CHECK_MEMORY(jsonc_hash(&parsed, &parsed_hash));
+  CHECK_MEMORY(jsonc_hash(&built, &built_hash));
+  CHECK(parsed_hash == built_hash);
+
+  // Moving a value within its container moves the text with it, and clones
+  // keep inline strings inline.
+  jsonc_value *const elements = jsonc_object_get(&parsed, "k");
+  CHECK_MEMORY(jsonc_array_insert(elements, 0, jsonc_null_new()));
+  CHECK(holds(&elements->value.array.values[1], "short", 5, true));
+  jsonc_array_remove(elements, 0);
+  CHECK(holds(&elements->value.array.values[0], "short", 5, true));
+  jsonc_value *const clone = jsonc_clone(&parsed);
+  CHECK_MEMORY(!clone);
+  CHECK(holds(&jsonc_object_get(clone, "k")->value.array.values[0], "short",
+              5, true));
+  CHECK_MEMORY(jsonc_equal(&built, clone, 0, &equal));
+  CHECK(equal);
+  free(clone);
+  jsonc_free(parsed);
+  jsonc_free(built);
+}
+
+int main(void) {
+  check_storage();
+  check_mixed();
+  return CHECK_STATUS();
+}
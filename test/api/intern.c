@@ -0,0 +1,108 @@
+// String interning: keys and short values parsed with a table are shared
+// between trees, longer values are not, lookups by interned key work, and
+// parses that fail leave the table usable.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static jsonc_value parse(const char *source, const jsonc_parse_options *options,
+                         jsonc_error_code code) {
+  jsonc_value value = {.type = JSONC_VALUE_TYPE_NULL};
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, options, &value, &error));
+  CHECK(error.code == code);
+  return value;
+}
+
+// An array of `count` records, each with a key of its own so that the table
+// has to grow.
+static char *records(int count) {
+  const size_t capacity = 128 * (size_t)count + 3;
+  char *const source = malloc(capacity);
+  CHECK_MEMORY(!source);
+  size_t length = 0;
+  source[length++] = '[';
+  for (int i = 0; i < count; i++) {
+    length += (size_t)snprintf(
+        source + length, capacity - length,
+        "%s{\"id\": %d, \"name\": \"name %d\", \"unit\": \"milliseconds each\","
+        " \"long\": \"a value that is past the limit\", \"k%d\": 1}",
+        i ? "," : "", i, i, i);
+  }
+  source[length++] = ']';
+  source[length] = '\0';
+  return source;
+}
+
+static void check_sharing(void) {
+  jsonc_intern *table;
+  CHECK_MEMORY(jsonc_intern_create(24, &table));
+  const jsonc_parse_options options = {.intern = table};
+  const int count = 2000;
+  char *const source = records(count);
+  jsonc_value first = parse(source, &options, JSONC_ERROR_NONE);
+  jsonc_value second = parse(source, &options, JSONC_ERROR_NONE);
+  CHECK(first.value.array.count == (size_t)count &&
+        second.value.array.count == (size_t)count);
+
+  const char *const id = jsonc_intern_find(table, "id");
+  const char *const unit = jsonc_intern_find(table, "unit");
+  CHECK(id && unit && !strcmp(id, "id"));
+  CHECK(jsonc_intern_find(table, "k1999"));
+  CHECK(!jsonc_intern_find(table, "absent"));
+  // Values longer than the limit, and those short enough to be stored
+  // inline, stay out of the table.
+  CHECK(jsonc_intern_find(table, "milliseconds each"));
+  CHECK(!jsonc_intern_find(table, "a value that is past the limit"));
+  CHECK(!jsonc_intern_find(table, "name 5"));
+
+  jsonc_value *const a = &first.value.array.values[5];
+  jsonc_value *const b = &second.value.array.values[7];
+  CHECK(a->value.object.entries[0].key == id);
+  CHECK(b->value.object.entries[0].key == id);
+  CHECK(a->value.object.entries[3].key == b->value.object.entries[3].key);
+  CHECK(jsonc_object_get(a, "unit")->value.string ==
+        jsonc_object_get(b, "unit")->value.string);
+  CHECK(jsonc_object_get(a, "long")->value.string !=
+        jsonc_object_get(b, "long")->value.string);
+  CHECK(jsonc_object_get_interned(a, id)->value.number == 5);
+  CHECK(!strcmp(jsonc_string_get(jsonc_object_get_interned(b, unit), NULL),
+                "milliseconds each"));
+  CHECK(!strcmp(jsonc_string_get(jsonc_object_get(a, "name"), NULL),
+                "name 5"));
+  jsonc_free_interned(first, table);
+  jsonc_free_interned(second, table);
+  free(source);
+
+  // The table outlives parses that fail with interned strings in flight.
+  parse("[{\"id\": \"milliseconds each\", \"x\": [\"s\", 1 2]}]", &options,
+        JSONC_ERROR_UNEXPECTED_TOKEN);
+  parse("{\"id\": \"milliseconds each\"} 1", &options,
+        JSONC_ERROR_TRAILING_DATA);
+  jsonc_value root =
+      parse("\"milliseconds each\"", &options, JSONC_ERROR_NONE);
+  CHECK(root.value.string == jsonc_intern_find(table, "milliseconds each"));
+  jsonc_free_interned(root, table);
+  jsonc_intern_free(table);
+}
+
+// With a limit of 0 only keys are interned.
+static void check_keys_only(void) {
+  jsonc_intern *table;
+  CHECK_MEMORY(jsonc_intern_create(0, &table));
+  const jsonc_parse_options options = {.intern = table};
+  jsonc_value value = parse("{\"a key\": \"a value that is long enough\"}",
+                            &options, JSONC_ERROR_NONE);
+  CHECK(jsonc_intern_find(table, "a key"));
+  CHECK(!jsonc_intern_find(table, "a value that is long enough"));
+  jsonc_free_interned(value, table);
+  jsonc_intern_free(table);
+}
+
+int main(void) {
+  check_sharing();
+  check_keys_only();
+  return CHECK_STATUS();
+}
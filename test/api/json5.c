@@ -0,0 +1,158 @@
+// The JSON5-style extensions: each input parses with its own flags, through
+// the tree and the pull reader, to the same value as the strict JSON next
+// to it; in strict mode it fails at the first character that needs them, and
+// with every other flag it still fails; and some inputs fail under all of
+// them.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <math.h>
+#include <string.h>
+
+// An input, the flags it needs, what it parses to as strict JSON (NULL for
+// NaN), and the error and offset it fails with in strict mode.
+static const struct {
+  const char *source;
+  unsigned flags;
+  const char *expected;
+  jsonc_error_code strict_code;
+  size_t strict_offset;
+} cases[] = {
+    {"{name: 1, _x$2: \"a\"}", JSONC_PARSE_UNQUOTED_KEYS,
+     "{\"name\": 1, \"_x$2\": \"a\"}", JSONC_ERROR_UNEXPECTED_CHARACTER, 2},
+    {"{\"a\": 1, b: [2,]}", JSONC_PARSE_UNQUOTED_KEYS, "{\"a\": 1, \"b\": [2]}",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 9},
+    {"'say \"hi\"'", JSONC_PARSE_SINGLE_QUOTES, "\"say \\\"hi\\\"\"",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 0},
+    {"'it\\'s \\t\\u0041'", JSONC_PARSE_SINGLE_QUOTES, "\"it's \\tA\"",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 0},
+    {"{'k': 'v'}", JSONC_PARSE_SINGLE_QUOTES, "{\"k\": \"v\"}",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 1},
+    {"0x1F", JSONC_PARSE_HEX_NUMBERS, "31", JSONC_ERROR_UNEXPECTED_CHARACTER,
+     1},
+    {"0XfF", JSONC_PARSE_HEX_NUMBERS, "255", JSONC_ERROR_UNEXPECTED_CHARACTER,
+     1},
+    {"-0xff", JSONC_PARSE_HEX_NUMBERS, "-255",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 2},
+    {"[0x10, 0x0]", JSONC_PARSE_HEX_NUMBERS, "[16, 0]",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 2},
+    {"+0x10", JSONC_PARSE_HEX_NUMBERS | JSONC_PARSE_LENIENT_NUMBERS, "16",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 0},
+    {"NaN", JSONC_PARSE_NAN_INFINITY, NULL, JSONC_ERROR_UNEXPECTED_CHARACTER,
+     0},
+    {"-NaN", JSONC_PARSE_NAN_INFINITY, NULL, JSONC_ERROR_UNEXPECTED_CHARACTER,
+     1},
+    {"[Infinity, -Infinity, +Infinity]", JSONC_PARSE_NAN_INFINITY,
+     "[1e999, -1e999, 1e999]", JSONC_ERROR_UNEXPECTED_CHARACTER, 1},
+    {"+1", JSONC_PARSE_LENIENT_NUMBERS, "1", JSONC_ERROR_UNEXPECTED_CHARACTER,
+     0},
+    {".5", JSONC_PARSE_LENIENT_NUMBERS, "0.5",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 0},
+    {"5.", JSONC_PARSE_LENIENT_NUMBERS, "5", JSONC_ERROR_UNEXPECTED_END, 2},
+    {"-.25", JSONC_PARSE_LENIENT_NUMBERS, "-0.25",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 1},
+    {"5.e2", JSONC_PARSE_LENIENT_NUMBERS, "500",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 2},
+    {"[.5, 5.]", JSONC_PARSE_LENIENT_NUMBERS, "[0.5, 5]",
+     JSONC_ERROR_UNEXPECTED_CHARACTER, 1},
+};
+
+// Inputs that fail even with every extension.
+static const struct {
+  const char *source;
+  jsonc_error_code code;
+  size_t offset;
+} failures[] = {
+    {"{true: 1}", JSONC_ERROR_UNEXPECTED_TOKEN, 1},
+    {"{a b: 1}", JSONC_ERROR_UNEXPECTED_TOKEN, 3},
+    {"Infinityx", JSONC_ERROR_UNEXPECTED_TOKEN, 0},
+    {"[1, nan]", JSONC_ERROR_UNEXPECTED_TOKEN, 4},
+    {"'open", JSONC_ERROR_UNTERMINATED_STRING, 0},
+    {"0x", JSONC_ERROR_UNEXPECTED_END, 2},
+    {"-0x", JSONC_ERROR_UNEXPECTED_END, 3},
+    {"0x1G", JSONC_ERROR_TRAILING_DATA, 3},
+    {".", JSONC_ERROR_UNEXPECTED_END, 1},
+};
+
+static jsonc_error parse(const char *source, unsigned flags,
+                         jsonc_value *out) {
+  const jsonc_parse_options options = {.flags = flags};
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, &options, out, &error));
+  return error;
+}
+
+// Whether the pull reader gets through `source` without an error.
+static bool reads(const char *source, unsigned flags) {
+  const jsonc_parse_options options = {.flags = flags};
+  jsonc_reader *reader;
+  CHECK_MEMORY(jsonc_reader_create(source, &options, &reader));
+  jsonc_event event;
+  do {
+    CHECK_MEMORY(jsonc_reader_next(reader, &event));
+  } while (event.type != JSONC_EVENT_EOF && event.type != JSONC_EVENT_ERROR);
+  jsonc_reader_destroy(reader);
+  return event.type == JSONC_EVENT_EOF;
+}
+
+static void check_case(size_t i) {
+  jsonc_value value;
+  jsonc_error error = parse(cases[i].source, cases[i].flags, &value);
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "case %zu: %s\n", i, jsonc_error_message(error.code));
+    check_failures++;
+    return;
+  }
+  if (cases[i].expected) {
+    jsonc_value expected;
+    CHECK(parse(cases[i].expected, 0, &expected).code == JSONC_ERROR_NONE);
+    bool equal;
+    CHECK_MEMORY(jsonc_equal(&value, &expected, 0, &equal));
+    CHECK(equal);
+    jsonc_free(expected);
+  } else {
+    CHECK(value.type == JSONC_VALUE_TYPE_NUMBER &&
+          isnan(value.value.number));
+  }
+  jsonc_free(value);
+  CHECK(reads(cases[i].source, cases[i].flags));
+  CHECK(reads(cases[i].source, JSONC_PARSE_JSON5));
+
+  error = parse(cases[i].source, 0, &value);
+  CHECK(error.code == cases[i].strict_code &&
+        error.offset == cases[i].strict_offset);
+  CHECK(!reads(cases[i].source, 0));
+  // The other flags may read it differently, but not accept it.
+  const unsigned others = JSONC_PARSE_JSON5 & ~cases[i].flags;
+  error = parse(cases[i].source, others, &value);
+  CHECK(error.code != JSONC_ERROR_NONE);
+  if (error.code == JSONC_ERROR_NONE) {
+    jsonc_free(value);
+  }
+  CHECK(!reads(cases[i].source, others));
+}
+
+static void check_failure(size_t i) {
+  jsonc_value value;
+  const jsonc_error error =
+      parse(failures[i].source, JSONC_PARSE_JSON5, &value);
+  if (error.code == JSONC_ERROR_NONE) {
+    fprintf(stderr, "failure %zu parses\n", i);
+    check_failures++;
+    jsonc_free(value);
+    return;
+  }
+  CHECK(error.code == failures[i].code && error.offset == failures[i].offset);
+  CHECK(!reads(failures[i].source, JSONC_PARSE_JSON5));
+}
+
+int main(void) {
+  for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+    check_case(i);
+  }
+  for (size_t i = 0; i < sizeof(failures) / sizeof(*failures); i++) {
+    check_failure(i);
+  }
+  return CHECK_STATUS();
+}
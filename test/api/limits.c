@@ -0,0 +1,103 @@
+// Parse limits: each limit accepts a document at the limit, rejects one past
+// it with its own code at the offending offset, and is enforced the same way
+// by the pull reader. Nesting far deeper than the C stack would allow parses.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static jsonc_error parse(const char *source,
+                         const jsonc_parse_options *options) {
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, options, &value, &error));
+  if (error.code == JSONC_ERROR_NONE) {
+    jsonc_free(value);
+  }
+  return error;
+}
+
+// The error that ends a walk of `source` with the pull reader.
+static jsonc_error read_all(const char *source,
+                            const jsonc_parse_options *options) {
+  jsonc_reader *reader;
+  CHECK_MEMORY(jsonc_reader_create(source, options, &reader));
+  jsonc_event event;
+  do {
+    CHECK_MEMORY(jsonc_reader_next(reader, &event));
+  } while (event.type != JSONC_EVENT_EOF && event.type != JSONC_EVENT_ERROR);
+  jsonc_error error = {.code = JSONC_ERROR_NONE};
+  if (event.type == JSONC_EVENT_ERROR) {
+    error = *jsonc_reader_error(reader);
+  }
+  jsonc_reader_destroy(reader);
+  return error;
+}
+
+static void check_limit(const jsonc_parse_options *options, const char *within,
+                        const char *beyond, jsonc_error_code code,
+                        size_t offset) {
+  CHECK(parse(within, options).code == JSONC_ERROR_NONE);
+  CHECK(read_all(within, options).code == JSONC_ERROR_NONE);
+  const jsonc_error error = parse(beyond, options);
+  CHECK(error.code == code);
+  CHECK(error.offset == offset);
+  const jsonc_error read = read_all(beyond, options);
+  CHECK(read.code == code);
+  CHECK(read.offset == offset);
+  // Without limits both documents are fine.
+  CHECK(parse(beyond, NULL).code == JSONC_ERROR_NONE);
+}
+
+static void check_limits(void) {
+  jsonc_parse_options options = {.max_depth = 2};
+  check_limit(&options, "[[1], {\"a\": 2}]", "[[1], {\"a\": [2]}]",
+              JSONC_ERROR_MAX_DEPTH, 12);
+
+  options = (jsonc_parse_options){.max_document_size = 5};
+  check_limit(&options, "[1,2]", "[1,23]", JSONC_ERROR_MAX_DOCUMENT_SIZE, 5);
+
+  options = (jsonc_parse_options){.max_string_length = 3};
+  check_limit(&options, "{\"abc\": \"\\u00e9x\"}", "[\"ab\", \"abcd\"]",
+              JSONC_ERROR_MAX_STRING_LENGTH, 7);
+
+  options = (jsonc_parse_options){.max_array_size = 2};
+  check_limit(&options, "[[1, 2], [3]]", "[[1, 2], [3, 4, 5]]",
+              JSONC_ERROR_MAX_ARRAY_SIZE, 16);
+
+  options = (jsonc_parse_options){.max_object_size = 1};
+  check_limit(&options, "[{\"a\": 1}, {}]",
+              "[{\"a\": 1}, {\"b\": 2, \"c\": 3}]", JSONC_ERROR_MAX_OBJECT_SIZE,
+              20);
+}
+
+static void check_deep_nesting(void) {
+  const size_t depth = 1000000;
+  char *const source = malloc(2 * depth + 1);
+  CHECK_MEMORY(!source);
+  memset(source, '[', depth);
+  memset(source + depth, ']', depth);
+  source[2 * depth] = '\0';
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  if (error.code == JSONC_ERROR_NONE) {
+    jsonc_free(value);
+  }
+
+  source[2 * depth - 1] = '\0';
+  CHECK(parse(source, NULL).code == JSONC_ERROR_UNEXPECTED_END);
+  jsonc_parse_options options = {.max_depth = 1000};
+  const jsonc_error limited = parse(source, &options);
+  CHECK(limited.code == JSONC_ERROR_MAX_DEPTH);
+  CHECK(limited.offset == 1000);
+  free(source);
+}
+
+int main(void) {
+  check_limits();
+  check_deep_nesting();
+  return CHECK_STATUS();
+}
@@ -0,0 +1,164 @@
+// The reusable parser: parses through one handle give the trees and errors
+// jsonc_parse_ex gives, round after round and with errors in between; once
+// warmed up, a parser that keeps its scratch at any size does not grow it
+// again; and one with a nonzero max_retained trims its scratch after a
+// large document and still parses correctly afterwards.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+#define MAX_RETAINED 4096
+// Each scratch buffer is trimmed on its own.
+#define SCRATCH_BUFFERS 6
+
+static char *large;
+static char *deep;
+static char *long_string;
+
+static void make_documents(void) {
+  const int records = 20000;
+  const size_t capacity = 96 * (size_t)records + 16;
+  large = malloc(capacity);
+  CHECK_MEMORY(!large);
+  size_t length = (size_t)sprintf(large, "[");
+  for (int i = 0; i < records; i++) {
+    length += (size_t)snprintf(
+        large + length, capacity - length,
+        "%s{\"id\": %d, \"name\": \"record number %d\", \"tags\": [%d, %d]}",
+        i ? ", " : "", i, i, i % 5, i % 11);
+  }
+  strcpy(large + length, "]");
+
+  const int depth = 300;
+  deep = malloc(2 * (size_t)depth + 2);
+  CHECK_MEMORY(!deep);
+  memset(deep, '[', depth);
+  deep[depth] = '1';
+  memset(deep + depth + 1, ']', depth);
+  deep[2 * depth + 1] = '\0';
+
+  const size_t characters = 100000;
+  long_string = malloc(characters + 3);
+  CHECK_MEMORY(!long_string);
+  long_string[0] = '"';
+  for (size_t i = 0; i < characters; i += 2) {
+    memcpy(long_string + 1 + i, i % 64 ? "ab" : "\\n", 2);
+  }
+  strcpy(long_string + 1 + characters, "\"");
+}
+
+// Documents that parse, then ones that fail, some of them after building
+// much of a tree.
+static const char *documents(size_t i) {
+  static const char *const fixed[] = {
+      "{\"a\": [1, 2.5, -3e2], \"b\": {\"c\": \"d\\n\\u00e9\"}, \"e\": null}",
+      "[]",
+      "\"a string too long to be stored inline\"",
+      "true",
+      "[1, 2",
+      "{\"a\": [{\"b\": 1}, {\"c\": \"unterminated",
+      "[1,,2]",
+      "{\"a\": {\"b\": [1, 2}}",
+      "",
+  };
+  static const size_t count = sizeof(fixed) / sizeof(*fixed);
+  if (i < count) {
+    return fixed[i];
+  }
+  const char *const generated[] = {large, deep, long_string};
+  return i - count < 3 ? generated[i - count] : NULL;
+}
+
+static bool same(const jsonc_value *a, const jsonc_value *b) {
+  bool equal;
+  CHECK_MEMORY(jsonc_equal(a, b, 0, &equal));
+  return equal;
+}
+
+// Parses `source` through `parser` and checks the outcome against
+// jsonc_parse_ex.
+static void check_parse(jsonc_parser *parser, const char *source,
+                        const jsonc_parse_options *options) {
+  jsonc_value expected;
+  jsonc_error expected_error;
+  CHECK_MEMORY(jsonc_parse_ex(source, options, &expected, &expected_error));
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parser_parse(parser, source, options, &value, &error));
+  bool passed = error.code == expected_error.code &&
+                error.offset == expected_error.offset &&
+                error.line == expected_error.line &&
+                error.column == expected_error.column;
+  if (error.code == JSONC_ERROR_NONE) {
+    passed = passed && same(&value, &expected);
+    jsonc_free(value);
+  }
+  if (expected_error.code == JSONC_ERROR_NONE) {
+    jsonc_free(expected);
+  }
+  if (!passed) {
+    fprintf(stderr, "%.40s: %s, expected %s\n", source,
+            jsonc_error_message(error.code),
+            jsonc_error_message(expected_error.code));
+    check_failures++;
+  }
+}
+
+static void check_rounds(void) {
+  jsonc_parser *kept;
+  jsonc_parser *trimmed;
+  CHECK_MEMORY(jsonc_parser_create(0, &kept));
+  CHECK_MEMORY(jsonc_parser_create(MAX_RETAINED, &trimmed));
+  // The depth limit fails the deep document part of the way in.
+  const jsonc_parse_options limited = {.max_depth = 100};
+  size_t warmed_up = 0;
+  for (int round = 0; round < 3; round++) {
+    for (size_t i = 0; documents(i); i++) {
+      for (int options = 0; options < 2; options++) {
+        const jsonc_parse_options *const chosen = options ? &limited : NULL;
+        check_parse(kept, documents(i), chosen);
+        check_parse(trimmed, documents(i), chosen);
+        CHECK(jsonc_parser_retained(trimmed) <=
+              SCRATCH_BUFFERS * MAX_RETAINED);
+      }
+    }
+    // Every document has been through the parser by the end of the first
+    // round, so its scratch is as large as it will get.
+    if (!round) {
+      warmed_up = jsonc_parser_retained(kept);
+      // Otherwise the trimmed parser would have had nothing to trim.
+      CHECK(warmed_up > SCRATCH_BUFFERS * MAX_RETAINED);
+    } else {
+      CHECK(jsonc_parser_retained(kept) == warmed_up);
+    }
+  }
+  jsonc_parser_free(kept);
+  jsonc_parser_free(trimmed);
+}
+
+// A trimmed parser regrows its scratch for the next large document, and
+// gives it up again afterwards.
+static void check_trim(void) {
+  jsonc_parser *parser;
+  CHECK_MEMORY(jsonc_parser_create(MAX_RETAINED, &parser));
+  const size_t initial = jsonc_parser_retained(parser);
+  CHECK(initial <= SCRATCH_BUFFERS * MAX_RETAINED);
+  for (int i = 0; i < 3; i++) {
+    check_parse(parser, large, NULL);
+    CHECK(jsonc_parser_retained(parser) <= SCRATCH_BUFFERS * MAX_RETAINED);
+    check_parse(parser, "{\"small\": [1]}", NULL);
+  }
+  jsonc_parser_free(parser);
+}
+
+int main(void) {
+  make_documents();
+  check_rounds();
+  check_trim();
+  free(large);
+  free(deep);
+  free(long_string);
+  return CHECK_STATUS();
+}
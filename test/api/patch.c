@@ -0,0 +1,322 @@
+// JSON Patch and merge patch: the cases in data/patch/, which include the
+// examples of RFC 6902, are applied and either give the expected document
+// or fail with the expected error at the expected operation and leave the
+// document unchanged; merge patches follow the examples of RFC 7386; and
+// the patches jsonc_diff computes between generated documents turn one into
+// the other in both formats, also when subtrees that differ hash alike.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static const char *data_path;
+
+static jsonc_value parse(const char *text) {
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(text, NULL, &value, &error));
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "cannot parse %s\n", text);
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+static jsonc_value parse_file(const char *name) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/patch/%s", data_path, name);
+  FILE *const file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "cannot open %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_file(file, NULL, &value, &error));
+  fclose(file);
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "%s:%zu:%zu: %s\n", path, error.line, error.column,
+            jsonc_error_message(error.code));
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+static bool equal(const jsonc_value *a, const jsonc_value *b) {
+  bool result;
+  CHECK_MEMORY(jsonc_equal(a, b, JSONC_EQUAL_IGNORE_KEY_ORDER, &result));
+  return result;
+}
+
+// A deep copy that, unlike jsonc_clone, can be patched.
+static jsonc_value copy(const jsonc_value *value) {
+  jsonc_value result;
+  switch (value->type) {
+  case JSONC_VALUE_TYPE_STRING:
+    CHECK_MEMORY(jsonc_string_new(jsonc_string_get(value, NULL), &result));
+    return result;
+  case JSONC_VALUE_TYPE_ARRAY:
+    result = jsonc_array_new();
+    for (size_t i = 0; i < value->value.array.count; i++) {
+      CHECK_MEMORY(
+          jsonc_array_push(&result, copy(&value->value.array.values[i])));
+    }
+    return result;
+  case JSONC_VALUE_TYPE_OBJECT:
+    result = jsonc_object_new();
+    for (size_t i = 0; i < value->value.object.count; i++) {
+      const jsonc_object_entry *const entry = &value->value.object.entries[i];
+      CHECK_MEMORY(jsonc_object_set(&result, entry->key, copy(&entry->value)));
+    }
+    return result;
+  default:
+    return *value;
+  }
+}
+
+static jsonc_error_code error_code(const char *name) {
+  if (!strcmp(name, "invalid")) {
+    return JSONC_ERROR_PATCH_INVALID;
+  }
+  if (!strcmp(name, "path")) {
+    return JSONC_ERROR_PATCH_PATH;
+  }
+  if (!strcmp(name, "test")) {
+    return JSONC_ERROR_PATCH_TEST;
+  }
+  fprintf(stderr, "unknown error %s\n", name);
+  exit(EXIT_FAILURE);
+}
+
+static void check_cases(const char *name) {
+  jsonc_value cases = parse_file(name);
+  for (size_t i = 0; i < cases.value.array.count; i++) {
+    const jsonc_value *const test = &cases.value.array.values[i];
+    const char *const comment =
+        jsonc_string_get(jsonc_pointer_get(test, "/comment"), NULL);
+    const jsonc_value *const doc = jsonc_pointer_get(test, "/doc");
+    const jsonc_value *const patch = jsonc_pointer_get(test, "/patch");
+    const jsonc_value *const expected = jsonc_pointer_get(test, "/expected");
+    const jsonc_value *const error_name = jsonc_pointer_get(test, "/error");
+    jsonc_value target = copy(doc);
+    jsonc_error error;
+    CHECK_MEMORY(
+        jsonc_apply_patch(&target, patch, JSONC_DIFF_JSON_PATCH, &error));
+    bool passed;
+    if (expected) {
+      passed = error.code == JSONC_ERROR_NONE && equal(&target, expected);
+    } else {
+      const jsonc_value *const index = jsonc_pointer_get(test, "/index");
+      passed = error.code == error_code(jsonc_string_get(error_name, NULL)) &&
+               error.offset == (size_t)index->value.number &&
+               equal(&target, doc);
+    }
+    if (!passed) {
+      fprintf(stderr, "%s: %s: %s at %zu\n", name, comment,
+              jsonc_error_message(error.code), error.offset);
+      check_failures++;
+    }
+    jsonc_free(target);
+  }
+  jsonc_free(cases);
+}
+
+// The examples of RFC 7386, Appendix A.
+static void check_merge(void) {
+  static const struct {
+    const char *doc;
+    const char *patch;
+    const char *expected;
+  } cases[] = {
+      {"{\"a\": \"b\"}", "{\"a\": \"c\"}", "{\"a\": \"c\"}"},
+      {"{\"a\": \"b\"}", "{\"b\": \"c\"}", "{\"a\": \"b\", \"b\": \"c\"}"},
+      {"{\"a\": \"b\"}", "{\"a\": null}", "{}"},
+      {"{\"a\": \"b\", \"b\": \"c\"}", "{\"a\": null}", "{\"b\": \"c\"}"},
+      {"{\"a\": [\"b\"]}", "{\"a\": \"c\"}", "{\"a\": \"c\"}"},
+      {"{\"a\": \"c\"}", "{\"a\": [\"b\"]}", "{\"a\": [\"b\"]}"},
+      {"{\"a\": {\"b\": \"c\"}}", "{\"a\": {\"b\": \"d\", \"c\": null}}",
+       "{\"a\": {\"b\": \"d\"}}"},
+      {"{\"a\": [{\"b\": \"c\"}]}", "{\"a\": [1]}", "{\"a\": [1]}"},
+      {"[\"a\", \"b\"]", "[\"c\", \"d\"]", "[\"c\", \"d\"]"},
+      {"{\"a\": \"b\"}", "[\"c\"]", "[\"c\"]"},
+      {"{\"a\": \"foo\"}", "null", "null"},
+      {"{\"a\": \"foo\"}", "\"bar\"", "\"bar\""},
+      {"{\"e\": null}", "{\"a\": 1}", "{\"e\": null, \"a\": 1}"},
+      {"[1, 2]", "{\"a\": \"b\", \"c\": null}", "{\"a\": \"b\"}"},
+      {"{}", "{\"a\": {\"bb\": {\"ccc\": null}}}",
+       "{\"a\": {\"bb\": {}}}"},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+    jsonc_value target = parse(cases[i].doc);
+    jsonc_value patch = parse(cases[i].patch);
+    jsonc_value expected = parse(cases[i].expected);
+    jsonc_error error;
+    CHECK_MEMORY(
+        jsonc_apply_patch(&target, &patch, JSONC_DIFF_MERGE_PATCH, &error));
+    CHECK(error.code == JSONC_ERROR_NONE && equal(&target, &expected));
+    jsonc_free(target);
+    jsonc_free(patch);
+    jsonc_free(expected);
+  }
+}
+
+static uint64_t random_state = 88172645463325252u;
+
+static uint64_t next_random(void) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return random_state;
+}
+
+// A random document; merge patches cannot set null, so `nulls` says whether
+// it may have any.
+static jsonc_value generate(int depth, bool nulls) {
+  const uint64_t choice = next_random() % (depth ? 8 : 5);
+  char key[16];
+  jsonc_value value;
+  switch (choice) {
+  case 0:
+    return nulls ? jsonc_null_new() : jsonc_boolean_new(true);
+  case 1:
+    return jsonc_boolean_new(next_random() % 2);
+  case 2:
+  case 3:
+    return jsonc_number_new((double)(next_random() % 10));
+  case 4:
+    snprintf(key, sizeof(key), "s%d", (int)(next_random() % 4));
+    CHECK_MEMORY(jsonc_string_new(key, &value));
+    return value;
+  case 5:
+  case 6:
+    value = jsonc_object_new();
+    for (uint64_t i = next_random() % 6; i; i--) {
+      snprintf(key, sizeof(key), "k%d", (int)(next_random() % 8));
+      CHECK_MEMORY(jsonc_object_set(&value, key, generate(depth - 1, nulls)));
+    }
+    return value;
+  default:
+    value = jsonc_array_new();
+    for (uint64_t i = next_random() % 6; i; i--) {
+      CHECK_MEMORY(jsonc_array_push(&value, generate(depth - 1, nulls)));
+    }
+    return value;
+  }
+}
+
+// Changes a few places in `value`, so that the two documents share most of
+// their structure, as the documents diffed in practice do.
+static void mutate(jsonc_value *value, int depth, bool nulls) {
+  if (value->type == JSONC_VALUE_TYPE_ARRAY) {
+    jsonc_array *const array = &value->value.array;
+    const uint64_t choice = next_random() % 5;
+    if (choice == 0 || !array->count) {
+      CHECK_MEMORY(jsonc_array_insert(value,
+                                      next_random() % (array->count + 1),
+                                      generate(depth, nulls)));
+    } else if (choice == 1) {
+      jsonc_array_remove(value, next_random() % array->count);
+    } else {
+      mutate(&array->values[next_random() % array->count], depth - 1, nulls);
+    }
+  } else if (value->type == JSONC_VALUE_TYPE_OBJECT) {
+    jsonc_object *const object = &value->value.object;
+    const uint64_t choice = next_random() % 5;
+    char key[16];
+    snprintf(key, sizeof(key), "k%d", (int)(next_random() % 10));
+    if (choice == 0 || !object->count) {
+      CHECK_MEMORY(jsonc_object_set(value, key, generate(depth, nulls)));
+    } else if (choice == 1) {
+      jsonc_object_remove(value, key);
+    } else {
+      mutate(&object->entries[next_random() % object->count].value,
+             depth - 1, nulls);
+    }
+  } else {
+    jsonc_free(*value);
+    *value = generate(depth, nulls);
+  }
+}
+
+static void check_round_trip(jsonc_diff_format format) {
+  const bool nulls = format == JSONC_DIFF_JSON_PATCH;
+  for (int i = 0; i < 2000; i++) {
+    jsonc_value a = generate(4, nulls);
+    jsonc_value b = copy(&a);
+    for (int changes = i % 4; changes >= 0; changes--) {
+      mutate(&b, 4, nulls);
+    }
+    jsonc_value patch;
+    CHECK_MEMORY(jsonc_diff(&a, &b, format, &patch));
+    jsonc_error error;
+    CHECK_MEMORY(jsonc_apply_patch(&a, &patch, format, &error));
+    if (error.code != JSONC_ERROR_NONE || !equal(&a, &b)) {
+      fprintf(stderr, "round trip %d: %s\n", i,
+              jsonc_error_message(error.code));
+      check_failures++;
+    }
+    // An empty patch between equal documents, except that a merge patch
+    // between documents that are not both objects is the second one.
+    jsonc_value empty;
+    CHECK_MEMORY(jsonc_diff(&a, &b, format, &empty));
+    if (format == JSONC_DIFF_JSON_PATCH) {
+      CHECK(empty.type == JSONC_VALUE_TYPE_ARRAY &&
+            empty.value.array.count == 0);
+    } else if (a.type == JSONC_VALUE_TYPE_OBJECT) {
+      CHECK(empty.type == JSONC_VALUE_TYPE_OBJECT &&
+            empty.value.object.count == 0);
+    } else {
+      CHECK(equal(&empty, &b));
+    }
+    jsonc_free(empty);
+    jsonc_free(patch);
+    jsonc_free(a);
+    jsonc_free(b);
+  }
+}
+
+// Object hashes add up the hashes of the members, so these objects hash
+// alike, as if their hashes collided. jsonc_diff matches members by their
+// first key, which differs, so the patch must not be empty.
+static void check_same_hash(void) {
+  static const char text_a[] = "{\"x\": [{\"a\": 1, \"a\": 2}], \"y\": 0}";
+  jsonc_value a = parse(text_a);
+  jsonc_value b = parse("{\"x\": [{\"a\": 2, \"a\": 1}], \"y\": 0}");
+  uint64_t hash_a;
+  uint64_t hash_b;
+  CHECK_MEMORY(jsonc_hash(&a, &hash_a));
+  CHECK_MEMORY(jsonc_hash(&b, &hash_b));
+  CHECK(hash_a == hash_b);
+  for (int format = JSONC_DIFF_JSON_PATCH; format <= JSONC_DIFF_MERGE_PATCH;
+       format++) {
+    // Not copy(), which would keep one member of each key.
+    jsonc_value target = parse(text_a);
+    jsonc_value patch;
+    CHECK_MEMORY(jsonc_diff(&a, &b, format, &patch));
+    jsonc_error error;
+    CHECK_MEMORY(jsonc_apply_patch(&target, &patch, format, &error));
+    const jsonc_value *const first = jsonc_pointer_get(&target, "/x/0/a");
+    CHECK(error.code == JSONC_ERROR_NONE && first &&
+          first->type == JSONC_VALUE_TYPE_NUMBER && first->value.number == 2);
+    jsonc_free(patch);
+    jsonc_free(target);
+  }
+  jsonc_free(a);
+  jsonc_free(b);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <test data directory>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  data_path = argv[1];
+  check_cases("rfc6902.json");
+  check_cases("errors.json");
+  check_merge();
+  check_same_hash();
+  check_round_trip(JSONC_DIFF_JSON_PATCH);
+  check_round_trip(JSONC_DIFF_MERGE_PATCH);
+  return CHECK_STATUS();
+}
@@ -0,0 +1,127 @@
+// JSON Pointer lookup in a parsed tree and single-pass extraction from the
+// source agree on every pointer, including escapes, the empty key, duplicate
+// keys and pointers that name nothing. Extraction stops reading once every
+// pointer is resolved.
+
+#include "check.h"
+#include "jsonc.h"
+
+static const char source[] =
+    "{\"servers\": [{\"name\": \"a\", \"limits\": {\"cpu\": 1}},\n"
+    "              {\"name\": \"b\"},\n"
+    "              {\"x\": [1, 2, {\"y\": null}]},\n"
+    "              {\"limits\":\n"
+    "                {\"cpu\": 4.5, \"m/e\": \"q\", \"t~\": true}}],\n"
+    " \"a\": 1, \"a\": 2, \"\": {\"\": 7}} // trailing comment\n";
+
+// A pointer and what it names, as JSON text, or NULL if it names nothing.
+static const struct {
+  const char *pointer;
+  const char *expected;
+} cases[] = {
+    {"/servers/3/limits/cpu", "4.5"},
+    {"/servers/3/limits", "{\"cpu\": 4.5, \"m/e\": \"q\", \"t~\": true}"},
+    {"/servers/0/name", "\"a\""},
+    {"/servers/2/x/2/y", "null"},
+    {"/servers/3/limits/m~1e", "\"q\""},
+    {"/servers/3/limits/t~0", "true"},
+    {"/a", "1"},
+    {"/", "{\"\": 7}"},
+    {"//", "7"},
+    {"/servers/9", NULL},
+    {"/servers/01", NULL},
+    {"/servers/-", NULL},
+    {"/servers/1/name/x", NULL},
+    {"/missing", NULL},
+    {"no-slash", NULL},
+    {"/servers/3/limits/t~2", NULL},
+};
+
+#define CASE_COUNT (sizeof(cases) / sizeof(*cases))
+
+static bool equals_text(const jsonc_value *value, const char *text) {
+  jsonc_value expected;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(text, NULL, &expected, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  bool equal = false;
+  if (error.code == JSONC_ERROR_NONE) {
+    CHECK_MEMORY(jsonc_equal(value, &expected, 0, &equal));
+    jsonc_free(expected);
+  }
+  return equal;
+}
+
+static void check_lookup(void) {
+  jsonc_value root;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &root, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  if (error.code != JSONC_ERROR_NONE) {
+    return;
+  }
+  CHECK(jsonc_pointer_get(&root, "") == &root);
+
+  const char *pointers[CASE_COUNT];
+  for (size_t i = 0; i < CASE_COUNT; i++) {
+    pointers[i] = cases[i].pointer;
+  }
+  jsonc_value values[CASE_COUNT];
+  bool found[CASE_COUNT];
+  CHECK_MEMORY(jsonc_extract(source, NULL, pointers, CASE_COUNT, values, found,
+                             &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  for (size_t i = 0; i < CASE_COUNT; i++) {
+    const jsonc_value *const got = jsonc_pointer_get(&root, cases[i].pointer);
+    if (cases[i].expected) {
+      CHECK(got && equals_text(got, cases[i].expected));
+      CHECK(found[i] && equals_text(&values[i], cases[i].expected));
+    } else {
+      CHECK(!got);
+      CHECK(!found[i]);
+    }
+    if (found[i]) {
+      jsonc_free(values[i]);
+    }
+  }
+  jsonc_free(root);
+}
+
+static void check_extract_stops(void) {
+  const char *const pointer = "/a";
+  jsonc_value value;
+  bool found;
+  jsonc_error error;
+  // What follows the resolved value is never read.
+  CHECK_MEMORY(
+      jsonc_extract("{\"a\": 1, garbage", NULL, &pointer, 1, &value, &found,
+                    &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  CHECK(found && value.type == JSONC_VALUE_TYPE_NUMBER &&
+        value.value.number == 1);
+  if (found) {
+    jsonc_free(value);
+  }
+  // What precedes it is, and skipped subtrees are still validated.
+  CHECK_MEMORY(jsonc_extract("{\"b\": [1,}, \"a\": 1}", NULL, &pointer, 1,
+                             &value, &found, &error));
+  CHECK(error.code == JSONC_ERROR_UNEXPECTED_TOKEN);
+  CHECK(error.line == 1 && error.column == 10);
+  CHECK(!found);
+
+  // A syntax error in a value being extracted leaves nothing behind, even
+  // for the pointers already resolved.
+  const char *const pointers[] = {"/b/0", "/a"};
+  jsonc_value values[2];
+  bool founds[2];
+  CHECK_MEMORY(jsonc_extract("{\"b\": [\"s\"], \"a\": [1 2]}", NULL, pointers,
+                             2, values, founds, &error));
+  CHECK(error.code == JSONC_ERROR_UNEXPECTED_TOKEN);
+  CHECK(!founds[0] && !founds[1]);
+}
+
+int main(void) {
+  check_lookup();
+  check_extract_stops();
+  return CHECK_STATUS();
+}
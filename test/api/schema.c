@@ -0,0 +1,123 @@
+// Schema validation during the parse: each violation stops the parse with its
+// own code at the offending value, and jsonc_error_pointer names that value.
+// The pull reader enforces the same schema, and malformed keywords are
+// rejected when the schema is compiled.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static jsonc_value parse(const char *source) {
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "cannot parse %s\n", source);
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+static jsonc_schema *compile(const char *text) {
+  jsonc_value value = parse(text);
+  jsonc_schema *schema;
+  CHECK_MEMORY(jsonc_schema_compile(&value, &schema));
+  jsonc_free(value);
+  return schema;
+}
+
+static const char schema_text[] =
+    "{\"type\": \"object\", \"required\": [\"name\", \"id\"],\n"
+    " \"properties\": {\"name\": {\"type\": \"string\", \"maxLength\": 3},\n"
+    "  \"id\": {\"type\": \"integer\", \"minimum\": 1, \"maximum\": 10},\n"
+    "  \"mode\": {\"enum\": [\"a\", 2, null, true]},\n"
+    "  \"tags\": {\"type\": \"array\",\n"
+    "            \"items\": {\"type\": [\"string\", \"null\"]}},\n"
+    "  \"a/b~\": {\"properties\": {\"x\": false}},\n"
+    "  \"any\": true},\n"
+    " \"additionalProperties\": false, \"title\": \"ignored\"}";
+
+// A document, the error it fails with, and the offset and JSON Pointer of the
+// value the error is reported at.
+static const struct {
+  const char *document;
+  jsonc_error_code code;
+  size_t offset;
+  const char *pointer;
+} cases[] = {
+    {"{\"name\": \"\xc3\xa9\xc3\xa9\xc3\xa9\", \"id\": 3, \"any\": [{}],"
+     " \"tags\": [\"x\", null], \"mode\": null}",
+     JSONC_ERROR_NONE, 0, ""},
+    {"{\"name\": \"a\", \"id\": 1, \"mode\": \"a\"}", JSONC_ERROR_NONE, 0, ""},
+    {"{\"name\": \"abcd\", \"id\": 3}", JSONC_ERROR_SCHEMA_MAX_LENGTH, 9,
+     "/name"},
+    {"{\"name\": \"a\", \"id\": 3.5}", JSONC_ERROR_TYPE_MISMATCH, 20, "/id"},
+    {"{\"name\": \"a\", \"id\": 0}", JSONC_ERROR_SCHEMA_MINIMUM, 20, "/id"},
+    {"{\"name\": \"a\", \"id\": 11}", JSONC_ERROR_SCHEMA_MAXIMUM, 20, "/id"},
+    {"{\"name\": \"a\"}", JSONC_ERROR_SCHEMA_REQUIRED, 0, ""},
+    {"{\"name\": \"a\", \"id\": 1, \"zz\": 1}", JSONC_ERROR_SCHEMA_NOT_ALLOWED,
+     23, "/zz"},
+    {"{\"name\": \"a\", \"id\": 1, \"mode\": 3}", JSONC_ERROR_SCHEMA_ENUM, 31,
+     "/mode"},
+    {"{\"tags\": [\"x\", null, 1]}", JSONC_ERROR_TYPE_MISMATCH, 21,
+     "/tags/2"},
+    {"{\"a/b~\": {\"y\": 1, \"x\": 2}}", JSONC_ERROR_SCHEMA_NOT_ALLOWED, 23,
+     "/a~1b~0/x"},
+    {"[1]", JSONC_ERROR_TYPE_MISMATCH, 0, ""},
+};
+
+static void check_violations(const jsonc_schema *schema) {
+  const jsonc_parse_options options = {.schema = schema};
+  for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+    const char *const document = cases[i].document;
+    jsonc_value value;
+    jsonc_error error;
+    CHECK_MEMORY(jsonc_parse_ex(document, &options, &value, &error));
+    CHECK(error.code == cases[i].code);
+    if (error.code == JSONC_ERROR_NONE) {
+      jsonc_free(value);
+      continue;
+    }
+    CHECK(error.offset == cases[i].offset);
+    char *pointer;
+    CHECK_MEMORY(jsonc_error_pointer(document, &error, &pointer));
+    CHECK(!strcmp(pointer, cases[i].pointer));
+    free(pointer);
+
+    jsonc_reader *reader;
+    CHECK_MEMORY(jsonc_reader_create(document, &options, &reader));
+    jsonc_event event;
+    do {
+      CHECK_MEMORY(jsonc_reader_next(reader, &event));
+    } while (event.type != JSONC_EVENT_EOF && event.type != JSONC_EVENT_ERROR);
+    CHECK(event.type == JSONC_EVENT_ERROR &&
+          jsonc_reader_error(reader)->code == cases[i].code &&
+          jsonc_reader_error(reader)->offset == cases[i].offset);
+    jsonc_reader_destroy(reader);
+  }
+}
+
+static void check_malformed(void) {
+  static const char *const schemas[] = {
+      "{\"type\": \"integr\"}",
+      "{\"maxLength\": -1}",
+      "{\"required\": [1]}",
+      "{\"properties\": {\"a\": 1}}",
+      "{\"enum\": [[1]]}",
+  };
+  for (size_t i = 0; i < sizeof(schemas) / sizeof(*schemas); i++) {
+    CHECK(!compile(schemas[i]));
+  }
+}
+
+int main(void) {
+  jsonc_schema *const schema = compile(schema_text);
+  CHECK(schema);
+  if (schema) {
+    check_violations(schema);
+    jsonc_schema_free(schema);
+  }
+  check_malformed();
+  return CHECK_STATUS();
+}
@@ -0,0 +1,97 @@
+// Snapshots under contention: reader threads enter and leave while the main
+// thread publishes new versions and reclaims old ones. Every tree a reader
+// sees is whole, versions never go backwards, and a tree retained past
+// leaving stays valid. Run it under the tsan preset to check the ordering.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <pthread.h>
+#include <string.h>
+
+enum { READERS = 4, READS = 20000, VERSIONS = 2000 };
+
+static jsonc_snapshot *snapshot;
+
+static jsonc_shared *version(int number) {
+  char source[128];
+  snprintf(source, sizeof(source),
+           "{\"v\": %d, \"a\": [%d, %d, %d], \"s\": \"version number %d\"}",
+           number, number, number, number, number);
+  jsonc_value value;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &value, &error));
+  jsonc_shared *shared;
+  CHECK_MEMORY(jsonc_shared_create(value, &shared));
+  return shared;
+}
+
+// The version `shared` holds, or -1 if its tree is not whole.
+static int version_of(const jsonc_shared *shared) {
+  const jsonc_value *const root = jsonc_shared_root(shared);
+  const int number = (int)jsonc_pointer_get(root, "/v")->value.number;
+  char expected[32];
+  snprintf(expected, sizeof(expected), "version number %d", number);
+  const jsonc_value *const array = jsonc_pointer_get(root, "/a");
+  for (size_t i = 0; i < 3; i++) {
+    if (array->value.array.values[i].value.number != number) {
+      return -1;
+    }
+  }
+  if (strcmp(jsonc_string_get(jsonc_pointer_get(root, "/s"), NULL),
+             expected)) {
+    return -1;
+  }
+  return number;
+}
+
+// Returns the number of reads that went wrong.
+static void *read_versions(void *argument) {
+  const size_t reader = (size_t)argument;
+  size_t failures = 0;
+  int last = -1;
+  jsonc_shared *kept = NULL;
+  for (int i = 0; i < READS; i++) {
+    jsonc_shared *const shared = jsonc_snapshot_enter(snapshot, reader);
+    const int number = shared ? version_of(shared) : -1;
+    failures += number < last;
+    last = number;
+    if (i % 97 == 0) {
+      jsonc_shared_release(kept);
+      kept = jsonc_shared_retain(shared);
+    }
+    jsonc_snapshot_leave(snapshot, reader);
+    failures += kept && version_of(kept) < 0;
+  }
+  jsonc_shared_release(kept);
+  return (void *)failures;
+}
+
+int main(void) {
+  CHECK_MEMORY(jsonc_snapshot_create(READERS, version(0), &snapshot));
+  pthread_t threads[READERS];
+  for (size_t i = 0; i < READERS; i++) {
+    CHECK(!pthread_create(&threads[i], NULL, read_versions, (void *)i));
+  }
+  for (int number = 1; number <= VERSIONS; number++) {
+    CHECK_MEMORY(jsonc_snapshot_publish(snapshot, version(number)));
+    if (number % 16 == 0) {
+      jsonc_snapshot_reclaim(snapshot);
+    }
+  }
+  for (size_t i = 0; i < READERS; i++) {
+    void *failures;
+    CHECK(!pthread_join(threads[i], &failures));
+    CHECK(!failures);
+  }
+
+  jsonc_snapshot_reclaim(snapshot);
+  jsonc_shared *const current = jsonc_snapshot_enter(snapshot, 0);
+  CHECK(current && version_of(current) == VERSIONS);
+  jsonc_snapshot_leave(snapshot, 0);
+  CHECK_MEMORY(jsonc_snapshot_publish(snapshot, NULL));
+  CHECK(!jsonc_snapshot_enter(snapshot, 0));
+  jsonc_snapshot_leave(snapshot, 0);
+  jsonc_snapshot_free(snapshot);
+  return CHECK_STATUS();
+}
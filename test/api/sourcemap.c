@@ -0,0 +1,218 @@
+// Source maps: the spans of values and keys, with their line and column,
+// across a document with nested and empty containers and escaped strings;
+// nodes that are not in the tree; a failed parse leaving the map empty;
+// jsonc_source_map_locate agreeing with the line and column of errors; a
+// long document through a reused parser; and jsonc_parse_file.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+static const char document[] = "{\n"
+                               "  \"name\": \"demo\",\n"
+                               "  \"list\": [1, true, null,\n"
+                               "           {\"deep\": [] }],\n"
+                               "  \"nested\": {\"a\": {\"b\": \"\\u00e9\"}},\n"
+                               "  \"text\": \"tab\\there\"\n"
+                               "}";
+
+// A node's text, its key's text (NULL for none), and the line and column of
+// each.
+static const struct {
+  const char *pointer;
+  const char *text;
+  size_t line;
+  size_t column;
+  const char *key;
+  size_t key_line;
+  size_t key_column;
+} cases[] = {
+    {"", document, 1, 1, NULL, 0, 0},
+    {"/name", "\"demo\"", 2, 11, "\"name\"", 2, 3},
+    {"/list", "[1, true, null,\n           {\"deep\": [] }]", 3, 11,
+     "\"list\"", 3, 3},
+    {"/list/0", "1", 3, 12, NULL, 0, 0},
+    {"/list/1", "true", 3, 15, NULL, 0, 0},
+    {"/list/2", "null", 3, 21, NULL, 0, 0},
+    {"/list/3", "{\"deep\": [] }", 4, 12, NULL, 0, 0},
+    {"/list/3/deep", "[]", 4, 21, "\"deep\"", 4, 13},
+    {"/nested", "{\"a\": {\"b\": \"\\u00e9\"}}", 5, 13, "\"nested\"", 5, 3},
+    {"/nested/a", "{\"b\": \"\\u00e9\"}", 5, 19, "\"a\"", 5, 14},
+    {"/nested/a/b", "\"\\u00e9\"", 5, 25, "\"b\"", 5, 20},
+    {"/text", "\"tab\\there\"", 6, 11, "\"text\"", 6, 3},
+};
+
+static bool spans(jsonc_source_map *map, const char *source, jsonc_span span,
+                  const char *text, size_t line, size_t column) {
+  size_t found_line;
+  size_t found_column;
+  CHECK_MEMORY(jsonc_source_map_locate(map, source, span.offset, &found_line,
+                                       &found_column));
+  return span.length == strlen(text) &&
+         !memcmp(source + span.offset, text, span.length) &&
+         found_line == line && found_column == column;
+}
+
+static void check_document(void) {
+  jsonc_source_map *map;
+  CHECK_MEMORY(jsonc_source_map_create(&map));
+  const jsonc_parse_options options = {.source_map = map};
+  jsonc_value root;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(document, &options, &root, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+    const jsonc_value *const value = jsonc_pointer_get(&root, cases[i].pointer);
+    jsonc_span span;
+    jsonc_span key;
+    if (!value || !jsonc_source_map_find(map, value, &span, &key)) {
+      fprintf(stderr, "%s: not found\n", cases[i].pointer);
+      check_failures++;
+      continue;
+    }
+    CHECK(spans(map, document, span, cases[i].text, cases[i].line,
+                cases[i].column));
+    if (cases[i].key) {
+      CHECK(spans(map, document, key, cases[i].key, cases[i].key_line,
+                  cases[i].key_column));
+    } else {
+      CHECK(key.offset == 0 && key.length == 0);
+    }
+    // Either output may be left out.
+    CHECK(jsonc_source_map_find(map, value, NULL, NULL));
+  }
+
+  // Copies of nodes, and nodes of other trees, are not in the tree.
+  const jsonc_value name = *jsonc_pointer_get(&root, "/name");
+  const jsonc_value list = *jsonc_pointer_get(&root, "/list");
+  jsonc_value other;
+  CHECK_MEMORY(jsonc_parse_ex("{\"name\": \"demo\"}", NULL, &other, &error));
+  CHECK(!jsonc_source_map_find(map, &name, NULL, NULL));
+  CHECK(!jsonc_source_map_find(map, &list, NULL, NULL));
+  CHECK(!jsonc_source_map_find(map, &other, NULL, NULL));
+  CHECK(!jsonc_source_map_find(map, jsonc_pointer_get(&other, "/name"), NULL,
+                               NULL));
+  jsonc_free(other);
+
+  // A failed parse leaves the map empty, and locate indexes the new source.
+  static const char invalid[] = "{\n  \"a\": [1,\n     2,,]\n}";
+  jsonc_value unused;
+  CHECK_MEMORY(jsonc_parse_ex(invalid, &options, &unused, &error));
+  CHECK(error.code != JSONC_ERROR_NONE);
+  CHECK(!jsonc_source_map_find(map, &root, NULL, NULL));
+  size_t line;
+  size_t column;
+  CHECK_MEMORY(
+      jsonc_source_map_locate(map, invalid, error.offset, &line, &column));
+  CHECK(line == error.line && column == error.column && line == 3);
+  jsonc_free(root);
+
+  // Scalars at the root, and offsets past the last newline.
+  static const char scalar[] = "\n\n   \"x\"  ";
+  CHECK_MEMORY(jsonc_parse_ex(scalar, &options, &root, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  jsonc_span span;
+  jsonc_span key;
+  CHECK(jsonc_source_map_find(map, &root, &span, &key));
+  CHECK(spans(map, scalar, span, "\"x\"", 3, 4) && key.length == 0);
+  CHECK_MEMORY(jsonc_source_map_locate(map, scalar, sizeof(scalar) - 1, &line,
+                                       &column));
+  CHECK(line == 3 && column == 9);
+  jsonc_free(root);
+  jsonc_source_map_free(map);
+}
+
+// One record a line, parsed twice with one parser and one map, so the second
+// parse must replace everything the first recorded.
+static void check_long(void) {
+  const int count = 20000;
+  const size_t capacity = 64 * (size_t)count + 16;
+  char *const source = malloc(capacity);
+  CHECK_MEMORY(!source);
+  size_t length = (size_t)sprintf(source, "[");
+  for (int i = 0; i < count; i++) {
+    length += (size_t)snprintf(source + length, capacity - length,
+                               "\n  {\"id\": %d, \"tags\": [\"t%d\"]}%s", i,
+                               i % 7, i + 1 < count ? "," : "\n]");
+  }
+  jsonc_parser *parser;
+  jsonc_source_map *map;
+  CHECK_MEMORY(jsonc_parser_create(0, &parser));
+  CHECK_MEMORY(jsonc_source_map_create(&map));
+  const jsonc_parse_options options = {.source_map = map};
+  for (int round = 0; round < 2; round++) {
+    jsonc_value root;
+    jsonc_error error;
+    CHECK_MEMORY(jsonc_parser_parse(parser, round ? source : "[[1], {}]",
+                                    &options, &root, &error));
+    CHECK(error.code == JSONC_ERROR_NONE);
+    if (!round) {
+      jsonc_free(root);
+      continue;
+    }
+    size_t failures = 0;
+    for (int i = 0; i < count; i++) {
+      const jsonc_value *const record = &root.value.array.values[i];
+      const jsonc_object_entry *const id = &record->value.object.entries[0];
+      const jsonc_value *const tag =
+          &record->value.object.entries[1].value.value.array.values[0];
+      jsonc_span span;
+      jsonc_span key;
+      jsonc_span tag_span;
+      size_t line;
+      size_t column;
+      if (!jsonc_source_map_find(map, record, &span, NULL) ||
+          !jsonc_source_map_find(map, &id->value, NULL, &key) ||
+          !jsonc_source_map_find(map, tag, &tag_span, NULL)) {
+        failures++;
+        continue;
+      }
+      CHECK_MEMORY(
+          jsonc_source_map_locate(map, source, span.offset, &line, &column));
+      char text[16];
+      snprintf(text, sizeof(text), "\"t%d\"", i % 7);
+      failures += line != (size_t)i + 2 || column != 3 ||
+                  source[span.offset] != '{' ||
+                  source[span.offset + span.length - 1] != '}' ||
+                  key.offset != span.offset + 1 || key.length != 4 ||
+                  tag_span.length != strlen(text) ||
+                  memcmp(source + tag_span.offset, text, tag_span.length);
+    }
+    CHECK(failures == 0);
+    jsonc_free(root);
+  }
+  jsonc_source_map_free(map);
+  jsonc_parser_free(parser);
+  free(source);
+}
+
+static void check_file(void) {
+  static const char text[] = "  [1,\n   \"two\"]  \n";
+  FILE *const file = tmpfile();
+  CHECK_MEMORY(!file);
+  fputs(text, file);
+  rewind(file);
+  jsonc_source_map *map;
+  CHECK_MEMORY(jsonc_source_map_create(&map));
+  const jsonc_parse_options options = {.source_map = map};
+  jsonc_value root;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_file(file, &options, &root, &error));
+  fclose(file);
+  CHECK(error.code == JSONC_ERROR_NONE);
+  jsonc_span span;
+  CHECK(jsonc_source_map_find(map, &root, &span, NULL));
+  CHECK(spans(map, text, span, "[1,\n   \"two\"]", 1, 3));
+  CHECK(jsonc_source_map_find(map, &root.value.array.values[1], &span, NULL));
+  CHECK(spans(map, text, span, "\"two\"", 2, 4));
+  jsonc_free(root);
+  jsonc_source_map_free(map);
+}
+
+int main(void) {
+  check_document();
+  check_long();
+  check_file();
+  return CHECK_STATUS();
+}
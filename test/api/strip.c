@@ -0,0 +1,162 @@
+// jsonc_strip with each combination of flags, into a separate buffer and in
+// place: what is dropped and what is blanked out, comment markers inside
+// strings, lengths and the terminating NUL, unterminated comments with
+// their line and column, and a long document whose stripped text parses to
+// the same tree as the original.
+
+#include "check.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+// A source and its output with no flags, JSONC_STRIP_TRAILING_COMMAS,
+// JSONC_STRIP_PRESERVE_OFFSETS, and both.
+static const struct {
+  const char *source;
+  const char *expected[4];
+} cases[] = {
+    {"[1, 2] // end\n",
+     {"[1, 2] \n", "[1, 2] \n", "[1, 2]       \n", "[1, 2]       \n"}},
+    {"{\"a\": 1, /* c */ \"b\": [2,],}",
+     {"{\"a\": 1,  \"b\": [2,],}", "{\"a\": 1,  \"b\": [2]}",
+      "{\"a\": 1,         \"b\": [2,],}", "{\"a\": 1,         \"b\": [2 ] }"}},
+    {"\"// not\" /* x\ny */ 3",
+     {"\"// not\" \n 3", "\"// not\" \n 3", "\"// not\"     \n     3",
+      "\"// not\"     \n     3"}},
+    {"[\"a\\\"//\", 1 ,\n // c\n]",
+     {"[\"a\\\"//\", 1 ,\n \n]", "[\"a\\\"//\", 1 \n \n]",
+      "[\"a\\\"//\", 1 ,\n     \n]", "[\"a\\\"//\", 1  \n     \n]"}},
+    {"[1,/**/]", {"[1,]", "[1]", "[1,    ]", "[1     ]"}},
+    {"[1, 2,// x\n ]\t",
+     {"[1, 2,\n ]\t", "[1, 2\n ]\t", "[1, 2,    \n ]\t", "[1, 2     \n ]\t"}},
+    {"1 /* a */ /* b */",
+     {"1  ", "1  ", "1                ", "1                "}},
+    // A '/' that starts no comment, and a comma before nothing.
+    {"1 /", {"1 /", "1 /", "1 /", "1 /"}},
+    {"{\"k\": \"/*\"},", {"{\"k\": \"/*\"},", "{\"k\": \"/*\"},",
+                         "{\"k\": \"/*\"},", "{\"k\": \"/*\"},"}},
+    {"", {"", "", "", ""}},
+};
+
+// Unterminated comments, and where they start.
+static const struct {
+  const char *source;
+  size_t offset;
+  size_t line;
+  size_t column;
+} failures[] = {
+    {"/* open", 0, 1, 1},
+    {"1 // at the end", 2, 1, 3},
+    {"{\"a\": 1, // c\n \"b\": [2,] /* open\n*", 25, 2, 12},
+};
+
+static void check_case(size_t i, unsigned flags) {
+  const char *const source = cases[i].source;
+  const char *const expected = cases[i].expected[flags];
+  const size_t length = strlen(source);
+  char out[128];
+  char in_place[128];
+  memset(out, 'x', sizeof(out));
+  memcpy(in_place, source, length + 1);
+  size_t out_length;
+  jsonc_error error;
+  jsonc_strip(source, length, flags, out, &out_length, &error);
+  CHECK(error.code == JSONC_ERROR_NONE && out_length == strlen(expected) &&
+        !memcmp(out, expected, out_length + 1));
+  if (flags & JSONC_STRIP_PRESERVE_OFFSETS) {
+    CHECK(out_length == length);
+  }
+  jsonc_strip(in_place, length, flags, in_place, &out_length, &error);
+  CHECK(error.code == JSONC_ERROR_NONE && !strcmp(in_place, expected));
+}
+
+static void check_failure(size_t i, unsigned flags) {
+  const size_t length = strlen(failures[i].source);
+  char out[128];
+  for (int place = 0; place < 2; place++) {
+    if (place) {
+      memcpy(out, failures[i].source, length + 1);
+    }
+    size_t out_length;
+    jsonc_error error;
+    jsonc_strip(place ? out : failures[i].source, length, flags, out,
+                &out_length, &error);
+    CHECK(error.code == JSONC_ERROR_UNTERMINATED_COMMENT &&
+          error.offset == failures[i].offset &&
+          error.line == failures[i].line &&
+          error.column == failures[i].column);
+  }
+}
+
+static size_t commas(const char *text) {
+  size_t count = 0;
+  for (; *text; text++) {
+    count += *text == ',';
+  }
+  return count;
+}
+
+// Records with comments of both kinds and trailing commas, so that kept
+// runs, dropped comments and pending commas fall everywhere.
+static void check_long(void) {
+  const int count = 20000;
+  const size_t capacity = 120 * (size_t)count + 16;
+  char *const source = malloc(capacity);
+  char *const out = malloc(capacity);
+  char *const in_place = malloc(capacity);
+  CHECK_MEMORY(!source || !out || !in_place);
+  size_t length = 0;
+  length += (size_t)sprintf(source, "// records\n[");
+  for (int i = 0; i < count; i++) {
+    length += (size_t)snprintf(
+        source + length, capacity - length,
+        "\n  {\"id\": %d, /* the \"id\" */ \"s\": \"/*%d*/\",%s}%s", i, i,
+        i % 3 ? " // more\n" : "", i % 7 ? "," : ", /* next */");
+  }
+  length += (size_t)sprintf(source + length, "\n]\n");
+  jsonc_value expected;
+  jsonc_error error;
+  CHECK_MEMORY(jsonc_parse_ex(source, NULL, &expected, &error));
+  CHECK(error.code == JSONC_ERROR_NONE);
+  for (unsigned flags = 0; flags < 4; flags++) {
+    size_t out_length;
+    jsonc_strip(source, length, flags, out, &out_length, &error);
+    CHECK(error.code == JSONC_ERROR_NONE && !out[out_length]);
+    CHECK(!(flags & JSONC_STRIP_PRESERVE_OFFSETS) || out_length == length);
+    CHECK(!strstr(out, "/* the") && !strstr(out, "// more"));
+    // One trailing comma in each record, and one after the last.
+    const size_t dropped = flags & JSONC_STRIP_TRAILING_COMMAS ? count + 1 : 0;
+    CHECK(commas(out) == commas(source) - dropped);
+    memcpy(in_place, source, length + 1);
+    size_t in_place_length;
+    jsonc_strip(in_place, length, flags, in_place, &in_place_length, &error);
+    CHECK(error.code == JSONC_ERROR_NONE && in_place_length == out_length &&
+          !memcmp(in_place, out, out_length + 1));
+    jsonc_value value;
+    CHECK_MEMORY(jsonc_parse_ex(out, NULL, &value, &error));
+    CHECK(error.code == JSONC_ERROR_NONE);
+    if (error.code == JSONC_ERROR_NONE) {
+      bool equal;
+      CHECK_MEMORY(jsonc_equal(&value, &expected, 0, &equal));
+      CHECK(equal);
+      jsonc_free(value);
+    }
+  }
+  jsonc_free(expected);
+  free(source);
+  free(out);
+  free(in_place);
+}
+
+int main(void) {
+  for (unsigned flags = 0; flags < 4; flags++) {
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++) {
+      check_case(i, flags);
+    }
+    for (size_t i = 0; i < sizeof(failures) / sizeof(*failures); i++) {
+      check_failure(i, flags);
+    }
+  }
+  check_long();
+  return CHECK_STATUS();
+}
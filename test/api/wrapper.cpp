@@ -0,0 +1,143 @@
+// The header-only C++ wrapper: navigation that never throws, typed access
+// through std::optional, iteration, array iterators in the standard
+// algorithms, move-only documents, parse errors, and the reusable parser.
+
+#include "check.h"
+#include "jsonc.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+static void check_navigation() {
+  auto parsed = jsonc::parse(
+      "{\"servers\": [{\"name\": \"a\", \"cpu\": 2}, {\"name\": \"b\"}],\n"
+      " \"on\": true, // comment\n"
+      " \"nothing\": null}");
+  CHECK(parsed);
+  if (!parsed) {
+    return;
+  }
+  jsonc::document document = std::move(parsed).value();
+  CHECK(document["servers"][0]["name"].as_string() == "a");
+  CHECK(document.root().at_pointer("/servers/0/cpu").as_number() == 2.0);
+  CHECK(document["servers"].size() == 2);
+  CHECK(*document["on"].as_bool());
+  CHECK(document["nothing"].is_null());
+  // Missing members, out-of-range indexes and wrong types give empty
+  // results all the way down.
+  CHECK(!document["servers"][5]["name"]);
+  CHECK(!document["missing"]["x"][0]);
+  CHECK(!document["on"].as_number());
+  CHECK(!document["servers"].as_string());
+  CHECK(!document.root().at_pointer("/servers/9"));
+  CHECK(document["on"].size() == 0);
+
+  size_t members = 0;
+  for (const jsonc::value_ref server : document["servers"].elements()) {
+    members += server.size();
+  }
+  CHECK(members == 3);
+  std::vector<std::string> keys;
+  for (const auto [key, value] : document.root().members()) {
+    keys.emplace_back(key);
+    CHECK(value);
+  }
+  CHECK((keys == std::vector<std::string>{"servers", "on", "nothing"}));
+  bool visited = false;
+  for (const jsonc::value_ref value : document["on"].elements()) {
+    (void)value;
+    visited = true;
+  }
+  CHECK(!visited);
+
+  // Moving leaves null behind.
+  jsonc::document other;
+  other = std::move(document);
+  CHECK(document.root().is_null());
+  CHECK(other["on"].is_bool());
+}
+
+// Array iterators are random access, so the standard algorithms take their
+// fast paths on them.
+static void check_iterators() {
+  const auto parsed = jsonc::parse("[1, 3, 5, 7, 9, 11]");
+  CHECK(parsed);
+  if (!parsed) {
+    return;
+  }
+  const auto elements = (*parsed).root().elements();
+  using iterator = jsonc::value_ref::array_iterator;
+  static_assert(
+      std::is_same_v<std::iterator_traits<iterator>::iterator_category,
+                     std::random_access_iterator_tag>);
+  iterator it = elements.begin();
+  std::advance(it, 2);
+  CHECK(*(*it).as_number() == 5);
+  std::advance(it, -1);
+  CHECK(*(*it).as_number() == 3);
+  CHECK(*(*std::next(it, 3)).as_number() == 9);
+  CHECK(*(*std::prev(elements.end())).as_number() == 11);
+  CHECK(std::distance(elements.begin(), elements.end()) == 6);
+  CHECK(*it[4].as_number() == 11 && *(*(2 + it)).as_number() == 7);
+  CHECK(it - 1 == elements.begin() && it + 5 == elements.end());
+  CHECK(it > elements.begin() && it >= it && it < elements.end() &&
+        it <= elements.end());
+  it += 3;
+  it -= 1;
+  CHECK(*(*it--).as_number() == 7 && *(*--it).as_number() == 3);
+  const auto found =
+      std::lower_bound(elements.begin(), elements.end(), 8.0,
+                       [](jsonc::value_ref value, double number) {
+                         return *value.as_number() < number;
+                       });
+  CHECK(found - elements.begin() == 4);
+  double sum = 0;
+  for (auto back = std::make_reverse_iterator(elements.end());
+       back != std::make_reverse_iterator(elements.begin()); ++back) {
+    sum = sum * 2 + *(*back).as_number();
+  }
+  CHECK(sum == ((((11 * 2 + 9) * 2 + 7) * 2 + 5) * 2 + 3) * 2 + 1);
+  CHECK(iterator() == iterator());
+}
+
+static void check_errors() {
+  const auto result = jsonc::parse("[1,\n 2,");
+  CHECK(!result);
+  if (result) {
+    return;
+  }
+  const jsonc::error &error = result.error();
+  CHECK(error.code() == JSONC_ERROR_UNEXPECTED_END);
+  CHECK(error.offset() == 7);
+  CHECK(error.line() == 2 && error.column() == 4);
+  CHECK(error.expected() & JSONC_EXPECT_VALUE);
+  CHECK(std::string(error.message()) ==
+        jsonc_error_message(JSONC_ERROR_UNEXPECTED_END));
+
+  jsonc_parse_options options = {};
+  options.max_depth = 1;
+  CHECK(jsonc::parse("[[1]]", &options).error().code() ==
+        JSONC_ERROR_MAX_DEPTH);
+}
+
+static void check_parser() {
+  jsonc::parser parser;
+  for (int i = 0; i < 3; i++) {
+    const auto good = parser.parse("{\"a\": [1, 2, {\"b\": \"c\"}]}");
+    CHECK(good && (*good)["a"][2]["b"].as_string() == "c");
+    const auto bad = parser.parse("{\"a\": [1, 2, \"unterminated");
+    CHECK(!bad && bad.error().code() == JSONC_ERROR_UNTERMINATED_STRING);
+  }
+}
+
+int main() {
+  check_navigation();
+  check_iterators();
+  check_errors();
+  check_parser();
+  return CHECK_STATUS();
+}
@@ -0,0 +1,34 @@
+#ifndef JSONC_BENCH_H
+#define JSONC_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Shared by the benchmarks, which define _POSIX_C_SOURCE for the clock
+// before including anything.
+
+static inline double bench_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static inline void bench_sleep(double seconds) {
+  struct timespec duration;
+  duration.tv_sec = (time_t)seconds;
+  duration.tv_nsec = (long)((seconds - (double)duration.tv_sec) * 1e9);
+  nanosleep(&duration, NULL);
+}
+
+// For calls returning err_t.
+#define BENCH_MEMORY(call)                                                     \
+  do {                                                                         \
+    if (call) {                                                                \
+      fprintf(stderr, "%s:%d: out of memory: %s\n", __FILE__, __LINE__,        \
+              #call);                                                          \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+#endif
@@ -0,0 +1,131 @@
+// Throughput of a long array of numbers of mixed length, with fractions and
+// exponents: built as a tree by jsonc_parse_ex, read into a double column
+// by jsonc_extract_array, and walked by the pull reader. The first two take
+// the fast path for elements followed by a comma; the reader does not, so
+// it shows what the tokenizer alone does with the same text.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+// `count` numbers of 1 to 25 digits, half with a fraction of up to 20
+// digits and a quarter with an exponent.
+static char *numbers(size_t count, size_t *out_length) {
+  char *const text = malloc(count * 56 + 2);
+  if (!text) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  uint32_t state = 7;
+#define NEXT() (state = state * 1103515245 + 12345, state >> 8)
+  size_t length = 0;
+  text[length++] = '[';
+  for (size_t i = 0; i < count; i++) {
+    if (i) {
+      text[length++] = ',';
+    }
+    const uint32_t digits = 1 + NEXT() % 25;
+    if (state >> 3 & 1) {
+      text[length++] = '-';
+    }
+    text[length++] = (char)('1' + NEXT() % 9);
+    for (uint32_t digit = 1; digit < digits; digit++) {
+      text[length++] = (char)('0' + NEXT() % 10);
+    }
+    if (NEXT() & 1) {
+      text[length++] = '.';
+      for (uint32_t digit = NEXT() % 20 + 1; digit; digit--) {
+        text[length++] = (char)('0' + NEXT() % 10);
+      }
+    }
+    if (NEXT() % 4 == 0) {
+      length += (size_t)sprintf(text + length, "e%d", (int)(NEXT() % 40) - 20);
+    }
+  }
+#undef NEXT
+  text[length++] = ']';
+  text[length] = '\0';
+  *out_length = length;
+  return text;
+}
+
+enum method { TREE, COLUMN, READER };
+
+// Seconds for one pass, and the sum of what it read as a check.
+static double run(enum method method, const char *text, double *out_sum) {
+  double sum = 0;
+  const double start = bench_now();
+  if (method == TREE) {
+    jsonc_value value;
+    jsonc_error error;
+    BENCH_MEMORY(jsonc_parse_ex(text, NULL, &value, &error));
+    const double seconds = bench_now() - start;
+    for (size_t i = 0; i < value.value.array.count; i++) {
+      sum += value.value.array.values[i].value.number;
+    }
+    jsonc_free(value);
+    *out_sum = sum;
+    return seconds;
+  }
+  if (method == COLUMN) {
+    jsonc_column column = {.type = JSONC_COLUMN_DOUBLE};
+    size_t rows;
+    bool found;
+    jsonc_error error;
+    BENCH_MEMORY(jsonc_extract_array(text, NULL, "", 0, &column, &rows,
+                                     &found, &error));
+    const double seconds = bench_now() - start;
+    for (size_t i = 0; i < rows; i++) {
+      sum += ((const double *)column.values)[i];
+    }
+    jsonc_columns_free(&column, 1);
+    *out_sum = sum;
+    return seconds;
+  }
+  jsonc_reader *reader;
+  BENCH_MEMORY(jsonc_reader_create(text, NULL, &reader));
+  jsonc_event event;
+  do {
+    BENCH_MEMORY(jsonc_reader_next(reader, &event));
+    if (event.type == JSONC_EVENT_NUMBER) {
+      sum += event.value.number;
+    }
+  } while (event.type != JSONC_EVENT_EOF && event.type != JSONC_EVENT_ERROR);
+  const double seconds = bench_now() - start;
+  jsonc_reader_destroy(reader);
+  *out_sum = sum;
+  return seconds;
+}
+
+int main(int argc, char **argv) {
+  const long count = argc > 1 ? atol(argv[1]) : 300000;
+  const int rounds = argc > 2 ? atoi(argv[2]) : 5;
+  if (count < 1 || rounds < 1) {
+    fprintf(stderr, "usage: %s [numbers [rounds]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t length;
+  char *const text = numbers((size_t)count, &length);
+  printf("%ld numbers, %zu bytes, best of %d\n", count, length, rounds);
+  printf("%-8s %10s %10s %14s\n", "", "ms", "MB/s", "Mnumbers/s");
+  static const char *const names[] = {"tree", "column", "reader"};
+  double sums[3];
+  for (int method = TREE; method <= READER; method++) {
+    double best = 0;
+    for (int round = 0; round < rounds; round++) {
+      const double seconds = run(method, text, &sums[method]);
+      best = round && best < seconds ? best : seconds;
+    }
+    printf("%-8s %10.1f %10.1f %14.2f\n", names[method], best * 1e3,
+           (double)length / best / 1e6, (double)count / best / 1e6);
+  }
+  if (sums[TREE] != sums[READER] || sums[COLUMN] != sums[READER]) {
+    fprintf(stderr, "the methods read different numbers\n");
+    return EXIT_FAILURE;
+  }
+  free(text);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+// Time to diff two large documents that differ in a few places, in both
+// patch formats, and to apply the patches: an array of records in which a
+// small share of the records are edited, inserted or removed, and members
+// of the root object are added and dropped.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+// {"records": [...], "meta": {...}} with `count` records.
+static char *document(size_t count, size_t *out_length) {
+  const size_t capacity = count * 160 + 256;
+  char *const text = malloc(capacity);
+  if (!text) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  size_t length = (size_t)sprintf(text, "{\"records\": [");
+  for (size_t i = 0; i < count; i++) {
+    length += (size_t)snprintf(
+        text + length, capacity - length,
+        "%s\n {\"id\": %zu, \"name\": \"record number %zu\", \"score\": %zu,"
+        " \"tags\": [\"t%zu\", \"u%zu\"], \"owner\": {\"group\": %zu}}",
+        i ? "," : "", i, i, i * 7919 % 1000, i % 10, i % 13, i % 50);
+  }
+  length += (size_t)snprintf(text + length, capacity - length,
+                             "],\n \"meta\": {\"version\": 1, \"old\": true}}");
+  *out_length = length;
+  return text;
+}
+
+static jsonc_value parse(const char *text) {
+  jsonc_value value;
+  jsonc_error error;
+  BENCH_MEMORY(jsonc_parse_ex(text, NULL, &value, &error));
+  if (error.code != JSONC_ERROR_NONE) {
+    fprintf(stderr, "parse failed: %s\n", jsonc_error_message(error.code));
+    exit(EXIT_FAILURE);
+  }
+  return value;
+}
+
+// Edits one record in `every`, and inserts and removes one in ten times
+// that.
+static void mutate(jsonc_value *root, size_t every) {
+  jsonc_value *const records = jsonc_object_get(root, "records");
+  for (size_t i = 0; i < records->value.array.count; i += every) {
+    jsonc_value *const record = &records->value.array.values[i];
+    if (i % (every * 10) == 0) {
+      jsonc_array_remove(records, i);
+      continue;
+    }
+    if (i % (every * 10) == every) {
+      jsonc_value inserted = jsonc_object_new();
+      BENCH_MEMORY(
+          jsonc_object_set(&inserted, "id", jsonc_number_new(-(double)i)));
+      BENCH_MEMORY(jsonc_array_insert(records, i, inserted));
+      continue;
+    }
+    BENCH_MEMORY(jsonc_object_set(record, "score", jsonc_number_new(-1)));
+    jsonc_value *const tags = jsonc_object_get(record, "tags");
+    jsonc_value tag;
+    BENCH_MEMORY(jsonc_string_new("edited", &tag));
+    BENCH_MEMORY(jsonc_array_push(tags, tag));
+  }
+  jsonc_value *const meta = jsonc_object_get(root, "meta");
+  jsonc_object_remove(meta, "old");
+  BENCH_MEMORY(jsonc_object_set(meta, "new", jsonc_boolean_new(true)));
+}
+
+static size_t patch_size(const jsonc_value *patch) {
+  return patch->type == JSONC_VALUE_TYPE_ARRAY ? patch->value.array.count
+                                               : patch->value.object.count;
+}
+
+int main(int argc, char **argv) {
+  const long count = argc > 1 ? atol(argv[1]) : 40000;
+  const long every = argc > 2 ? atol(argv[2]) : 100;
+  if (count < 1 || every < 1) {
+    fprintf(stderr, "usage: %s [records [edit one in]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t length;
+  char *const text = document((size_t)count, &length);
+  jsonc_value a = parse(text);
+  jsonc_value b = parse(text);
+  mutate(&b, (size_t)every);
+  printf("%ld records, %zu bytes, one in %ld edited\n", count, length, every);
+  printf("%-12s %10s %10s %10s\n", "", "diff ms", "apply ms", "size");
+
+  static const char *const names[] = {"json patch", "merge patch"};
+  for (int format = JSONC_DIFF_JSON_PATCH; format <= JSONC_DIFF_MERGE_PATCH;
+       format++) {
+    jsonc_value target = parse(text);
+    jsonc_value patch;
+    double start = bench_now();
+    BENCH_MEMORY(jsonc_diff(&a, &b, format, &patch));
+    const double diff_seconds = bench_now() - start;
+    jsonc_error error;
+    start = bench_now();
+    BENCH_MEMORY(jsonc_apply_patch(&target, &patch, format, &error));
+    const double apply_seconds = bench_now() - start;
+    bool equal;
+    BENCH_MEMORY(
+        jsonc_equal(&target, &b, JSONC_EQUAL_IGNORE_KEY_ORDER, &equal));
+    if (error.code != JSONC_ERROR_NONE || !equal) {
+      fprintf(stderr, "%s does not give the second document\n",
+              names[format]);
+      return EXIT_FAILURE;
+    }
+    printf("%-12s %10.1f %10.1f %10zu\n", names[format], diff_seconds * 1e3,
+           apply_seconds * 1e3, patch_size(&patch));
+    jsonc_free(patch);
+    jsonc_free(target);
+  }
+  jsonc_free(a);
+  jsonc_free(b);
+  free(text);
+  return EXIT_SUCCESS;
+}
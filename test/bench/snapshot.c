@@ -0,0 +1,90 @@
+// Read throughput of a shared configuration as reader threads are added:
+// jsonc_snapshot_enter/leave against taking a mutex to retain the current
+// tree. Snapshot reads touch no shared cache line, so they should scale
+// with the thread count where the mutex does not.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include "jsonc.h"
+
+#include <pthread.h>
+
+enum { MAX_THREADS = 16, BATCH = 64 };
+
+static jsonc_snapshot *snapshot;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static jsonc_shared *locked;
+static int use_snapshot;
+static int done;
+
+static double read_value(const jsonc_shared *shared) {
+  return jsonc_pointer_get(jsonc_shared_root(shared), "/limits/cpu")
+      ->value.number;
+}
+
+// Returns the number of reads made.
+static void *read_loop(void *argument) {
+  const size_t reader = (size_t)argument;
+  size_t reads = 0;
+  double sum = 0;
+  while (!__atomic_load_n(&done, __ATOMIC_RELAXED)) {
+    for (int i = 0; i < BATCH; i++) {
+      if (use_snapshot) {
+        sum += read_value(jsonc_snapshot_enter(snapshot, reader));
+        jsonc_snapshot_leave(snapshot, reader);
+      } else {
+        pthread_mutex_lock(&mutex);
+        jsonc_shared *const shared = jsonc_shared_retain(locked);
+        pthread_mutex_unlock(&mutex);
+        sum += read_value(shared);
+        jsonc_shared_release(shared);
+      }
+    }
+    reads += BATCH;
+  }
+  return (void *)(reads + (sum < 0));
+}
+
+int main(int argc, char **argv) {
+  const int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+  if (max_threads < 1 || max_threads > MAX_THREADS) {
+    fprintf(stderr, "usage: %s [threads, at most %d]\n", argv[0],
+            MAX_THREADS);
+    return EXIT_FAILURE;
+  }
+  const double seconds = 0.5;
+  jsonc_value value;
+  jsonc_error error;
+  BENCH_MEMORY(jsonc_parse_ex("{\"limits\": {\"cpu\": 2, \"memory\": 1e9}}",
+                              NULL, &value, &error));
+  jsonc_shared *shared;
+  BENCH_MEMORY(jsonc_shared_create(value, &shared));
+  locked = jsonc_shared_retain(shared);
+  BENCH_MEMORY(jsonc_snapshot_create(MAX_THREADS, shared, &snapshot));
+
+  printf("%-10s %8s %12s\n", "", "threads", "Mreads/s");
+  for (use_snapshot = 0; use_snapshot < 2; use_snapshot++) {
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+      pthread_t ids[MAX_THREADS];
+      __atomic_store_n(&done, 0, __ATOMIC_RELAXED);
+      for (int i = 0; i < threads; i++) {
+        pthread_create(&ids[i], NULL, read_loop, (void *)(size_t)i);
+      }
+      const double start = bench_now();
+      bench_sleep(seconds);
+      __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+      size_t total = 0;
+      for (int i = 0; i < threads; i++) {
+        void *reads;
+        pthread_join(ids[i], &reads);
+        total += (size_t)reads;
+      }
+      printf("%-10s %8d %12.1f\n", use_snapshot ? "snapshot" : "mutex",
+             threads, (double)total / (bench_now() - start) / 1e6);
+    }
+  }
+  jsonc_shared_release(locked);
+  jsonc_snapshot_free(snapshot);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+// Parse throughput of strict JSON with no jsonc_parse_flags, which runs the
+// strict tokenizer table, against the same text with JSONC_PARSE_JSON5,
+// which runs the lenient one. The lenient figure shows what the extensions
+// cost when enabled. What they cost when disabled only shows by comparing
+// the strict figure between builds with and without them.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include "jsonc.h"
+
+#include <string.h>
+
+// About `megabytes` of records with keys, strings, numbers and literals.
+static char *records(size_t megabytes, size_t *out_length) {
+  const size_t capacity = megabytes << 20;
+  char *const text = malloc(capacity + 256);
+  if (!text) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  size_t length = 0;
+  text[length++] = '[';
+  for (size_t i = 0; length < capacity; i++) {
+    length += (size_t)sprintf(
+        text + length,
+        "%s{\"id\": %zu, \"name\": \"record %zu\", \"score\": %zu.%02zu,"
+        " \"tags\": [\"a\", \"b\\n\"], \"ok\": %s, \"parent\": null}",
+        i ? ",\n" : "", i, i, i % 1000, i % 100, i % 3 ? "true" : "false");
+  }
+  text[length++] = ']';
+  text[length] = '\0';
+  *out_length = length;
+  return text;
+}
+
+// Best of `rounds` parses, in MB/s.
+static double parse_rate(const char *text, size_t length, unsigned flags,
+                         int rounds) {
+  const jsonc_parse_options options = {.flags = flags};
+  double best = 0;
+  for (int round = 0; round < rounds; round++) {
+    jsonc_value value;
+    jsonc_error error;
+    const double start = bench_now();
+    BENCH_MEMORY(jsonc_parse_ex(text, &options, &value, &error));
+    const double seconds = bench_now() - start;
+    if (error.code != JSONC_ERROR_NONE) {
+      fprintf(stderr, "parse failed: %s\n", jsonc_error_message(error.code));
+      exit(EXIT_FAILURE);
+    }
+    jsonc_free(value);
+    const double rate = (double)length / seconds / 1e6;
+    best = rate > best ? rate : best;
+  }
+  return best;
+}
+
+// The same through the pull reader, which builds no tree.
+static double read_rate(const char *text, size_t length, unsigned flags,
+                        int rounds) {
+  const jsonc_parse_options options = {.flags = flags};
+  double best = 0;
+  for (int round = 0; round < rounds; round++) {
+    jsonc_reader *reader;
+    BENCH_MEMORY(jsonc_reader_create(text, &options, &reader));
+    jsonc_event event;
+    const double start = bench_now();
+    do {
+      BENCH_MEMORY(jsonc_reader_next(reader, &event));
+    } while (event.type != JSONC_EVENT_EOF && event.type != JSONC_EVENT_ERROR);
+    const double seconds = bench_now() - start;
+    jsonc_reader_destroy(reader);
+    if (event.type == JSONC_EVENT_ERROR) {
+      fprintf(stderr, "read failed\n");
+      exit(EXIT_FAILURE);
+    }
+    const double rate = (double)length / seconds / 1e6;
+    best = rate > best ? rate : best;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  const int megabytes = argc > 1 ? atoi(argv[1]) : 16;
+  const int rounds = argc > 2 ? atoi(argv[2]) : 5;
+  if (megabytes < 1 || rounds < 1) {
+    fprintf(stderr, "usage: %s [megabytes [rounds]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t length;
+  char *const text = records((size_t)megabytes, &length);
+  printf("%zu bytes, best of %d\n", length, rounds);
+  printf("%-8s %12s %12s\n", "", "parse MB/s", "read MB/s");
+  printf("%-8s %12.1f %12.1f\n", "strict", parse_rate(text, length, 0, rounds),
+         read_rate(text, length, 0, rounds));
+  printf("%-8s %12.1f %12.1f\n", "json5",
+         parse_rate(text, length, JSONC_PARSE_JSON5, rounds),
+         read_rate(text, length, JSONC_PARSE_JSON5, rounds));
+  free(text);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+# Runs TOOL and compares what it prints with a file, ignoring carriage
+# returns. Either TOOL is run on INPUT alone, must exit with status 0 and
+# print INPUT.txt, or it is run with ARGS, a list separated by "|", and
+# standard input from STDIN if given, and must exit with STATUS and print
+# EXPECTED: standard output followed by standard error. TOOL's path in the
+# output reads as "jsonc".
+if(DEFINED INPUT)
+  set(EXPECTED ${INPUT}.txt)
+  set(ARGS ${INPUT})
+  set(STATUS 0)
+endif()
+string(REPLACE "|" ";" args "${ARGS}")
+set(stdin)
+if(DEFINED STDIN)
+  set(stdin INPUT_FILE ${STDIN})
+endif()
+execute_process(COMMAND ${TOOL} ${args} ${stdin} OUTPUT_VARIABLE output
+                ERROR_VARIABLE errors RESULT_VARIABLE status)
+set(actual "${output}${errors}")
+file(READ ${EXPECTED} expected)
+string(REPLACE "\r" "" actual "${actual}")
+string(REPLACE "${TOOL}" "jsonc" actual "${actual}")
+string(REPLACE "\r" "" expected "${expected}")
+if(NOT status EQUAL STATUS OR NOT actual STREQUAL expected)
+  message(FATAL_ERROR "${ARGS}: exit status ${status}, output:\n${actual}"
+                      "expected status ${STATUS}, output:\n${expected}")
+endif()
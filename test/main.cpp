@@ -1,84 +1,696 @@
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
-#include "jsonc.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JSONC_CLI_HAVE_MMAP
+#endif
 
-static std::string read_file(const char *path) {
-  std::ifstream t(path);
-  std::stringstream buffer;
-  buffer << t.rdbuf();
-  return buffer.str();
+#include "jsonc.hpp"
+
+static const char usage[] =
+    "Usage: %s <file>\n"
+    "       %s <command> [options] [file]\n"
+    "\n"
+    "With just a file, prints the document the way the tests expect it.\n"
+    "Commands read `file`, or standard input if it is absent or \"-\":\n"
+    "  validate          check syntax only, in constant memory\n"
+    "  minify            print as compact JSON, without comments\n"
+    "  strip-comments    drop comments and trailing commas, keeping the\n"
+    "                    rest of the text as it is\n"
+    "  pretty            print as JSON indented by two spaces\n"
+    "  get <pointer>     print the value at an RFC 6901 JSON Pointer\n"
+    "  stats             print depth, counts and sizes\n"
+    "Options:\n"
+    "  --ndjson          one document per line\n"
+    "  --threads <n>     split --ndjson input across n threads\n"
+    "  --preserve-offsets\n"
+    "                    with strip-comments, blank out what is dropped\n"
+    "                    so that offsets stay the same\n"
+    "  --json5           accept unquoted keys, single quotes, hexadecimal,\n"
+    "                    NaN, Infinity, +1, .5 and 5.; NaN and Infinity are\n"
+    "                    printed as they are written\n"
+    "\n"
+    "Errors go to standard error as file:line:column: message. The exit\n"
+    "status is 1 if a document is invalid or a pointer names nothing, and\n"
+    "2 for bad usage or unreadable input.\n";
+
+static void print_value(jsonc::value_ref value);
+
+// The whole input, NUL-terminated. Files are mapped where possible so that
+// a multi-gigabyte log costs address space rather than heap.
+class input {
+public:
+  input() = default;
+  input(const input &) = delete;
+  input &operator=(const input &) = delete;
+  ~input() {
+#ifdef JSONC_CLI_HAVE_MMAP
+    if (map_) {
+      munmap(map_, map_size_);
+    }
+#endif
+  }
+
+  bool open(const char *path) {
+    if (!path || !std::strcmp(path, "-")) {
+      return read(stdin);
+    }
+#ifdef JSONC_CLI_HAVE_MMAP
+    if (map(path)) {
+      return true;
+    }
+#endif
+    std::FILE *const file = std::fopen(path, "rb");
+    if (!file) {
+      return false;
+    }
+    const bool result = read(file);
+    std::fclose(file);
+    return result;
+  }
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  bool read(std::FILE *file) {
+    char block[1 << 16];
+    size_t count;
+    while ((count = std::fread(block, 1, sizeof(block), file)) != 0) {
+      buffer_.append(block, count);
+    }
+    data_ = buffer_.c_str();
+    size_ = buffer_.size();
+    return !std::ferror(file);
+  }
+
+#ifdef JSONC_CLI_HAVE_MMAP
+  // Maps the file over the start of a zero-filled anonymous mapping one
+  // byte longer, which supplies the terminating NUL even when the file
+  // ends on a page boundary.
+  bool map(const char *path) {
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    bool mapped = false;
+    if (!fstat(fd, &info) && S_ISREG(info.st_mode) && info.st_size > 0) {
+      const size_t size = static_cast<size_t>(info.st_size);
+      void *const base = mmap(nullptr, size + 1, PROT_READ,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (base != MAP_FAILED) {
+        if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) !=
+            MAP_FAILED) {
+          map_ = base;
+          map_size_ = size + 1;
+          data_ = static_cast<const char *>(base);
+          size_ = size;
+          mapped = true;
+        } else {
+          munmap(base, size + 1);
+        }
+      }
+    }
+    close(fd);
+    return mapped;
+  }
+
+  void *map_ = nullptr;
+  size_t map_size_ = 0;
+#endif
+  std::string buffer_;
+  const char *data_ = "";
+  size_t size_ = 0;
+};
+
+// Writes JSON into a string from a stream of values, compact or indented.
+class writer {
+public:
+  explicit writer(std::string &out, bool pretty) : out_(out), pretty_(pretty) {}
+
+  void null() {
+    value();
+    out_ += "null";
+  }
+  void boolean(bool value) {
+    this->value();
+    out_ += value ? "true" : "false";
+  }
+  void number(double value) {
+    this->value();
+    if (!std::isfinite(value)) {
+      out_ += std::isnan(value) ? "NaN" : value < 0 ? "-Infinity" : "Infinity";
+      return;
+    }
+    char text[32];
+    // The shortest of the two that reads back as the same double.
+    std::snprintf(text, sizeof(text), "%.15g", value);
+    if (std::strtod(text, nullptr) != value) {
+      std::snprintf(text, sizeof(text), "%.17g", value);
+    }
+    out_ += text;
+  }
+  void string(std::string_view value) {
+    this->value();
+    quote(value);
+  }
+  void key(std::string_view key) {
+    value();
+    quote(key);
+    out_ += pretty_ ? ": " : ":";
+    after_key_ = true;
+  }
+  void begin(char bracket) {
+    value();
+    out_ += bracket;
+    first_.push_back(true);
+  }
+  void end(char bracket) {
+    const bool empty = first_.back();
+    first_.pop_back();
+    if (!empty) {
+      newline();
+    }
+    out_ += bracket;
+  }
+
+private:
+  // Separates a value from what came before it.
+  void value() {
+    if (after_key_) {
+      after_key_ = false;
+      return;
+    }
+    if (first_.empty()) {
+      return;
+    }
+    if (!first_.back()) {
+      out_ += ',';
+    }
+    first_.back() = false;
+    newline();
+  }
+  void newline() {
+    if (pretty_) {
+      out_ += '\n';
+      out_.append(first_.size() * 2, ' ');
+    }
+  }
+  void quote(std::string_view text) {
+    out_ += '"';
+    for (const char c : text) {
+      switch (c) {
+        case '"':
+          out_ += "\\\"";
+          break;
+        case '\\':
+          out_ += "\\\\";
+          break;
+        case '\n':
+          out_ += "\\n";
+          break;
+        case '\r':
+          out_ += "\\r";
+          break;
+        case '\t':
+          out_ += "\\t";
+          break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out_ += escape;
+          } else {
+            out_ += c;
+          }
+      }
+    }
+    out_ += '"';
+  }
+
+  std::string &out_;
+  bool pretty_;
+  bool after_key_ = false;
+  // Whether each open container has had no member yet.
+  std::vector<bool> first_;
+};
+
+static void write_tree(writer &out, jsonc::value_ref value) {
+  switch (value.type()) {
+    case jsonc::type::null:
+      out.null();
+      break;
+    case jsonc::type::boolean:
+      out.boolean(*value.as_bool());
+      break;
+    case jsonc::type::number:
+      out.number(*value.as_number());
+      break;
+    case jsonc::type::string:
+      out.string(*value.as_string());
+      break;
+    case jsonc::type::array:
+      out.begin('[');
+      for (const jsonc::value_ref element : value.elements()) {
+        write_tree(out, element);
+      }
+      out.end(']');
+      break;
+    case jsonc::type::object:
+      out.begin('{');
+      for (const auto [key, member] : value.members()) {
+        out.key(key);
+        write_tree(out, member);
+      }
+      out.end('}');
+      break;
+  }
 }
 
-static void print_array(const jsonc_array &array);
-static void print_object(const jsonc_object &object);
-static void print_value(const jsonc_value &value);
+struct stats {
+  size_t documents = 0;
+  size_t bytes = 0;
+  size_t max_depth = 0;
+  size_t objects = 0;
+  size_t arrays = 0;
+  size_t keys = 0;
+  size_t strings = 0;
+  size_t string_bytes = 0;
+  size_t numbers = 0;
+  size_t booleans = 0;
+  size_t nulls = 0;
+
+  void add(const stats &other) {
+    documents += other.documents;
+    bytes += other.bytes;
+    max_depth = std::max(max_depth, other.max_depth);
+    objects += other.objects;
+    arrays += other.arrays;
+    keys += other.keys;
+    strings += other.strings;
+    string_bytes += other.string_bytes;
+    numbers += other.numbers;
+    booleans += other.booleans;
+    nulls += other.nulls;
+  }
+};
+
+enum class command { validate, minify, strip, pretty, get, stats };
+
+struct job {
+  command what;
+  const char *pointer = nullptr;
+  unsigned strip_flags = JSONC_STRIP_TRAILING_COMMAS;
+  jsonc_parse_options options = {};
+  const char *name = "<stdin>";
+};
+
+// What one worker produced for a run of documents.
+struct result {
+  std::string output;
+  std::string errors;
+  stats counts;
+  bool failed = false;
+};
+
+static void report(result &out, const job &task, size_t first_line,
+                   const jsonc_error &error, const char *message) {
+  char text[64];
+  std::snprintf(text, sizeof(text), ":%zu:%zu: ",
+                first_line + error.line - 1, error.column);
+  out.errors += task.name;
+  out.errors += text;
+  out.errors += message ? message : jsonc_error_message(error.code);
+  out.errors += '\n';
+  out.failed = true;
+}
+
+// Runs a streaming command over one document with the pull reader, so that
+// memory does not grow with the document.
+static void stream(const job &task, const char *source, size_t first_line,
+                   result &out) {
+  jsonc_reader *reader;
+  if (jsonc_reader_create(source, &task.options, &reader)) {
+    throw std::bad_alloc();
+  }
+  std::string text;
+  writer json(text, task.what == command::pretty);
+  stats counts;
+  size_t depth = 0;
+  jsonc_event event;
+  for (;;) {
+    if (jsonc_reader_next(reader, &event)) {
+      jsonc_reader_destroy(reader);
+      throw std::bad_alloc();
+    }
+    const std::string_view string(event.value.string.data,
+                                  event.value.string.length);
+    switch (event.type) {
+      case JSONC_EVENT_NULL:
+        counts.nulls++;
+        json.null();
+        break;
+      case JSONC_EVENT_BOOLEAN:
+        counts.booleans++;
+        json.boolean(event.value.boolean);
+        break;
+      case JSONC_EVENT_NUMBER:
+        counts.numbers++;
+        json.number(event.value.number);
+        break;
+      case JSONC_EVENT_STRING:
+        counts.strings++;
+        counts.string_bytes += string.size();
+        json.string(string);
+        break;
+      case JSONC_EVENT_KEY:
+        counts.keys++;
+        json.key(string);
+        break;
+      case JSONC_EVENT_BEGIN_ARRAY:
+      case JSONC_EVENT_BEGIN_OBJECT:
+        (event.type == JSONC_EVENT_BEGIN_ARRAY ? counts.arrays
+                                               : counts.objects)++;
+        counts.max_depth = std::max(counts.max_depth, ++depth);
+        json.begin(event.type == JSONC_EVENT_BEGIN_ARRAY ? '[' : '{');
+        break;
+      case JSONC_EVENT_END_ARRAY:
+      case JSONC_EVENT_END_OBJECT:
+        depth--;
+        json.end(event.type == JSONC_EVENT_END_ARRAY ? ']' : '}');
+        break;
+      case JSONC_EVENT_EOF:
+      case JSONC_EVENT_ERROR:
+        break;
+    }
+    if (event.type == JSONC_EVENT_EOF || event.type == JSONC_EVENT_ERROR) {
+      break;
+    }
+    // validate and stats produce no text; keep the buffer from growing.
+    if (task.what == command::validate || task.what == command::stats) {
+      text.clear();
+    }
+  }
+  if (event.type == JSONC_EVENT_ERROR) {
+    report(out, task, first_line, *jsonc_reader_error(reader), nullptr);
+  } else if (task.what == command::minify || task.what == command::pretty) {
+    out.output += text;
+    out.output += '\n';
+  } else if (task.what == command::stats) {
+    counts.documents = 1;
+    counts.bytes = std::strlen(source);
+    out.counts.add(counts);
+  }
+  jsonc_reader_destroy(reader);
+}
+
+// Reads only as much of the document as it takes to find the pointer.
+static void get(const job &task, const char *source, size_t first_line,
+                result &out) {
+  jsonc_value value;
+  bool found;
+  jsonc_error error;
+  if (jsonc_extract(source, &task.options, &task.pointer, 1, &value, &found,
+                    &error)) {
+    throw std::bad_alloc();
+  }
+  if (error.code != JSONC_ERROR_NONE) {
+    report(out, task, first_line, error, nullptr);
+    return;
+  }
+  if (!found) {
+    out.failed = true;
+    return;
+  }
+  const jsonc::document document(value);
+  writer json(out.output, false);
+  write_tree(json, document.root());
+  out.output += '\n';
+}
+
+// Copies the text minus comments and trailing commas, without parsing it.
+static void strip(const job &task, const char *source, size_t length,
+                  size_t first_line, result &out) {
+  const size_t start = out.output.size();
+  out.output.resize(start + length);
+  size_t stripped;
+  jsonc_error error;
+  jsonc_strip(source, length, task.strip_flags, out.output.data() + start,
+              &stripped, &error);
+  out.output.resize(error.code == JSONC_ERROR_NONE ? start + stripped : start);
+  if (error.code != JSONC_ERROR_NONE) {
+    report(out, task, first_line, error, nullptr);
+  }
+}
+
+static void run(const job &task, const char *source, size_t length,
+                size_t first_line, result &out) {
+  if (task.what == command::strip) {
+    strip(task, source, length, first_line, out);
+  } else if (task.what == command::get) {
+    get(task, source, first_line, out);
+  } else {
+    stream(task, source, first_line, out);
+  }
+}
+
+// Runs the command on each non-blank line of [begin, end), which starts on
+// line `first_line`.
+static void run_lines(const job &task, const char *begin, const char *end,
+                      size_t first_line, result &out) {
+  std::string line;
+  for (size_t number = first_line; begin < end; number++) {
+    const char *const newline =
+        static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+    const char *const stop = newline ? newline : end;
+    line.assign(begin, stop);
+    if (line.find_first_not_of(" \t\r") != std::string::npos) {
+      const size_t errors = out.errors.size();
+      run(task, line.c_str(), line.size(), number, out);
+      if (task.what == command::strip && out.errors.size() == errors) {
+        out.output += '\n';
+      }
+    }
+    begin = stop + 1;
+  }
+}
+
+// Splits NDJSON input at line boundaries into one slice per thread and
+// prints the results in input order.
+static std::vector<result> run_ndjson(const job &task, const input &in,
+                                      size_t threads) {
+  const char *const data = in.data();
+  const size_t size = in.size();
+  std::vector<const char *> bounds{data};
+  for (size_t i = 1; i < threads; i++) {
+    const char *cut = std::max(bounds.back(), data + size * i / threads);
+    const void *const newline =
+        std::memchr(cut, '\n', static_cast<size_t>(data + size - cut));
+    cut = newline ? static_cast<const char *>(newline) + 1 : data + size;
+    bounds.push_back(cut);
+  }
+  bounds.push_back(data + size);
+  std::vector<size_t> first_lines{1};
+  for (size_t i = 1; i + 1 < bounds.size(); i++) {
+    first_lines.push_back(first_lines.back() +
+                          std::count(bounds[i - 1], bounds[i], '\n'));
+  }
+  std::vector<result> results(threads);
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; i++) {
+    workers.emplace_back(run_lines, std::cref(task), bounds[i], bounds[i + 1],
+                         first_lines[i], std::ref(results[i]));
+  }
+  run_lines(task, bounds[0], bounds[1], 1, results[0]);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  return results;
+}
+
+static void print_stats(const stats &counts) {
+  std::printf("documents: %zu\n"
+              "bytes: %zu\n"
+              "max_depth: %zu\n"
+              "objects: %zu\n"
+              "arrays: %zu\n"
+              "keys: %zu\n"
+              "strings: %zu\n"
+              "string_bytes: %zu\n"
+              "numbers: %zu\n"
+              "booleans: %zu\n"
+              "nulls: %zu\n",
+              counts.documents, counts.bytes, counts.max_depth,
+              counts.objects, counts.arrays, counts.keys, counts.strings,
+              counts.string_bytes, counts.numbers, counts.booleans,
+              counts.nulls);
+}
+
+static int usage_error(const char *program) {
+  std::fprintf(stderr, usage, program, program);
+  return 2;
+}
+
+// Returns the exit status, or -1 if argv[1] is not a command.
+static int run_command(int argc, char **argv) {
+  static const struct {
+    const char *name;
+    command what;
+  } commands[] = {
+      {"validate", command::validate}, {"minify", command::minify},
+      {"strip-comments", command::strip}, {"pretty", command::pretty},
+      {"get", command::get},           {"stats", command::stats},
+  };
+  job task;
+  bool known = false;
+  for (const auto &entry : commands) {
+    if (!std::strcmp(argv[1], entry.name)) {
+      task.what = entry.what;
+      known = true;
+    }
+  }
+  if (!known) {
+    return -1;
+  }
+  bool ndjson = false;
+  size_t threads = 1;
+  const char *path = nullptr;
+  for (int i = 2; i < argc; i++) {
+    if (!std::strcmp(argv[i], "--ndjson")) {
+      ndjson = true;
+    } else if (!std::strcmp(argv[i], "--preserve-offsets")) {
+      task.strip_flags |= JSONC_STRIP_PRESERVE_OFFSETS;
+    } else if (!std::strcmp(argv[i], "--json5")) {
+      task.options.flags = JSONC_PARSE_JSON5;
+    } else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (task.what == command::get && !task.pointer) {
+      task.pointer = argv[i];
+    } else if (!path) {
+      path = argv[i];
+    } else {
+      return usage_error(argv[0]);
+    }
+  }
+  if ((task.what == command::get && !task.pointer) || !threads) {
+    return usage_error(argv[0]);
+  }
+  input in;
+  if (!in.open(path)) {
+    std::fprintf(stderr, "Cannot read %s\n", path ? path : "<stdin>");
+    return 2;
+  }
+  if (path && std::strcmp(path, "-")) {
+    task.name = path;
+  }
+  std::vector<result> results(1);
+  if (ndjson) {
+    results = run_ndjson(task, in, threads);
+  } else {
+    run(task, in.data(), in.size(), 1, results[0]);
+  }
+  bool failed = false;
+  stats counts;
+  for (const result &part : results) {
+    std::fwrite(part.output.data(), 1, part.output.size(), stdout);
+    std::fputs(part.errors.c_str(), stderr);
+    failed |= part.failed;
+    counts.add(part.counts);
+  }
+  if (task.what == command::stats) {
+    print_stats(counts);
+  }
+  return failed ? 1 : 0;
+}
 
 int main(int argc, char **argv) {
+  if (argc >= 2) {
+    const int status = run_command(argc, argv);
+    if (status >= 0) {
+      return status;
+    }
+  }
   if (argc != 2) {
-    fprintf(stderr, "Usage: %s <jsonc file>\n", argv[0]);
+    usage_error(argv[0]);
     return 0;
   }
-  const std::string source = read_file(argv[1]);
-  jsonc_value value;
-  bool is_error;
-  if (jsonc_parse(source.c_str(), &value, &is_error)) {
-    return 1;
+  std::FILE *const file = std::fopen(argv[1], "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", argv[1]);
+    return 0;
   }
-  if (is_error) {
-    std::cout << "Error" << std::endl;
+  const jsonc::result<jsonc::document> document = jsonc::parse_file(file);
+  std::fclose(file);
+  if (!document) {
+    const jsonc::error &error = document.error();
+    std::cout << "Error at line " << error.line() << ", column "
+              << error.column() << ": " << error.message() << std::endl;
     return 0;
   }
-  print_value(value);
+  print_value(document->root());
   std::cout << std::endl;
-  jsonc_free(value);
   return 0;
 }
 
-static void print_array(const jsonc_array &array) {
+static void print_array(jsonc::value_ref array) {
   std::cout << "[";
-  for (size_t i = 0; i < array.count; i++) {
-    print_value(array.values[i]);
-    if (i < array.count - 1) {
+  bool first = true;
+  for (const jsonc::value_ref value : array.elements()) {
+    if (!first) {
       std::cout << ",";
     }
+    first = false;
+    print_value(value);
   }
   std::cout << "]";
 }
 
-static void print_object(const jsonc_object &object) {
+static void print_object(jsonc::value_ref object) {
   std::cout << "{";
-  for (size_t i = 0; i < object.count; i++) {
-    std::cout << "\"" << object.entries[i].key << "\"" << ":";
-    print_value(object.entries[i].value);
-    if (i <object.count - 1) {
+  bool first = true;
+  for (const auto [key, value] : object.members()) {
+    if (!first) {
       std::cout << ",";
     }
+    first = false;
+    std::cout << "\"" << key << "\"" << ":";
+    print_value(value);
   }
   std::cout << "}";
 }
 
-static void print_value(const jsonc_value &value) {
-  switch (value.type) {
-    case JSONC_VALUE_TYPE_NULL:
+static void print_value(jsonc::value_ref value) {
+  switch (value.type()) {
+    case jsonc::type::null:
       std::cout << "null";
       break;
-    case JSONC_VALUE_TYPE_BOOLEAN:
-      std::cout << (value.value.boolean ? "true" : "false");
+    case jsonc::type::boolean:
+      std::cout << (*value.as_bool() ? "true" : "false");
       break;
-    case JSONC_VALUE_TYPE_NUMBER:
-      std::cout << value.value.number;
+    case jsonc::type::number:
+      std::cout << *value.as_number();
       break;
-    case JSONC_VALUE_TYPE_STRING:
-      std::cout << "\"" << value.value.string << "\"";
+    case jsonc::type::string:
+      std::cout << "\"" << *value.as_string() << "\"";
       break;
-    case JSONC_VALUE_TYPE_ARRAY:
-      print_array(value.value.array);
+    case jsonc::type::array:
+      print_array(value);
       break;
-    case JSONC_VALUE_TYPE_OBJECT:
-      print_object(value.value.object);
+    case jsonc::type::object:
+      print_object(value);
       break;
   }
 }